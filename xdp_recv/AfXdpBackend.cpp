@@ -0,0 +1,453 @@
+#if defined(__linux__)
+
+#include <windows.h>
+#include <afxdp_helper.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/bpf.h>
+#include <linux/if_xdp.h>
+
+#include <vector>
+
+#include "PacketHeaders.h"
+#include "XskBackend.h"
+
+C_ASSERT(sizeof(xdp_desc) == sizeof(XSK_BUFFER_DESCRIPTOR));
+C_ASSERT(FIELD_OFFSET(xdp_desc, len) == FIELD_OFFSET(XSK_BUFFER_DESCRIPTOR, Length));
+
+namespace {
+
+HRESULT LastError()
+{
+    return HRESULT_FROM_WIN32(errno);
+}
+
+enum AfXdpRing : UINT32 {
+    AfXdpRx,
+    AfXdpTx,
+    AfXdpFill,
+    AfXdpCompletion,
+    AfXdpRingCount,
+};
+
+//
+// What a HANDLE from this backend points to: the socket and its mapped
+// rings, which stay mapped until the socket is closed.
+//
+struct AfXdpSocket {
+    int Fd;
+    BYTE* Maps[AfXdpRingCount];
+    SIZE_T MapSizes[AfXdpRingCount];
+    XSK_RING_INFO Rings[AfXdpRingCount];
+};
+
+//
+// An attached program, the XSKMAP it redirects into, and the link that
+// keeps it attached; closing the link detaches it.
+//
+struct AfXdpRedirect {
+    int MapFd;
+    int ProgramFd;
+    int LinkFd;
+};
+
+long Bpf(bpf_cmd Command, _Inout_ bpf_attr* Attributes)
+{
+    return syscall(__NR_bpf, Command, Attributes, sizeof(*Attributes));
+}
+
+bpf_insn Instruction(UINT8 Code, UINT8 Destination, UINT8 Source, INT16 Offset, INT32 Immediate)
+{
+    bpf_insn Insn {};
+    Insn.code = Code;
+    Insn.dst_reg = Destination;
+    Insn.src_reg = Source;
+    Insn.off = Offset;
+    Insn.imm = Immediate;
+    return Insn;
+}
+
+//
+// Assembles the redirect program:
+//
+//   if the frame is Ethernet + IPv4 without options, not a fragment,
+//      + UDP to one of Ports:
+//       return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS);
+//   return XDP_PASS;
+//
+// XDP_PASS in the redirect flags is what a queue without a socket in the
+// map gets. Frames with IP options go to the stack. So do all fragments,
+// the first included: only the first carries the UDP header, so the rest
+// cannot be matched by port, and a datagram split between the socket and
+// the stack could be reassembled by neither.
+//
+std::vector<bpf_insn> AssembleRedirect(int MapFd, _In_reads_(PortCount) const UINT16* Ports, UINT32 PortCount)
+{
+    constexpr UINT8 R0 = BPF_REG_0, R1 = BPF_REG_1, R2 = BPF_REG_2, R3 = BPF_REG_3;
+    constexpr UINT8 R4 = BPF_REG_4, R5 = BPF_REG_5, R6 = BPF_REG_6;
+    constexpr INT16 IpOffset = sizeof(EthernetHeader);
+    constexpr INT16 UdpOffset = IpOffset + sizeof(Ipv4Header);
+
+    std::vector<bpf_insn> Program;
+    std::vector<size_t> ToPass;
+    std::vector<size_t> ToRedirect;
+
+    Program.push_back(Instruction(BPF_ALU64 | BPF_MOV | BPF_X, R6, R1, 0, 0));
+    Program.push_back(Instruction(BPF_LDX | BPF_MEM | BPF_W, R2, R1, FIELD_OFFSET(xdp_md, data), 0));
+    Program.push_back(Instruction(BPF_LDX | BPF_MEM | BPF_W, R3, R1, FIELD_OFFSET(xdp_md, data_end), 0));
+    Program.push_back(Instruction(BPF_ALU64 | BPF_MOV | BPF_X, R4, R2, 0, 0));
+    Program.push_back(Instruction(BPF_ALU64 | BPF_ADD | BPF_K, R4, 0, 0, UdpOffset + sizeof(UdpHeader)));
+    ToPass.push_back(Program.size());
+    Program.push_back(Instruction(BPF_JMP | BPF_JGT | BPF_X, R4, R3, 0, 0));
+
+    //
+    // Loads are little endian, so wire-order constants are byte swapped.
+    //
+    Program.push_back(Instruction(BPF_LDX | BPF_MEM | BPF_H, R5, R2, FIELD_OFFSET(EthernetHeader, EtherType), 0));
+    ToPass.push_back(Program.size());
+    Program.push_back(Instruction(BPF_JMP | BPF_JNE | BPF_K, R5, 0, 0, HostToNet16(EtherTypeIpv4)));
+    Program.push_back(Instruction(BPF_LDX | BPF_MEM | BPF_B, R5, R2, IpOffset, 0));
+    ToPass.push_back(Program.size());
+    Program.push_back(Instruction(BPF_JMP | BPF_JNE | BPF_K, R5, 0, 0, 0x45));
+    Program.push_back(
+        Instruction(BPF_LDX | BPF_MEM | BPF_H, R5, R2, IpOffset + FIELD_OFFSET(Ipv4Header, FlagsAndFragmentOffset), 0));
+    ToPass.push_back(Program.size());
+    Program.push_back(
+        Instruction(BPF_JMP | BPF_JSET | BPF_K, R5, 0, 0, HostToNet16(Ipv4MoreFragments | Ipv4FragmentOffsetMask)));
+    Program.push_back(Instruction(BPF_LDX | BPF_MEM | BPF_B, R5, R2, IpOffset + FIELD_OFFSET(Ipv4Header, Protocol), 0));
+    ToPass.push_back(Program.size());
+    Program.push_back(Instruction(BPF_JMP | BPF_JNE | BPF_K, R5, 0, 0, IpProtocolUdp));
+    Program.push_back(
+        Instruction(BPF_LDX | BPF_MEM | BPF_H, R5, R2, UdpOffset + FIELD_OFFSET(UdpHeader, DestinationPort), 0));
+    for (UINT32 i = 0; i < PortCount; i++) {
+        ToRedirect.push_back(Program.size());
+        Program.push_back(Instruction(BPF_JMP | BPF_JEQ | BPF_K, R5, 0, 0, HostToNet16(Ports[i])));
+    }
+    ToPass.push_back(Program.size());
+    Program.push_back(Instruction(BPF_JMP | BPF_JA, 0, 0, 0, 0));
+
+    size_t Redirect = Program.size();
+    Program.push_back(Instruction(BPF_LDX | BPF_MEM | BPF_W, R2, R6, FIELD_OFFSET(xdp_md, rx_queue_index), 0));
+    Program.push_back(Instruction(BPF_LD | BPF_DW | BPF_IMM, R1, BPF_PSEUDO_MAP_FD, 0, MapFd));
+    Program.push_back(Instruction(0, 0, 0, 0, 0));
+    Program.push_back(Instruction(BPF_ALU64 | BPF_MOV | BPF_K, R3, 0, 0, XDP_PASS));
+    Program.push_back(Instruction(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map));
+    Program.push_back(Instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+    size_t Pass = Program.size();
+    Program.push_back(Instruction(BPF_ALU64 | BPF_MOV | BPF_K, R0, 0, 0, XDP_PASS));
+    Program.push_back(Instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+    for (size_t Jump : ToPass) {
+        Program[Jump].off = (INT16)(Pass - Jump - 1);
+    }
+    for (size_t Jump : ToRedirect) {
+        Program[Jump].off = (INT16)(Redirect - Jump - 1);
+    }
+    return Program;
+}
+
+class AfXdpBackend : public XskBackend {
+  public:
+    const char* Name() const override { return "Linux AF_XDP"; }
+
+    HRESULT CreateSocket(_Out_ HANDLE* Socket) override
+    {
+        *Socket = nullptr;
+
+        int Fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+        if (Fd < 0) {
+            return LastError();
+        }
+
+        AfXdpSocket* Xsk = new AfXdpSocket {};
+        Xsk->Fd = Fd;
+        *Socket = Xsk;
+        return S_OK;
+    }
+
+    void CloseSocket(HANDLE Socket) override
+    {
+        AfXdpSocket* Xsk = (AfXdpSocket*)Socket;
+        for (UINT32 i = 0; i < AfXdpRingCount; i++) {
+            if (Xsk->Maps[i] != nullptr) {
+                munmap(Xsk->Maps[i], Xsk->MapSizes[i]);
+            }
+        }
+        close(Xsk->Fd);
+        delete Xsk;
+    }
+
+    _Ret_maybenull_ VOID* AllocateUmem(SIZE_T Size) override
+    {
+        VOID* Memory = mmap(nullptr, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        return Memory != MAP_FAILED ? Memory : nullptr;
+    }
+
+    void FreeUmem(_In_ VOID* Memory, SIZE_T Size) override { munmap(Memory, Size); }
+
+    HRESULT RegisterUmem(HANDLE Socket, const XSK_UMEM_REG& Umem) override
+    {
+        xdp_umem_reg Reg {};
+        Reg.addr = (UINT64)Umem.Address;
+        Reg.len = Umem.TotalSize;
+        Reg.chunk_size = Umem.ChunkSize;
+        Reg.headroom = Umem.Headroom;
+        if (setsockopt(((AfXdpSocket*)Socket)->Fd, SOL_XDP, XDP_UMEM_REG, &Reg, sizeof(Reg)) != 0) {
+            return LastError();
+        }
+        return S_OK;
+    }
+
+    //
+    // Linux sizes the rings before the bind, and the socket that registered
+    // the UMEM has to have both a fill and a completion ring even if it only
+    // receives; a missing one gets the size of the other.
+    //
+    HRESULT Bind(
+        HANDLE Socket,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        XSK_BIND_FLAGS Flags,
+        const XskRingSizes& Sizes) override
+    {
+        AfXdpSocket* Xsk = (AfXdpSocket*)Socket;
+
+        UINT32 Entries[AfXdpRingCount];
+        Entries[AfXdpRx] = (Flags & XSK_BIND_FLAG_RX) ? Sizes.Rx : 0;
+        Entries[AfXdpTx] = (Flags & XSK_BIND_FLAG_TX) ? Sizes.Tx : 0;
+        Entries[AfXdpFill] = Sizes.Fill != 0 ? Sizes.Fill : Sizes.Completion;
+        Entries[AfXdpCompletion] = Sizes.Completion != 0 ? Sizes.Completion : Sizes.Fill;
+
+        static const int Options[AfXdpRingCount] = {
+            XDP_RX_RING, XDP_TX_RING, XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING};
+        for (UINT32 i = 0; i < AfXdpRingCount; i++) {
+            if (Entries[i] != 0 && setsockopt(Xsk->Fd, SOL_XDP, Options[i], &Entries[i], sizeof(Entries[i])) != 0) {
+                return LastError();
+            }
+        }
+
+        xdp_mmap_offsets Offsets {};
+        socklen_t Length = sizeof(Offsets);
+        if (getsockopt(Xsk->Fd, SOL_XDP, XDP_MMAP_OFFSETS, &Offsets, &Length) != 0) {
+            return LastError();
+        }
+
+        const xdp_ring_offset* RingOffsets[AfXdpRingCount] = {&Offsets.rx, &Offsets.tx, &Offsets.fr, &Offsets.cr};
+        static const off_t PageOffsets[AfXdpRingCount] = {
+            XDP_PGOFF_RX_RING, XDP_PGOFF_TX_RING, XDP_UMEM_PGOFF_FILL_RING, XDP_UMEM_PGOFF_COMPLETION_RING};
+        static const UINT32 Strides[AfXdpRingCount] = {
+            sizeof(xdp_desc), sizeof(xdp_desc), sizeof(UINT64), sizeof(UINT64)};
+
+        for (UINT32 i = 0; i < AfXdpRingCount; i++) {
+            if (Entries[i] == 0) {
+                continue;
+            }
+
+            SIZE_T Size = RingOffsets[i]->desc + (SIZE_T)Entries[i] * Strides[i];
+            VOID* Map = mmap(nullptr, Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Xsk->Fd, PageOffsets[i]);
+            if (Map == MAP_FAILED) {
+                return LastError();
+            }
+            Xsk->Maps[i] = (BYTE*)Map;
+            Xsk->MapSizes[i] = Size;
+
+            XSK_RING_INFO& Info = Xsk->Rings[i];
+            Info.Ring = Xsk->Maps[i];
+            Info.DescriptorsOffset = (UINT32)RingOffsets[i]->desc;
+            Info.ProducerIndexOffset = (UINT32)RingOffsets[i]->producer;
+            Info.ConsumerIndexOffset = (UINT32)RingOffsets[i]->consumer;
+            Info.FlagsOffset = (UINT32)RingOffsets[i]->flags;
+            Info.Size = Entries[i];
+            Info.ElementStride = Strides[i];
+        }
+
+        //
+        // Without XDP_COPY or XDP_ZEROCOPY the kernel uses zero copy where
+        // the driver supports it and falls back to copying otherwise.
+        //
+        sockaddr_xdp Address {};
+        Address.sxdp_family = AF_XDP;
+        Address.sxdp_flags = XDP_USE_NEED_WAKEUP;
+        Address.sxdp_ifindex = IfIndex;
+        Address.sxdp_queue_id = QueueId;
+        if (bind(Xsk->Fd, (sockaddr*)&Address, sizeof(Address)) != 0) {
+            return LastError();
+        }
+        return S_OK;
+    }
+
+    HRESULT GetRingInfo(HANDLE Socket, _Out_ XSK_RING_INFO_SET* Rings) override
+    {
+        AfXdpSocket* Xsk = (AfXdpSocket*)Socket;
+        Rings->Rx = Xsk->Rings[AfXdpRx];
+        Rings->Tx = Xsk->Rings[AfXdpTx];
+        Rings->Fill = Xsk->Rings[AfXdpFill];
+        Rings->Completion = Xsk->Rings[AfXdpCompletion];
+        return S_OK;
+    }
+
+    //
+    // The program is attached through a BPF link (Linux 5.9 and later), in
+    // native mode if the driver has it and generic mode otherwise.
+    //
+    HRESULT RedirectUdp(
+        HANDLE Socket,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        _In_reads_(PortCount) const UINT16* Ports,
+        UINT32 PortCount,
+        _Out_ HANDLE* Program) override
+    {
+        *Program = nullptr;
+
+        AfXdpRedirect Redirect {-1, -1, -1};
+        HRESULT Result = CreateRedirect(((AfXdpSocket*)Socket)->Fd, IfIndex, QueueId, Ports, PortCount, &Redirect);
+        if (FAILED(Result)) {
+            CloseRedirect(Redirect);
+            return Result;
+        }
+
+        *Program = new AfXdpRedirect(Redirect);
+        return S_OK;
+    }
+
+    void CloseProgram(HANDLE Program) override
+    {
+        AfXdpRedirect* Redirect = (AfXdpRedirect*)Program;
+        CloseRedirect(*Redirect);
+        delete Redirect;
+    }
+
+    //
+    // A wait is a poll() on the socket, which also wakes the driver for RX;
+    // a TX poke is an empty sendto(), an RX poke an empty recvfrom(). The
+    // result comes from the rings themselves, so a timed-out wait succeeds
+    // with no flags set.
+    //
+    HRESULT Notify(
+        HANDLE Socket,
+        XSK_NOTIFY_FLAGS Flags,
+        UINT32 TimeoutMs,
+        _Out_ XSK_NOTIFY_RESULT_FLAGS* Result) override
+    {
+        AfXdpSocket* Xsk = (AfXdpSocket*)Socket;
+        *Result = XSK_NOTIFY_RESULT_FLAG_NONE;
+
+        if ((Flags & XSK_NOTIFY_FLAG_POKE_TX) &&
+            sendto(Xsk->Fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0) < 0 && !IsBenignPokeError(errno)) {
+            return LastError();
+        }
+
+        if (Flags & (XSK_NOTIFY_FLAG_WAIT_RX | XSK_NOTIFY_FLAG_WAIT_TX)) {
+            pollfd Poll {};
+            Poll.fd = Xsk->Fd;
+            Poll.events = ((Flags & XSK_NOTIFY_FLAG_WAIT_RX) ? POLLIN : 0) |
+                ((Flags & XSK_NOTIFY_FLAG_WAIT_TX) ? POLLOUT : 0);
+            if (poll(&Poll, 1, TimeoutMs == INFINITE ? -1 : (int)TimeoutMs) < 0 && errno != EINTR) {
+                return LastError();
+            }
+        } else if (
+            (Flags & XSK_NOTIFY_FLAG_POKE_RX) &&
+            recvfrom(Xsk->Fd, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr) < 0 && !IsBenignPokeError(errno)) {
+            return LastError();
+        }
+
+        if ((Flags & XSK_NOTIFY_FLAG_WAIT_RX) && RingHasEntries(Xsk->Rings[AfXdpRx])) {
+            *Result |= XSK_NOTIFY_RESULT_FLAG_RX_AVAILABLE;
+        }
+        if ((Flags & XSK_NOTIFY_FLAG_WAIT_TX) && RingHasEntries(Xsk->Rings[AfXdpCompletion])) {
+            *Result |= XSK_NOTIFY_RESULT_FLAG_TX_COMP_AVAILABLE;
+        }
+        return S_OK;
+    }
+
+    bool NeedsPoke(const XSK_RING* Ring) const override { return XskRingGetFlags(Ring) & XDP_RING_NEED_WAKEUP; }
+
+  private:
+    static bool IsBenignPokeError(int Error)
+    {
+        return Error == EAGAIN || Error == EBUSY || Error == ENOBUFS || Error == ENETDOWN;
+    }
+
+    static bool RingHasEntries(const XSK_RING_INFO& Info)
+    {
+        if (Info.Ring == nullptr) {
+            return false;
+        }
+        UINT32 Producer = ReadUInt32Acquire((UINT32*)(Info.Ring + Info.ProducerIndexOffset));
+        return Producer != *(volatile UINT32*)(Info.Ring + Info.ConsumerIndexOffset);
+    }
+
+    static HRESULT CreateRedirect(
+        int SocketFd,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        _In_reads_(PortCount) const UINT16* Ports,
+        UINT32 PortCount,
+        _Inout_ AfXdpRedirect* Redirect)
+    {
+        bpf_attr Attributes {};
+        Attributes.map_type = BPF_MAP_TYPE_XSKMAP;
+        Attributes.key_size = sizeof(UINT32);
+        Attributes.value_size = sizeof(int);
+        Attributes.max_entries = QueueId + 1;
+        Redirect->MapFd = (int)Bpf(BPF_MAP_CREATE, &Attributes);
+        if (Redirect->MapFd < 0) {
+            return LastError();
+        }
+
+        Attributes = {};
+        Attributes.map_fd = Redirect->MapFd;
+        Attributes.key = (UINT64)&QueueId;
+        Attributes.value = (UINT64)&SocketFd;
+        Attributes.flags = BPF_ANY;
+        if (Bpf(BPF_MAP_UPDATE_ELEM, &Attributes) != 0) {
+            return LastError();
+        }
+
+        std::vector<bpf_insn> Instructions = AssembleRedirect(Redirect->MapFd, Ports, PortCount);
+        static const char License[] = "Dual MIT/GPL";
+        Attributes = {};
+        Attributes.prog_type = BPF_PROG_TYPE_XDP;
+        Attributes.insns = (UINT64)Instructions.data();
+        Attributes.insn_cnt = (UINT32)Instructions.size();
+        Attributes.license = (UINT64)License;
+        Redirect->ProgramFd = (int)Bpf(BPF_PROG_LOAD, &Attributes);
+        if (Redirect->ProgramFd < 0) {
+            return LastError();
+        }
+
+        Attributes = {};
+        Attributes.link_create.prog_fd = Redirect->ProgramFd;
+        Attributes.link_create.target_ifindex = IfIndex;
+        Attributes.link_create.attach_type = BPF_XDP;
+        Redirect->LinkFd = (int)Bpf(BPF_LINK_CREATE, &Attributes);
+        if (Redirect->LinkFd < 0) {
+            return LastError();
+        }
+        return S_OK;
+    }
+
+    static void CloseRedirect(const AfXdpRedirect& Redirect)
+    {
+        for (int Fd : {Redirect.LinkFd, Redirect.ProgramFd, Redirect.MapFd}) {
+            if (Fd >= 0) {
+                close(Fd);
+            }
+        }
+    }
+};
+
+} // namespace
+
+std::unique_ptr<XskBackend> CreateAfXdpBackend()
+{
+    return std::make_unique<AfXdpBackend>();
+}
+
+#endif
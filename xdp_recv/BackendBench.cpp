@@ -0,0 +1,208 @@
+#include "SocketApi.h"
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <xdpapi.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BackendReceiver.h"
+#include "Benchmarks.h"
+#include "XskBackend.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+//
+// Source ports the sender spreads its datagrams over, one flow each.
+//
+constexpr UINT32 SenderFlows = 4;
+
+//
+// How long the receiver gets to set up before the sender starts, and to
+// drain after it stops.
+//
+constexpr auto ReceiverSetup = std::chrono::milliseconds(500);
+constexpr auto ReceiverDrain = std::chrono::seconds(1);
+
+struct BackendRunResult {
+    HRESULT Result;
+    UINT64 Sent;
+    double SendSeconds;
+    BackendReceiverStats Stats;
+};
+
+//
+// Sends Payload-byte datagrams to 127.0.0.1:Port from SenderFlows sockets in
+// turn, as fast as it can, for Seconds. Returns the number sent.
+//
+UINT64 SendLoopback(UINT16 Port, UINT32 Payload, UINT32 Seconds, _Out_ double* SendSeconds)
+{
+    SOCKET Sockets[SenderFlows];
+    for (UINT32 i = 0; i < SenderFlows; i++) {
+        Sockets[i] = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    }
+
+    sockaddr_in Destination {};
+    Destination.sin_family = AF_INET;
+    Destination.sin_port = htons(Port);
+    Destination.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    std::vector<char> Datagram(Payload, 'x');
+    UINT64 Sent = 0;
+    Clock::time_point Start = Clock::now();
+    Clock::time_point End = Start + std::chrono::seconds(Seconds);
+    while (Clock::now() < End) {
+        for (UINT32 Burst = 0; Burst < 256; Burst++) {
+            SOCKET Socket = Sockets[Sent % SenderFlows];
+            if (Socket != INVALID_SOCKET &&
+                sendto(Socket, Datagram.data(), (int)Payload, 0, (sockaddr*)&Destination, sizeof(Destination)) ==
+                    (int)Payload) {
+                Sent++;
+            }
+        }
+    }
+    *SendSeconds = std::chrono::duration<double>(Clock::now() - Start).count();
+
+    for (SOCKET Socket : Sockets) {
+        if (Socket != INVALID_SOCKET) {
+            closesocket(Socket);
+        }
+    }
+    return Sent;
+}
+
+//
+// Runs the portable receiver on Backend in a thread of its own while this
+// thread sends to it over loopback.
+//
+BackendRunResult RunBackend(XskBackend& Backend, UINT32 IfIndex, UINT32 Seconds, UINT32 Payload, UINT16 Port)
+{
+    BackendRunResult Run {};
+
+    BackendReceiverConfig Config;
+    Config.IfIndex = IfIndex;
+    Config.Ports = {Port};
+    Config.Seconds = Seconds + 2;
+    Config.WaitMs = 10;
+
+    std::atomic<bool> Finished = false;
+    std::thread Receiver([&]() {
+        Run.Result = RunBackendReceiver(Backend, Config, nullptr, &Run.Stats);
+        Finished = true;
+    });
+
+    std::this_thread::sleep_for(ReceiverSetup);
+    if (!Finished) {
+        Run.Sent = SendLoopback(Port, Payload, Seconds, &Run.SendSeconds);
+    }
+    Receiver.join();
+    return Run;
+}
+
+void PrintBackendRun(_In_ const XskBackend& Backend, const BackendRunResult& Run)
+{
+    if (FAILED(Run.Result)) {
+        printf("%-22s unavailable (%x)\n", Backend.Name(), (UINT32)Run.Result);
+        return;
+    }
+
+    UINT64 Received = Run.Stats.Frames;
+    UINT64 Lost = Run.Sent > Received ? Run.Sent - Received : 0;
+    printf(
+        "%-22s %12llu %12llu %8.2f%% %10.3f %10.3f %8.1f\n",
+        Backend.Name(),
+        (unsigned long long)Run.Sent,
+        (unsigned long long)Received,
+        Run.Sent != 0 ? 100.0 * Lost / Run.Sent : 0.0,
+        Run.SendSeconds > 0 ? Run.Sent / Run.SendSeconds / 1e6 : 0.0,
+        Run.SendSeconds > 0 ? Received / Run.SendSeconds / 1e6 : 0.0,
+        Run.Stats.Bursts != 0 ? (double)Received / Run.Stats.Bursts : 0.0);
+}
+
+} // namespace
+
+//
+// The XSK path against the socket fallback, both under the same receiver
+// and fed by the same loopback sender. The sender shares the machine, so
+// this compares what each backend costs per frame rather than what either
+// could do on a NIC. XDP for Windows does not attach to the loopback
+// interface and reports itself unavailable; on Linux, AF_XDP runs on lo in
+// generic mode.
+//
+int BackendBenchmark(int argc, char** argv)
+{
+    UINT32 IfIndex = argc >= 1 ? atoi(argv[0]) : 0;
+    UINT32 Seconds = argc >= 2 ? atoi(argv[1]) : 5;
+    UINT32 Payload = argc >= 3 ? atoi(argv[2]) : 64;
+    UINT16 Port = argc >= 4 ? (UINT16)atoi(argv[3]) : 0x4321;
+    if (IfIndex == 0 || Seconds == 0 || Payload == 0 || Payload > 1400 || Port == 0) {
+        fprintf(stderr, "backends <loopback IfIndex> [seconds] [payload] [port]\n");
+        return EXIT_FAILURE;
+    }
+
+#if defined(_WIN32)
+    WSADATA WsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0) {
+        fprintf(stderr, "WSAStartup failed\n");
+        return EXIT_FAILURE;
+    }
+
+    const XDP_API_TABLE* XdpApi = nullptr;
+    std::unique_ptr<XskBackend> Xsk;
+    if (SUCCEEDED(XdpOpenApi(XDP_API_VERSION_1, &XdpApi))) {
+        Xsk = CreateXdpBackend(XdpApi);
+    }
+#else
+    std::unique_ptr<XskBackend> Xsk = CreateAfXdpBackend();
+#endif
+    std::unique_ptr<XskBackend> Sockets = CreateSocketBackend();
+
+    printf(
+        "%u s of %u-byte datagrams to 127.0.0.1:%u over interface %u, %u flows\n\n",
+        Seconds,
+        Payload,
+        Port,
+        IfIndex,
+        SenderFlows);
+    printf(
+        "%-22s %12s %12s %9s %10s %10s %8s\n",
+        "backend",
+        "sent",
+        "received",
+        "loss",
+        "sent Mpps",
+        "recv Mpps",
+        "burst");
+
+    if (Xsk != nullptr) {
+        PrintBackendRun(*Xsk, RunBackend(*Xsk, IfIndex, Seconds, Payload, Port));
+    } else {
+        printf("%-22s unavailable (no XDP API)\n", "XDP");
+    }
+
+    //
+    // Let the first receiver's sockets and programs go before the second
+    // binds the same port.
+    //
+    std::this_thread::sleep_for(ReceiverDrain);
+    PrintBackendRun(*Sockets, RunBackend(*Sockets, IfIndex, Seconds, Payload, Port));
+
+#if defined(_WIN32)
+    Xsk.reset();
+    if (XdpApi != nullptr) {
+        XdpApi->XdpCloseApi(XdpApi);
+    }
+    WSACleanup();
+#endif
+    return EXIT_SUCCESS;
+}
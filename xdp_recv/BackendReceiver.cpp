@@ -0,0 +1,276 @@
+#include <windows.h>
+#include <afxdp_helper.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <memory>
+
+#include "BackendReceiver.h"
+#include "ChainedFrame.h"
+#include "FillRingRefiller.h"
+#include "FlowTable.h"
+#include "RxBurstPipeline.h"
+#include "UmemFramePool.h"
+
+namespace {
+
+struct ReceiverFlow {
+    UINT64 Frames;
+    UINT64 Bytes;
+};
+
+//
+// What the receiver holds on the backend, released in reverse order of
+// creation however it returns.
+//
+struct BackendResources {
+    XskBackend& Backend;
+    VOID* Umem = nullptr;
+    SIZE_T UmemSize = 0;
+    HANDLE Socket = nullptr;
+    HANDLE Program = nullptr;
+
+    ~BackendResources()
+    {
+        if (Program != nullptr) {
+            Backend.CloseProgram(Program);
+        }
+        if (Socket != nullptr) {
+            Backend.CloseSocket(Socket);
+        }
+        if (Umem != nullptr) {
+            Backend.FreeUmem(Umem, UmemSize);
+        }
+    }
+};
+
+bool ParsePorts(_In_z_ const char* List, _Out_ std::vector<UINT16>* Ports)
+{
+    Ports->clear();
+    const char* Next = List;
+    while (*Next != '\0') {
+        char* End;
+        unsigned long Port = strtoul(Next, &End, 10);
+        if (End == Next || Port == 0 || Port > MAXUINT16 || (*End != ',' && *End != '\0')) {
+            return false;
+        }
+        Ports->push_back((UINT16)Port);
+        Next = *End == ',' ? End + 1 : End;
+    }
+    return !Ports->empty();
+}
+
+} // namespace
+
+HRESULT RunBackendReceiver(
+    XskBackend& Backend,
+    const BackendReceiverConfig& Config,
+    _In_opt_ FILE* Output,
+    _Out_ BackendReceiverStats* Stats)
+{
+    using Clock = std::chrono::steady_clock;
+
+    *Stats = {};
+
+    if (Config.RingSize == 0 || (Config.RingSize & (Config.RingSize - 1)) != 0 || Config.ChunkSize == 0 ||
+        (Config.ChunkSize & (Config.ChunkSize - 1)) != 0 || Config.Ports.empty()) {
+        return E_INVALIDARG;
+    }
+
+    //
+    // A fill ring's worth of chunks in flight and as many again held by the
+    // loop and the pool, so a full RX ring never leaves the fill ring empty.
+    //
+    BackendResources Resources {Backend};
+    UINT32 ChunkCount = 2 * Config.RingSize;
+    Resources.UmemSize = (SIZE_T)ChunkCount * Config.ChunkSize;
+    Resources.Umem = Backend.AllocateUmem(Resources.UmemSize);
+    if (Resources.Umem == nullptr) {
+        return E_OUTOFMEMORY;
+    }
+    UCHAR* Umem = (UCHAR*)Resources.Umem;
+
+    if (auto Result = Backend.CreateSocket(&Resources.Socket); FAILED(Result)) {
+        return Result;
+    }
+
+    XSK_UMEM_REG UmemReg {};
+    UmemReg.TotalSize = Resources.UmemSize;
+    UmemReg.ChunkSize = Config.ChunkSize;
+    UmemReg.Address = Umem;
+    if (auto Result = Backend.RegisterUmem(Resources.Socket, UmemReg); FAILED(Result)) {
+        return Result;
+    }
+
+    XskRingSizes Sizes {};
+    Sizes.Rx = Config.RingSize;
+    Sizes.Fill = Config.RingSize;
+    if (auto Result = Backend.Bind(Resources.Socket, Config.IfIndex, Config.QueueId, XSK_BIND_FLAG_RX, Sizes);
+        FAILED(Result)) {
+        return Result;
+    }
+
+    XSK_RING_INFO_SET RingInfo;
+    if (auto Result = Backend.GetRingInfo(Resources.Socket, &RingInfo); FAILED(Result)) {
+        return Result;
+    }
+
+    XSK_RING RxRing;
+    XSK_RING FillRing;
+    XskRingInitialize(&RxRing, &RingInfo.Rx);
+    XskRingInitialize(&FillRing, &RingInfo.Fill);
+
+    UmemFramePool Pool(ChunkCount);
+    Pool.AddRegion(0, ChunkCount, Config.ChunkSize);
+    FillRingRefiller Refiller(&FillRing, &Pool, Config.RingSize / 2);
+    Refiller.Refill();
+
+    if (auto Result = Backend.RedirectUdp(
+            Resources.Socket,
+            Config.IfIndex,
+            Config.QueueId,
+            Config.Ports.data(),
+            (UINT32)Config.Ports.size(),
+            &Resources.Program);
+        FAILED(Result)) {
+        return Result;
+    }
+
+    FlowTableConfig FlowConfig;
+    FlowConfig.MaxFlows = Config.MaxFlows;
+    FlowTable<ReceiverFlow> Flows(FlowConfig);
+    RxBurstPipeline<ReceiverFlow> Pipeline(&Flows, Config.PrefetchDistance);
+    auto Frames = std::make_unique<ChainedFrame[]>(RxBurstPipeline<ReceiverFlow>::MaxBurst);
+
+    if (Output != nullptr) {
+        fprintf(
+            Output,
+            "%s: receiving on interface %u queue %u for %u s\n",
+            Backend.Name(),
+            Config.IfIndex,
+            Config.QueueId,
+            Config.Seconds);
+    }
+
+    Clock::time_point Start = Clock::now();
+    Clock::time_point End = Start + std::chrono::seconds(Config.Seconds);
+    Clock::time_point NextReport = Start + std::chrono::seconds(1);
+    UINT64 ReportedFrames = 0;
+    UINT64 ChunkMask = ~(UINT64)(Config.ChunkSize - 1);
+
+    for (;;) {
+        Clock::time_point Now = Clock::now();
+        if (Now >= NextReport) {
+            if (Output != nullptr) {
+                fprintf(
+                    Output,
+                    "%10llu frames  %8.3f Mpps  %6u flows\n",
+                    (unsigned long long)Stats->Frames,
+                    (Stats->Frames - ReportedFrames) / 1e6,
+                    Flows.Flows());
+            }
+            ReportedFrames = Stats->Frames;
+            NextReport += std::chrono::seconds(1);
+        }
+        if (Now >= End) {
+            break;
+        }
+
+        UINT32 Index;
+        UINT32 Count = XskRingConsumerReserve(&RxRing, RxBurstPipeline<ReceiverFlow>::MaxBurst, &Index);
+        if (Count == 0) {
+            XSK_NOTIFY_RESULT_FLAGS Ready;
+            Backend.Notify(Resources.Socket, XSK_NOTIFY_FLAG_WAIT_RX, Config.WaitMs, &Ready);
+            Stats->Waits++;
+            continue;
+        }
+
+        //
+        // On Linux the descriptor address is a plain UMEM offset, which reads
+        // as BaseAddress with a zero Offset; either way the chunk is found by
+        // rounding down.
+        //
+        for (UINT32 i = 0; i < Count; i++) {
+            const XSK_BUFFER_DESCRIPTOR* Buffer = (XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&RxRing, Index + i);
+            UINT64 Data = Buffer->Address.BaseAddress + Buffer->Address.Offset;
+            Frames[i].Reset();
+            Frames[i].Append(Data & ChunkMask, Umem + Data, Buffer->Length);
+        }
+
+        UINT64 NowTick = (UINT64)Now.time_since_epoch().count();
+        Pipeline.Run(Frames.get(), Count, NowTick, [&](UINT32 Frame, ReceiverFlow* Flow) {
+            UINT32 Length = Frames[Frame].Length();
+            if (Flow != nullptr) {
+                Flow->Frames++;
+                Flow->Bytes += Length;
+            } else {
+                Stats->NonIpv4Frames++;
+            }
+            Stats->Bytes += Length;
+        });
+
+        for (UINT32 i = 0; i < Count; i++) {
+            Pool.Free(Frames[i].Segment(0).Address);
+        }
+        XskRingConsumerRelease(&RxRing, Count);
+        Stats->Frames += Count;
+        Stats->Bursts++;
+
+        Refiller.Refill();
+        if (Backend.NeedsPoke(&FillRing)) {
+            XSK_NOTIFY_RESULT_FLAGS Ready;
+            Backend.Notify(Resources.Socket, XSK_NOTIFY_FLAG_POKE_RX, 0, &Ready);
+            Stats->Pokes++;
+        }
+    }
+
+    Stats->Seconds = std::chrono::duration<double>(Clock::now() - Start).count();
+    Stats->Flows = Flows.Flows();
+    Stats->FillStarvationEvents = Refiller.Statistics().StarvationEvents;
+    return S_OK;
+}
+
+void PrintBackendReceiverStats(_In_ FILE* Output, const BackendReceiverStats& Stats)
+{
+    fprintf(
+        Output,
+        "frames: %llu (%.3f Mpps), bytes: %llu, bursts: %llu (%.1f frames each), flows: %llu, non-IPv4: %llu\n"
+        "waits: %llu, pokes: %llu, fill starvation events: %llu\n",
+        (unsigned long long)Stats.Frames,
+        Stats.Seconds > 0 ? Stats.Frames / Stats.Seconds / 1e6 : 0.0,
+        (unsigned long long)Stats.Bytes,
+        (unsigned long long)Stats.Bursts,
+        Stats.Bursts != 0 ? (double)Stats.Frames / Stats.Bursts : 0.0,
+        (unsigned long long)Stats.Flows,
+        (unsigned long long)Stats.NonIpv4Frames,
+        (unsigned long long)Stats.Waits,
+        (unsigned long long)Stats.Pokes,
+        (unsigned long long)Stats.FillStarvationEvents);
+}
+
+int BackendReceiveCommand(XskBackend& Backend, _In_opt_ XskBackend* Fallback, int argc, char** argv)
+{
+    BackendReceiverConfig Config;
+    Config.IfIndex = argc >= 1 ? atoi(argv[0]) : 0;
+    Config.QueueId = argc >= 2 ? atoi(argv[1]) : 0;
+    Config.Seconds = argc >= 3 ? atoi(argv[2]) : Config.Seconds;
+    if (Config.IfIndex == 0 || (argc >= 4 && !ParsePorts(argv[3], &Config.Ports))) {
+        fprintf(stderr, "usage: <IfIndex> [QueueId] [Seconds] [Ports]\n");
+        return EXIT_FAILURE;
+    }
+
+    BackendReceiverStats Stats;
+    auto Result = RunBackendReceiver(Backend, Config, stdout, &Stats);
+    if (FAILED(Result) && Fallback != nullptr) {
+        fprintf(stderr, "%s failed: %x, falling back to %s\n", Backend.Name(), Result, Fallback->Name());
+        Result = RunBackendReceiver(*Fallback, Config, stdout, &Stats);
+    }
+    if (FAILED(Result)) {
+        fprintf(stderr, "RunBackendReceiver failed: %x\n", Result);
+        return EXIT_FAILURE;
+    }
+
+    PrintBackendReceiverStats(stdout, Stats);
+    return EXIT_SUCCESS;
+}
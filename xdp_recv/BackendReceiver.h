@@ -0,0 +1,66 @@
+#pragma once
+
+#include <windows.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "XskBackend.h"
+
+struct BackendReceiverConfig {
+    UINT32 IfIndex = 0;
+    UINT32 QueueId = 0;
+
+    //
+    // UDP destination ports redirected to the socket, in host byte order.
+    //
+    std::vector<UINT16> Ports {0x4321};
+
+    UINT32 Seconds = 10;
+    UINT32 RingSize = 2048;
+    UINT32 ChunkSize = 2048;
+    UINT32 PrefetchDistance = 4;
+    UINT32 MaxFlows = 65536;
+
+    //
+    // How long an idle receiver sleeps in the backend's notify before it
+    // checks the clock again.
+    //
+    UINT32 WaitMs = 100;
+};
+
+struct BackendReceiverStats {
+    UINT64 Frames;
+    UINT64 Bytes;
+    UINT64 Bursts;
+    UINT64 Waits;
+    UINT64 Pokes;
+    UINT64 Flows;
+    UINT64 NonIpv4Frames;
+    UINT64 FillStarvationEvents;
+    double Seconds;
+};
+
+//
+// The receive path on top of an XskBackend: one socket on one queue, a UMEM
+// cycled through a frame pool and fill refiller, and bursts run through the
+// prefetching flow pipeline, counting frames per 5-tuple. It is the same
+// code on every backend; only the control calls differ.
+//
+// Runs for Config.Seconds, printing a line per second to Output unless it
+// is null.
+//
+HRESULT RunBackendReceiver(
+    XskBackend& Backend,
+    const BackendReceiverConfig& Config,
+    _In_opt_ FILE* Output,
+    _Out_ BackendReceiverStats* Stats);
+
+void PrintBackendReceiverStats(_In_ FILE* Output, const BackendReceiverStats& Stats);
+
+//
+// The receive command of both front ends: <IfIndex> [QueueId] [Seconds]
+// [Ports], with Ports a comma separated list. If Backend cannot set up the
+// receiver (XDP missing, or access denied), it runs on Fallback instead.
+//
+int BackendReceiveCommand(XskBackend& Backend, _In_opt_ XskBackend* Fallback, int argc, char** argv);
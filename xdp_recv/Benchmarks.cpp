@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Benchmarks.h"
+
+struct Benchmark {
+    const char* Name;
+    const char* Usage;
+    int (*Run)(int argc, char** argv);
+};
+
+static const Benchmark Benchmarks[] {
+    {"tsc", "tsc [drift-seconds]   cost per clock read and TSC drift against the OS clocks", TscClockBenchmark},
+    {"fill",
+     "fill [pps] [hold-us] [seconds] [ring] [spare]   fill ring drops with a slow consumer, per refill policy",
+     FillRingBenchmark},
+    {"swap",
+     "swap [pps] [swaps] [interval-ms] [attach-us]   frames lost while hot-swapping the rule set, per swap order",
+     RuleSwapBenchmark},
+    {"rules",
+     "rules [groups] [ports-per-group] [any-address-ports] [frames]   compiled vs one-rule-per-subscription programs",
+     UdpRuleBenchmark},
+    {"rss-sim",
+     "rss-sim [recording|-] [queues] [table-size] [periods] [capacity-pps]   RSS rebalancer over recorded flow rates",
+     RssRebalanceSimulation},
+    {"toeplitz", "toeplitz [count]   software Toeplitz hashes/s, reference vs table vs batch", ToeplitzBenchmark},
+    {"fanout",
+     "fanout [frames] [flows] [work-ns] [max-workers]   software RSS fan-out throughput from 1 to N workers",
+     FanOutBenchmark},
+    {"steal",
+     "steal [workers] [frames] [flows] [cheap-ns] [heavy-ns] [heavy-every]   work stealing vs static flow hashing",
+     WorkStealingBenchmark},
+    {"reasm",
+     "reasm [datagrams] [datagram-bytes] [timeout-ms] [slots]   IPv4 reassembly rate and memory under fragment loss",
+     ReassemblyBenchmark},
+    {"multibuf",
+     "multibuf [frames] [in-flight]   chained multi-buffer RX/TX rate and UMEM use per chunk size",
+     MultiBufferBenchmark},
+    {"timers",
+     "timers [timers] [span-ms] [batch] [resolution-ns]   timer wheel vs binary heap with a million live timers",
+     TimerWheelBenchmark},
+    {"flows",
+     "flows [lookups] [batch] [max-flows]   flow table lookups/s at 10k, 1M and 10M flows vs std::unordered_map",
+     FlowTableBenchmark},
+    {"prefetch",
+     "prefetch [umem-mib] [flows] [work-ns]   RX burst cost per prefetch distance on a UMEM larger than the LLC",
+     RxPipelineBenchmark},
+    {"numa",
+     "numa [umem-mib] [accesses]   UMEM miss latency and read rate with memory on each NUMA node, local vs remote",
+     NumaBenchmark},
+    {"shared-umem",
+     "shared-umem [sockets] [frames] [frame-bytes]   socket-to-socket forwarding, UMEM per socket vs one shared UMEM",
+     SharedUmemBenchmark},
+    {"reactor",
+     "reactor [sockets] [pps-per-socket] [seconds]   wakeup latency and CPU, one IOCP thread vs spinning per socket",
+     XskReactorBenchmark},
+    {"coro",
+     "coro [frames] [burst]   receive cost per frame, co_await ReceiveBurst() vs the hand-written loop",
+     XskCoroutineBenchmark},
+    {"backends",
+     "backends <IfIndex> [seconds] [payload] [port]   loopback receive rate and loss, XSK vs the socket fallback",
+     BackendBenchmark},
+    {"decode",
+     "decode [frames] [messages-per-datagram]   ITCH messages/s from the RX burst, generated views vs copy + switch",
+     DecoderBenchmark},
+    {"book",
+     "book [capture.pcap|-] [datagrams] [instruments] [messages-per-datagram]   order book updates/s and p99 latency",
+     OrderBookBenchmark},
+    {"lvc",
+     "lvc [writes] [keys] [updates-per-second] [consumer-ns-per-update]   last-value cache writes/s and staleness",
+     LastValueCacheBenchmark},
+    {"recovery",
+     "recovery [udp|tcp] [datagrams] [loss-per-million] [loss-burst] [messages/s]   gap recovery from a local server",
+     GapRecoveryBenchmark},
+};
+
+int RunBenchmark(int argc, char** argv)
+{
+    if (argc >= 1) {
+        for (const Benchmark& Bench : Benchmarks) {
+            if (strcmp(argv[0], Bench.Name) == 0) {
+                return Bench.Run(argc - 1, argv + 1);
+            }
+        }
+    }
+
+    fprintf(stderr, "xdp_recv.exe --bench <name> [args...]\n\nAvailable benchmarks:\n");
+    for (const Benchmark& Bench : Benchmarks) {
+        fprintf(stderr, "  %s\n", Bench.Usage);
+    }
+    return EXIT_FAILURE;
+}
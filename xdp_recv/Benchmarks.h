@@ -0,0 +1,34 @@
+#pragma once
+
+//
+// Benchmarks are built into xdp_recv and run with
+//
+//     xdp_recv.exe --bench <name> [args...]
+//
+// Each benchmark receives the arguments that follow its name and returns a
+// process exit code.
+//
+int RunBenchmark(int argc, char** argv);
+
+int TscClockBenchmark(int argc, char** argv);
+int FillRingBenchmark(int argc, char** argv);
+int RuleSwapBenchmark(int argc, char** argv);
+int UdpRuleBenchmark(int argc, char** argv);
+int RssRebalanceSimulation(int argc, char** argv);
+int ToeplitzBenchmark(int argc, char** argv);
+int FanOutBenchmark(int argc, char** argv);
+int WorkStealingBenchmark(int argc, char** argv);
+int ReassemblyBenchmark(int argc, char** argv);
+int MultiBufferBenchmark(int argc, char** argv);
+int TimerWheelBenchmark(int argc, char** argv);
+int FlowTableBenchmark(int argc, char** argv);
+int RxPipelineBenchmark(int argc, char** argv);
+int NumaBenchmark(int argc, char** argv);
+int SharedUmemBenchmark(int argc, char** argv);
+int XskReactorBenchmark(int argc, char** argv);
+int XskCoroutineBenchmark(int argc, char** argv);
+int BackendBenchmark(int argc, char** argv);
+int DecoderBenchmark(int argc, char** argv);
+int OrderBookBenchmark(int argc, char** argv);
+int LastValueCacheBenchmark(int argc, char** argv);
+int GapRecoveryBenchmark(int argc, char** argv);
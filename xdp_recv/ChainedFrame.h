@@ -0,0 +1,167 @@
+#pragma once
+
+#include <windows.h>
+#include <afxdp.h>
+#include <string.h>
+
+#include "UmemFramePool.h"
+
+//
+// One UMEM buffer of a frame. Address is the descriptor's address, base and
+// offset; Data points at the first byte of the frame in the buffer.
+//
+struct FrameSegment {
+    UINT64 Address;
+    UCHAR* Data;
+    UINT32 Length;
+
+    //
+    // The chunk holding the buffer, as the frame pool keeps it, and where in
+    // the chunk Data starts.
+    //
+    UINT64 Chunk() const
+    {
+        XSK_BUFFER_ADDRESS Unpacked;
+        Unpacked.AddressAndOffset = Address;
+        return Unpacked.BaseAddress;
+    }
+
+    UINT32 ChunkOffset() const
+    {
+        XSK_BUFFER_ADDRESS Unpacked;
+        Unpacked.AddressAndOffset = Address;
+        return (UINT32)Unpacked.Offset;
+    }
+};
+
+//
+// A frame spread over one or more UMEM buffers, in wire order. Parsers read
+// it in place: Peek() hands out a pointer into the UMEM when the bytes asked
+// for lie in one buffer and only copies the few header bytes that straddle a
+// boundary, and ForEach() walks a byte range buffer by buffer. Linearize()
+// copies the whole frame for code that needs it contiguous.
+//
+// A single-buffer frame is the common case and costs no more than a bare
+// descriptor. The view does not own its buffers; Release() returns them.
+//
+class ChainedFrame {
+  public:
+    //
+    // A 64 KiB frame in 2 KiB chunks.
+    //
+    static constexpr UINT32 MaxSegments = 32;
+
+    void Reset()
+    {
+        Count = 0;
+        TotalLength = 0;
+    }
+
+    bool Append(UINT64 Address, _In_ UCHAR* Data, UINT32 Length)
+    {
+        if (Count == MaxSegments) {
+            return false;
+        }
+        Segments[Count++] = {Address, Data, Length};
+        TotalLength += Length;
+        return true;
+    }
+
+    UINT32 Length() const { return TotalLength; }
+    UINT32 SegmentCount() const { return Count; }
+    const FrameSegment& Segment(UINT32 Index) const { return Segments[Index]; }
+
+    //
+    // Returns Length bytes at Offset: in place when they are contiguous,
+    // otherwise copied to Scratch, which must hold Length bytes. Returns
+    // nullptr if the frame is shorter than Offset + Length.
+    //
+    const UCHAR* Peek(UINT32 Offset, UINT32 Length, _Out_writes_bytes_(Length) UCHAR* Scratch) const
+    {
+        if (Offset > TotalLength || Length > TotalLength - Offset) {
+            return nullptr;
+        }
+
+        UINT32 Index = 0;
+        while (Index + 1 < Count && Offset >= Segments[Index].Length) {
+            Offset -= Segments[Index++].Length;
+        }
+        if (Length <= Segments[Index].Length - Offset) {
+            return Segments[Index].Data + Offset;
+        }
+
+        CopyFrom(Index, Offset, Scratch, Length);
+        return Scratch;
+    }
+
+    //
+    // Calls Visit(const UCHAR* Data, UINT32 Length) for each contiguous
+    // piece of the Length bytes at Offset. Returns false, without visiting
+    // anything, if the range is out of the frame.
+    //
+    template <typename Visitor>
+    bool ForEach(UINT32 Offset, UINT32 Length, Visitor&& Visit) const
+    {
+        if (Offset > TotalLength || Length > TotalLength - Offset) {
+            return false;
+        }
+
+        for (UINT32 Index = 0; Length != 0; Index++) {
+            if (Offset >= Segments[Index].Length) {
+                Offset -= Segments[Index].Length;
+                continue;
+            }
+            UINT32 Piece = Segments[Index].Length - Offset;
+            if (Piece > Length) {
+                Piece = Length;
+            }
+            Visit((const UCHAR*)Segments[Index].Data + Offset, Piece);
+            Length -= Piece;
+            Offset = 0;
+        }
+        return true;
+    }
+
+    //
+    // Copies the frame to Buffer. Returns the frame length, or 0 if the
+    // buffer is too small.
+    //
+    UINT32 Linearize(_Out_writes_bytes_(BufferLength) UCHAR* Buffer, UINT32 BufferLength) const
+    {
+        if (TotalLength > BufferLength) {
+            return 0;
+        }
+        CopyFrom(0, 0, Buffer, TotalLength);
+        return TotalLength;
+    }
+
+    //
+    // Returns every buffer of the frame to the pool.
+    //
+    void Release(_Inout_ UmemFramePool* Pool) const
+    {
+        for (UINT32 i = 0; i < Count; i++) {
+            Pool->Free(Segments[i].Chunk());
+        }
+    }
+
+  private:
+    void CopyFrom(UINT32 Index, UINT32 Offset, _Out_writes_bytes_(Length) UCHAR* Buffer, UINT32 Length) const
+    {
+        while (Length != 0) {
+            UINT32 Piece = Segments[Index].Length - Offset;
+            if (Piece > Length) {
+                Piece = Length;
+            }
+            memcpy(Buffer, Segments[Index].Data + Offset, Piece);
+            Buffer += Piece;
+            Length -= Piece;
+            Offset = 0;
+            Index++;
+        }
+    }
+
+    UINT32 Count = 0;
+    UINT32 TotalLength = 0;
+    FrameSegment Segments[MaxSegments];
+};
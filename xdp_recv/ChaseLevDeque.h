@@ -0,0 +1,107 @@
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <memory>
+
+//
+// Fixed-capacity Chase-Lev work-stealing deque (Le, Pop, Cohen and Zappa
+// Nardelli, "Correct and Efficient Work-Stealing for Weak Memory Models").
+// The owning thread pushes and pops at the bottom; any other thread steals
+// the oldest element from the top. The size is rounded up to a power of two
+// and never grows: Push() fails when the deque is full.
+//
+template <typename T>
+class ChaseLevDeque {
+  public:
+    explicit ChaseLevDeque(UINT32 Size)
+    {
+        Capacity = 1;
+        while (Capacity < Size) {
+            Capacity <<= 1;
+        }
+        Mask = Capacity - 1;
+        Elements = std::make_unique<std::atomic<T>[]>(Capacity);
+    }
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    //
+    // Owner only.
+    //
+    bool Push(T Element)
+    {
+        INT64 B = Bottom.load(std::memory_order_relaxed);
+        INT64 T0 = Top.load(std::memory_order_acquire);
+        if (B - T0 >= (INT64)Capacity) {
+            return false;
+        }
+        Elements[B & Mask].store(Element, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        Bottom.store(B + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    //
+    // Owner only. Takes the newest element.
+    //
+    bool Pop(_Out_ T* Element)
+    {
+        INT64 B = Bottom.load(std::memory_order_relaxed) - 1;
+        Bottom.store(B, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        INT64 T0 = Top.load(std::memory_order_relaxed);
+
+        if (T0 > B) {
+            Bottom.store(B + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        *Element = Elements[B & Mask].load(std::memory_order_relaxed);
+        if (T0 == B) {
+            //
+            // Last element: race the thieves for it.
+            //
+            bool Won = Top.compare_exchange_strong(T0, T0 + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            Bottom.store(B + 1, std::memory_order_relaxed);
+            return Won;
+        }
+        return true;
+    }
+
+    //
+    // Any thread. Takes the oldest element; fails if the deque is empty or
+    // another thread took it first.
+    //
+    bool Steal(_Out_ T* Element)
+    {
+        INT64 T0 = Top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        INT64 B = Bottom.load(std::memory_order_acquire);
+
+        if (T0 >= B) {
+            return false;
+        }
+
+        *Element = Elements[T0 & Mask].load(std::memory_order_relaxed);
+        return Top.compare_exchange_strong(T0, T0 + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    //
+    // Approximate when read by a thief.
+    //
+    UINT32 Occupancy() const
+    {
+        INT64 Count = Bottom.load(std::memory_order_relaxed) - Top.load(std::memory_order_relaxed);
+        return Count > 0 ? (UINT32)Count : 0;
+    }
+
+  private:
+    alignas(64) std::atomic<INT64> Top {0};
+    alignas(64) std::atomic<INT64> Bottom {0};
+    std::unique_ptr<std::atomic<T>[]> Elements;
+    UINT32 Capacity;
+    UINT32 Mask;
+};
@@ -0,0 +1,433 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "ChainedFrame.h"
+#include "ItchMessages.h"
+#include "PacketHeaders.h"
+#include "TscClock.h"
+
+static constexpr UINT32 BenchChunkSize = 2048;
+static constexpr UINT32 BenchBurst = 32;
+static constexpr UINT32 BenchPasses = 5;
+static constexpr UINT32 HeadersLength = sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader);
+
+//
+// Writes one message of the usual order book mix at Message, roughly in the
+// proportions of a busy ITCH session: mostly adds and deletes. Returns its
+// length.
+//
+static UINT32 WriteMessage(_Out_writes_bytes_(Itch::Trade::Size) UCHAR* Message, std::mt19937_64& Random)
+{
+    UINT32 Roll = (UINT32)(Random() % 100);
+    UINT64 Value = Random();
+    UINT64 Reference = Value >> 24;
+    UINT32 Shares = 1 + (UINT32)(Value % 1000);
+    UINT32 Price = 10000 + (UINT32)(Value >> 40) % 100000;
+    UINT64 Timestamp = (Value >> 8) & 0xffffffffffff;
+
+    //
+    // StockLocate, TrackingNumber and Timestamp lead every message.
+    //
+    auto Common = [&](UINT8 Type) {
+        Message[0] = Type;
+        WireStoreBig(Message + Itch::AddOrder::StockLocateOffset, Value & 0x1fff, 2);
+        WireStoreBig(Message + Itch::AddOrder::TrackingNumberOffset, 0, 2);
+        WireStoreBig(Message + Itch::AddOrder::TimestampOffset, Timestamp, 6);
+    };
+
+    if (Roll < 40) {
+        using M = Itch::AddOrder;
+        Common(M::Type);
+        WireStoreBig(Message + M::OrderReferenceOffset, Reference, 8);
+        Message[M::BuySellOffset] = Value & 1 ? 'B' : 'S';
+        WireStoreBig(Message + M::SharesOffset, Shares, 4);
+        memcpy(Message + M::StockOffset, "MSFT    ", M::StockLength);
+        WireStoreBig(Message + M::PriceOffset, Price, 4);
+        return M::Size;
+    } else if (Roll < 42) {
+        using M = Itch::AddOrderMpid;
+        Common(M::Type);
+        WireStoreBig(Message + M::OrderReferenceOffset, Reference, 8);
+        Message[M::BuySellOffset] = Value & 1 ? 'B' : 'S';
+        WireStoreBig(Message + M::SharesOffset, Shares, 4);
+        memcpy(Message + M::StockOffset, "AAPL    ", M::StockLength);
+        WireStoreBig(Message + M::PriceOffset, Price, 4);
+        memcpy(Message + M::AttributionOffset, "NSDQ", M::AttributionLength);
+        return M::Size;
+    } else if (Roll < 77) {
+        using M = Itch::OrderDelete;
+        Common(M::Type);
+        WireStoreBig(Message + M::OrderReferenceOffset, Reference, 8);
+        return M::Size;
+    } else if (Roll < 82) {
+        using M = Itch::OrderCancel;
+        Common(M::Type);
+        WireStoreBig(Message + M::OrderReferenceOffset, Reference, 8);
+        WireStoreBig(Message + M::CancelledSharesOffset, Shares, 4);
+        return M::Size;
+    } else if (Roll < 90) {
+        using M = Itch::OrderExecuted;
+        Common(M::Type);
+        WireStoreBig(Message + M::OrderReferenceOffset, Reference, 8);
+        WireStoreBig(Message + M::ExecutedSharesOffset, Shares, 4);
+        WireStoreBig(Message + M::MatchNumberOffset, Value >> 16, 8);
+        return M::Size;
+    } else if (Roll < 98) {
+        using M = Itch::OrderReplace;
+        Common(M::Type);
+        WireStoreBig(Message + M::OriginalOrderReferenceOffset, Reference, 8);
+        WireStoreBig(Message + M::NewOrderReferenceOffset, Reference + 1, 8);
+        WireStoreBig(Message + M::SharesOffset, Shares, 4);
+        WireStoreBig(Message + M::PriceOffset, Price, 4);
+        return M::Size;
+    } else if (Roll < 99) {
+        using M = Itch::Trade;
+        Common(M::Type);
+        WireStoreBig(Message + M::OrderReferenceOffset, 0, 8);
+        Message[M::BuySellOffset] = 'B';
+        WireStoreBig(Message + M::SharesOffset, Shares, 4);
+        memcpy(Message + M::StockOffset, "MSFT    ", M::StockLength);
+        WireStoreBig(Message + M::PriceOffset, Price, 4);
+        WireStoreBig(Message + M::MatchNumberOffset, Value >> 16, 8);
+        return M::Size;
+    } else {
+        using M = Itch::SystemEvent;
+        Common(M::Type);
+        Message[M::EventCodeOffset] = 'Q';
+        return M::Size;
+    }
+}
+
+//
+// Fills a chunk with a MoldUDP64 datagram of Messages messages and returns
+// the frame length.
+//
+static UINT32 WriteDatagram(
+    _Out_writes_bytes_(BenchChunkSize) UCHAR* Frame,
+    UINT32 Messages,
+    UINT64 Sequence,
+    std::mt19937_64& Random)
+{
+    UCHAR* Payload = Frame + HeadersLength;
+    memcpy(Payload + Itch::MoldUdp64::SessionOffset, "SESSION001", Itch::MoldUdp64::SessionLength);
+    WireStoreBig(Payload + Itch::MoldUdp64::SequenceNumberOffset, Sequence, 8);
+    WireStoreBig(Payload + Itch::MoldUdp64::MessageCountOffset, Messages, 2);
+
+    UINT32 Length = Itch::MoldUdp64::Size;
+    for (UINT32 i = 0; i < Messages; i++) {
+        UINT32 MessageLength = WriteMessage(Payload + Length + Itch::Schema::LengthPrefixBytes, Random);
+        WireStoreBig(Payload + Length, MessageLength, Itch::Schema::LengthPrefixBytes);
+        Length += Itch::Schema::LengthPrefixBytes + MessageLength;
+    }
+
+    WriteUdpHeaders(Frame, Length, 0x0a000001, 26400, 0xe9363601, 26400);
+    return HeadersLength + Length;
+}
+
+//
+// What a handler makes of each message, the same for both decoders so
+// their checksums have to agree.
+//
+struct OrderBookChecksum {
+    UINT64 Sum = 0;
+
+    void On(const Itch::SystemEvent& M) { Sum += M.Timestamp() + M.EventCode(); }
+    void On(const Itch::AddOrder& M) { Sum += M.Timestamp() + M.OrderReference() + (UINT64)M.Shares() * M.Price(); }
+    void On(const Itch::AddOrderMpid& M)
+    {
+        Sum += M.Timestamp() + M.OrderReference() + (UINT64)M.Shares() * M.Price();
+    }
+    void On(const Itch::OrderExecuted& M) { Sum += M.OrderReference() + M.ExecutedShares() + M.MatchNumber(); }
+    void On(const Itch::OrderCancel& M) { Sum += M.OrderReference() + M.CancelledShares(); }
+    void On(const Itch::OrderDelete& M) { Sum += M.OrderReference(); }
+    void On(const Itch::OrderReplace& M)
+    {
+        Sum += M.OriginalOrderReference() + M.NewOrderReference() + (UINT64)M.Shares() * M.Price();
+    }
+    void On(const Itch::Trade& M) { Sum += M.MatchNumber() + (UINT64)M.Shares() * M.Price(); }
+};
+
+//
+// The usual hand-written decoder the generated one replaces: every field of
+// a message converted into a native struct, then a switch on the type.
+//
+struct CopiedMessage {
+    UINT8 Type;
+    UINT16 StockLocate;
+    UINT16 TrackingNumber;
+    UINT64 Timestamp;
+    UINT64 OrderReference;
+    UINT64 NewOrderReference;
+    UINT64 MatchNumber;
+    UINT32 Shares;
+    UINT32 Price;
+    char BuySell;
+    char EventCode;
+    char Stock[8];
+    char Attribution[4];
+};
+
+//
+// The same loads the generated views use, so that the comparison is of
+// copying and switching against reading in place and the jump table.
+//
+template <UINT32 Bytes>
+static UINT64 GetBig(_In_reads_bytes_(Bytes) const UCHAR* Data)
+{
+    return WireLoad<Bytes, WireByteOrder::Big>(Data);
+}
+
+static bool CopyMessage(_In_reads_bytes_(Length) const UCHAR* Data, UINT32 Length, _Out_ CopiedMessage* Message)
+{
+    *Message = {};
+    Message->Type = Data[0];
+    if (Length < 11) {
+        return false;
+    }
+    Message->StockLocate = (UINT16)GetBig<2>(Data + 1);
+    Message->TrackingNumber = (UINT16)GetBig<2>(Data + 3);
+    Message->Timestamp = GetBig<6>(Data + 5);
+
+    switch (Message->Type) {
+    case 'S':
+        if (Length < 12) {
+            return false;
+        }
+        Message->EventCode = (char)Data[11];
+        return true;
+    case 'A':
+    case 'F':
+        if (Length < (Message->Type == 'A' ? 36u : 40u)) {
+            return false;
+        }
+        Message->OrderReference = GetBig<8>(Data + 11);
+        Message->BuySell = (char)Data[19];
+        Message->Shares = (UINT32)GetBig<4>(Data + 20);
+        memcpy(Message->Stock, Data + 24, sizeof(Message->Stock));
+        Message->Price = (UINT32)GetBig<4>(Data + 32);
+        if (Message->Type == 'F') {
+            memcpy(Message->Attribution, Data + 36, sizeof(Message->Attribution));
+        }
+        return true;
+    case 'E':
+        if (Length < 31) {
+            return false;
+        }
+        Message->OrderReference = GetBig<8>(Data + 11);
+        Message->Shares = (UINT32)GetBig<4>(Data + 19);
+        Message->MatchNumber = GetBig<8>(Data + 23);
+        return true;
+    case 'X':
+        if (Length < 23) {
+            return false;
+        }
+        Message->OrderReference = GetBig<8>(Data + 11);
+        Message->Shares = (UINT32)GetBig<4>(Data + 19);
+        return true;
+    case 'D':
+        if (Length < 19) {
+            return false;
+        }
+        Message->OrderReference = GetBig<8>(Data + 11);
+        return true;
+    case 'U':
+        if (Length < 35) {
+            return false;
+        }
+        Message->OrderReference = GetBig<8>(Data + 11);
+        Message->NewOrderReference = GetBig<8>(Data + 19);
+        Message->Shares = (UINT32)GetBig<4>(Data + 27);
+        Message->Price = (UINT32)GetBig<4>(Data + 31);
+        return true;
+    case 'P':
+        if (Length < 44) {
+            return false;
+        }
+        Message->OrderReference = GetBig<8>(Data + 11);
+        Message->BuySell = (char)Data[19];
+        Message->Shares = (UINT32)GetBig<4>(Data + 20);
+        memcpy(Message->Stock, Data + 24, sizeof(Message->Stock));
+        Message->Price = (UINT32)GetBig<4>(Data + 32);
+        Message->MatchNumber = GetBig<8>(Data + 36);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static UINT64 HandleCopied(const CopiedMessage& M)
+{
+    switch (M.Type) {
+    case 'S':
+        return M.Timestamp + M.EventCode;
+    case 'A':
+    case 'F':
+        return M.Timestamp + M.OrderReference + (UINT64)M.Shares * M.Price;
+    case 'E':
+        return M.OrderReference + M.Shares + M.MatchNumber;
+    case 'X':
+        return M.OrderReference + M.Shares;
+    case 'D':
+        return M.OrderReference;
+    case 'U':
+        return M.OrderReference + M.NewOrderReference + (UINT64)M.Shares * M.Price;
+    case 'P':
+        return M.MatchNumber + (UINT64)M.Shares * M.Price;
+    default:
+        return 0;
+    }
+}
+
+static UINT32 DecodeCopied(_In_reads_bytes_(Length) const UCHAR* Payload, UINT32 Length, _Inout_ UINT64* Sum)
+{
+    if (Length < Itch::MoldUdp64::Size) {
+        return 0;
+    }
+
+    UINT32 Count = 0;
+    UINT32 Offset = Itch::MoldUdp64::Size;
+    while (Length - Offset >= 2) {
+        UINT32 MessageLength = (UINT32)GetBig<2>(Payload + Offset);
+        Offset += 2;
+        if (MessageLength == 0 || MessageLength > Length - Offset) {
+            break;
+        }
+        CopiedMessage Message;
+        if (CopyMessage(Payload + Offset, MessageLength, &Message)) {
+            *Sum += HandleCopied(Message);
+        }
+        Offset += MessageLength;
+        Count++;
+    }
+    return Count;
+}
+
+//
+// Decodes every datagram of the UMEM a burst at a time, as a receive loop
+// would straight off the RX ring. Returns ns per message.
+//
+template <bool Generated>
+static double RunDecoder(
+    const TscClock& Clock,
+    _In_ UCHAR* Umem,
+    const std::vector<UINT32>& Lengths,
+    _Out_ UINT64* Messages,
+    _Out_ UINT64* Checksum)
+{
+    auto Frames = std::make_unique<ChainedFrame[]>(BenchBurst);
+    UINT32 Chunks = (UINT32)Lengths.size();
+    OrderBookChecksum Handler;
+    WireDecodeStats Stats {};
+    UINT64 CopiedSum = 0;
+    UINT64 Count = 0;
+
+    UINT64 Start = Clock.NowOrdered();
+    for (UINT32 Next = 0; Next < Chunks; Next += BenchBurst) {
+        UINT32 Burst = std::min(BenchBurst, Chunks - Next);
+        for (UINT32 i = 0; i < Burst; i++) {
+            UINT64 Address = (UINT64)(Next + i) * BenchChunkSize;
+            Frames[i].Reset();
+            Frames[i].Append(Address, Umem + Address, Lengths[Next + i]);
+        }
+
+        for (UINT32 i = 0; i < Burst; i++) {
+            const FrameSegment& Head = Frames[i].Segment(0);
+            Ipv4Frame Parsed;
+            if (!ParseIpv4Frame(Head.Data, Head.Length, &Parsed) || Parsed.Udp == nullptr) {
+                continue;
+            }
+            const UCHAR* Payload = Parsed.L4 + sizeof(UdpHeader);
+            UINT32 PayloadLength = Parsed.L4Length - sizeof(UdpHeader);
+            if constexpr (Generated) {
+                Count += WireDecode<Itch::Schema>(Payload, PayloadLength, Handler, &Stats);
+            } else {
+                Count += DecodeCopied(Payload, PayloadLength, &CopiedSum);
+            }
+        }
+    }
+    UINT64 Ns = Clock.TicksToNs(Clock.NowOrdered() - Start);
+
+    *Messages = Count;
+    *Checksum = Generated ? Handler.Sum : CopiedSum;
+    return Count != 0 ? (double)Ns / Count : 0.0;
+}
+
+//
+// Messages/s decoding ITCH out of MoldUDP64 datagrams in the UMEM, with the
+// generated flyweight views and jump table against copying every message
+// into a struct and switching on its type. The UMEM is larger than the
+// last-level cache, so both pay for the misses a receive loop would.
+//
+int DecoderBenchmark(int argc, char** argv)
+{
+    UINT32 FrameCount = argc >= 1 ? atoi(argv[0]) : 65536;
+    UINT32 PerDatagram = argc >= 2 ? atoi(argv[1]) : 8;
+    constexpr UINT32 MaxPerDatagram =
+        (1500 - sizeof(Ipv4Header) - sizeof(UdpHeader) - Itch::MoldUdp64::Size) / (2 + Itch::Trade::Size);
+
+    if (FrameCount == 0 || PerDatagram == 0 || PerDatagram > MaxPerDatagram) {
+        fprintf(stderr, "decode [frames] [messages-per-datagram]: 1 to %u messages per datagram\n", MaxPerDatagram);
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    auto Umem = std::make_unique<UCHAR[]>((UINT64)FrameCount * BenchChunkSize);
+    std::vector<UINT32> Lengths(FrameCount);
+    std::mt19937_64 Random(47);
+    UINT64 PayloadBytes = 0;
+    for (UINT32 Chunk = 0; Chunk < FrameCount; Chunk++) {
+        UCHAR* Frame = Umem.get() + (UINT64)Chunk * BenchChunkSize;
+        Lengths[Chunk] = WriteDatagram(Frame, PerDatagram, (UINT64)Chunk * PerDatagram + 1, Random);
+        PayloadBytes += Lengths[Chunk] - HeadersLength;
+    }
+
+    printf(
+        "%u MoldUDP64 datagrams of %u ITCH messages (%.0f bytes on average) in %u-byte chunks, bursts of %u, "
+        "best of %u\n\n",
+        FrameCount,
+        PerDatagram,
+        (double)PayloadBytes / FrameCount,
+        BenchChunkSize,
+        BenchBurst,
+        BenchPasses);
+    printf("%-24s %10s %10s %12s %10s\n", "decoder", "ns/msg", "Mmsgs/s", "Mdatagrams/s", "speedup");
+
+    double Best[2] = {1e30, 1e30};
+    UINT64 Messages[2];
+    UINT64 Checksums[2];
+    for (UINT32 Pass = 0; Pass < BenchPasses; Pass++) {
+        Best[0] = std::min(Best[0], RunDecoder<false>(Clock, Umem.get(), Lengths, &Messages[0], &Checksums[0]));
+        Best[1] = std::min(Best[1], RunDecoder<true>(Clock, Umem.get(), Lengths, &Messages[1], &Checksums[1]));
+    }
+
+    UINT64 Expected = (UINT64)FrameCount * PerDatagram;
+    if (Messages[0] != Expected || Messages[1] != Expected || Checksums[0] != Checksums[1]) {
+        fprintf(
+            stderr,
+            "decoders disagree: %llu and %llu of %llu messages\n",
+            (unsigned long long)Messages[0],
+            (unsigned long long)Messages[1],
+            (unsigned long long)Expected);
+        return EXIT_FAILURE;
+    }
+
+    static const char* Names[] = {"copy + switch", "flyweight + jump table"};
+    for (UINT32 i = 0; i < 2; i++) {
+        printf(
+            "%-24s %10.2f %10.1f %12.2f %9.2fx\n",
+            Names[i],
+            Best[i],
+            1000.0 / Best[i],
+            1000.0 / Best[i] / PerDatagram,
+            Best[0] / Best[i]);
+    }
+    return EXIT_SUCCESS;
+}
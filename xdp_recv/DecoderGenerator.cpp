@@ -0,0 +1,452 @@
+#include <windows.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "DecoderGenerator.h"
+
+namespace {
+
+constexpr UINT32 MaxLineLength = 120;
+
+struct FieldTypeName {
+    const char* Name;
+    WireFieldType Type;
+    UINT32 Length;
+};
+
+const FieldTypeName FieldTypeNames[] = {
+    {"u8", WireFieldType::Unsigned, 1},
+    {"u16", WireFieldType::Unsigned, 2},
+    {"u32", WireFieldType::Unsigned, 4},
+    {"u48", WireFieldType::Unsigned, 6},
+    {"u64", WireFieldType::Unsigned, 8},
+    {"i8", WireFieldType::Signed, 1},
+    {"i16", WireFieldType::Signed, 2},
+    {"i32", WireFieldType::Signed, 4},
+    {"i64", WireFieldType::Signed, 8},
+};
+
+void Append(_Inout_ std::string* Out, _In_z_ const char* Format, ...)
+{
+    char Buffer[512];
+    va_list Args;
+    va_start(Args, Format);
+    int Length = vsnprintf(Buffer, sizeof(Buffer), Format, Args);
+    va_end(Args);
+    if (Length > 0) {
+        Out->append(Buffer, std::min((size_t)Length, sizeof(Buffer) - 1));
+    }
+}
+
+bool IsIdentifier(const std::string& Text)
+{
+    if (Text.empty() || !(isalpha((UCHAR)Text[0]) || Text[0] == '_')) {
+        return false;
+    }
+    return std::all_of(Text.begin(), Text.end(), [](char c) { return isalnum((UCHAR)c) || c == '_'; });
+}
+
+std::vector<std::string> Tokenize(const std::string& Line)
+{
+    std::vector<std::string> Tokens;
+    size_t Next = 0;
+    while (true) {
+        Next = Line.find_first_not_of(" \t\r", Next);
+        if (Next == std::string::npos) {
+            break;
+        }
+        size_t End = Line.find_first_of(" \t\r", Next);
+        Tokens.push_back(Line.substr(Next, End - Next));
+        Next = End;
+    }
+    return Tokens;
+}
+
+bool ParseNumber(const std::string& Text, UINT32 Max, _Out_ UINT32* Value)
+{
+    char* End;
+    unsigned long Parsed = strtoul(Text.c_str(), &End, 0);
+    *Value = (UINT32)Parsed;
+    return !Text.empty() && *End == '\0' && Parsed <= Max;
+}
+
+//
+// A message type is a character in quotes, as ITCH documents them, or a
+// number.
+//
+bool ParseMessageType(const std::string& Text, _Out_ UINT32* Type)
+{
+    if (Text.size() == 3 && Text[0] == '\'' && Text[2] == '\'') {
+        *Type = (UCHAR)Text[1];
+        return true;
+    }
+    return ParseNumber(Text, MAXUINT8, Type);
+}
+
+bool ParseFieldType(const std::string& Text, _Out_ WireFieldType* Type, _Out_ UINT32* Length)
+{
+    for (const FieldTypeName& Entry : FieldTypeNames) {
+        if (Text == Entry.Name) {
+            *Type = Entry.Type;
+            *Length = Entry.Length;
+            return true;
+        }
+    }
+
+    if (Text.size() > 6 && Text.compare(0, 5, "char[") == 0 && Text.back() == ']') {
+        *Type = WireFieldType::Char;
+        return ParseNumber(Text.substr(5, Text.size() - 6), 65535, Length) && *Length != 0;
+    }
+    return false;
+}
+
+//
+// Names the generated classes use for themselves; a field cannot have them.
+//
+bool IsReservedName(const std::string& Name)
+{
+    return Name == "Type" || Name == "Size" || Name == "Data" || Name == "Bytes";
+}
+
+const char* AccessorType(const WireFieldSchema& Field)
+{
+    if (Field.Type == WireFieldType::Char) {
+        return Field.Length == 1 ? "char" : "const char*";
+    }
+
+    bool Signed = Field.Type == WireFieldType::Signed;
+    switch (Field.Length) {
+    case 1:
+        return Signed ? "INT8" : "UINT8";
+    case 2:
+        return Signed ? "INT16" : "UINT16";
+    case 4:
+        return Signed ? "INT32" : "UINT32";
+    default:
+        return Signed ? "INT64" : "UINT64";
+    }
+}
+
+//
+// The load behind an accessor. Signed fields are loaded unsigned and
+// narrowed, which keeps their two's complement bits.
+//
+std::string AccessorBody(const WireFieldSchema& Field)
+{
+    std::string Body;
+    if (Field.Type == WireFieldType::Char) {
+        if (Field.Length == 1) {
+            Append(&Body, "return (char)Data[%sOffset];", Field.Name.c_str());
+        } else {
+            Append(&Body, "return (const char*)Data + %sOffset;", Field.Name.c_str());
+        }
+    } else if (Field.Type == WireFieldType::Unsigned && Field.Length >= 6) {
+        Append(&Body, "return WireLoad<%u, ByteOrder>(Data + %sOffset);", Field.Length, Field.Name.c_str());
+    } else {
+        Append(
+            &Body,
+            "return (%s)WireLoad<%u, ByteOrder>(Data + %sOffset);",
+            AccessorType(Field),
+            Field.Length,
+            Field.Name.c_str());
+    }
+    return Body;
+}
+
+void EmitView(_Inout_ std::string* Out, const WireMessageSchema& View, bool IsMessage)
+{
+    Append(Out, "class %s {\n  public:\n", View.Name.c_str());
+    if (IsMessage) {
+        if (isprint((int)View.Type) && View.Type != '\'' && View.Type != '\\') {
+            Append(Out, "    static constexpr UINT8 Type = '%c';\n", (char)View.Type);
+        } else {
+            Append(Out, "    static constexpr UINT8 Type = %u;\n", View.Type);
+        }
+    }
+    Append(Out, "    static constexpr UINT32 Size = %u;\n\n", View.Size);
+
+    for (const WireFieldSchema& Field : View.Fields) {
+        Append(Out, "    static constexpr UINT32 %sOffset = %u;\n", Field.Name.c_str(), Field.Offset);
+        if (Field.Type == WireFieldType::Char && Field.Length > 1) {
+            Append(Out, "    static constexpr UINT32 %sLength = %u;\n", Field.Name.c_str(), Field.Length);
+        }
+    }
+
+    Append(Out, "\n    explicit %s(_In_ const UCHAR* Data) : Data(Data) {}\n\n", View.Name.c_str());
+
+    for (const WireFieldSchema& Field : View.Fields) {
+        std::string Body = AccessorBody(Field);
+        std::string Line;
+        Append(&Line, "    %s %s() const { %s }", AccessorType(Field), Field.Name.c_str(), Body.c_str());
+        if (Line.size() <= MaxLineLength) {
+            Append(Out, "%s\n", Line.c_str());
+        } else {
+            Append(
+                Out,
+                "    %s %s() const\n    {\n        %s\n    }\n",
+                AccessorType(Field),
+                Field.Name.c_str(),
+                Body.c_str());
+        }
+    }
+
+    Append(Out, "\n    const UCHAR* Bytes() const { return Data; }\n\n  private:\n    const UCHAR* Data;\n};\n\n");
+}
+
+} // namespace
+
+HRESULT ParseWireSchema(_In_z_ const char* Text, _Out_ WireSchema* Schema, _Out_ std::string* Error)
+{
+    *Schema = {};
+    Error->clear();
+
+    //
+    // The view fields are added to: the packet header, a message, or none
+    // before the first of them.
+    //
+    WireMessageSchema* Current = nullptr;
+    bool HavePacket = false;
+    UINT32 LineNumber = 0;
+
+    auto Fail = [&](_In_z_ const char* Reason, const std::string& Token) {
+        if (LineNumber != 0) {
+            Append(Error, "line %u: ", LineNumber);
+        }
+        Append(Error, "%s", Reason);
+        if (!Token.empty()) {
+            Append(Error, ": %s", Token.c_str());
+        }
+        return E_INVALIDARG;
+    };
+
+    const char* Next = Text;
+    while (*Next != '\0') {
+        const char* End = strchr(Next, '\n');
+        std::string Line = End != nullptr ? std::string(Next, End) : std::string(Next);
+        Next = End != nullptr ? End + 1 : Next + Line.size();
+        LineNumber++;
+
+        if (size_t Comment = Line.find('#'); Comment != std::string::npos) {
+            Line.resize(Comment);
+        }
+        std::vector<std::string> Tokens = Tokenize(Line);
+        if (Tokens.empty()) {
+            continue;
+        }
+        const std::string& Keyword = Tokens[0];
+
+        if (Keyword == "schema") {
+            if (Tokens.size() != 3 || !IsIdentifier(Tokens[1])) {
+                return Fail("expected schema <Name> <big|little>", "");
+            }
+            if (Tokens[2] != "big" && Tokens[2] != "little") {
+                return Fail("unknown byte order", Tokens[2]);
+            }
+            Schema->Name = Tokens[1];
+            Schema->Order = Tokens[2] == "big" ? WireByteOrder::Big : WireByteOrder::Little;
+            Current = nullptr;
+        } else if (Keyword == "packet") {
+            if (Tokens.size() != 2 || !IsIdentifier(Tokens[1])) {
+                return Fail("expected packet <Name>", "");
+            }
+            if (HavePacket) {
+                return Fail("second packet header", Tokens[1]);
+            }
+            Schema->Packet.Name = Tokens[1];
+            HavePacket = true;
+            Current = &Schema->Packet;
+        } else if (Keyword == "frame") {
+            if (Tokens.size() != 2 || (Tokens[1] != "u8" && Tokens[1] != "u16" && Tokens[1] != "u32")) {
+                return Fail("expected frame <u8|u16|u32>", "");
+            }
+            Schema->LengthPrefixBytes = Tokens[1] == "u8" ? 1 : Tokens[1] == "u16" ? 2 : 4;
+            Current = nullptr;
+        } else if (Keyword == "message") {
+            WireMessageSchema Message {};
+            if (Tokens.size() != 3 || !IsIdentifier(Tokens[1])) {
+                return Fail("expected message <Name> <'c'|number>", "");
+            }
+            if (!ParseMessageType(Tokens[2], &Message.Type)) {
+                return Fail("invalid message type", Tokens[2]);
+            }
+            for (const WireMessageSchema& Other : Schema->Messages) {
+                if (Other.Name == Tokens[1] || Other.Type == Message.Type) {
+                    return Fail("message name or type used twice", Tokens[1]);
+                }
+            }
+            Message.Name = Tokens[1];
+            Message.Size = 1;
+            Schema->Messages.push_back(std::move(Message));
+            Current = &Schema->Messages.back();
+        } else {
+            if (Current == nullptr) {
+                return Fail("field outside a packet or message", Keyword);
+            }
+
+            WireFieldSchema Field {};
+            if (Tokens.size() != 2 || !IsIdentifier(Tokens[0]) || IsReservedName(Tokens[0])) {
+                return Fail("expected <field> <type>", Keyword);
+            }
+            if (!ParseFieldType(Tokens[1], &Field.Type, &Field.Length)) {
+                return Fail("unknown field type", Tokens[1]);
+            }
+            for (const WireFieldSchema& Other : Current->Fields) {
+                if (Other.Name == Tokens[0]) {
+                    return Fail("field name used twice", Tokens[0]);
+                }
+            }
+            Field.Name = Tokens[0];
+            Field.Offset = Current->Size;
+            Current->Size += Field.Length;
+            Current->Fields.push_back(std::move(Field));
+        }
+    }
+
+    //
+    // What is missing is not on any one line.
+    //
+    LineNumber = 0;
+    if (Schema->Name.empty()) {
+        return Fail("no schema statement", "");
+    }
+    if (!HavePacket) {
+        return Fail("no packet header", "");
+    }
+    if (Schema->LengthPrefixBytes == 0) {
+        return Fail("no frame statement", "");
+    }
+    if (Schema->Messages.empty()) {
+        return Fail("no messages", "");
+    }
+    return S_OK;
+}
+
+std::string GenerateWireDecoder(const WireSchema& Schema, _In_z_ const char* SourceName)
+{
+    std::string Out;
+    Append(
+        &Out,
+        "#pragma once\n"
+        "\n"
+        "//\n"
+        "// Generated by xdp_recv.exe --decoder-gen from %s.\n"
+        "// Edit the schema and regenerate rather than changing this file.\n"
+        "//\n"
+        "\n"
+        "#include <windows.h>\n"
+        "\n"
+        "#include \"WireMessage.h\"\n"
+        "\n"
+        "namespace %s {\n"
+        "\n"
+        "constexpr WireByteOrder ByteOrder = WireByteOrder::%s;\n"
+        "\n",
+        SourceName,
+        Schema.Name.c_str(),
+        Schema.Order == WireByteOrder::Big ? "Big" : "Little");
+
+    EmitView(&Out, Schema.Packet, false);
+    for (const WireMessageSchema& Message : Schema.Messages) {
+        EmitView(&Out, Message, true);
+    }
+
+    std::string Messages = "    using Messages = WireMessageList<";
+    for (size_t i = 0; i < Schema.Messages.size(); i++) {
+        Append(&Messages, "%s%s", i != 0 ? ", " : "", Schema.Messages[i].Name.c_str());
+    }
+    Messages += ">;\n";
+    if (Messages.size() > MaxLineLength + 1) {
+        Messages = "    using Messages = WireMessageList<";
+        for (size_t i = 0; i < Schema.Messages.size(); i++) {
+            bool Last = i + 1 == Schema.Messages.size();
+            Append(&Messages, "\n        %s%s", Schema.Messages[i].Name.c_str(), Last ? ">;\n" : ",");
+        }
+    }
+
+    Append(
+        &Out,
+        "struct Schema {\n"
+        "    static constexpr WireByteOrder Order = ByteOrder;\n"
+        "    static constexpr UINT32 LengthPrefixBytes = %u;\n"
+        "\n"
+        "    using Packet = %s;\n",
+        Schema.LengthPrefixBytes,
+        Schema.Packet.Name.c_str());
+    Out += Messages;
+    Append(&Out, "};\n\n} // namespace %s\n", Schema.Name.c_str());
+    return Out;
+}
+
+int DecoderGenCommand(int argc, char** argv)
+{
+    if (argc < 1) {
+        fprintf(
+            stderr,
+            "xdp_recv.exe --decoder-gen <file.schema> [output.h]\n"
+            "\n"
+            "Writes the decoder header for a message schema, to stdout without output.h.\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE* File = fopen(argv[0], "rb");
+    if (File == nullptr) {
+        fprintf(stderr, "cannot read %s\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::string Text;
+    char Buffer[4096];
+    size_t Read;
+    while ((Read = fread(Buffer, 1, sizeof(Buffer), File)) != 0) {
+        Text.append(Buffer, Read);
+    }
+    fclose(File);
+
+    WireSchema Schema;
+    std::string Error;
+    if (FAILED(ParseWireSchema(Text.c_str(), &Schema, &Error))) {
+        fprintf(stderr, "%s: %s\n", argv[0], Error.c_str());
+        return EXIT_FAILURE;
+    }
+
+    //
+    // The banner names the schema by its file name, so regenerating from
+    // another directory leaves the header unchanged.
+    //
+    const char* SourceName = argv[0];
+    for (const char* c = argv[0]; *c != '\0'; c++) {
+        if (*c == '/' || *c == '\\') {
+            SourceName = c + 1;
+        }
+    }
+    std::string Header = GenerateWireDecoder(Schema, SourceName);
+
+    FILE* Output = argc >= 2 ? fopen(argv[1], "wb") : stdout;
+    if (Output == nullptr) {
+        fprintf(stderr, "cannot write %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    bool Written = fwrite(Header.data(), 1, Header.size(), Output) == Header.size();
+    if (Output != stdout) {
+        Written = fclose(Output) == 0 && Written;
+    }
+    if (!Written) {
+        fprintf(stderr, "cannot write %s\n", argc >= 2 ? argv[1] : "stdout");
+        return EXIT_FAILURE;
+    }
+
+    fprintf(
+        stderr,
+        "%s: %zu messages, %u-byte packet header, %s-endian\n",
+        Schema.Name.c_str(),
+        Schema.Messages.size(),
+        Schema.Packet.Size,
+        Schema.Order == WireByteOrder::Big ? "big" : "little");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <windows.h>
+
+#include <string>
+#include <vector>
+
+#include "WireMessage.h"
+
+//
+// Generates the flyweight decoders WireMessage.h runs from a schema of
+// fixed-layout binary messages. A schema is a text file of one statement per
+// line, '#' starting a comment:
+//
+//     schema <Name> <big|little>
+//     packet <Name>
+//         <field> <type>
+//     frame <u8|u16|u32>
+//     message <Name> <'c'|number>
+//         <field> <type>
+//
+// with one packet header, the width of the length prefix in front of each
+// message, and the messages, each with its type byte. The type byte is the
+// first byte of a message and its fields follow from offset 1. Field types
+// are u8 u16 u32 u48 u64 i8 i16 i32 i64 and char[N].
+//
+// The output is a header with a namespace named after the schema, a view
+// class per packet header and message with the offset of every field as a
+// constant, and the Schema type WireDecode() takes.
+//
+
+enum class WireFieldType {
+    Unsigned,
+    Signed,
+    Char,
+};
+
+struct WireFieldSchema {
+    std::string Name;
+    WireFieldType Type;
+    UINT32 Offset;
+    UINT32 Length;
+};
+
+struct WireMessageSchema {
+    std::string Name;
+    UINT32 Type;
+    UINT32 Size;
+    std::vector<WireFieldSchema> Fields;
+};
+
+struct WireSchema {
+    std::string Name;
+    WireByteOrder Order;
+    UINT32 LengthPrefixBytes;
+    WireMessageSchema Packet;
+    std::vector<WireMessageSchema> Messages;
+};
+
+//
+// Parses schema text. On failure, Error says which line and why.
+//
+HRESULT ParseWireSchema(_In_z_ const char* Text, _Out_ WireSchema* Schema, _Out_ std::string* Error);
+
+//
+// The C++ header for a parsed schema; SourceName goes into its banner.
+//
+std::string GenerateWireDecoder(const WireSchema& Schema, _In_z_ const char* SourceName);
+
+//
+// xdp_recv.exe --decoder-gen: writes the header for a schema file.
+//
+int DecoderGenCommand(int argc, char** argv);
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+//
+// Epoch-based reclamation for read-mostly data shared with the RX thread.
+//
+// Readers bracket every access with Enter()/Exit(); both are a single store
+// to the reader's own cache line, so the RX thread never takes a lock and
+// never waits for a writer. Writers publish a new version through an
+// RcuPointer and retire the old one; a retired object is destroyed once every
+// reader has been outside a read section or has entered a newer epoch since
+// the object was unlinked.
+//
+class EpochDomain {
+  public:
+    static constexpr UINT64 Idle = 0;
+
+    explicit EpochDomain(UINT32 MaxReaders)
+        : Readers(std::make_unique<ReaderSlot[]>(MaxReaders))
+        , MaxReaders(MaxReaders)
+    {
+    }
+
+    ~EpochDomain()
+    {
+        for (Retired& Entry : RetiredList) {
+            Entry.Destroy(Entry.Object);
+        }
+    }
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    //
+    // Returns a reader id for Enter()/Exit(), or MAXUINT32 if all slots are
+    // taken. Each reader thread registers once.
+    //
+    UINT32 RegisterReader()
+    {
+        UINT32 Id = ReaderCount.fetch_add(1, std::memory_order_relaxed);
+        return Id < MaxReaders ? Id : MAXUINT32;
+    }
+
+    void Enter(UINT32 Reader)
+    {
+        //
+        // The store must be ordered before any load of protected data, hence
+        // sequentially consistent, as are the pointer loads and exchanges in
+        // RcuPointer. On x86 only the store costs anything extra.
+        //
+        Readers[Reader].Epoch.store(GlobalEpoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+    }
+
+    void Exit(UINT32 Reader) { Readers[Reader].Epoch.store(Idle, std::memory_order_release); }
+
+    //
+    // Writer side. Defers destruction of Object until no reader can still be
+    // looking at it. Retire() and Reclaim() must not race with each other.
+    //
+    template <typename T>
+    void Retire(T* Object)
+    {
+        if (Object == nullptr) {
+            return;
+        }
+
+        UINT64 Epoch = GlobalEpoch.fetch_add(1, std::memory_order_seq_cst);
+        RetiredList.push_back({Object, [](VOID* Pointer) { delete (T*)Pointer; }, Epoch});
+        Reclaim();
+    }
+
+    //
+    // Destroys every retired object that no reader can reach any more.
+    // Returns the number of objects still pending.
+    //
+    size_t Reclaim()
+    {
+        UINT64 Oldest = OldestActiveEpoch();
+
+        size_t Kept = 0;
+        for (Retired& Entry : RetiredList) {
+            if (Entry.Epoch < Oldest) {
+                Entry.Destroy(Entry.Object);
+            } else {
+                RetiredList[Kept++] = Entry;
+            }
+        }
+        RetiredList.resize(Kept);
+        return Kept;
+    }
+
+    //
+    // Blocks the calling writer until everything retired so far is destroyed.
+    //
+    void Synchronize()
+    {
+        while (Reclaim() != 0) {
+            std::this_thread::yield();
+        }
+    }
+
+  private:
+    UINT64 OldestActiveEpoch() const
+    {
+        UINT64 Oldest = GlobalEpoch.load(std::memory_order_seq_cst);
+        UINT32 Count = ReaderCount.load(std::memory_order_relaxed);
+        if (Count > MaxReaders) {
+            Count = MaxReaders;
+        }
+
+        for (UINT32 i = 0; i < Count; i++) {
+            UINT64 Epoch = Readers[i].Epoch.load(std::memory_order_seq_cst);
+            if (Epoch != Idle && Epoch < Oldest) {
+                Oldest = Epoch;
+            }
+        }
+        return Oldest;
+    }
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<UINT64> Epoch {Idle};
+    };
+
+    struct Retired {
+        VOID* Object;
+        void (*Destroy)(VOID*);
+        UINT64 Epoch;
+    };
+
+    alignas(64) std::atomic<UINT64> GlobalEpoch {1};
+    std::atomic<UINT32> ReaderCount {0};
+    std::unique_ptr<ReaderSlot[]> Readers;
+    UINT32 MaxReaders;
+    std::vector<Retired> RetiredList;
+};
+
+//
+// Pointer to the current version of an RCU-managed object. Readers call Get()
+// between EpochDomain::Enter() and Exit(); the writer calls Publish().
+//
+template <typename T>
+class RcuPointer {
+  public:
+    explicit RcuPointer(EpochDomain& Domain, T* Initial = nullptr) : Domain(Domain), Current(Initial) {}
+
+    ~RcuPointer() { delete Current.load(std::memory_order_relaxed); }
+
+    RcuPointer(const RcuPointer&) = delete;
+    RcuPointer& operator=(const RcuPointer&) = delete;
+
+    const T* Get() const { return Current.load(std::memory_order_seq_cst); }
+
+    void Publish(std::unique_ptr<T> Next)
+    {
+        Domain.Retire(Current.exchange(Next.release(), std::memory_order_seq_cst));
+    }
+
+  private:
+    EpochDomain& Domain;
+    std::atomic<T*> Current;
+};
@@ -0,0 +1,165 @@
+#include "FanOutDispatcher.h"
+
+#include <string.h>
+
+FanOutDispatcher::FanOutDispatcher(const FanOutConfig& Config, _In_opt_ const RssPredictor* Hasher)
+    : Config(Config)
+    , Hasher(Hasher)
+    , WorkerCount(Config.Workers != 0 ? Config.Workers : 1)
+{
+    if (this->Config.FieldLength > sizeof(UINT64)) {
+        this->Config.FieldLength = sizeof(UINT64);
+    }
+    if (this->Config.WorkerBatch == 0) {
+        this->Config.WorkerBatch = 1;
+    }
+    for (UINT32 Worker = 0; Worker < WorkerCount; Worker++) {
+        State.push_back(std::make_unique<WorkerState>(Config.RingSize));
+    }
+}
+
+FanOutDispatcher::~FanOutDispatcher()
+{
+    Stop(nullptr);
+}
+
+void FanOutDispatcher::Start(Handler Handle)
+{
+    this->Handle = std::move(Handle);
+    Stopping.store(false, std::memory_order_relaxed);
+    Exited.store(0, std::memory_order_relaxed);
+    Running = true;
+    for (UINT32 Worker = 0; Worker < WorkerCount; Worker++) {
+        State[Worker]->Thread = std::thread(&FanOutDispatcher::WorkerThread, this, Worker);
+    }
+}
+
+void FanOutDispatcher::Stop(_Inout_opt_ UmemFramePool* Pool)
+{
+    if (!Running) {
+        return;
+    }
+
+    //
+    // Keep draining the done rings while the workers finish, so none of them
+    // can wait on a full one forever.
+    //
+    Flush();
+    Stopping.store(true, std::memory_order_release);
+    while (Exited.load(std::memory_order_acquire) != WorkerCount) {
+        Reclaim(Pool);
+        std::this_thread::yield();
+    }
+    for (auto& Worker : State) {
+        Worker->Thread.join();
+    }
+    Reclaim(Pool);
+    Running = false;
+}
+
+UINT32 FanOutDispatcher::FlowHash(_In_reads_bytes_(Length) const UCHAR* Frame, UINT32 Length) const
+{
+    if (Config.Key == FanOutKey::RssHash) {
+        UINT32 Hash;
+        return Hasher->HashFrame(Frame, Length, &Hash) ? Hash : 0;
+    }
+
+    if (Config.FieldLength == 0 || Length < Config.FieldOffset + Config.FieldLength) {
+        return 0;
+    }
+
+    //
+    // Fibonacci hashing spreads small consecutive ids over the whole range,
+    // so they do not all land on the first worker.
+    //
+    UINT64 Field = 0;
+    memcpy(&Field, Frame + Config.FieldOffset, Config.FieldLength);
+    return (UINT32)((Field * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+bool FanOutDispatcher::Dispatch(_In_reads_bytes_(Length) UCHAR* Frame, UINT64 Address, UINT32 Length)
+{
+    UINT32 Hash = FlowHash(Frame, Length);
+    WorkerState& Worker = *State[WorkerOfHash(Hash)];
+
+    if (!Worker.Frames.Push({Frame, Address, Length, Hash})) {
+        Worker.RingFullDrops++;
+        return false;
+    }
+    Worker.Dispatched++;
+    Worker.Pending = true;
+    return true;
+}
+
+void FanOutDispatcher::Flush()
+{
+    for (auto& Worker : State) {
+        if (Worker->Pending) {
+            Worker->Frames.Publish();
+            Worker->Pending = false;
+        }
+    }
+}
+
+UINT32 FanOutDispatcher::Reclaim(_Inout_opt_ UmemFramePool* Pool)
+{
+    UINT64 Addresses[64];
+    UINT32 Total = 0;
+
+    for (auto& Worker : State) {
+        UINT32 Count;
+        while ((Count = Worker->Done.Pop(Addresses, (UINT32)std::size(Addresses))) != 0) {
+            for (UINT32 i = 0; i < Count && Pool != nullptr; i++) {
+                Pool->Free(Addresses[i]);
+            }
+            Total += Count;
+        }
+    }
+    return Total;
+}
+
+FanOutWorkerStats FanOutDispatcher::Statistics(UINT32 Worker) const
+{
+    const WorkerState& Stats = *State[Worker];
+    return {Stats.Dispatched, Stats.Handled.load(std::memory_order_relaxed), Stats.RingFullDrops};
+}
+
+void FanOutDispatcher::WorkerThread(UINT32 Worker)
+{
+    WorkerState& Self = *State[Worker];
+    PinCurrentThread(NthProcessor(Config.WorkerAffinity, Worker));
+    std::unique_ptr<FanOutFrame[]> Batch = std::make_unique<FanOutFrame[]>(Config.WorkerBatch);
+
+    while (TRUE) {
+        //
+        // Stop() flushes before it sets the flag, so a ring found empty after
+        // the flag was seen has nothing left to handle.
+        //
+        bool StopRequested = Stopping.load(std::memory_order_acquire);
+        UINT32 Count = Self.Frames.Pop(Batch.get(), Config.WorkerBatch);
+        if (Count == 0) {
+            if (StopRequested) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        Handle(Worker, Batch.get(), Count);
+        Self.Handled.fetch_add(Count, std::memory_order_relaxed);
+
+        //
+        // The done ring is twice the frame ring, so it only fills if the RX
+        // thread stops reclaiming; wait for it rather than lose frames.
+        //
+        for (UINT32 i = 0; i < Count; i++) {
+            while (!Self.Done.Push(Batch[i].Address)) {
+                Self.Done.Publish();
+                std::this_thread::yield();
+            }
+        }
+        Self.Done.Publish();
+    }
+
+    Exited.fetch_add(1, std::memory_order_release);
+}
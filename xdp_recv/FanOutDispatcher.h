@@ -0,0 +1,153 @@
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "NumaPlacement.h"
+#include "RssPredictor.h"
+#include "SpscRing.h"
+#include "UmemFramePool.h"
+
+//
+// A received frame as handed to a worker: its bytes, the UMEM chunk holding
+// them, which goes back to the frame pool once the worker is done, its length
+// and the flow hash it was dispatched by.
+//
+struct FanOutFrame {
+    UCHAR* Data;
+    UINT64 Address;
+    UINT32 Length;
+    UINT32 FlowHash;
+};
+
+enum class FanOutKey {
+    //
+    // Toeplitz hash of the RSS fields, as the NIC would compute it.
+    //
+    RssHash,
+
+    //
+    // A fixed byte range of the frame, e.g. an instrument or session id at a
+    // known payload offset. Frames too short to hold it go to worker 0.
+    //
+    Field,
+};
+
+struct FanOutConfig {
+    UINT32 Workers = 4;
+    UINT32 RingSize = 1024;
+    UINT32 WorkerBatch = 32;
+    FanOutKey Key = FanOutKey::RssHash;
+    UINT32 FieldOffset = 0;
+    UINT32 FieldLength = 0;
+
+    //
+    // Processors the workers run on, one each in turn. An empty mask leaves
+    // them to the scheduler.
+    //
+    GROUP_AFFINITY WorkerAffinity {};
+};
+
+struct FanOutWorkerStats {
+    UINT64 Dispatched;
+    UINT64 Handled;
+    UINT64 RingFullDrops;
+};
+
+//
+// Software RSS for interfaces with fewer RX queues than cores. The RX thread
+// hashes each frame and pushes its handle onto the SPSC ring of one of N
+// worker threads; workers run the handler and pass the frame addresses back
+// over a second SPSC ring, and the RX thread returns them to its frame pool
+// with Reclaim(). The RX thread stays the only owner of the pool and the fill
+// ring.
+//
+// A flow always maps to the same worker and each ring is FIFO, so per-flow
+// order is preserved. Workers are picked from the high bits of the hash
+// (multiply-shift), which stay independent of the low bits the NIC already
+// used to pick the hardware queue.
+//
+// Dispatch() never blocks: a full worker ring drops the frame, which the
+// caller returns to the pool, rather than stalling every other flow behind
+// it.
+//
+class FanOutDispatcher {
+  public:
+    using Handler = std::function<void(UINT32 Worker, _In_reads_(Count) const FanOutFrame* Frames, UINT32 Count)>;
+
+    //
+    // Hasher is required for FanOutKey::RssHash and must outlive the
+    // dispatcher.
+    //
+    FanOutDispatcher(const FanOutConfig& Config, _In_opt_ const RssPredictor* Hasher);
+    ~FanOutDispatcher();
+
+    FanOutDispatcher(const FanOutDispatcher&) = delete;
+    FanOutDispatcher& operator=(const FanOutDispatcher&) = delete;
+
+    void Start(Handler Handle);
+
+    //
+    // Waits for the workers to drain their rings, then joins them. Frames
+    // the workers are done with go back to Pool, or are discarded if it is
+    // null.
+    //
+    void Stop(_Inout_opt_ UmemFramePool* Pool);
+
+    UINT32 FlowHash(_In_reads_bytes_(Length) const UCHAR* Frame, UINT32 Length) const;
+    UINT32 WorkerOfHash(UINT32 Hash) const { return (UINT32)(((UINT64)Hash * WorkerCount) >> 32); }
+
+    //
+    // RX thread. Frame is the frame's bytes and Address its chunk. Returns
+    // false if the worker's ring was full; the frame is then still owned by
+    // the caller. Dispatched frames become visible to the workers at the next
+    // Flush().
+    //
+    bool Dispatch(_In_reads_bytes_(Length) UCHAR* Frame, UINT64 Address, UINT32 Length);
+    void Flush();
+
+    //
+    // RX thread. Returns frames the workers are done with to Pool.
+    //
+    UINT32 Reclaim(_Inout_opt_ UmemFramePool* Pool);
+
+    UINT32 Workers() const { return WorkerCount; }
+    FanOutWorkerStats Statistics(UINT32 Worker) const;
+
+  private:
+    struct alignas(64) WorkerState {
+        WorkerState(UINT32 RingSize) : Frames(RingSize), Done(2 * RingSize) {}
+
+        SpscRing<FanOutFrame> Frames;
+        SpscRing<UINT64> Done;
+        std::thread Thread;
+
+        //
+        // Written by the RX thread.
+        //
+        UINT64 Dispatched = 0;
+        UINT64 RingFullDrops = 0;
+        bool Pending = false;
+
+        //
+        // Written by the worker.
+        //
+        alignas(64) std::atomic<UINT64> Handled {0};
+    };
+
+    void WorkerThread(UINT32 Worker);
+
+    FanOutConfig Config;
+    const RssPredictor* Hasher;
+    UINT32 WorkerCount;
+    std::vector<std::unique_ptr<WorkerState>> State;
+    Handler Handle;
+    std::atomic<bool> Stopping {false};
+    std::atomic<UINT32> Exited {0};
+    bool Running = false;
+};
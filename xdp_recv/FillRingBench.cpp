@@ -0,0 +1,153 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <memory>
+
+#include "Benchmarks.h"
+#include "FillRingRefiller.h"
+#include "SoftwareXsk.h"
+#include "UmemFramePool.h"
+
+static constexpr UINT32 BenchChunkSize = 2048;
+static constexpr UINT32 BenchFrameLength = 128;
+
+struct FillPolicy {
+    const char* Name;
+    UINT32 SpareFrames;
+    UINT32 LowWatermark;
+};
+
+struct FillRunResult {
+    UINT64 Delivered;
+    UINT64 FillStarvedDrops;
+    UINT64 RxFullDrops;
+    FillRingStats Refill;
+};
+
+//
+// Runs the software NIC at a fixed packet rate against a consumer that keeps
+// every frame for HoldUs before giving it back, which is what a slow
+// downstream stage looks like to the fill ring. Both run on this thread in
+// simulated time, one frame interval per step, so the drops come from the
+// policy alone and not from how the two threads would share the cores.
+//
+static FillRunResult RunFillPolicy(
+    const FillPolicy& Policy,
+    UINT32 RingSize,
+    UINT32 Rate,
+    UINT32 HoldUs,
+    UINT32 Seconds)
+{
+    UINT32 FrameCount = RingSize + Policy.SpareFrames;
+    UINT64 UmemSize = (UINT64)FrameCount * BenchChunkSize;
+    auto Umem = std::make_unique<UCHAR[]>(UmemSize);
+
+    SoftwareXsk Xsk(Umem.get(), UmemSize, BenchChunkSize, RingSize);
+    XSK_RING RxRing;
+    XSK_RING FillRing;
+    XskRingInitialize(&RxRing, &Xsk.RingInfo().Rx);
+    XskRingInitialize(&FillRing, &Xsk.RingInfo().Fill);
+
+    UmemFramePool Pool(FrameCount);
+    Pool.AddRegion(0, FrameCount, BenchChunkSize);
+    FillRingRefiller Refiller(&FillRing, &Pool, Policy.LowWatermark);
+    Refiller.Refill();
+
+    //
+    // Frames are held by their chunk, which is what goes back to the pool.
+    //
+    struct HeldFrame {
+        UINT64 Address;
+        UINT64 ReleaseNs;
+    };
+    auto Held = std::make_unique<HeldFrame[]>(FrameCount);
+    UINT32 HeldHead = 0;
+    UINT32 HeldCount = 0;
+    UINT64 HoldNs = (UINT64)HoldUs * 1000;
+
+    UCHAR Frame[BenchFrameLength] = {};
+    UINT64 Frames = (UINT64)Rate * Seconds;
+    for (UINT64 Sent = 0; Sent < Frames; Sent++) {
+        UINT64 Now = Sent * 1000000000ull / Rate;
+        Xsk.Deliver(Frame, sizeof(Frame));
+
+        UINT32 Index;
+        UINT32 Count = XskRingConsumerReserve(&RxRing, 64, &Index);
+        for (UINT32 i = 0; i < Count; i++) {
+            XSK_BUFFER_DESCRIPTOR* Descriptor = (XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&RxRing, Index + i);
+            Held[(HeldHead + HeldCount) % FrameCount] = {Descriptor->Address.BaseAddress, Now + HoldNs};
+            HeldCount++;
+        }
+        if (Count > 0) {
+            XskRingConsumerRelease(&RxRing, Count);
+        }
+
+        while (HeldCount > 0 && Held[HeldHead].ReleaseNs <= Now) {
+            Pool.Free(Held[HeldHead].Address);
+            HeldHead = (HeldHead + 1) % FrameCount;
+            HeldCount--;
+        }
+
+        Refiller.Refill();
+    }
+
+    return {Xsk.Delivered(), Xsk.FillStarved(), Xsk.RxFull(), Refiller.Statistics()};
+}
+
+//
+// Compares the one-for-one fill policy of the original receive loop (no spare
+// frames, every returned frame goes straight back to the fill ring) with the
+// low-watermark policy backed by a spare pool.
+//
+int FillRingBenchmark(int argc, char** argv)
+{
+    UINT32 Rate = argc >= 1 ? atoi(argv[0]) : 500000;
+    UINT32 HoldUs = argc >= 2 ? atoi(argv[1]) : 500;
+    UINT32 Seconds = argc >= 3 ? atoi(argv[2]) : 5;
+    UINT32 RingSize = argc >= 4 ? atoi(argv[3]) : 128;
+    UINT32 SpareFrames = argc >= 5 ? atoi(argv[4]) : 1024;
+
+    if (Rate == 0 || RingSize == 0 || (RingSize & (RingSize - 1)) != 0) {
+        fprintf(stderr, "rate must be non-zero and ring size a power of two\n");
+        return EXIT_FAILURE;
+    }
+
+    const FillPolicy Policies[] = {
+        {"one-for-one", 0, RingSize},
+        {"low-watermark", SpareFrames, RingSize / 2},
+    };
+
+    printf(
+        "rate=%u pps, hold=%u us (%llu frames in flight), ring=%u, spare=%u, %u s\n\n",
+        Rate,
+        HoldUs,
+        (unsigned long long)Rate * HoldUs / 1000000,
+        RingSize,
+        SpareFrames,
+        Seconds);
+    printf(
+        "%-14s %12s %14s %12s %12s %12s %12s\n",
+        "policy",
+        "delivered",
+        "fill-drops",
+        "rx-drops",
+        "starvation",
+        "empty",
+        "refills");
+
+    for (const FillPolicy& Policy : Policies) {
+        FillRunResult Result = RunFillPolicy(Policy, RingSize, Rate, HoldUs, Seconds);
+        printf(
+            "%-14s %12llu %14llu %12llu %12llu %12llu %12llu\n",
+            Policy.Name,
+            (unsigned long long)Result.Delivered,
+            (unsigned long long)Result.FillStarvedDrops,
+            (unsigned long long)Result.RxFullDrops,
+            (unsigned long long)Result.Refill.StarvationEvents,
+            (unsigned long long)Result.Refill.EmptyEvents,
+            (unsigned long long)Result.Refill.Refills);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <windows.h>
+#include <afxdp_helper.h>
+
+#include "UmemFramePool.h"
+
+struct FillRingStats {
+    UINT64 Refills;
+    UINT64 FramesPosted;
+
+    //
+    // Number of times the fill ring dropped below the low watermark and the
+    // spare pool could not lift it back above. Every starvation episode counts
+    // once, however long it lasts.
+    //
+    UINT64 StarvationEvents;
+
+    //
+    // Number of times the fill ring was found completely empty. While empty,
+    // XDP has nowhere to place frames and drops them (XSK_STATISTICS.RxDropped).
+    //
+    UINT64 EmptyEvents;
+};
+
+//
+// Keeps the RX fill ring above a low watermark from a pool of spare UMEM
+// frames. Frames the application is done with go back to the pool, not
+// straight to the fill ring, so a frame held by downstream code no longer
+// shrinks the fill ring. Refill() tops the ring up in one bulk submit once it
+// crosses the watermark; call it once per RX loop iteration.
+//
+class FillRingRefiller {
+  public:
+    FillRingRefiller(
+        _In_ XSK_RING* FillRing,
+        _In_ UmemFramePool* Pool,
+        UINT32 LowWatermark,
+        UINT32 MaxBatch = MAXUINT32)
+        : FillRing(FillRing)
+        , Pool(Pool)
+        , LowWatermark(LowWatermark < FillRing->Size ? LowWatermark : FillRing->Size)
+        , MaxBatch(MaxBatch)
+    {
+        if (this->LowWatermark == 0) {
+            this->LowWatermark = 1;
+        }
+    }
+
+    //
+    // Entries posted to the fill ring that XDP has not consumed yet.
+    //
+    UINT32 Occupancy() const { return *FillRing->SharedProducer - ReadUInt32Acquire(FillRing->SharedConsumer); }
+
+    UINT32 Refill()
+    {
+        UINT32 Level = Occupancy();
+
+        if (Level == 0) {
+            if (!WasEmpty) {
+                Stats.EmptyEvents++;
+                WasEmpty = true;
+            }
+        } else {
+            WasEmpty = false;
+        }
+
+        if (Level >= LowWatermark) {
+            Starving = false;
+            return 0;
+        }
+
+        UINT32 Index;
+        UINT32 Wanted = FillRing->Size - Level;
+        if (Wanted > MaxBatch) {
+            Wanted = MaxBatch;
+        }
+        Wanted = XskRingProducerReserve(FillRing, Wanted, &Index);
+
+        UINT32 Posted = 0;
+        UINT64 Address;
+        while (Posted < Wanted && Pool->Allocate(&Address)) {
+            *(UINT64*)XskRingGetElement(FillRing, Index + Posted) = Address;
+            Posted++;
+        }
+
+        if (Posted > 0) {
+            XskRingProducerSubmit(FillRing, Posted);
+            Stats.Refills++;
+            Stats.FramesPosted += Posted;
+        }
+
+        if (Level + Posted < LowWatermark) {
+            if (!Starving) {
+                Stats.StarvationEvents++;
+                Starving = true;
+            }
+        } else {
+            Starving = false;
+        }
+
+        return Posted;
+    }
+
+    UINT32 Watermark() const { return LowWatermark; }
+    const FillRingStats& Statistics() const { return Stats; }
+
+  private:
+    XSK_RING* FillRing;
+    UmemFramePool* Pool;
+    UINT32 LowWatermark;
+    UINT32 MaxBatch;
+    bool Starving = false;
+    bool WasEmpty = false;
+    FillRingStats Stats {};
+};
@@ -0,0 +1,509 @@
+#pragma once
+
+#include <windows.h>
+#include <immintrin.h>
+#include <string.h>
+
+#include <bit>
+#include <functional>
+#include <memory>
+
+#include "PacketHeaders.h"
+
+//
+// IPv4 5-tuple of a flow, addresses and ports in network byte order. Ports
+// are zero for protocols without them and for non-first fragments.
+//
+struct FlowKey {
+    UINT32 SourceAddress;
+    UINT32 DestinationAddress;
+    UINT16 SourcePort;
+    UINT16 DestinationPort;
+    UINT8 Protocol;
+    UINT8 Reserved[3];
+};
+
+C_ASSERT(sizeof(FlowKey) == 16);
+
+inline FlowKey MakeFlowKey(const Ipv4Frame& Parsed)
+{
+    FlowKey Key {};
+    Key.SourceAddress = Parsed.Ip->SourceAddress;
+    Key.DestinationAddress = Parsed.Ip->DestinationAddress;
+    Key.Protocol = Parsed.Ip->Protocol;
+
+    //
+    // UDP and TCP both start with the two ports.
+    //
+    bool FirstFragment = (NetToHost16(Parsed.Ip->FlagsAndFragmentOffset) & Ipv4FragmentOffsetMask) == 0;
+    if ((Key.Protocol == IpProtocolUdp || Key.Protocol == IpProtocolTcp) && FirstFragment && Parsed.L4Length >= 4) {
+        memcpy(&Key.SourcePort, Parsed.L4, sizeof(Key.SourcePort));
+        memcpy(&Key.DestinationPort, Parsed.L4 + 2, sizeof(Key.DestinationPort));
+    }
+    return Key;
+}
+
+inline UINT64 FlowKeyHash(const FlowKey& Key)
+{
+    UINT64 Low;
+    UINT64 High;
+    memcpy(&Low, &Key, sizeof(Low));
+    memcpy(&High, (const UCHAR*)&Key + sizeof(Low), sizeof(High));
+
+    UINT64 Hash = Low * 0x87c37b91114253d5ull ^ std::rotl(High * 0x4cf5ad432745937full, 31);
+    Hash ^= Hash >> 33;
+    Hash *= 0xff51afd7ed558ccdull;
+    Hash ^= Hash >> 33;
+    return Hash;
+}
+
+struct FlowTableConfig {
+    UINT32 MaxFlows = 65536;
+
+    //
+    // A flow not seen for this long is removed by ExpireIdle(). Zero keeps
+    // flows until the table is full.
+    //
+    UINT64 IdleTicks = 0;
+
+    //
+    // Flows looked at to pick one to evict when the table is full; the least
+    // recently seen of them goes.
+    //
+    UINT32 EvictionSample = 16;
+};
+
+struct FlowTableStats {
+    UINT64 Lookups;
+    UINT64 Hits;
+    UINT64 Inserts;
+    UINT64 Erased;
+    UINT64 IdleEvictions;
+    UINT64 FullEvictions;
+};
+
+//
+// Fixed-capacity per-flow state for the RX thread, looked up by 5-tuple on
+// every frame.
+//
+// The index is an open-addressing table in the style of SwissTable and F14:
+// each 64-byte bucket holds 12 one-byte tags (seven hash bits and an in-use
+// bit) and the 12 flow indexes they belong to, so one cache line and one
+// SSE2 compare narrow a probe down to the few flows worth a key compare.
+// Buckets count the inserts that probed past them while full; a lookup stops
+// at the first bucket with no such overflow, and erasing a flow gives the
+// counts back, so lookups stay short under churn without tombstones. The
+// index is kept at most about 80% full.
+//
+// Flow state lives in a preallocated array, so State pointers stay put and
+// nothing is allocated after construction. A full table evicts the least
+// recently seen of a few flows next to a clock hand (sampled LRU);
+// ExpireIdle() walks the same hand to drop idle flows a few at a time
+// between bursts, instead of a timer per flow that every frame would have
+// to push back.
+//
+// FindBatch() looks up a whole burst in stages: hash every key and prefetch
+// its home bucket, match tags and prefetch the candidate flows, then compare
+// keys. At table sizes past the cache, the misses of a burst overlap instead
+// of being paid one after another.
+//
+// Single-threaded: the owning thread makes every call.
+//
+template <typename State>
+class FlowTable {
+  public:
+    static constexpr UINT32 MaxBatch = 64;
+
+    //
+    // Called with the state of a flow that is evicted, before it is reused.
+    // Not called for Erase().
+    //
+    using EvictCallback = std::function<void(const FlowKey& Key, State& Flow)>;
+
+    explicit FlowTable(const FlowTableConfig& Config, EvictCallback OnEvict = nullptr)
+        : Config(Config)
+        , OnEvict(std::move(OnEvict))
+    {
+        if (this->Config.MaxFlows < 2 * MaxBatch) {
+            this->Config.MaxFlows = 2 * MaxBatch;
+        }
+        if (this->Config.EvictionSample == 0) {
+            this->Config.EvictionSample = 1;
+        }
+
+        BucketCount = 1;
+        while (BucketCount * SlotsPerBucket * 4 < this->Config.MaxFlows * 5ull) {
+            BucketCount <<= 1;
+        }
+        BucketMask = BucketCount - 1;
+        Buckets = std::make_unique<Bucket[]>(BucketCount);
+
+        Entries = std::make_unique<Entry[]>(this->Config.MaxFlows);
+        for (UINT32 Index = this->Config.MaxFlows; Index-- > 0;) {
+            Entries[Index].Location = None;
+            Entries[Index].Pin = FreeList;
+            FreeList = Index;
+        }
+    }
+
+    FlowTable(const FlowTable&) = delete;
+    FlowTable& operator=(const FlowTable&) = delete;
+
+    //
+    // Returns the state of Key's flow and marks it seen at NowTick, or
+    // nullptr if the flow is not in the table.
+    //
+    State* Find(const FlowKey& Key, UINT64 NowTick)
+    {
+        Stats.Lookups++;
+        Entry* Flow = Lookup(Key, FlowKeyHash(Key));
+        if (Flow == nullptr) {
+            return nullptr;
+        }
+
+        Stats.Hits++;
+        Flow->LastSeen = NowTick;
+        return &Flow->Value;
+    }
+
+    //
+    // Like Find(), but adds the flow with value-initialized state if it is
+    // new, evicting another if the table is full. Never fails.
+    //
+    State* FindOrInsert(const FlowKey& Key, UINT64 NowTick, _Out_opt_ bool* Inserted = nullptr)
+    {
+        return FindOrInsertHashed(Key, FlowKeyHash(Key), NowTick, Inserted);
+    }
+
+    //
+    // A lookup spread over a pipeline, each step a few frames after the one
+    // before: Prefetch() the home bucket of the key's hash, PrefetchFlow()
+    // the flow its tag points at once the bucket is in cache, then
+    // FindOrInsertHashed() with the same hash.
+    //
+    void Prefetch(UINT64 Hash) const { _mm_prefetch((const char*)&Buckets[HomeOf(Hash)], _MM_HINT_T0); }
+
+    void PrefetchFlow(UINT64 Hash) const
+    {
+        //
+        // The first tag match in the home bucket is almost always the flow.
+        //
+        const Bucket& Home = Buckets[HomeOf(Hash)];
+        UINT32 Matches = MatchTags(Home, TagOf(Hash));
+        if (Matches != 0) {
+            _mm_prefetch((const char*)&Entries[Home.Flows[std::countr_zero(Matches)]], _MM_HINT_T0);
+        }
+    }
+
+    State* FindOrInsertHashed(const FlowKey& Key, UINT64 Hash, UINT64 NowTick, _Out_opt_ bool* Inserted = nullptr)
+    {
+        Stats.Lookups++;
+        Entry* Flow = Lookup(Key, Hash);
+        if (Inserted != nullptr) {
+            *Inserted = Flow == nullptr;
+        }
+        if (Flow == nullptr) {
+            Flow = Insert(Key, Hash);
+        } else {
+            Stats.Hits++;
+        }
+
+        Flow->LastSeen = NowTick;
+        return &Flow->Value;
+    }
+
+    //
+    // Find() or, with Insert, FindOrInsert() for each of up to MaxBatch keys;
+    // Flows[i] receives the state for Keys[i]. Inserts never evict a flow
+    // found or inserted earlier in the same call.
+    //
+    void FindBatch(
+        _In_reads_(Count) const FlowKey* Keys,
+        UINT32 Count,
+        UINT64 NowTick,
+        bool Insert,
+        _Out_writes_(Count) State** Flows)
+    {
+        if (Count > MaxBatch) {
+            Count = MaxBatch;
+        }
+
+        UINT64 Hashes[MaxBatch];
+        for (UINT32 i = 0; i < Count; i++) {
+            Hashes[i] = FlowKeyHash(Keys[i]);
+            Prefetch(Hashes[i]);
+        }
+        for (UINT32 i = 0; i < Count; i++) {
+            PrefetchFlow(Hashes[i]);
+        }
+
+        Batch++;
+        InBatch = true;
+        Stats.Lookups += Count;
+        for (UINT32 i = 0; i < Count; i++) {
+            Entry* Flow = Lookup(Keys[i], Hashes[i]);
+            if (Flow != nullptr) {
+                Stats.Hits++;
+            } else if (Insert) {
+                Flow = this->Insert(Keys[i], Hashes[i]);
+            } else {
+                Flows[i] = nullptr;
+                continue;
+            }
+
+            Flow->LastSeen = NowTick;
+            Flow->Pin = Batch;
+            Flows[i] = &Flow->Value;
+        }
+
+        //
+        // Pins only hold within a call; single inserts may evict anything.
+        //
+        InBatch = false;
+    }
+
+    //
+    // Removes Key's flow. Returns false if it was not in the table.
+    //
+    bool Erase(const FlowKey& Key)
+    {
+        Entry* Flow = Lookup(Key, FlowKeyHash(Key));
+        if (Flow == nullptr) {
+            return false;
+        }
+
+        Remove((UINT32)(Flow - Entries.get()));
+        Stats.Erased++;
+        return true;
+    }
+
+    //
+    // Looks at up to Budget flows, continuing where the last call stopped,
+    // and evicts those idle for IdleTicks or longer. Returns the number
+    // evicted. Calling it between bursts bounds its cost per RX iteration;
+    // an idle flow goes within one sweep of the table after its timeout.
+    //
+    UINT32 ExpireIdle(UINT64 NowTick, UINT32 Budget)
+    {
+        if (Config.IdleTicks == 0 || Active == 0) {
+            return 0;
+        }
+
+        UINT32 Evicted = 0;
+        for (; Budget != 0; Budget--) {
+            UINT32 Index = NextHand();
+            Entry& Flow = Entries[Index];
+            if (Flow.Location != None && NowTick >= Flow.LastSeen && NowTick - Flow.LastSeen >= Config.IdleTicks) {
+                Evict(Index);
+                Stats.IdleEvictions++;
+                Evicted++;
+            }
+        }
+        return Evicted;
+    }
+
+    UINT32 Flows() const { return Active; }
+    UINT32 Capacity() const { return Config.MaxFlows; }
+    const FlowTableStats& Statistics() const { return Stats; }
+
+    UINT64 MemoryFootprint() const
+    {
+        return (UINT64)BucketCount * sizeof(Bucket) + (UINT64)Config.MaxFlows * sizeof(Entry);
+    }
+
+  private:
+    static constexpr UINT32 None = MAXUINT32;
+    static constexpr UINT32 SlotsPerBucket = 12;
+    static constexpr UINT32 SlotsMask = (1u << SlotsPerBucket) - 1;
+    static constexpr UINT8 EmptyTag = 0;
+
+    struct alignas(64) Bucket {
+        UINT8 Tags[SlotsPerBucket];
+
+        //
+        // Inserts that probed past this bucket because it was full, and
+        // whose flows are still in the table. Saturates.
+        //
+        UINT8 Overflow;
+        UINT8 Reserved[3];
+        UINT32 Flows[SlotsPerBucket];
+    };
+
+    C_ASSERT(sizeof(Bucket) == 64);
+
+    struct Entry {
+        FlowKey Key;
+        UINT64 LastSeen;
+
+        //
+        // Bucket * SlotsPerBucket + slot while in use; None while free.
+        //
+        UINT32 Location;
+
+        //
+        // The FindBatch() call that last touched the flow; the next free
+        // entry while free.
+        //
+        UINT32 Pin;
+        State Value;
+    };
+
+    static UINT8 TagOf(UINT64 Hash) { return (UINT8)(0x80 | (Hash & 0x7f)); }
+
+    UINT32 HomeOf(UINT64 Hash) const { return (UINT32)(Hash >> 7) & BucketMask; }
+
+    static UINT32 MatchTags(const Bucket& Slots, UINT8 Tag)
+    {
+        __m128i Tags = _mm_load_si128((const __m128i*)Slots.Tags);
+        return (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi8(Tags, _mm_set1_epi8((char)Tag))) & SlotsMask;
+    }
+
+    static bool SameKey(const FlowKey& Left, const FlowKey& Right)
+    {
+        UINT64 A[2];
+        UINT64 B[2];
+        memcpy(A, &Left, sizeof(A));
+        memcpy(B, &Right, sizeof(B));
+        return ((A[0] ^ B[0]) | (A[1] ^ B[1])) == 0;
+    }
+
+    //
+    // Buckets are probed at triangular offsets from the home bucket, which
+    // visits every bucket of a power-of-two table once.
+    //
+    Entry* Lookup(const FlowKey& Key, UINT64 Hash)
+    {
+        UINT8 Tag = TagOf(Hash);
+        UINT32 Index = HomeOf(Hash);
+        for (UINT32 Probe = 1;; Probe++) {
+            const Bucket& Slots = Buckets[Index];
+            for (UINT32 Matches = MatchTags(Slots, Tag); Matches != 0; Matches &= Matches - 1) {
+                Entry& Flow = Entries[Slots.Flows[std::countr_zero(Matches)]];
+                if (SameKey(Flow.Key, Key)) {
+                    return &Flow;
+                }
+            }
+            if (Slots.Overflow == 0) {
+                return nullptr;
+            }
+            Index = (Index + Probe) & BucketMask;
+        }
+    }
+
+    Entry* Insert(const FlowKey& Key, UINT64 Hash)
+    {
+        if (FreeList == None) {
+            EvictLeastRecent();
+        }
+
+        UINT32 Index = FreeList;
+        Entry& Flow = Entries[Index];
+        FreeList = Flow.Pin;
+        Flow.Key = Key;
+        Flow.Pin = Batch;
+        Flow.Value = State {};
+
+        //
+        // The index has more slots than there are flows, so a free slot is
+        // always found.
+        //
+        UINT32 BucketIndex = HomeOf(Hash);
+        for (UINT32 Probe = 1;; Probe++) {
+            Bucket& Slots = Buckets[BucketIndex];
+            UINT32 Free = MatchTags(Slots, EmptyTag);
+            if (Free != 0) {
+                UINT32 Slot = std::countr_zero(Free);
+                Slots.Tags[Slot] = TagOf(Hash);
+                Slots.Flows[Slot] = Index;
+                Flow.Location = BucketIndex * SlotsPerBucket + Slot;
+                break;
+            }
+            if (Slots.Overflow != MAXUINT8) {
+                Slots.Overflow++;
+            }
+            BucketIndex = (BucketIndex + Probe) & BucketMask;
+        }
+
+        Active++;
+        Stats.Inserts++;
+        return &Flow;
+    }
+
+    void Remove(UINT32 Index)
+    {
+        Entry& Flow = Entries[Index];
+        UINT32 Target = Flow.Location / SlotsPerBucket;
+        Buckets[Target].Tags[Flow.Location % SlotsPerBucket] = EmptyTag;
+
+        //
+        // Give back the overflow counts the insert took on its way here.
+        //
+        UINT32 BucketIndex = HomeOf(FlowKeyHash(Flow.Key));
+        for (UINT32 Probe = 1; BucketIndex != Target; Probe++) {
+            Bucket& Slots = Buckets[BucketIndex];
+            if (Slots.Overflow != MAXUINT8) {
+                Slots.Overflow--;
+            }
+            BucketIndex = (BucketIndex + Probe) & BucketMask;
+        }
+
+        Flow.Location = None;
+        Flow.Pin = FreeList;
+        FreeList = Index;
+        Active--;
+    }
+
+    void Evict(UINT32 Index)
+    {
+        if (OnEvict) {
+            OnEvict(Entries[Index].Key, Entries[Index].Value);
+        }
+        Remove(Index);
+    }
+
+    UINT32 NextHand()
+    {
+        UINT32 Index = Hand;
+        Hand = Hand + 1 != Config.MaxFlows ? Hand + 1 : 0;
+        return Index;
+    }
+
+    //
+    // Only called with every entry in use. At most MaxBatch of them are
+    // pinned by the current batch, so the sample always finds a victim.
+    //
+    void EvictLeastRecent()
+    {
+        UINT32 Victim = None;
+        for (UINT32 Sampled = 0; Sampled < Config.EvictionSample || Victim == None;) {
+            UINT32 Index = NextHand();
+            const Entry& Flow = Entries[Index];
+            if (InBatch && Flow.Pin == Batch) {
+                continue;
+            }
+            if (Victim == None || Flow.LastSeen < Entries[Victim].LastSeen) {
+                Victim = Index;
+            }
+            Sampled++;
+        }
+
+        Evict(Victim);
+        Stats.FullEvictions++;
+    }
+
+    FlowTableConfig Config;
+    EvictCallback OnEvict;
+
+    std::unique_ptr<Bucket[]> Buckets;
+    UINT32 BucketCount;
+    UINT32 BucketMask;
+
+    std::unique_ptr<Entry[]> Entries;
+    UINT32 FreeList = None;
+    UINT32 Active = 0;
+    UINT32 Hand = 0;
+    UINT32 Batch = 0;
+    bool InBatch = false;
+
+    FlowTableStats Stats {};
+};
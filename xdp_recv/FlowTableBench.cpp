@@ -0,0 +1,238 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "FlowTable.h"
+#include "TscClock.h"
+
+//
+// What the RX path keeps per flow: the last sequence number and counters.
+//
+struct BenchFlow {
+    UINT64 Frames;
+    UINT64 Bytes;
+    UINT32 Sequence;
+};
+
+struct FlowKeyHasher {
+    size_t operator()(const FlowKey& Key) const { return (size_t)FlowKeyHash(Key); }
+};
+
+struct FlowKeyEqual {
+    bool operator()(const FlowKey& Left, const FlowKey& Right) const
+    {
+        return memcmp(&Left, &Right, sizeof(FlowKey)) == 0;
+    }
+};
+
+struct FlowRunResult {
+    double InsertNs;
+    double FindMlps;
+    double BatchMlps;
+    double MapMlps;
+    double ChurnMlps;
+    double BytesPerFlow;
+    double MapBytesPerFlow;
+    UINT64 Misses;
+};
+
+static FlowKey RandomFlowKey(std::mt19937_64& Random)
+{
+    UINT64 Bits = Random();
+    FlowKey Key {};
+    Key.SourceAddress = (UINT32)Bits;
+    Key.DestinationAddress = 0xef000000 | ((UINT32)(Bits >> 32) & 0xffff);
+    Key.SourcePort = (UINT16)(Bits >> 48);
+    Key.DestinationPort = (UINT16)Random();
+    Key.Protocol = IpProtocolUdp;
+    return Key;
+}
+
+static void CountFrame(_Inout_ BenchFlow* Flow, UINT32 Length)
+{
+    Flow->Frames++;
+    Flow->Bytes += Length;
+    Flow->Sequence++;
+}
+
+//
+// Fills a table with Flows flows, then looks up a stream of keys drawn
+// uniformly from them, one at a time, in bursts, and in std::unordered_map.
+// The churn run replaces a tenth of the lookups with new flows, so a full
+// table evicts on every one of them.
+//
+static FlowRunResult RunFlows(const TscClock& Clock, UINT32 Flows, UINT32 Lookups, UINT32 Batch)
+{
+    std::mt19937_64 Random(Flows);
+    std::vector<FlowKey> Keys(Flows);
+    for (FlowKey& Key : Keys) {
+        Key = RandomFlowKey(Random);
+    }
+
+    //
+    // The keys as a stream of frames would present them; reading the stream
+    // is sequential, as parsing the headers of a burst is.
+    //
+    std::vector<FlowKey> Stream(Lookups);
+    for (FlowKey& Key : Stream) {
+        Key = Keys[Random() % Flows];
+    }
+
+    FlowRunResult Result {};
+    FlowTableConfig Config;
+    Config.MaxFlows = Flows;
+    auto Table = std::make_unique<FlowTable<BenchFlow>>(Config);
+
+    UINT64 Start = Clock.NowOrdered();
+    for (const FlowKey& Key : Keys) {
+        Table->FindOrInsert(Key, 0);
+    }
+    Result.InsertNs = (double)Clock.TicksToNs(Clock.NowOrdered() - Start) / Flows;
+    Result.BytesPerFlow = (double)Table->MemoryFootprint() / Flows;
+
+    Start = Clock.NowOrdered();
+    for (UINT32 i = 0; i < Lookups; i++) {
+        BenchFlow* Flow = Table->Find(Stream[i], i);
+        if (Flow == nullptr) {
+            Result.Misses++;
+            continue;
+        }
+        CountFrame(Flow, 64);
+    }
+    Result.FindMlps = Lookups * 1000.0 / Clock.TicksToNs(Clock.NowOrdered() - Start);
+
+    BenchFlow* Found[FlowTable<BenchFlow>::MaxBatch];
+    Start = Clock.NowOrdered();
+    for (UINT32 Next = 0; Next < Lookups; Next += Batch) {
+        UINT32 Count = Lookups - Next < Batch ? Lookups - Next : Batch;
+        Table->FindBatch(&Stream[Next], Count, Next, false, Found);
+        for (UINT32 i = 0; i < Count; i++) {
+            if (Found[i] == nullptr) {
+                Result.Misses++;
+                continue;
+            }
+            CountFrame(Found[i], 64);
+        }
+    }
+    Result.BatchMlps = Lookups * 1000.0 / Clock.TicksToNs(Clock.NowOrdered() - Start);
+
+    //
+    // Every tenth key of the churn stream is a flow the table has not seen.
+    //
+    for (UINT32 i = 0; i < Lookups; i += 10) {
+        Stream[i] = RandomFlowKey(Random);
+    }
+    Start = Clock.NowOrdered();
+    for (UINT32 Next = 0; Next < Lookups; Next += Batch) {
+        UINT32 Count = Lookups - Next < Batch ? Lookups - Next : Batch;
+        Table->FindBatch(&Stream[Next], Count, Next, true, Found);
+        for (UINT32 i = 0; i < Count; i++) {
+            CountFrame(Found[i], 64);
+        }
+    }
+    Result.ChurnMlps = Lookups * 1000.0 / Clock.TicksToNs(Clock.NowOrdered() - Start);
+    Table.reset();
+
+    //
+    // The node-based map the table replaces, on the original stream.
+    //
+    for (UINT32 i = 0; i < Lookups; i += 10) {
+        Stream[i] = Keys[Random() % Flows];
+    }
+    std::unordered_map<FlowKey, BenchFlow, FlowKeyHasher, FlowKeyEqual> Map;
+    Map.reserve(Flows);
+    for (const FlowKey& Key : Keys) {
+        Map.emplace(Key, BenchFlow {});
+    }
+
+    //
+    // Node, hash code, allocator header and bucket pointer.
+    //
+    Result.MapBytesPerFlow =
+        (double)(Map.size() * (sizeof(void*) + sizeof(FlowKey) + sizeof(BenchFlow) + sizeof(size_t) + 16) +
+                 Map.bucket_count() * sizeof(void*)) /
+        Flows;
+
+    Start = Clock.NowOrdered();
+    for (UINT32 i = 0; i < Lookups; i++) {
+        auto Flow = Map.find(Stream[i]);
+        if (Flow == Map.end()) {
+            Result.Misses++;
+            continue;
+        }
+        CountFrame(&Flow->second, 64);
+    }
+    Result.MapMlps = Lookups * 1000.0 / Clock.TicksToNs(Clock.NowOrdered() - Start);
+    return Result;
+}
+
+//
+// Flow table lookups per second at 10k, 1M and 10M flows, one at a time and
+// in prefetched bursts, against std::unordered_map.
+//
+int FlowTableBenchmark(int argc, char** argv)
+{
+    UINT32 Lookups = argc >= 1 ? atoi(argv[0]) : 10000000;
+    UINT32 Batch = argc >= 2 ? atoi(argv[1]) : 32;
+    UINT32 MaxFlows = argc >= 3 ? atoi(argv[2]) : 10000000;
+
+    if (Lookups == 0 || Batch == 0 || Batch > FlowTable<BenchFlow>::MaxBatch) {
+        fprintf(stderr, "lookups must be positive and batch between 1 and %u\n", FlowTable<BenchFlow>::MaxBatch);
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    printf("%u lookups per run, uniform over the flows, bursts of %u\n\n", Lookups, Batch);
+    printf(
+        "%-10s %10s %10s %10s %10s %10s %12s %12s\n",
+        "flows",
+        "insert",
+        "find",
+        "batch",
+        "churn",
+        "std map",
+        "table",
+        "std map");
+    printf(
+        "%-10s %10s %10s %10s %10s %10s %12s %12s\n",
+        "",
+        "ns",
+        "M/s",
+        "M/s",
+        "M/s",
+        "M/s",
+        "bytes/flow",
+        "bytes/flow");
+
+    static const UINT32 FlowCounts[] = {10000, 1000000, 10000000};
+    for (UINT32 Flows : FlowCounts) {
+        if (Flows > MaxFlows) {
+            break;
+        }
+
+        FlowRunResult Result = RunFlows(Clock, Flows, Lookups, Batch);
+        printf(
+            "%-10u %10.1f %10.2f %10.2f %10.2f %10.2f %12.1f %12.1f\n",
+            Flows,
+            Result.InsertNs,
+            Result.FindMlps,
+            Result.BatchMlps,
+            Result.ChurnMlps,
+            Result.MapMlps,
+            Result.BytesPerFlow,
+            Result.MapBytesPerFlow);
+        if (Result.Misses != 0) {
+            fprintf(stderr, "%llu lookups missed\n", (unsigned long long)Result.Misses);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
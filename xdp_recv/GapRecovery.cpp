@@ -0,0 +1,300 @@
+#include "GapRecovery.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+//
+// A message count of 0xFFFF ends the session.
+//
+static constexpr UINT16 EndOfSession = 0xFFFF;
+
+UINT32 MoldUdp64RequestFormat::WriteRequest(
+    const MoldSession& Session,
+    UINT64 Sequence,
+    UINT16 Count,
+    _Out_writes_bytes_(MaxRequestSize) UCHAR* Request) const
+{
+    memcpy(Request + Itch::MoldUdp64::SessionOffset, Session.Name, sizeof(Session.Name));
+    WireStoreBig(Request + Itch::MoldUdp64::SequenceNumberOffset, Sequence, 8);
+    WireStoreBig(Request + Itch::MoldUdp64::MessageCountOffset, Count, 2);
+    return Itch::MoldUdp64::Size;
+}
+
+bool MoldUdp64RequestFormat::ParseRequest(
+    _In_reads_bytes_(Length) const UCHAR* Request,
+    UINT32 Length,
+    _Out_ MoldSession* Session,
+    _Out_ UINT64* Sequence,
+    _Out_ UINT16* Count) const
+{
+    if (Length != Itch::MoldUdp64::Size) {
+        return false;
+    }
+
+    Itch::MoldUdp64 Header(Request);
+    memcpy(Session->Name, Header.Session(), sizeof(Session->Name));
+    *Sequence = Header.SequenceNumber();
+    *Count = Header.MessageCount();
+    return true;
+}
+
+//
+// Whether every one of Count messages fits in Payload.
+//
+static bool MessagesFit(_In_reads_bytes_(Length) const UCHAR* Payload, UINT32 Length, UINT32 Count)
+{
+    UINT32 Offset = Itch::MoldUdp64::Size;
+    for (UINT32 i = 0; i < Count; i++) {
+        if (Length - Offset < Itch::Schema::LengthPrefixBytes) {
+            return false;
+        }
+        UINT32 MessageLength = (UINT32)WireLoad<Itch::Schema::LengthPrefixBytes, Itch::ByteOrder>(Payload + Offset);
+        Offset += Itch::Schema::LengthPrefixBytes;
+        if (Length - Offset < MessageLength) {
+            return false;
+        }
+        Offset += MessageLength;
+    }
+    return true;
+}
+
+GapRecovery::GapRecovery(
+    const GapRecoveryConfig& Config,
+    const TscClock& Clock,
+    _In_ RetransmitChannel* Channel,
+    _In_ const RetransmitRequestFormat* Format,
+    _In_ GapRecoverySink* Sink)
+    : Config(Config)
+    , Channel(Channel)
+    , Format(Format)
+    , Sink(Sink)
+{
+    if (this->Config.RequestTimeoutUs == 0) {
+        this->Config.RequestTimeoutUs = GapRecoveryConfig().RequestTimeoutUs;
+    }
+    RequestTimeoutTicks = Clock.NsToTicks(1000ull * this->Config.RequestTimeoutUs);
+
+    Slots = std::make_unique<UCHAR[]>((size_t)Config.ReorderDatagrams * Config.MaxDatagramSize);
+    for (UINT32 Slot = Config.ReorderDatagrams; Slot-- > 0;) {
+        FreeSlots.push_back(Slot);
+    }
+    Reorder.reserve(Config.ReorderDatagrams);
+    Packet = std::make_unique<UCHAR[]>(Config.MaxDatagramSize);
+}
+
+void GapRecovery::OnDatagram(_In_reads_bytes_(Length) const UCHAR* Payload, UINT32 Length, UINT64 NowTick)
+{
+    Stats.Datagrams++;
+    Accept(Payload, Length, false, NowTick);
+}
+
+void GapRecovery::Accept(
+    _In_reads_bytes_(Length) const UCHAR* Payload,
+    UINT32 Length,
+    bool Retransmission,
+    UINT64 NowTick)
+{
+    if (Length < Itch::MoldUdp64::Size) {
+        Stats.Malformed++;
+        return;
+    }
+
+    Itch::MoldUdp64 Header(Payload);
+    if (!HaveSession) {
+        memcpy(Session.Name, Header.Session(), sizeof(Session.Name));
+        HaveSession = true;
+    }
+    UINT16 Count = Header.MessageCount();
+    if (memcmp(Session.Name, Header.Session(), sizeof(Session.Name)) != 0 ||
+        (Count != EndOfSession && !MessagesFit(Payload, Length, Count))) {
+        Stats.Malformed++;
+        return;
+    }
+    if (Count == EndOfSession) {
+        return;
+    }
+
+    //
+    // A heartbeat has no messages and the sequence number of the next one,
+    // so it reveals a loss at the tail like any other packet.
+    //
+    UINT64 First = Header.SequenceNumber();
+    UINT64 End = First + Count;
+    if (End <= Expected) {
+        Stats.Duplicates += Count != 0 ? 1 : 0;
+        return;
+    }
+
+    UINT64 Before = Expected;
+    if (First > Expected && First - Expected > Config.SnapshotGap) {
+        Stats.Gaps++;
+        Snapshot(NowTick);
+    }
+
+    if (First <= Expected) {
+        Deliver(Payload, First, End, Retransmission);
+        Drain();
+    } else {
+        UINT64 From = std::max(Highest, Expected);
+        if (First > From) {
+            if (!GapOpen()) {
+                ProgressTick = NowTick;
+                Retries = 0;
+            }
+            Stats.Gaps++;
+            Request(std::max(From, Requested), First, NowTick);
+        }
+
+        if (Count != 0 && !Hold(Payload, Length, First, End, Retransmission)) {
+            //
+            // Nothing can wait behind the gap any more. Whatever of this
+            // datagram the snapshot does not cover is asked for again.
+            //
+            Stats.Overflows++;
+            Snapshot(NowTick);
+            if (First <= Expected) {
+                Deliver(Payload, First, End, Retransmission);
+                Drain();
+            } else {
+                Request(First, End, NowTick);
+            }
+        }
+    }
+
+    Highest = std::max(Highest, End);
+    if (Expected != Before) {
+        ProgressTick = NowTick;
+        Retries = 0;
+    }
+}
+
+void GapRecovery::Deliver(_In_ const UCHAR* Payload, UINT64 First, UINT64 End, bool Retransmission)
+{
+    UINT32 Offset = Itch::MoldUdp64::Size;
+    for (UINT64 Sequence = First; Sequence < End; Sequence++) {
+        UINT32 MessageLength = (UINT32)WireLoad<Itch::Schema::LengthPrefixBytes, Itch::ByteOrder>(Payload + Offset);
+        Offset += Itch::Schema::LengthPrefixBytes;
+        if (Sequence >= Expected) {
+            Sink->OnMessage(Sequence, Payload + Offset, MessageLength);
+            Expected = Sequence + 1;
+            Stats.Messages++;
+            Stats.Recovered += Retransmission ? 1 : 0;
+        }
+        Offset += MessageLength;
+    }
+}
+
+void GapRecovery::Drain()
+{
+    size_t Done = 0;
+    for (; Done < Reorder.size() && Reorder[Done].First <= Expected; Done++) {
+        const Held& Entry = Reorder[Done];
+        if (Entry.End > Expected) {
+            Deliver(&Slots[(size_t)Entry.Slot * Config.MaxDatagramSize], Entry.First, Entry.End, Entry.Retransmission);
+        } else {
+            Stats.Duplicates++;
+        }
+        FreeSlots.push_back(Entry.Slot);
+    }
+    Reorder.erase(Reorder.begin(), Reorder.begin() + Done);
+}
+
+bool GapRecovery::Hold(
+    _In_reads_bytes_(Length) const UCHAR* Payload,
+    UINT32 Length,
+    UINT64 First,
+    UINT64 End,
+    bool Retransmission)
+{
+    if (FreeSlots.empty() || Length > Config.MaxDatagramSize) {
+        return false;
+    }
+
+    UINT32 Slot = FreeSlots.back();
+    FreeSlots.pop_back();
+    memcpy(&Slots[(size_t)Slot * Config.MaxDatagramSize], Payload, Length);
+
+    //
+    // Live datagrams arrive in order and append; only retransmissions that
+    // overtake each other land in the middle.
+    //
+    auto At = std::upper_bound(Reorder.begin(), Reorder.end(), First, [](UINT64 Sequence, const Held& Entry) {
+        return Sequence < Entry.First;
+    });
+    Reorder.insert(At, {First, End, Slot, Length, Retransmission});
+    Stats.Buffered++;
+    return true;
+}
+
+void GapRecovery::Request(UINT64 First, UINT64 End, UINT64 NowTick)
+{
+    UCHAR Buffer[RetransmitRequestFormat::MaxRequestSize];
+    for (UINT64 Sequence = First; Sequence < End;) {
+        UINT16 Count = (UINT16)std::min<UINT64>(End - Sequence, Config.MessagesPerRequest);
+        UINT32 Length = Format->WriteRequest(Session, Sequence, Count, Buffer);
+        if (SUCCEEDED(Channel->Send(Buffer, Length))) {
+            Stats.Requests++;
+        }
+        Sequence += Count;
+    }
+    Requested = std::max(Requested, End);
+    RequestTick = NowTick;
+}
+
+//
+// Asks again for everything between Expected and Highest that is not held.
+//
+void GapRecovery::RequestHoles(UINT64 NowTick)
+{
+    UINT64 From = Expected;
+    for (const Held& Entry : Reorder) {
+        if (Entry.First > From) {
+            Request(From, Entry.First, NowTick);
+        }
+        From = std::max(From, Entry.End);
+    }
+    if (Highest > From) {
+        Request(From, Highest, NowTick);
+    }
+}
+
+void GapRecovery::Snapshot(UINT64 NowTick)
+{
+    Stats.Snapshots++;
+    UINT64 Next = Sink->OnSnapshot(Expected);
+    Expected = std::max(Expected, Next);
+    Highest = std::max(Highest, Expected);
+    Requested = std::max(Requested, Expected);
+    Drain();
+
+    ProgressTick = NowTick;
+    Retries = 0;
+}
+
+void GapRecovery::Poll(UINT64 NowTick)
+{
+    for (UINT32 i = 0; i < AnswersPerPoll; i++) {
+        UINT32 Length = Channel->Receive(Packet.get(), Config.MaxDatagramSize);
+        if (Length == 0) {
+            break;
+        }
+        Stats.Retransmissions++;
+        Accept(Packet.get(), Length, true, NowTick);
+    }
+
+    if (!GapOpen() || NowTick - ProgressTick < RequestTimeoutTicks || NowTick - RequestTick < RequestTimeoutTicks) {
+        return;
+    }
+
+    if (Retries == Config.MaxRetries) {
+        Snapshot(NowTick);
+        if (GapOpen()) {
+            RequestHoles(NowTick);
+        }
+        return;
+    }
+    Retries++;
+    Stats.Retries++;
+    RequestHoles(NowTick);
+}
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <windows.h>
+
+#include <memory>
+#include <vector>
+
+#include "ItchMessages.h"
+#include "TscClock.h"
+
+//
+// A MoldUDP64 session name, space padded.
+//
+struct MoldSession {
+    char Name[Itch::MoldUdp64::SessionLength];
+};
+
+//
+// How a retransmission request is put on the wire. The answer to a request
+// is always ordinary MoldUDP64 packets carrying the messages asked for.
+//
+class RetransmitRequestFormat {
+  public:
+    static constexpr UINT32 MaxRequestSize = 64;
+
+    virtual ~RetransmitRequestFormat() = default;
+
+    virtual const char* Name() const = 0;
+
+    //
+    // Writes a request for Count messages from Sequence and returns its
+    // length.
+    //
+    virtual UINT32 WriteRequest(
+        const MoldSession& Session,
+        UINT64 Sequence,
+        UINT16 Count,
+        _Out_writes_bytes_(MaxRequestSize) UCHAR* Request) const = 0;
+
+    //
+    // The server side of WriteRequest(); false if Request is not one.
+    //
+    virtual bool ParseRequest(
+        _In_reads_bytes_(Length) const UCHAR* Request,
+        UINT32 Length,
+        _Out_ MoldSession* Session,
+        _Out_ UINT64* Sequence,
+        _Out_ UINT16* Count) const = 0;
+};
+
+//
+// The MoldUDP64 request packet: the 20-byte downstream header, with the
+// number of messages wanted in place of the message count.
+//
+class MoldUdp64RequestFormat : public RetransmitRequestFormat {
+  public:
+    const char* Name() const override { return "MoldUDP64"; }
+
+    UINT32 WriteRequest(
+        const MoldSession& Session,
+        UINT64 Sequence,
+        UINT16 Count,
+        _Out_writes_bytes_(MaxRequestSize) UCHAR* Request) const override;
+
+    bool ParseRequest(
+        _In_reads_bytes_(Length) const UCHAR* Request,
+        UINT32 Length,
+        _Out_ MoldSession* Session,
+        _Out_ UINT64* Sequence,
+        _Out_ UINT16* Count) const override;
+};
+
+//
+// Carries requests to a retransmission server and its answers back. Neither
+// call blocks.
+//
+class RetransmitChannel {
+  public:
+    virtual ~RetransmitChannel() = default;
+
+    virtual const char* Name() const = 0;
+
+    virtual HRESULT Send(_In_reads_bytes_(Length) const UCHAR* Request, UINT32 Length) = 0;
+
+    //
+    // Copies the next MoldUDP64 packet the server sent to Packet and returns
+    // its length, or zero if none is waiting.
+    //
+    virtual UINT32 Receive(_Out_writes_bytes_(Size) UCHAR* Packet, UINT32 Size) = 0;
+};
+
+//
+// Channels to a server at Address:Port (host byte order). Over UDP a request
+// and each packet of the answer are one datagram; over TCP each is preceded
+// by its length as two bytes in network byte order.
+//
+HRESULT CreateUdpRetransmitChannel(UINT32 Address, UINT16 Port, _Out_ std::unique_ptr<RetransmitChannel>* Channel);
+HRESULT CreateTcpRetransmitChannel(UINT32 Address, UINT16 Port, _Out_ std::unique_ptr<RetransmitChannel>* Channel);
+
+//
+// Where recovered messages go, in sequence order, and where the state comes
+// from when a gap cannot be recovered message by message.
+//
+class GapRecoverySink {
+  public:
+    virtual ~GapRecoverySink() = default;
+
+    virtual void OnMessage(UINT64 Sequence, _In_reads_bytes_(Length) const UCHAR* Message, UINT32 Length) = 0;
+
+    //
+    // Rebuilds the state from a snapshot, dropping everything derived from
+    // messages, and returns the sequence number of the first message the
+    // snapshot does not cover. Messages from there on follow.
+    //
+    virtual UINT64 OnSnapshot(UINT64 FirstMissing) = 0;
+};
+
+struct GapRecoveryConfig {
+    //
+    // Live datagrams held behind a gap; a gap that needs more falls back to
+    // a snapshot.
+    //
+    UINT32 ReorderDatagrams = 1024;
+    UINT32 MaxDatagramSize = 1472;
+
+    //
+    // Gaps of more messages than this are not requested but go straight to
+    // a snapshot.
+    //
+    UINT64 SnapshotGap = 65536;
+
+    //
+    // Missing ranges are requested in pieces of at most this many messages.
+    //
+    UINT16 MessagesPerRequest = 512;
+
+    //
+    // A gap that made no progress for this long is requested again, up to
+    // MaxRetries times before falling back to a snapshot. Zero takes the
+    // default rather than re-requesting on every Poll().
+    //
+    UINT32 RequestTimeoutUs = 2000;
+    UINT32 MaxRetries = 3;
+};
+
+struct GapRecoveryStats {
+    UINT64 Datagrams;
+    UINT64 Retransmissions;
+    UINT64 Messages;
+
+    //
+    // Messages delivered from retransmissions.
+    //
+    UINT64 Recovered;
+
+    UINT64 Duplicates;
+    UINT64 Gaps;
+    UINT64 Requests;
+    UINT64 Retries;
+
+    //
+    // Datagrams held behind a gap, and those that found the reorder buffer
+    // full.
+    //
+    UINT64 Buffered;
+    UINT64 Overflows;
+
+    UINT64 Snapshots;
+
+    //
+    // Datagrams too short, from another session, or with a message running
+    // past the end.
+    //
+    UINT64 Malformed;
+};
+
+//
+// Turns a MoldUDP64 feed with losses into a gapless message sequence.
+//
+// Datagrams in sequence go straight through to the sink. A datagram past
+// the next expected message opens a gap: the missing range is requested at
+// once over the channel, and the datagram waits in a bounded reorder buffer
+// of fixed-size slots, kept sorted by sequence, with any that follow it.
+// Retransmitted packets take the same path as live ones, so whichever copy
+// of a message arrives first is delivered and the rest count as
+// duplicates; every arrival that moves the expected sequence drains the
+// buffer as far as it now reaches.
+//
+// A gap larger than SnapshotGap, a reorder buffer that fills up, or a gap
+// that stays stuck through MaxRetries requests falls back to the sink's
+// snapshot, after which buffered datagrams past the snapshot still count.
+//
+// The server is expected to answer a request with every message asked for,
+// in as many packets as that takes; a short answer is completed by the
+// timeout.
+//
+// Single-threaded: the RX thread makes every call.
+//
+class GapRecovery {
+  public:
+    GapRecovery(
+        const GapRecoveryConfig& Config,
+        const TscClock& Clock,
+        _In_ RetransmitChannel* Channel,
+        _In_ const RetransmitRequestFormat* Format,
+        _In_ GapRecoverySink* Sink);
+
+    GapRecovery(const GapRecovery&) = delete;
+    GapRecovery& operator=(const GapRecovery&) = delete;
+
+    //
+    // A MoldUDP64 payload from the live feed.
+    //
+    void OnDatagram(_In_reads_bytes_(Length) const UCHAR* Payload, UINT32 Length, UINT64 NowTick);
+
+    //
+    // Takes the channel's answers and re-requests gaps that timed out. Call
+    // it after every burst and while idle if a gap is open.
+    //
+    void Poll(UINT64 NowTick);
+
+    //
+    // The sequence number of the next message the sink gets, and whether
+    // anything after it has been seen.
+    //
+    UINT64 NextSequence() const { return Expected; }
+    bool GapOpen() const { return Expected < Highest; }
+
+    const GapRecoveryStats& Statistics() const { return Stats; }
+
+  private:
+    struct Held {
+        UINT64 First;
+        UINT64 End;
+        UINT32 Slot;
+        UINT32 Length;
+        bool Retransmission;
+    };
+
+    //
+    // Answers taken from the channel per Poll(), so a flood of them cannot
+    // hold up the live feed.
+    //
+    static constexpr UINT32 AnswersPerPoll = 64;
+
+    void Accept(_In_reads_bytes_(Length) const UCHAR* Payload, UINT32 Length, bool Retransmission, UINT64 NowTick);
+
+    //
+    // Delivers the messages First to End of a checked Payload from Expected
+    // on.
+    //
+    void Deliver(_In_ const UCHAR* Payload, UINT64 First, UINT64 End, bool Retransmission);
+    void Drain();
+    bool Hold(
+        _In_reads_bytes_(Length) const UCHAR* Payload,
+        UINT32 Length,
+        UINT64 First,
+        UINT64 End,
+        bool Retransmission);
+    void Request(UINT64 First, UINT64 End, UINT64 NowTick);
+    void RequestHoles(UINT64 NowTick);
+    void Snapshot(UINT64 NowTick);
+
+    GapRecoveryConfig Config;
+    UINT64 RequestTimeoutTicks;
+    RetransmitChannel* Channel;
+    const RetransmitRequestFormat* Format;
+    GapRecoverySink* Sink;
+
+    MoldSession Session {};
+    bool HaveSession = false;
+
+    //
+    // Next message for the sink; highest sequence seen, exclusive; and how
+    // far requests have been sent.
+    //
+    UINT64 Expected = 1;
+    UINT64 Highest = 1;
+    UINT64 Requested = 1;
+
+    //
+    // When the open gap last moved or was last requested, and how many
+    // requests it has had without moving.
+    //
+    UINT64 ProgressTick = 0;
+    UINT64 RequestTick = 0;
+    UINT32 Retries = 0;
+
+    std::unique_ptr<UCHAR[]> Slots;
+    std::vector<UINT32> FreeSlots;
+    std::vector<Held> Reorder;
+    std::unique_ptr<UCHAR[]> Packet;
+    GapRecoveryStats Stats {};
+};
@@ -0,0 +1,231 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "GapRecovery.h"
+#include "ItchFeed.h"
+#include "LatencyHistogram.h"
+#include "RetransmitServer.h"
+#include "TscClock.h"
+
+static constexpr UINT32 BenchBurst = 32;
+static constexpr UINT32 MessagesPerDatagram = 8;
+static constexpr UINT32 Loopback = 0x7f000001;
+
+//
+// Checks that messages arrive gapless and in order, and charges each the
+// time from the feed sending it to its delivery.
+//
+class BenchSink : public GapRecoverySink {
+  public:
+    BenchSink(const TscClock& Clock, const RetransmitServer& Server, UINT64 Messages)
+        : Clock(Clock)
+        , Server(Server)
+        , SentTicks(Messages + 1)
+        , Lost(Messages + 1)
+    {
+    }
+
+    void OnMessage(UINT64 Sequence, _In_reads_bytes_(Length) const UCHAR*, UINT32) override
+    {
+        if (Sequence != Next || Sequence >= SentTicks.size()) {
+            OutOfOrder++;
+        } else {
+            UINT64 Ns = Clock.TicksToNs(Clock.Now() - SentTicks[Sequence]);
+            (Lost[Sequence] ? RecoveredNs : LiveNs).Record(Ns);
+        }
+        Next = Sequence + 1;
+        Delivered++;
+    }
+
+    //
+    // The stand-in snapshot is the server's view of the feed: everything it
+    // has sent so far.
+    //
+    UINT64 OnSnapshot(UINT64 FirstMissing) override
+    {
+        UINT64 Covered = Server.NextSequence();
+        if (Covered > FirstMissing) {
+            Skipped += Covered - FirstMissing;
+            Next = Covered;
+        }
+        return Covered;
+    }
+
+    const TscClock& Clock;
+    const RetransmitServer& Server;
+    std::vector<UINT64> SentTicks;
+    std::vector<bool> Lost;
+    UINT64 Next = 1;
+    UINT64 Delivered = 0;
+    UINT64 Skipped = 0;
+    UINT64 OutOfOrder = 0;
+    LatencyHistogram<> LiveNs;
+    LatencyHistogram<> RecoveredNs;
+};
+
+//
+// Loss and recovery on one box: this thread plays the feed handler, taking
+// datagrams from a synthesized ITCH feed and dropping some of them, in
+// bursts, before GapRecovery sees them. The stand-in server, which saw
+// every datagram, answers the requests over loopback from a thread of its
+// own.
+//
+int GapRecoveryBenchmark(int argc, char** argv)
+{
+    const char* Transport = argc >= 1 ? argv[0] : "udp";
+    UINT32 Datagrams = argc >= 2 ? atoi(argv[1]) : 200000;
+    UINT32 LossPerMillion = argc >= 3 ? atoi(argv[2]) : 1000;
+    UINT32 LossBurst = argc >= 4 ? atoi(argv[3]) : 4;
+    UINT32 Rate = argc >= 5 ? atoi(argv[4]) : 1000000;
+
+    bool Tcp = strcmp(Transport, "tcp") == 0;
+    if ((!Tcp && strcmp(Transport, "udp") != 0) || Datagrams == 0 || LossPerMillion >= 1000000 || LossBurst == 0 ||
+        Rate == 0) {
+        fprintf(stderr, "recovery [udp|tcp] [datagrams] [loss-per-million] [loss-burst] [messages-per-second]\n");
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    MoldUdp64RequestFormat Format;
+    RetransmitServerConfig ServerConfig;
+    RetransmitServer Server(ServerConfig, &Format);
+    if (HRESULT Result = Server.Start(); FAILED(Result)) {
+        fprintf(stderr, "retransmission server failed to start: %x\n", (UINT32)Result);
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<RetransmitChannel> Channel;
+    HRESULT Result = Tcp ? CreateTcpRetransmitChannel(Loopback, ServerConfig.Port, &Channel)
+                         : CreateUdpRetransmitChannel(Loopback, ServerConfig.Port, &Channel);
+    if (FAILED(Result)) {
+        fprintf(stderr, "cannot reach the retransmission server over %s: %x\n", Transport, (UINT32)Result);
+        return EXIT_FAILURE;
+    }
+
+    UINT64 Messages = (UINT64)Datagrams * MessagesPerDatagram;
+    auto Sink = std::make_unique<BenchSink>(Clock, Server, Messages);
+    GapRecoveryConfig Config;
+    GapRecovery Recovery(Config, Clock, Channel.get(), &Format, Sink.get());
+
+    printf(
+        "%u datagrams of %u messages at %u messages/s, %u per million lost in bursts of %u, recovered over %s\n\n",
+        Datagrams,
+        MessagesPerDatagram,
+        Rate,
+        LossPerMillion,
+        LossBurst,
+        Transport);
+
+    ItchFeedConfig FeedConfig;
+    FeedConfig.Seed = 50;
+    ItchFeed Feed(FeedConfig);
+    std::vector<UCHAR> Frame(ItchFeed::FrameRoom(MessagesPerDatagram));
+    std::mt19937_64 Random(50);
+    UINT32 Dropping = 0;
+    UINT64 DroppedDatagrams = 0;
+
+    //
+    // Bursts start only between bursts, so a loss rate L in bursts of B
+    // means starting one with probability L / (B * (1 - L)) per datagram
+    // that is not already being dropped.
+    //
+    double Loss = LossPerMillion / 1e6;
+    double BurstStart = Loss / (LossBurst * (1.0 - Loss));
+    std::uniform_real_distribution<double> Uniform(0.0, 1.0);
+
+    UINT64 TicksPerBurst = Clock.NsToTicks(1000000000ull * BenchBurst * MessagesPerDatagram / Rate);
+    UINT64 Start = Clock.Now();
+    UINT64 Next = Start;
+    for (UINT32 i = 0; i < Datagrams; i++) {
+        if (i % BenchBurst == 0) {
+            Recovery.Poll(Clock.Now());
+            while (Clock.Now() < Next) {
+                std::this_thread::yield();
+                Recovery.Poll(Clock.Now());
+            }
+            Next += TicksPerBurst;
+        }
+
+        UINT64 First = Feed.NextSequence();
+        UINT32 Length = Feed.NextDatagram(Frame.data(), MessagesPerDatagram) - ItchFeed::HeadersLength;
+        const UCHAR* Payload = Frame.data() + ItchFeed::HeadersLength;
+        Server.Record(Payload, Length);
+
+        UINT64 Now = Clock.Now();
+        if (Dropping == 0 && Uniform(Random) < BurstStart) {
+            Dropping = LossBurst;
+        }
+        for (UINT64 Sequence = First; Sequence < First + MessagesPerDatagram; Sequence++) {
+            Sink->SentTicks[Sequence] = Now;
+            Sink->Lost[Sequence] = Dropping != 0;
+        }
+        if (Dropping != 0) {
+            Dropping--;
+            DroppedDatagrams++;
+            continue;
+        }
+        Recovery.OnDatagram(Payload, Length, Now);
+    }
+
+    //
+    // A loss at the very end shows no gap until something follows it; the
+    // real feed would send a heartbeat.
+    //
+    UCHAR Heartbeat[Itch::MoldUdp64::Size];
+    memcpy(Heartbeat, Frame.data() + ItchFeed::HeadersLength, sizeof(Heartbeat));
+    WireStoreBig(Heartbeat + Itch::MoldUdp64::SequenceNumberOffset, Feed.NextSequence(), 8);
+    WireStoreBig(Heartbeat + Itch::MoldUdp64::MessageCountOffset, 0, 2);
+    Recovery.OnDatagram(Heartbeat, sizeof(Heartbeat), Clock.Now());
+    UINT64 Deadline = Clock.Now() + Clock.NsToTicks(2000000000ull);
+    while (Recovery.GapOpen() && Clock.Now() < Deadline) {
+        std::this_thread::yield();
+        Recovery.Poll(Clock.Now());
+    }
+    double Seconds = Clock.TicksToNs(Clock.Now() - Start) / 1e9;
+    Server.Stop();
+
+    const GapRecoveryStats& Stats = Recovery.Statistics();
+    RetransmitServerStats ServerStats = Server.Statistics();
+    printf(
+        "%llu datagrams dropped (%.2f%%), %llu gaps, %llu requests (%llu retries), %llu answer packets, "
+        "%llu snapshots\n",
+        (unsigned long long)DroppedDatagrams,
+        100.0 * DroppedDatagrams / Datagrams,
+        (unsigned long long)Stats.Gaps,
+        (unsigned long long)Stats.Requests,
+        (unsigned long long)Stats.Retries,
+        (unsigned long long)ServerStats.Packets,
+        (unsigned long long)Stats.Snapshots);
+    printf(
+        "%llu messages delivered (%llu recovered), %llu skipped by snapshots, %llu duplicates, %llu held behind gaps, "
+        "%llu reorder overflows\n",
+        (unsigned long long)Sink->Delivered,
+        (unsigned long long)Stats.Recovered,
+        (unsigned long long)Sink->Skipped,
+        (unsigned long long)Stats.Duplicates,
+        (unsigned long long)Stats.Buffered,
+        (unsigned long long)Stats.Overflows);
+    printf("%.2f M messages/s over %.2f s\n\n", Sink->Delivered / Seconds / 1e6, Seconds);
+    PrintLatencySummary(stdout, "live", Sink->LiveNs);
+    PrintLatencySummary(stdout, "recovered", Sink->RecoveredNs);
+
+    if (Sink->OutOfOrder != 0 || Sink->Delivered + Sink->Skipped != Messages) {
+        fprintf(
+            stderr,
+            "sequence broken: %llu out of order, %llu of %llu messages accounted for\n",
+            (unsigned long long)Sink->OutOfOrder,
+            (unsigned long long)(Sink->Delivered + Sink->Skipped),
+            (unsigned long long)Messages);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,378 @@
+#include "Ipv4Reassembler.h"
+
+#include <string.h>
+
+//
+// Largest IP payload an IPv4 datagram can carry.
+//
+static constexpr UINT32 MaxIpv4Payload = 65535 - sizeof(Ipv4Header);
+
+static UINT32 KeyHash(UINT32 SourceAddress, UINT32 DestinationAddress, UINT16 Identification, UINT8 Protocol)
+{
+    UINT64 Key = ((UINT64)SourceAddress << 32) | DestinationAddress;
+    Key ^= ((UINT64)Identification << 8 | Protocol) * 0xff51afd7ed558ccdull;
+    Key *= 0x9e3779b97f4a7c15ull;
+    return (UINT32)(Key >> 32);
+}
+
+Ipv4Reassembler::Ipv4Reassembler(const Ipv4ReassemblerConfig& Config, _In_ UmemFramePool* Pool)
+    : Config(Config)
+    , Pool(Pool)
+{
+    if (this->Config.MaxDatagrams == 0) {
+        this->Config.MaxDatagrams = 1;
+    }
+    if (this->Config.MaxFragments < 2) {
+        this->Config.MaxFragments = 2;
+    }
+    if (this->Config.MaxDatagramLength > MaxIpv4Payload) {
+        this->Config.MaxDatagramLength = MaxIpv4Payload;
+    }
+    if (this->Config.WheelBuckets < 2) {
+        this->Config.WheelBuckets = 2;
+    }
+
+    //
+    // A timeout spans at most WheelBuckets - 1 granules, so Expire() reaches
+    // every entry in the lap it is due.
+    //
+    UINT64 Spans = this->Config.WheelBuckets - 1;
+    Granularity = (this->Config.TimeoutTicks + Spans - 1) / Spans;
+    if (Granularity == 0) {
+        Granularity = 1;
+    }
+
+    UINT32 Buckets = 1;
+    while (Buckets < 2 * this->Config.MaxDatagrams) {
+        Buckets <<= 1;
+    }
+    BucketMask = Buckets - 1;
+
+    UINT32 Datagrams = this->Config.MaxDatagrams;
+    UINT32 Fragments = this->Config.MaxFragments;
+    Slots = std::make_unique<Slot[]>(Datagrams);
+    FragmentStorage = std::make_unique<ReassemblyFragment[]>((size_t)Datagrams * Fragments);
+    OffsetStorage = std::make_unique<UINT32[]>((size_t)Datagrams * Fragments);
+    HashBuckets = std::make_unique<UINT32[]>(Buckets);
+    Wheel = std::make_unique<UINT32[]>(this->Config.WheelBuckets);
+    Completed = std::make_unique<ReassemblyFragment[]>(Fragments);
+
+    for (UINT32 i = 0; i < Buckets; i++) {
+        HashBuckets[i] = None;
+    }
+    for (UINT32 i = 0; i < this->Config.WheelBuckets; i++) {
+        Wheel[i] = None;
+    }
+    for (UINT32 i = Datagrams; i-- > 0;) {
+        Slots[i] = {};
+        Slots[i].Fragments = &FragmentStorage[(size_t)i * Fragments];
+        Slots[i].Offsets = &OffsetStorage[(size_t)i * Fragments];
+        Slots[i].HashNext = FreeList;
+        FreeList = i;
+    }
+}
+
+UINT64 Ipv4Reassembler::MemoryFootprint() const
+{
+    UINT64 Datagrams = Config.MaxDatagrams;
+    UINT64 Fragments = Config.MaxFragments;
+    return Datagrams * sizeof(Slot) + Datagrams * Fragments * (sizeof(ReassemblyFragment) + sizeof(UINT32)) +
+           (BucketMask + 1ull) * sizeof(UINT32) + Config.WheelBuckets * sizeof(UINT32) +
+           Fragments * sizeof(ReassemblyFragment);
+}
+
+void Ipv4Reassembler::DropFrame(UINT64 Address)
+{
+    Pool->Free(Address);
+}
+
+UINT32 Ipv4Reassembler::Lookup(const Ipv4Header* Ip, _Out_ UINT32* Bucket) const
+{
+    *Bucket = KeyHash(Ip->SourceAddress, Ip->DestinationAddress, Ip->Identification, Ip->Protocol) & BucketMask;
+
+    for (UINT32 Index = HashBuckets[*Bucket]; Index != None; Index = Slots[Index].HashNext) {
+        const Slot& Entry = Slots[Index];
+        if (Entry.SourceAddress == Ip->SourceAddress && Entry.DestinationAddress == Ip->DestinationAddress &&
+            Entry.Identification == Ip->Identification && Entry.Protocol == Ip->Protocol) {
+            return Index;
+        }
+    }
+    return None;
+}
+
+UINT32 Ipv4Reassembler::OldestSlot() const
+{
+    for (UINT32 Step = 0; Step < Config.WheelBuckets; Step++) {
+        UINT32 Oldest = None;
+        for (UINT32 Index = Wheel[(NextGranule + Step) % Config.WheelBuckets]; Index != None;
+             Index = Slots[Index].WheelNext) {
+            if (Oldest == None || Slots[Index].Deadline < Slots[Oldest].Deadline) {
+                Oldest = Index;
+            }
+        }
+        if (Oldest != None) {
+            return Oldest;
+        }
+    }
+    return None;
+}
+
+UINT32 Ipv4Reassembler::Allocate(const Ipv4Header* Ip, UINT32 Bucket, UINT64 NowTicks)
+{
+    if (FreeList == None) {
+        Free(OldestSlot(), true);
+        Stats.Evictions++;
+    }
+
+    UINT32 Index = FreeList;
+    Slot& Entry = Slots[Index];
+    FreeList = Entry.HashNext;
+
+    Entry.SourceAddress = Ip->SourceAddress;
+    Entry.DestinationAddress = Ip->DestinationAddress;
+    Entry.Identification = Ip->Identification;
+    Entry.Protocol = Ip->Protocol;
+    Entry.InUse = true;
+    Entry.TotalLength = 0;
+    Entry.ReceivedLength = 0;
+    Entry.FragmentCount = 0;
+    Entry.Deadline = NowTicks + Config.TimeoutTicks;
+
+    Entry.HashNext = HashBuckets[Bucket];
+    HashBuckets[Bucket] = Index;
+    WheelInsert(Index);
+    Active++;
+    return Index;
+}
+
+void Ipv4Reassembler::Free(UINT32 Index, bool ReleaseFrames)
+{
+    Slot& Entry = Slots[Index];
+
+    for (UINT32 i = 0; i < Entry.FragmentCount && ReleaseFrames; i++) {
+        DropFrame(Entry.Fragments[i].Address);
+    }
+    Stats.HeldFrames -= Entry.FragmentCount;
+
+    UINT32 Bucket =
+        KeyHash(Entry.SourceAddress, Entry.DestinationAddress, Entry.Identification, Entry.Protocol) & BucketMask;
+    UINT32* Link = &HashBuckets[Bucket];
+    while (*Link != Index) {
+        Link = &Slots[*Link].HashNext;
+    }
+    *Link = Entry.HashNext;
+
+    WheelRemove(Index);
+    Entry.InUse = false;
+    Entry.FragmentCount = 0;
+    Entry.HashNext = FreeList;
+    FreeList = Index;
+    Active--;
+}
+
+void Ipv4Reassembler::WheelInsert(UINT32 Index)
+{
+    Slot& Entry = Slots[Index];
+
+    Entry.WheelBucket = (UINT32)((Entry.Deadline / Granularity) % Config.WheelBuckets);
+    Entry.WheelPrev = None;
+    Entry.WheelNext = Wheel[Entry.WheelBucket];
+    if (Entry.WheelNext != None) {
+        Slots[Entry.WheelNext].WheelPrev = Index;
+    }
+    Wheel[Entry.WheelBucket] = Index;
+}
+
+void Ipv4Reassembler::WheelRemove(UINT32 Index)
+{
+    Slot& Entry = Slots[Index];
+
+    if (Entry.WheelPrev != None) {
+        Slots[Entry.WheelPrev].WheelNext = Entry.WheelNext;
+    } else {
+        Wheel[Entry.WheelBucket] = Entry.WheelNext;
+    }
+    if (Entry.WheelNext != None) {
+        Slots[Entry.WheelNext].WheelPrev = Entry.WheelPrev;
+    }
+}
+
+UINT32 Ipv4Reassembler::Expire(UINT64 NowTicks)
+{
+    UINT64 NowGranule = NowTicks / Granularity;
+    if (NowGranule < NextGranule) {
+        return 0;
+    }
+
+    UINT64 Steps = NowGranule - NextGranule + 1;
+    if (Steps > Config.WheelBuckets) {
+        Steps = Config.WheelBuckets;
+    }
+
+    //
+    // The current granule is visited again next time, since entries due
+    // later in it are still live.
+    //
+    UINT32 Expired = 0;
+    for (UINT64 Granule = NextGranule; Granule < NextGranule + Steps; Granule++) {
+        UINT32 Index = Wheel[Granule % Config.WheelBuckets];
+        while (Index != None) {
+            UINT32 Next = Slots[Index].WheelNext;
+            if (Slots[Index].Deadline <= NowTicks) {
+                Free(Index, true);
+                Stats.Timeouts++;
+                Expired++;
+            }
+            Index = Next;
+        }
+    }
+    NextGranule = NowGranule;
+    return Expired;
+}
+
+ReassemblyResult Ipv4Reassembler::Submit(
+    _In_reads_bytes_(Length) const UCHAR* Frame,
+    UINT64 Address,
+    UINT32 FrameOffset,
+    UINT32 Length,
+    UINT64 NowTicks,
+    _Out_ ReassembledDatagram* Datagram)
+{
+    Ipv4Frame Parsed;
+    if (!ParseIpv4Frame(Frame, Length, &Parsed) || !Ipv4IsFragment(Parsed.Ip)) {
+        return ReassemblyResult::NotFragment;
+    }
+
+    const Ipv4Header* Ip = Parsed.Ip;
+    UINT16 Flags = NetToHost16(Ip->FlagsAndFragmentOffset);
+    UINT32 Offset = (Flags & Ipv4FragmentOffsetMask) * 8;
+    UINT32 DataLength = Parsed.L4Length;
+    UINT32 End = Offset + DataLength;
+    bool MoreFragments = (Flags & Ipv4MoreFragments) != 0;
+    UINT32 HeaderLength = (Ip->VersionAndHeaderLength & 0xf) * 4;
+
+    Stats.Fragments++;
+
+    //
+    // Truncated frames, empty or misaligned middle fragments, datagrams past
+    // 64 KiB (ping of death) and first fragments too short for the UDP
+    // header are rejected on their own.
+    //
+    if (NetToHost16(Ip->TotalLength) != HeaderLength + DataLength || DataLength == 0 ||
+        End > Config.MaxDatagramLength || (MoreFragments && DataLength % 8 != 0) ||
+        (Offset == 0 && Ip->Protocol == IpProtocolUdp && DataLength < sizeof(UdpHeader))) {
+        Stats.Malformed++;
+        DropFrame(Address);
+        return ReassemblyResult::Dropped;
+    }
+
+    UINT32 Bucket;
+    UINT32 Index = Lookup(Ip, &Bucket);
+    if (Index == None) {
+        Index = Allocate(Ip, Bucket, NowTicks);
+    }
+    Slot& Entry = Slots[Index];
+
+    UINT32 Position = 0;
+    while (Position < Entry.FragmentCount && Entry.Offsets[Position] < Offset) {
+        Position++;
+    }
+
+    if (Position < Entry.FragmentCount && Entry.Offsets[Position] == Offset &&
+        Entry.Fragments[Position].Length == DataLength && MoreFragments == (Entry.TotalLength != End)) {
+        Stats.Duplicates++;
+        DropFrame(Address);
+        return ReassemblyResult::Dropped;
+    }
+
+    //
+    // Anything that disagrees with data already held, or with the end the
+    // last fragment fixed, poisons the datagram.
+    //
+    bool Overlaps = (Position > 0 && Entry.Offsets[Position - 1] + Entry.Fragments[Position - 1].Length > Offset) ||
+                    (Position < Entry.FragmentCount && End > Entry.Offsets[Position]);
+    if (Entry.TotalLength != 0) {
+        Overlaps |= End > Entry.TotalLength || (!MoreFragments && End != Entry.TotalLength);
+    }
+    if (!MoreFragments && Entry.FragmentCount != 0) {
+        UINT32 Last = Entry.FragmentCount - 1;
+        Overlaps |= Entry.Offsets[Last] + Entry.Fragments[Last].Length > End;
+    }
+    if (Overlaps) {
+        Stats.Overlaps++;
+        Free(Index, true);
+        DropFrame(Address);
+        return ReassemblyResult::Dropped;
+    }
+
+    if (Entry.FragmentCount == Config.MaxFragments) {
+        Stats.TooManyFragments++;
+        Free(Index, true);
+        DropFrame(Address);
+        return ReassemblyResult::Dropped;
+    }
+
+    for (UINT32 i = Entry.FragmentCount; i > Position; i--) {
+        Entry.Offsets[i] = Entry.Offsets[i - 1];
+        Entry.Fragments[i] = Entry.Fragments[i - 1];
+    }
+    Entry.Offsets[Position] = Offset;
+    Entry.Fragments[Position] = {Address, FrameOffset + (UINT32)(Parsed.L4 - Frame), DataLength};
+    Entry.FragmentCount++;
+    Entry.ReceivedLength += DataLength;
+    if (!MoreFragments) {
+        Entry.TotalLength = End;
+    }
+
+    Stats.HeldFrames++;
+    if (Stats.HeldFrames > Stats.PeakHeldFrames) {
+        Stats.PeakHeldFrames = Stats.HeldFrames;
+    }
+
+    //
+    // Fragments never overlap, so the datagram is complete once their
+    // lengths add up to the total.
+    //
+    if (Entry.TotalLength == 0 || Entry.ReceivedLength != Entry.TotalLength) {
+        return ReassemblyResult::Held;
+    }
+
+    memcpy(Completed.get(), Entry.Fragments, Entry.FragmentCount * sizeof(ReassemblyFragment));
+    Datagram->SourceAddress = Entry.SourceAddress;
+    Datagram->DestinationAddress = Entry.DestinationAddress;
+    Datagram->Identification = Entry.Identification;
+    Datagram->Protocol = Entry.Protocol;
+    Datagram->Length = Entry.TotalLength;
+    Datagram->FragmentCount = Entry.FragmentCount;
+    Datagram->Fragments = Completed.get();
+
+    Free(Index, false);
+    Stats.Datagrams++;
+    return ReassemblyResult::Complete;
+}
+
+void Ipv4Reassembler::Release(const ReassembledDatagram& Datagram)
+{
+    for (UINT32 i = 0; i < Datagram.FragmentCount; i++) {
+        Pool->Free(Datagram.Fragments[i].Address);
+    }
+}
+
+UINT32 Ipv4Reassembler::Linearize(
+    _In_ const UCHAR* Umem,
+    const ReassembledDatagram& Datagram,
+    _Out_writes_bytes_(BufferLength) UCHAR* Buffer,
+    UINT32 BufferLength)
+{
+    if (Datagram.Length > BufferLength) {
+        return 0;
+    }
+
+    UINT32 Copied = 0;
+    for (UINT32 i = 0; i < Datagram.FragmentCount; i++) {
+        const ReassemblyFragment& Fragment = Datagram.Fragments[i];
+        memcpy(Buffer + Copied, Umem + Fragment.Address + Fragment.DataOffset, Fragment.Length);
+        Copied += Fragment.Length;
+    }
+    return Copied;
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <windows.h>
+
+#include <memory>
+
+#include "PacketHeaders.h"
+#include "UmemFramePool.h"
+
+//
+// One piece of a reassembled datagram: Length bytes of IP payload at
+// DataOffset bytes into the UMEM chunk at Address.
+//
+struct ReassemblyFragment {
+    UINT64 Address;
+    UINT32 DataOffset;
+    UINT32 Length;
+};
+
+//
+// A complete datagram as a scatter list in payload order. The first
+// fragment's frame also holds the Ethernet and IP headers, and its data
+// starts with the UDP header. Fragments points into the reassembler and is
+// valid until the next call into it.
+//
+struct ReassembledDatagram {
+    UINT32 SourceAddress;
+    UINT32 DestinationAddress;
+    UINT16 Identification;
+    UINT8 Protocol;
+    UINT32 Length;
+    UINT32 FragmentCount;
+    const ReassemblyFragment* Fragments;
+};
+
+enum class ReassemblyResult {
+    //
+    // Not a fragment; the caller keeps the frame and handles it as usual.
+    //
+    NotFragment,
+
+    //
+    // The reassembler owns the frame until its datagram completes or
+    // expires.
+    //
+    Held,
+
+    //
+    // The frame completed a datagram. The caller owns all of its frames and
+    // returns them with Release().
+    //
+    Complete,
+
+    //
+    // The frame was malformed, a duplicate, or overlapped its datagram; it
+    // went back to the frame pool, along with the rest of the datagram if it
+    // overlapped.
+    //
+    Dropped,
+};
+
+struct Ipv4ReassemblerConfig {
+    UINT32 MaxDatagrams = 256;
+    UINT32 MaxFragments = 16;
+    UINT32 MaxDatagramLength = 65535;
+    UINT64 TimeoutTicks = 0;
+    UINT32 WheelBuckets = 64;
+};
+
+struct Ipv4ReassemblerStats {
+    UINT64 Fragments;
+    UINT64 Datagrams;
+    UINT64 Duplicates;
+    UINT64 Overlaps;
+    UINT64 Malformed;
+    UINT64 TooManyFragments;
+    UINT64 Timeouts;
+    UINT64 Evictions;
+    UINT64 HeldFrames;
+    UINT64 PeakHeldFrames;
+};
+
+//
+// Bounded-memory IPv4 reassembly for the RX thread. Datagrams in progress
+// are keyed by (source, destination, identification, protocol) and live in
+// preallocated slots; nothing is allocated after construction and at most
+// MaxDatagrams * MaxFragments UMEM frames are ever held.
+//
+// Frames are never copied: a completed datagram is handed out as a scatter
+// list over the frames it arrived in. Linearize() copies it when a handler
+// needs contiguous bytes.
+//
+// Each datagram expires TimeoutTicks after its first fragment, through a
+// timing wheel advanced by Expire(). When every slot is taken, the datagram
+// closest to expiry is evicted to make room.
+//
+// Any fragment that overlaps data already held discards the whole datagram
+// (teardrop and overlap attacks, RFC 5722 policy); an exact duplicate is
+// dropped on its own. Fragments must be multiples of 8 bytes except the
+// last, may not extend past 64 KiB, and the first of a UDP datagram must
+// hold the whole UDP header.
+//
+class Ipv4Reassembler {
+  public:
+    Ipv4Reassembler(const Ipv4ReassemblerConfig& Config, _In_ UmemFramePool* Pool);
+
+    Ipv4Reassembler(const Ipv4Reassembler&) = delete;
+    Ipv4Reassembler& operator=(const Ipv4Reassembler&) = delete;
+
+    //
+    // Frame is the frame's bytes, FrameOffset bytes into the UMEM chunk at
+    // Address. The chunk goes back to the pool when the frame is dropped or
+    // its datagram is released or expires.
+    //
+    ReassemblyResult Submit(
+        _In_reads_bytes_(Length) const UCHAR* Frame,
+        UINT64 Address,
+        UINT32 FrameOffset,
+        UINT32 Length,
+        UINT64 NowTicks,
+        _Out_ ReassembledDatagram* Datagram);
+
+    //
+    // Frees datagrams whose timeout has passed. Returns how many expired.
+    //
+    UINT32 Expire(UINT64 NowTicks);
+
+    //
+    // Returns the frames of a completed datagram to the pool.
+    //
+    void Release(const ReassembledDatagram& Datagram);
+
+    //
+    // Copies the datagram's IP payload to Buffer. Returns the number of
+    // bytes copied, or 0 if the buffer is too small.
+    //
+    static UINT32 Linearize(
+        _In_ const UCHAR* Umem,
+        const ReassembledDatagram& Datagram,
+        _Out_writes_bytes_(BufferLength) UCHAR* Buffer,
+        UINT32 BufferLength);
+
+    UINT32 ActiveDatagrams() const { return Active; }
+    const Ipv4ReassemblerStats& Statistics() const { return Stats; }
+
+    //
+    // Bytes preallocated for slots, fragment lists, hash buckets and wheel.
+    //
+    UINT64 MemoryFootprint() const;
+
+  private:
+    static constexpr UINT32 None = MAXUINT32;
+
+    struct Slot {
+        UINT32 SourceAddress;
+        UINT32 DestinationAddress;
+        UINT16 Identification;
+        UINT8 Protocol;
+        bool InUse;
+
+        //
+        // Payload length, known once the last fragment has arrived.
+        //
+        UINT32 TotalLength;
+        UINT32 ReceivedLength;
+        UINT32 FragmentCount;
+        UINT64 Deadline;
+
+        UINT32 HashNext;
+        UINT32 WheelPrev;
+        UINT32 WheelNext;
+        UINT32 WheelBucket;
+
+        //
+        // MaxFragments entries, sorted by offset.
+        //
+        ReassemblyFragment* Fragments;
+        UINT32* Offsets;
+    };
+
+    UINT32 Lookup(const Ipv4Header* Ip, _Out_ UINT32* Bucket) const;
+    UINT32 Allocate(const Ipv4Header* Ip, UINT32 Bucket, UINT64 NowTicks);
+    void Free(UINT32 Index, bool ReleaseFrames);
+    void WheelInsert(UINT32 Index);
+    void WheelRemove(UINT32 Index);
+    UINT32 OldestSlot() const;
+    void DropFrame(UINT64 Address);
+
+    Ipv4ReassemblerConfig Config;
+    UmemFramePool* Pool;
+    UINT64 Granularity;
+    UINT64 NextGranule = 0;
+    UINT32 BucketMask;
+    UINT32 Active = 0;
+
+    std::unique_ptr<Slot[]> Slots;
+    std::unique_ptr<ReassemblyFragment[]> FragmentStorage;
+    std::unique_ptr<UINT32[]> OffsetStorage;
+    std::unique_ptr<UINT32[]> HashBuckets;
+    std::unique_ptr<UINT32[]> Wheel;
+    std::unique_ptr<ReassemblyFragment[]> Completed;
+    UINT32 FreeList = None;
+
+    Ipv4ReassemblerStats Stats {};
+};
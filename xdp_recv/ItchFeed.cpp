@@ -0,0 +1,187 @@
+#include "ItchFeed.h"
+
+#include <string.h>
+
+#include <bit>
+
+#include "PacketHeaders.h"
+
+static_assert(ItchFeed::HeadersLength == sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader));
+
+//
+// Prices have four decimals; orders rest on whole cents.
+//
+static constexpr UINT32 Tick = 100;
+
+//
+// StockLocate, TrackingNumber and Timestamp lead every message, at the
+// same offsets in all of them.
+//
+static void PutCommon(
+    _Out_writes_bytes_(Itch::OrderDelete::Size) UCHAR* Message,
+    UINT8 Type,
+    UINT16 Locate,
+    UINT64 Timestamp)
+{
+    Message[0] = Type;
+    WireStoreBig(Message + Itch::OrderDelete::StockLocateOffset, Locate, 2);
+    WireStoreBig(Message + Itch::OrderDelete::TrackingNumberOffset, 0, 2);
+    WireStoreBig(Message + Itch::OrderDelete::TimestampOffset, Timestamp, 6);
+}
+
+ItchFeed::ItchFeed(const ItchFeedConfig& Config) : Config(Config), Random(Config.Seed)
+{
+    if (this->Config.Instruments == 0) {
+        this->Config.Instruments = 1;
+    }
+    Mid.resize((size_t)this->Config.Instruments + 1);
+    for (UINT32& Price : Mid) {
+        Price = (UINT32)(20 + Random() % 480) * 10000;
+    }
+    Live.reserve((size_t)this->Config.Instruments * this->Config.OrdersPerInstrument * 2);
+}
+
+UINT32 ItchFeed::WriteAdd(_Out_writes_bytes_(MaxMessageSize) UCHAR* Message, UINT64 Timestamp)
+{
+    UINT64 Value = Random();
+    LiveOrder Order;
+    Order.Reference = NextReference++;
+    Order.Locate = (UINT16)(1 + Value % Config.Instruments);
+    Order.Buy = (Value >> 20) & 1;
+    Order.Shares = 100 * (1 + (UINT32)(Value >> 24) % 10);
+
+    //
+    // Most orders join within a few ticks of the mid, fewer further out;
+    // the mid moves by a tick now and then.
+    //
+    UINT32& Center = Mid[Order.Locate];
+    if ((Value >> 32) % 64 == 0) {
+        if ((Value >> 38) & 1) {
+            Center += Tick;
+        } else if (Center > 100 * Tick) {
+            Center -= Tick;
+        }
+    }
+    UINT32 Distance = 1 + (UINT32)std::countr_zero((Value >> 40) | (1ull << 20)) + (UINT32)(Value >> 44) % 4;
+    Order.Price = Order.Buy ? Center - Distance * Tick : Center + Distance * Tick;
+    Live.push_back(Order);
+
+    bool Mpid = (Value >> 48) % 50 == 0;
+    using A = Itch::AddOrder;
+    PutCommon(Message, Mpid ? Itch::AddOrderMpid::Type : A::Type, Order.Locate, Timestamp);
+    WireStoreBig(Message + A::OrderReferenceOffset, Order.Reference, 8);
+    Message[A::BuySellOffset] = Order.Buy ? 'B' : 'S';
+    WireStoreBig(Message + A::SharesOffset, Order.Shares, 4);
+    memcpy(Message + A::StockOffset, "SYNTH   ", A::StockLength);
+    WireStoreBig(Message + A::PriceOffset, Order.Price, 4);
+    if (Mpid) {
+        memcpy(Message + Itch::AddOrderMpid::AttributionOffset, "SYNT", Itch::AddOrderMpid::AttributionLength);
+        return Itch::AddOrderMpid::Size;
+    }
+    return A::Size;
+}
+
+UINT32 ItchFeed::NextMessage(_Out_writes_bytes_(MaxMessageSize) UCHAR* Message)
+{
+    Clock += 1 + Random() % 2000;
+    Sequence++;
+
+    //
+    // Adds until the book is half full and deletes past one and a half
+    // times the target, so the number of live orders stays near it.
+    //
+    UINT64 Target = (UINT64)Config.Instruments * Config.OrdersPerInstrument;
+    UINT32 Roll = (UINT32)(Random() % 100);
+    if (Live.size() < Target / 2 + 1 || (Roll < 44 && Live.size() < Target * 3 / 2)) {
+        return WriteAdd(Message, Clock);
+    }
+
+    UINT32 Index = (UINT32)(Random() % Live.size());
+    LiveOrder& Order = Live[Index];
+    UINT32 Length;
+    bool Gone = false;
+    if (Roll >= 99) {
+        using M = Itch::Trade;
+        PutCommon(Message, M::Type, Order.Locate, Clock);
+        WireStoreBig(Message + M::OrderReferenceOffset, 0, 8);
+        Message[M::BuySellOffset] = 'B';
+        WireStoreBig(Message + M::SharesOffset, 100, 4);
+        memcpy(Message + M::StockOffset, "SYNTH   ", M::StockLength);
+        WireStoreBig(Message + M::PriceOffset, Mid[Order.Locate], 4);
+        WireStoreBig(Message + M::MatchNumberOffset, NextMatch++, 8);
+        return M::Size;
+    } else if (Roll >= 91) {
+        using M = Itch::OrderReplace;
+        UINT64 Reference = NextReference++;
+        UINT32 Price = Order.Buy ? Order.Price + Tick : Order.Price - Tick;
+        PutCommon(Message, M::Type, Order.Locate, Clock);
+        WireStoreBig(Message + M::OriginalOrderReferenceOffset, Order.Reference, 8);
+        WireStoreBig(Message + M::NewOrderReferenceOffset, Reference, 8);
+        WireStoreBig(Message + M::SharesOffset, Order.Shares, 4);
+        WireStoreBig(Message + M::PriceOffset, Price, 4);
+        Order.Reference = Reference;
+        Order.Price = Price;
+        return M::Size;
+    } else if (Roll >= 86) {
+        using M = Itch::OrderExecuted;
+        UINT32 Shares = Order.Shares > 100 ? 100 : Order.Shares;
+        PutCommon(Message, M::Type, Order.Locate, Clock);
+        WireStoreBig(Message + M::OrderReferenceOffset, Order.Reference, 8);
+        WireStoreBig(Message + M::ExecutedSharesOffset, Shares, 4);
+        WireStoreBig(Message + M::MatchNumberOffset, NextMatch++, 8);
+        Order.Shares -= Shares;
+        Gone = Order.Shares == 0;
+        Length = M::Size;
+    } else if (Roll >= 83) {
+        using M = Itch::OrderExecutedWithPrice;
+        UINT32 Shares = Order.Shares > 100 ? 100 : Order.Shares;
+        PutCommon(Message, M::Type, Order.Locate, Clock);
+        WireStoreBig(Message + M::OrderReferenceOffset, Order.Reference, 8);
+        WireStoreBig(Message + M::ExecutedSharesOffset, Shares, 4);
+        WireStoreBig(Message + M::MatchNumberOffset, NextMatch++, 8);
+        Message[M::PrintableOffset] = 'Y';
+        WireStoreBig(Message + M::ExecutionPriceOffset, Mid[Order.Locate], 4);
+        Order.Shares -= Shares;
+        Gone = Order.Shares == 0;
+        Length = M::Size;
+    } else if (Roll >= 75) {
+        using M = Itch::OrderCancel;
+        UINT32 Shares = Order.Shares > 100 ? 100 : Order.Shares;
+        PutCommon(Message, M::Type, Order.Locate, Clock);
+        WireStoreBig(Message + M::OrderReferenceOffset, Order.Reference, 8);
+        WireStoreBig(Message + M::CancelledSharesOffset, Shares, 4);
+        Order.Shares -= Shares;
+        Gone = Order.Shares == 0;
+        Length = M::Size;
+    } else {
+        using M = Itch::OrderDelete;
+        PutCommon(Message, M::Type, Order.Locate, Clock);
+        WireStoreBig(Message + M::OrderReferenceOffset, Order.Reference, 8);
+        Gone = true;
+        Length = M::Size;
+    }
+
+    if (Gone) {
+        Order = Live.back();
+        Live.pop_back();
+    }
+    return Length;
+}
+
+UINT32 ItchFeed::NextDatagram(_Out_ UCHAR* Frame, UINT32 Messages)
+{
+    UCHAR* Payload = Frame + HeadersLength;
+    memcpy(Payload + Itch::MoldUdp64::SessionOffset, "SYNTHETIC1", Itch::MoldUdp64::SessionLength);
+    WireStoreBig(Payload + Itch::MoldUdp64::SequenceNumberOffset, Sequence, 8);
+    WireStoreBig(Payload + Itch::MoldUdp64::MessageCountOffset, Messages, 2);
+
+    UINT32 Length = Itch::MoldUdp64::Size;
+    for (UINT32 i = 0; i < Messages; i++) {
+        UINT32 MessageLength = NextMessage(Payload + Length + Itch::Schema::LengthPrefixBytes);
+        WireStoreBig(Payload + Length, MessageLength, Itch::Schema::LengthPrefixBytes);
+        Length += Itch::Schema::LengthPrefixBytes + MessageLength;
+    }
+
+    WriteUdpHeaders(Frame, Length, 0x0a000001, Port, 0xe9363601, Port);
+    return HeadersLength + Length;
+}
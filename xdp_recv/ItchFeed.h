@@ -0,0 +1,81 @@
+#pragma once
+
+#include <windows.h>
+
+#include <random>
+#include <vector>
+
+#include "ItchMessages.h"
+
+struct ItchFeedConfig {
+    //
+    // Instruments get stock locates 1 to Instruments.
+    //
+    UINT32 Instruments = 1000;
+
+    //
+    // Resting orders the feed keeps per instrument on average.
+    //
+    UINT32 OrdersPerInstrument = 200;
+
+    UINT64 Seed = 1;
+};
+
+//
+// Synthesizes an ITCH session for the benchmarks: orders added around a
+// drifting price per instrument, then executed (some at a price of their
+// own), cancelled, replaced or deleted, with the proportions of a busy day
+// and every message about an order that is still live. Datagrams are MoldUDP64 packets behind Ethernet,
+// IPv4 and UDP headers, numbered from sequence 1.
+//
+class ItchFeed {
+  public:
+    static constexpr UINT32 MaxMessageSize = Itch::Trade::Size;
+    static constexpr UINT32 HeadersLength = 42;
+    static constexpr UINT16 Port = 26400;
+
+    explicit ItchFeed(const ItchFeedConfig& Config);
+
+    //
+    // Writes the next message at Message and returns its length.
+    //
+    UINT32 NextMessage(_Out_writes_bytes_(MaxMessageSize) UCHAR* Message);
+
+    //
+    // Writes a frame with the next Messages messages and returns its length,
+    // which is at most FrameRoom(Messages).
+    //
+    UINT32 NextDatagram(_Out_ UCHAR* Frame, UINT32 Messages);
+
+    static constexpr UINT32 FrameRoom(UINT32 Messages)
+    {
+        return HeadersLength + Itch::MoldUdp64::Size + Messages * (Itch::Schema::LengthPrefixBytes + MaxMessageSize);
+    }
+
+    //
+    // The sequence number the next message gets.
+    //
+    UINT64 NextSequence() const { return Sequence; }
+
+    UINT32 LiveOrders() const { return (UINT32)Live.size(); }
+
+  private:
+    struct LiveOrder {
+        UINT64 Reference;
+        UINT32 Price;
+        UINT32 Shares;
+        UINT16 Locate;
+        bool Buy;
+    };
+
+    UINT32 WriteAdd(_Out_writes_bytes_(MaxMessageSize) UCHAR* Message, UINT64 Timestamp);
+
+    ItchFeedConfig Config;
+    std::mt19937_64 Random;
+    std::vector<UINT32> Mid;
+    std::vector<LiveOrder> Live;
+    UINT64 NextReference = 1;
+    UINT64 NextMatch = 1;
+    UINT64 Sequence = 1;
+    UINT64 Clock = 34200000000000;
+};
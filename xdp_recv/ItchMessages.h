@@ -0,0 +1,392 @@
+#pragma once
+
+//
+// Generated by xdp_recv.exe --decoder-gen from Itch.schema.
+// Edit the schema and regenerate rather than changing this file.
+//
+
+#include <windows.h>
+
+#include "WireMessage.h"
+
+namespace Itch {
+
+constexpr WireByteOrder ByteOrder = WireByteOrder::Big;
+
+class MoldUdp64 {
+  public:
+    static constexpr UINT32 Size = 20;
+
+    static constexpr UINT32 SessionOffset = 0;
+    static constexpr UINT32 SessionLength = 10;
+    static constexpr UINT32 SequenceNumberOffset = 10;
+    static constexpr UINT32 MessageCountOffset = 18;
+
+    explicit MoldUdp64(_In_ const UCHAR* Data) : Data(Data) {}
+
+    const char* Session() const { return (const char*)Data + SessionOffset; }
+    UINT64 SequenceNumber() const { return WireLoad<8, ByteOrder>(Data + SequenceNumberOffset); }
+    UINT16 MessageCount() const { return (UINT16)WireLoad<2, ByteOrder>(Data + MessageCountOffset); }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class SystemEvent {
+  public:
+    static constexpr UINT8 Type = 'S';
+    static constexpr UINT32 Size = 12;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 EventCodeOffset = 11;
+
+    explicit SystemEvent(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    char EventCode() const { return (char)Data[EventCodeOffset]; }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class StockDirectory {
+  public:
+    static constexpr UINT8 Type = 'R';
+    static constexpr UINT32 Size = 39;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 StockOffset = 11;
+    static constexpr UINT32 StockLength = 8;
+    static constexpr UINT32 MarketCategoryOffset = 19;
+    static constexpr UINT32 FinancialStatusIndicatorOffset = 20;
+    static constexpr UINT32 RoundLotSizeOffset = 21;
+    static constexpr UINT32 RoundLotsOnlyOffset = 25;
+    static constexpr UINT32 IssueClassificationOffset = 26;
+    static constexpr UINT32 IssueSubTypeOffset = 27;
+    static constexpr UINT32 IssueSubTypeLength = 2;
+    static constexpr UINT32 AuthenticityOffset = 29;
+    static constexpr UINT32 ShortSaleThresholdIndicatorOffset = 30;
+    static constexpr UINT32 IpoFlagOffset = 31;
+    static constexpr UINT32 LuldReferencePriceTierOffset = 32;
+    static constexpr UINT32 EtpFlagOffset = 33;
+    static constexpr UINT32 EtpLeverageFactorOffset = 34;
+    static constexpr UINT32 InverseIndicatorOffset = 38;
+
+    explicit StockDirectory(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    const char* Stock() const { return (const char*)Data + StockOffset; }
+    char MarketCategory() const { return (char)Data[MarketCategoryOffset]; }
+    char FinancialStatusIndicator() const { return (char)Data[FinancialStatusIndicatorOffset]; }
+    UINT32 RoundLotSize() const { return (UINT32)WireLoad<4, ByteOrder>(Data + RoundLotSizeOffset); }
+    char RoundLotsOnly() const { return (char)Data[RoundLotsOnlyOffset]; }
+    char IssueClassification() const { return (char)Data[IssueClassificationOffset]; }
+    const char* IssueSubType() const { return (const char*)Data + IssueSubTypeOffset; }
+    char Authenticity() const { return (char)Data[AuthenticityOffset]; }
+    char ShortSaleThresholdIndicator() const { return (char)Data[ShortSaleThresholdIndicatorOffset]; }
+    char IpoFlag() const { return (char)Data[IpoFlagOffset]; }
+    char LuldReferencePriceTier() const { return (char)Data[LuldReferencePriceTierOffset]; }
+    char EtpFlag() const { return (char)Data[EtpFlagOffset]; }
+    UINT32 EtpLeverageFactor() const { return (UINT32)WireLoad<4, ByteOrder>(Data + EtpLeverageFactorOffset); }
+    char InverseIndicator() const { return (char)Data[InverseIndicatorOffset]; }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class RegShoRestriction {
+  public:
+    static constexpr UINT8 Type = 'Y';
+    static constexpr UINT32 Size = 20;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 StockOffset = 11;
+    static constexpr UINT32 StockLength = 8;
+    static constexpr UINT32 RegShoActionOffset = 19;
+
+    explicit RegShoRestriction(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    const char* Stock() const { return (const char*)Data + StockOffset; }
+    char RegShoAction() const { return (char)Data[RegShoActionOffset]; }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class AddOrder {
+  public:
+    static constexpr UINT8 Type = 'A';
+    static constexpr UINT32 Size = 36;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 OrderReferenceOffset = 11;
+    static constexpr UINT32 BuySellOffset = 19;
+    static constexpr UINT32 SharesOffset = 20;
+    static constexpr UINT32 StockOffset = 24;
+    static constexpr UINT32 StockLength = 8;
+    static constexpr UINT32 PriceOffset = 32;
+
+    explicit AddOrder(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    UINT64 OrderReference() const { return WireLoad<8, ByteOrder>(Data + OrderReferenceOffset); }
+    char BuySell() const { return (char)Data[BuySellOffset]; }
+    UINT32 Shares() const { return (UINT32)WireLoad<4, ByteOrder>(Data + SharesOffset); }
+    const char* Stock() const { return (const char*)Data + StockOffset; }
+    UINT32 Price() const { return (UINT32)WireLoad<4, ByteOrder>(Data + PriceOffset); }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class AddOrderMpid {
+  public:
+    static constexpr UINT8 Type = 'F';
+    static constexpr UINT32 Size = 40;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 OrderReferenceOffset = 11;
+    static constexpr UINT32 BuySellOffset = 19;
+    static constexpr UINT32 SharesOffset = 20;
+    static constexpr UINT32 StockOffset = 24;
+    static constexpr UINT32 StockLength = 8;
+    static constexpr UINT32 PriceOffset = 32;
+    static constexpr UINT32 AttributionOffset = 36;
+    static constexpr UINT32 AttributionLength = 4;
+
+    explicit AddOrderMpid(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    UINT64 OrderReference() const { return WireLoad<8, ByteOrder>(Data + OrderReferenceOffset); }
+    char BuySell() const { return (char)Data[BuySellOffset]; }
+    UINT32 Shares() const { return (UINT32)WireLoad<4, ByteOrder>(Data + SharesOffset); }
+    const char* Stock() const { return (const char*)Data + StockOffset; }
+    UINT32 Price() const { return (UINT32)WireLoad<4, ByteOrder>(Data + PriceOffset); }
+    const char* Attribution() const { return (const char*)Data + AttributionOffset; }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class OrderExecuted {
+  public:
+    static constexpr UINT8 Type = 'E';
+    static constexpr UINT32 Size = 31;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 OrderReferenceOffset = 11;
+    static constexpr UINT32 ExecutedSharesOffset = 19;
+    static constexpr UINT32 MatchNumberOffset = 23;
+
+    explicit OrderExecuted(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    UINT64 OrderReference() const { return WireLoad<8, ByteOrder>(Data + OrderReferenceOffset); }
+    UINT32 ExecutedShares() const { return (UINT32)WireLoad<4, ByteOrder>(Data + ExecutedSharesOffset); }
+    UINT64 MatchNumber() const { return WireLoad<8, ByteOrder>(Data + MatchNumberOffset); }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class OrderExecutedWithPrice {
+  public:
+    static constexpr UINT8 Type = 'C';
+    static constexpr UINT32 Size = 36;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 OrderReferenceOffset = 11;
+    static constexpr UINT32 ExecutedSharesOffset = 19;
+    static constexpr UINT32 MatchNumberOffset = 23;
+    static constexpr UINT32 PrintableOffset = 31;
+    static constexpr UINT32 ExecutionPriceOffset = 32;
+
+    explicit OrderExecutedWithPrice(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    UINT64 OrderReference() const { return WireLoad<8, ByteOrder>(Data + OrderReferenceOffset); }
+    UINT32 ExecutedShares() const { return (UINT32)WireLoad<4, ByteOrder>(Data + ExecutedSharesOffset); }
+    UINT64 MatchNumber() const { return WireLoad<8, ByteOrder>(Data + MatchNumberOffset); }
+    char Printable() const { return (char)Data[PrintableOffset]; }
+    UINT32 ExecutionPrice() const { return (UINT32)WireLoad<4, ByteOrder>(Data + ExecutionPriceOffset); }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class OrderCancel {
+  public:
+    static constexpr UINT8 Type = 'X';
+    static constexpr UINT32 Size = 23;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 OrderReferenceOffset = 11;
+    static constexpr UINT32 CancelledSharesOffset = 19;
+
+    explicit OrderCancel(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    UINT64 OrderReference() const { return WireLoad<8, ByteOrder>(Data + OrderReferenceOffset); }
+    UINT32 CancelledShares() const { return (UINT32)WireLoad<4, ByteOrder>(Data + CancelledSharesOffset); }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class OrderDelete {
+  public:
+    static constexpr UINT8 Type = 'D';
+    static constexpr UINT32 Size = 19;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 OrderReferenceOffset = 11;
+
+    explicit OrderDelete(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    UINT64 OrderReference() const { return WireLoad<8, ByteOrder>(Data + OrderReferenceOffset); }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class OrderReplace {
+  public:
+    static constexpr UINT8 Type = 'U';
+    static constexpr UINT32 Size = 35;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 OriginalOrderReferenceOffset = 11;
+    static constexpr UINT32 NewOrderReferenceOffset = 19;
+    static constexpr UINT32 SharesOffset = 27;
+    static constexpr UINT32 PriceOffset = 31;
+
+    explicit OrderReplace(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    UINT64 OriginalOrderReference() const { return WireLoad<8, ByteOrder>(Data + OriginalOrderReferenceOffset); }
+    UINT64 NewOrderReference() const { return WireLoad<8, ByteOrder>(Data + NewOrderReferenceOffset); }
+    UINT32 Shares() const { return (UINT32)WireLoad<4, ByteOrder>(Data + SharesOffset); }
+    UINT32 Price() const { return (UINT32)WireLoad<4, ByteOrder>(Data + PriceOffset); }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+class Trade {
+  public:
+    static constexpr UINT8 Type = 'P';
+    static constexpr UINT32 Size = 44;
+
+    static constexpr UINT32 StockLocateOffset = 1;
+    static constexpr UINT32 TrackingNumberOffset = 3;
+    static constexpr UINT32 TimestampOffset = 5;
+    static constexpr UINT32 OrderReferenceOffset = 11;
+    static constexpr UINT32 BuySellOffset = 19;
+    static constexpr UINT32 SharesOffset = 20;
+    static constexpr UINT32 StockOffset = 24;
+    static constexpr UINT32 StockLength = 8;
+    static constexpr UINT32 PriceOffset = 32;
+    static constexpr UINT32 MatchNumberOffset = 36;
+
+    explicit Trade(_In_ const UCHAR* Data) : Data(Data) {}
+
+    UINT16 StockLocate() const { return (UINT16)WireLoad<2, ByteOrder>(Data + StockLocateOffset); }
+    UINT16 TrackingNumber() const { return (UINT16)WireLoad<2, ByteOrder>(Data + TrackingNumberOffset); }
+    UINT64 Timestamp() const { return WireLoad<6, ByteOrder>(Data + TimestampOffset); }
+    UINT64 OrderReference() const { return WireLoad<8, ByteOrder>(Data + OrderReferenceOffset); }
+    char BuySell() const { return (char)Data[BuySellOffset]; }
+    UINT32 Shares() const { return (UINT32)WireLoad<4, ByteOrder>(Data + SharesOffset); }
+    const char* Stock() const { return (const char*)Data + StockOffset; }
+    UINT32 Price() const { return (UINT32)WireLoad<4, ByteOrder>(Data + PriceOffset); }
+    UINT64 MatchNumber() const { return WireLoad<8, ByteOrder>(Data + MatchNumberOffset); }
+
+    const UCHAR* Bytes() const { return Data; }
+
+  private:
+    const UCHAR* Data;
+};
+
+struct Schema {
+    static constexpr WireByteOrder Order = ByteOrder;
+    static constexpr UINT32 LengthPrefixBytes = 2;
+
+    using Packet = MoldUdp64;
+    using Messages = WireMessageList<
+        SystemEvent,
+        StockDirectory,
+        RegShoRestriction,
+        AddOrder,
+        AddOrderMpid,
+        OrderExecuted,
+        OrderExecutedWithPrice,
+        OrderCancel,
+        OrderDelete,
+        OrderReplace,
+        Trade>;
+};
+
+} // namespace Itch
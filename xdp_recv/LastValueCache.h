@@ -0,0 +1,271 @@
+#pragma once
+
+#include <windows.h>
+#include <string.h>
+
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+struct LastValueCacheConfig {
+    //
+    // Keys are 0 to Keys - 1; every key has its slot from the start.
+    //
+    UINT32 Keys = 16384;
+
+    UINT32 MaxConsumers = 4;
+};
+
+struct LastValueCacheStats {
+    UINT64 Writes;
+    UINT64 Publishes;
+
+    //
+    // Dirty bitmap words handed to consumers; a word carries every key of it
+    // written since the last publish.
+    //
+    UINT64 WordsPublished;
+};
+
+struct LastValueConsumerStats {
+    UINT64 Sweeps;
+    UINT64 Delivered;
+
+    //
+    // Reads repeated because the writer was updating the slot.
+    //
+    UINT64 Retries;
+};
+
+//
+// Latest value per key between the RX thread and consumers that may not keep
+// up with every update, e.g. TopOfBook snapshots keyed by stock locate from
+// OrderBookBuilder::Published(). A consumer that falls behind sees fewer,
+// newer values instead of a growing backlog: updates to a key it has not
+// looked at yet are conflated into the last one.
+//
+// Each key has a slot on its own cache line guarded by a sequence lock. The
+// single writer bumps the sequence to odd, stores the value and bumps it back
+// to even, so it never waits; a reader copies the value and retries if the
+// sequence was odd or moved meanwhile. Values are stored as relaxed atomic
+// words, which keeps the copy free of data races and on x86 costs the same as
+// a memcpy.
+//
+// Every consumer has a two-level dirty bitmap: a bit per key and a summary bit
+// per 64-key word. Write() only marks the key in a writer-local bitmap;
+// Publish(), once per burst, ORs each word touched since the last publish into
+// every consumer's bitmap with one atomic operation, so keys written many
+// times in a burst cost one bit. Sweep() takes the summary and then each dirty
+// word with an exchange, and reads only the keys whose bits were set. Memory is
+// fixed at construction: one slot per key and Keys / 8 bytes per consumer.
+//
+// T must be trivially copyable. Write() and Publish() are for a single writer
+// thread; each consumer id is used by one thread at a time.
+//
+template <typename T>
+class LastValueCache {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+  public:
+    static constexpr UINT32 NoConsumer = MAXUINT32;
+
+    explicit LastValueCache(const LastValueCacheConfig& Config)
+        : Keys(Config.Keys)
+        , WordCount((Config.Keys + 63) / 64)
+        , SummaryCount((WordCount + 63) / 64)
+        , MaxConsumers(Config.MaxConsumers)
+    {
+        Slots = std::make_unique<Slot[]>(Keys);
+        Pending = std::make_unique<UINT64[]>(WordCount);
+        Touched.reserve(WordCount);
+        Consumers = std::make_unique<ConsumerState[]>(MaxConsumers);
+        for (UINT32 Consumer = 0; Consumer < MaxConsumers; Consumer++) {
+            Consumers[Consumer].Dirty = std::make_unique<std::atomic<UINT64>[]>(WordCount);
+            Consumers[Consumer].Summary = std::make_unique<std::atomic<UINT64>[]>(SummaryCount);
+        }
+    }
+
+    LastValueCache(const LastValueCache&) = delete;
+    LastValueCache& operator=(const LastValueCache&) = delete;
+
+    //
+    // Returns a consumer id for Sweep(), or NoConsumer if all are taken. A
+    // consumer is told about keys published after it registered; Read()
+    // gives it anything older.
+    //
+    UINT32 RegisterConsumer()
+    {
+        UINT32 Id = ConsumerCount.load(std::memory_order_relaxed);
+        do {
+            if (Id == MaxConsumers) {
+                return NoConsumer;
+            }
+        } while (!ConsumerCount.compare_exchange_weak(Id, Id + 1, std::memory_order_relaxed));
+        return Id;
+    }
+
+    //
+    // Writer side. The value can be read at once; consumers are told about
+    // the key at the next Publish().
+    //
+    void Write(UINT32 Key, const T& Value)
+    {
+        Slot& Target = Slots[Key];
+        UINT64 Sequence = Target.Sequence.load(std::memory_order_relaxed);
+        Target.Sequence.store(Sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        UINT64 Words[WordsPerValue] = {};
+        memcpy(Words, &Value, sizeof(T));
+        for (UINT32 i = 0; i < WordsPerValue; i++) {
+            Target.Words[i].store(Words[i], std::memory_order_relaxed);
+        }
+        Target.Sequence.store(Sequence + 2, std::memory_order_release);
+
+        UINT64& Word = Pending[Key / 64];
+        if (Word == 0) {
+            Touched.push_back(Key / 64);
+        }
+        Word |= 1ull << (Key % 64);
+        Stats.Writes++;
+    }
+
+    //
+    // Writer side. Marks every key written since the last call dirty for
+    // every consumer.
+    //
+    void Publish()
+    {
+        UINT32 Registered = ConsumerCount.load(std::memory_order_acquire);
+        for (UINT32 Index : Touched) {
+            UINT64 Bits = Pending[Index];
+            Pending[Index] = 0;
+            for (UINT32 Consumer = 0; Consumer < Registered; Consumer++) {
+                ConsumerState& State = Consumers[Consumer];
+
+                //
+                // The word is set before its summary bit, and the summary bit
+                // is only skipped if still set, which Sweep() has then not
+                // taken yet: it takes the summary before the words. Sequential
+                // consistency is what makes the skip safe; on x86 it only
+                // costs on the read-modify-write, which is locked anyway.
+                //
+                State.Dirty[Index].fetch_or(Bits, std::memory_order_seq_cst);
+                std::atomic<UINT64>& Summary = State.Summary[Index / 64];
+                UINT64 Bit = 1ull << (Index % 64);
+                if ((Summary.load(std::memory_order_seq_cst) & Bit) == 0) {
+                    Summary.fetch_or(Bit, std::memory_order_seq_cst);
+                }
+            }
+        }
+        Stats.WordsPublished += Touched.size();
+        Stats.Publishes++;
+        Touched.clear();
+    }
+
+    //
+    // Copies the latest value of Key to Value. Version counts the writes to
+    // the key, and is zero if it was never written; Value is then zeroed.
+    //
+    void Read(UINT32 Key, _Out_ T* Value, _Out_ UINT64* Version) const
+    {
+        UINT64 Retries;
+        ReadSlot(Slots[Key], Value, Version, &Retries);
+    }
+
+    //
+    // Consumer side. Calls Deliver(Key, Value, Version) for every key
+    // published since the consumer's last sweep, with its latest value, and
+    // returns the number of keys delivered. Never waits for the writer beyond
+    // retrying a read that overlapped a write.
+    //
+    template <typename Fn>
+    UINT32 Sweep(UINT32 Consumer, Fn&& Deliver)
+    {
+        ConsumerState& State = Consumers[Consumer];
+        UINT32 Delivered = 0;
+        for (UINT32 Group = 0; Group < SummaryCount; Group++) {
+            if (State.Summary[Group].load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+
+            UINT64 Words = State.Summary[Group].exchange(0, std::memory_order_seq_cst);
+            for (; Words != 0; Words &= Words - 1) {
+                UINT32 Index = Group * 64 + std::countr_zero(Words);
+                UINT64 Bits = State.Dirty[Index].exchange(0, std::memory_order_seq_cst);
+                for (; Bits != 0; Bits &= Bits - 1) {
+                    UINT32 Key = Index * 64 + std::countr_zero(Bits);
+                    T Value;
+                    UINT64 Version;
+                    UINT64 Retries;
+                    ReadSlot(Slots[Key], &Value, &Version, &Retries);
+                    State.Stats.Retries += Retries;
+                    Deliver(Key, Value, Version);
+                    Delivered++;
+                }
+            }
+        }
+        State.Stats.Sweeps++;
+        State.Stats.Delivered += Delivered;
+        return Delivered;
+    }
+
+    UINT32 KeyCount() const { return Keys; }
+    const LastValueCacheStats& Statistics() const { return Stats; }
+    const LastValueConsumerStats& Statistics(UINT32 Consumer) const { return Consumers[Consumer].Stats; }
+
+  private:
+    static constexpr UINT32 WordsPerValue = (sizeof(T) + 7) / 8;
+
+    struct alignas(64) Slot {
+        std::atomic<UINT64> Sequence {0};
+        std::atomic<UINT64> Words[WordsPerValue] = {};
+    };
+
+    struct alignas(64) ConsumerState {
+        std::unique_ptr<std::atomic<UINT64>[]> Dirty;
+        std::unique_ptr<std::atomic<UINT64>[]> Summary;
+        LastValueConsumerStats Stats {};
+    };
+
+    static void ReadSlot(const Slot& Source, _Out_ T* Value, _Out_ UINT64* Version, _Out_ UINT64* Retries)
+    {
+        UINT64 Words[WordsPerValue];
+        *Retries = 0;
+        for (;;) {
+            UINT64 Before = Source.Sequence.load(std::memory_order_acquire);
+            if ((Before & 1) == 0) {
+                for (UINT32 i = 0; i < WordsPerValue; i++) {
+                    Words[i] = Source.Words[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (Source.Sequence.load(std::memory_order_relaxed) == Before) {
+                    memcpy(Value, Words, sizeof(T));
+                    *Version = Before / 2;
+                    return;
+                }
+            }
+            (*Retries)++;
+            YieldProcessor();
+        }
+    }
+
+    UINT32 Keys;
+    UINT32 WordCount;
+    UINT32 SummaryCount;
+    UINT32 MaxConsumers;
+    std::unique_ptr<Slot[]> Slots;
+
+    //
+    // Writer-local: keys written since the last Publish() and the indexes of
+    // their words.
+    //
+    std::unique_ptr<UINT64[]> Pending;
+    std::vector<UINT32> Touched;
+    LastValueCacheStats Stats {};
+
+    std::unique_ptr<ConsumerState[]> Consumers;
+    std::atomic<UINT32> ConsumerCount {0};
+};
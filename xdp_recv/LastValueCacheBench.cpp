@@ -0,0 +1,249 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "LastValueCache.h"
+#include "LatencyHistogram.h"
+#include "SpscRing.h"
+#include "TscClock.h"
+
+static constexpr UINT32 BenchBurst = 32;
+static constexpr UINT32 QueueSize = 4096;
+
+//
+// Sized like a TopOfBook; the writer stamps each value with its write time.
+//
+struct BenchQuote {
+    UINT64 WriteTicks;
+    UINT64 Fields[5];
+};
+
+struct BenchUpdate {
+    UINT32 Key;
+    BenchQuote Quote;
+};
+
+struct StalenessResult {
+    UINT64 Writes;
+    UINT64 Delivered;
+
+    //
+    // Updates the consumer never saw: overwritten in the cache, or dropped by
+    // the RX thread on a full queue.
+    //
+    UINT64 Lost;
+
+    //
+    // Keys whose last update never reached the consumer by the end of the
+    // run.
+    //
+    UINT32 StaleKeys;
+    LatencyHistogram<> AgeNs;
+};
+
+//
+// Keys skewed the way instruments are: a few take most of the updates.
+//
+static std::vector<UINT32> SkewedKeys(UINT32 Keys, UINT32 Count)
+{
+    std::mt19937_64 Random(49);
+    std::vector<UINT32> Sequence(Count);
+    for (UINT32& Key : Sequence) {
+        UINT64 Value = Random();
+        UINT32 Shift = std::min(std::countr_zero(Value | (1ull << 40)), 31);
+        Key = (UINT32)((Value >> 40) >> Shift) % Keys;
+    }
+    return Sequence;
+}
+
+static void SimulateWork(const TscClock& Clock, UINT64 Ticks)
+{
+    if (Ticks != 0) {
+        UINT64 End = Clock.Now() + Ticks;
+        while (Clock.Now() < End) {
+        }
+    }
+}
+
+//
+// Ns per Write() on the writer thread alone, publishing every burst, with
+// Consumers registered but idle.
+//
+static double MeasureWrites(const TscClock& Clock, const std::vector<UINT32>& Keys, UINT32 KeyCount, UINT32 Consumers)
+{
+    LastValueCacheConfig Config;
+    Config.Keys = KeyCount;
+    Config.MaxConsumers = std::max(Consumers, 1u);
+    auto Cache = std::make_unique<LastValueCache<BenchQuote>>(Config);
+    for (UINT32 i = 0; i < Consumers; i++) {
+        Cache->RegisterConsumer();
+    }
+
+    BenchQuote Quote {};
+    UINT64 Start = Clock.NowOrdered();
+    for (UINT32 i = 0; i < (UINT32)Keys.size(); i++) {
+        Quote.WriteTicks = i;
+        Cache->Write(Keys[i], Quote);
+        if ((i + 1) % BenchBurst == 0) {
+            Cache->Publish();
+        }
+    }
+    Cache->Publish();
+    return (double)Clock.TicksToNs(Clock.NowOrdered() - Start) / Keys.size();
+}
+
+//
+// The writer thread plays the RX thread at Rate updates/s and never waits;
+// the consumer spends WorkTicks on every update it is handed. With Conflate
+// the two meet in the cache, otherwise in a queue the writer drops from when
+// it is full.
+//
+static void MeasureStaleness(
+    const TscClock& Clock,
+    const std::vector<UINT32>& Keys,
+    UINT32 KeyCount,
+    UINT32 Rate,
+    UINT64 WorkTicks,
+    bool Conflate,
+    _Out_ StalenessResult* Result)
+{
+    LastValueCacheConfig Config;
+    Config.Keys = KeyCount;
+    Config.MaxConsumers = 1;
+    auto Cache = std::make_unique<LastValueCache<BenchQuote>>(Config);
+    UINT32 Consumer = Cache->RegisterConsumer();
+    SpscRing<BenchUpdate> Queue(QueueSize);
+
+    Result->Writes = 0;
+    Result->Delivered = 0;
+    Result->Lost = 0;
+    Result->AgeNs.Reset();
+    std::atomic<bool> Done {false};
+    std::vector<UINT64> LastWritten(KeyCount, 0);
+    std::vector<UINT64> LastSeen(KeyCount, 0);
+
+    std::thread Reader([&] {
+        auto Deliver = [&](UINT32 Key, const BenchQuote& Quote) {
+            LastSeen[Key] = Quote.WriteTicks;
+            Result->AgeNs.Record(Clock.TicksToNs(Clock.Now() - Quote.WriteTicks));
+            Result->Delivered++;
+            SimulateWork(Clock, WorkTicks);
+        };
+
+        BenchUpdate Updates[BenchBurst];
+        while (TRUE) {
+            bool Finished = Done.load(std::memory_order_acquire);
+            UINT32 Count;
+            if (Conflate) {
+                Count = Cache->Sweep(
+                    Consumer, [&](UINT32 Key, const BenchQuote& Quote, UINT64) { Deliver(Key, Quote); });
+            } else {
+                Count = Queue.Pop(Updates, BenchBurst);
+                for (UINT32 i = 0; i < Count; i++) {
+                    Deliver(Updates[i].Key, Updates[i].Quote);
+                }
+            }
+            if (Count == 0) {
+                if (Finished) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    UINT64 TicksPerBurst = Clock.NsToTicks(1000000000ull * BenchBurst / Rate);
+    UINT64 Next = Clock.Now();
+    BenchQuote Quote {};
+    for (UINT32 i = 0; i < (UINT32)Keys.size(); i += BenchBurst) {
+        while (Clock.Now() < Next) {
+            std::this_thread::yield();
+        }
+        Next += TicksPerBurst;
+
+        UINT32 Burst = std::min(BenchBurst, (UINT32)Keys.size() - i);
+        Quote.WriteTicks = Clock.Now();
+        for (UINT32 j = 0; j < Burst; j++) {
+            LastWritten[Keys[i + j]] = Quote.WriteTicks;
+            if (Conflate) {
+                Cache->Write(Keys[i + j], Quote);
+            } else if (!Queue.Push({Keys[i + j], Quote})) {
+                Result->Lost++;
+            }
+        }
+        if (Conflate) {
+            Cache->Publish();
+        } else {
+            Queue.Publish();
+        }
+        Result->Writes += Burst;
+    }
+
+    Done.store(true, std::memory_order_release);
+    Reader.join();
+    if (Conflate) {
+        Result->Lost = Result->Writes - Result->Delivered;
+    }
+    Result->StaleKeys = 0;
+    for (UINT32 Key = 0; Key < KeyCount; Key++) {
+        Result->StaleKeys += LastSeen[Key] != LastWritten[Key] ? 1 : 0;
+    }
+}
+
+//
+// Write rate of the last-value cache, and how stale a slow consumer's view
+// gets with it against a bounded queue of every update.
+//
+int LastValueCacheBenchmark(int argc, char** argv)
+{
+    UINT32 Writes = argc >= 1 ? atoi(argv[0]) : 4000000;
+    UINT32 KeyCount = argc >= 2 ? atoi(argv[1]) : 16384;
+    UINT32 Rate = argc >= 3 ? atoi(argv[2]) : 2000000;
+    UINT32 WorkNs = argc >= 4 ? atoi(argv[3]) : 1000;
+
+    if (Writes == 0 || KeyCount == 0 || Rate == 0) {
+        fprintf(stderr, "lvc [writes] [keys] [updates-per-second] [consumer-ns-per-update]\n");
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    std::vector<UINT32> Keys = SkewedKeys(KeyCount, Writes);
+    printf("%u writes over %u keys, bursts of %u\n\n", Writes, KeyCount, BenchBurst);
+
+    printf("%10s %10s %12s\n", "consumers", "ns/write", "M writes/s");
+    for (UINT32 Consumers : {0u, 1u, 4u}) {
+        double Ns = MeasureWrites(Clock, Keys, KeyCount, Consumers);
+        printf("%10u %10.1f %12.2f\n", Consumers, Ns, 1e3 / Ns);
+    }
+
+    printf(
+        "\nwriter at %u updates/s, consumer at %u ns per update (%.0f updates/s), queue of %u\n",
+        Rate,
+        WorkNs,
+        WorkNs != 0 ? 1e9 / WorkNs : 0.0,
+        QueueSize);
+    auto Result = std::make_unique<StalenessResult>();
+    for (bool Conflate : {false, true}) {
+        std::vector<UINT32> Paced(Keys.begin(), Keys.begin() + std::min<size_t>(Keys.size(), Rate));
+        MeasureStaleness(Clock, Paced, KeyCount, Rate, Clock.NsToTicks(WorkNs), Conflate, Result.get());
+        printf(
+            "\n%s: %llu written, %llu delivered, %llu %s, %u keys left stale\n",
+            Conflate ? "last-value cache" : "queue",
+            (unsigned long long)Result->Writes,
+            (unsigned long long)Result->Delivered,
+            (unsigned long long)Result->Lost,
+            Conflate ? "conflated" : "dropped",
+            Result->StaleKeys);
+        PrintLatencySummary(stdout, "age when delivered", Result->AgeNs);
+    }
+    return EXIT_SUCCESS;
+}
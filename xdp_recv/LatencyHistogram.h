@@ -0,0 +1,140 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+//
+// Log-linear latency histogram in the spirit of HdrHistogram. Values are
+// grouped by power of two and every power-of-two range is split into
+// 2^SubBucketBits linear sub-buckets, so the relative error of any reported
+// value is bounded by 2^-SubBucketBits. All storage is inline: Record() never
+// allocates and touches exactly one counter, which keeps it usable on the RX
+// thread.
+//
+template <unsigned SubBucketBits = 6>
+class LatencyHistogram {
+    static_assert(SubBucketBits >= 1 && SubBucketBits < 16);
+
+  public:
+    static constexpr uint64_t SubBucketCount = uint64_t {1} << SubBucketBits;
+    static constexpr uint64_t BucketCount = (65 - SubBucketBits) * SubBucketCount;
+
+    LatencyHistogram() { Reset(); }
+
+    void Reset()
+    {
+        memset(Counts, 0, sizeof(Counts));
+        TotalCount = 0;
+        MinValue = UINT64_MAX;
+        MaxValue = 0;
+    }
+
+    void Record(uint64_t Value)
+    {
+        Counts[IndexOf(Value)]++;
+        TotalCount++;
+        if (Value < MinValue)
+            MinValue = Value;
+        if (Value > MaxValue)
+            MaxValue = Value;
+    }
+
+    void Merge(const LatencyHistogram& Other)
+    {
+        for (uint64_t i = 0; i < BucketCount; i++)
+            Counts[i] += Other.Counts[i];
+        TotalCount += Other.TotalCount;
+        if (Other.MinValue < MinValue)
+            MinValue = Other.MinValue;
+        if (Other.MaxValue > MaxValue)
+            MaxValue = Other.MaxValue;
+    }
+
+    uint64_t Count() const { return TotalCount; }
+    uint64_t Min() const { return TotalCount ? MinValue : 0; }
+    uint64_t Max() const { return MaxValue; }
+
+    //
+    // Returns the highest value equivalent to the bucket that holds the given
+    // percentile (0..100), clamped to the largest value actually recorded.
+    //
+    uint64_t ValueAtPercentile(double Percentile) const
+    {
+        if (TotalCount == 0)
+            return 0;
+
+        uint64_t Target = (uint64_t)(Percentile / 100.0 * (double)TotalCount + 0.5);
+        if (Target == 0)
+            Target = 1;
+        if (Target > TotalCount)
+            Target = TotalCount;
+
+        uint64_t Seen = 0;
+        for (uint64_t i = 0; i < BucketCount; i++) {
+            Seen += Counts[i];
+            if (Seen >= Target) {
+                uint64_t Value = HighestEquivalentValue(i);
+                return Value < MaxValue ? Value : MaxValue;
+            }
+        }
+        return MaxValue;
+    }
+
+    static constexpr uint64_t IndexOf(uint64_t Value)
+    {
+        if (Value < SubBucketCount)
+            return Value;
+
+        unsigned Shift = (unsigned)std::bit_width(Value) - 1 - SubBucketBits;
+        return Shift * SubBucketCount + (Value >> Shift);
+    }
+
+    static constexpr uint64_t LowestEquivalentValue(uint64_t Index)
+    {
+        if (Index < SubBucketCount)
+            return Index;
+
+        unsigned Shift = (unsigned)(Index / SubBucketCount) - 1;
+        return (Index - Shift * SubBucketCount) << Shift;
+    }
+
+    static constexpr uint64_t HighestEquivalentValue(uint64_t Index)
+    {
+        if (Index + 1 >= BucketCount)
+            return UINT64_MAX;
+        return LowestEquivalentValue(Index + 1) - 1;
+    }
+
+  private:
+    uint64_t Counts[BucketCount];
+    uint64_t TotalCount;
+    uint64_t MinValue;
+    uint64_t MaxValue;
+};
+
+static_assert(LatencyHistogram<>::IndexOf(63) == 63);
+static_assert(LatencyHistogram<>::IndexOf(64) == 64);
+static_assert(LatencyHistogram<>::IndexOf(129) == 128);
+static_assert(LatencyHistogram<>::LowestEquivalentValue(LatencyHistogram<>::IndexOf(1000)) <= 1000);
+static_assert(LatencyHistogram<>::HighestEquivalentValue(LatencyHistogram<>::IndexOf(1000)) >= 1000);
+static_assert(LatencyHistogram<>::IndexOf(UINT64_MAX) == LatencyHistogram<>::BucketCount - 1);
+
+//
+// Prints one line with the usual tail percentiles of a histogram whose values
+// are nanoseconds.
+//
+template <unsigned SubBucketBits>
+inline void PrintLatencySummary(FILE* Stream, const char* Name, const LatencyHistogram<SubBucketBits>& Histogram)
+{
+    fprintf(
+        Stream,
+        "%-22s n=%-10llu p50=%-9llu p99=%-9llu p99.9=%-9llu max=%llu (ns)\n",
+        Name,
+        (unsigned long long)Histogram.Count(),
+        (unsigned long long)Histogram.ValueAtPercentile(50.0),
+        (unsigned long long)Histogram.ValueAtPercentile(99.0),
+        (unsigned long long)Histogram.ValueAtPercentile(99.9),
+        (unsigned long long)Histogram.Max());
+}
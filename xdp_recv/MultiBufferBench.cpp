@@ -0,0 +1,267 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "ChainedFrame.h"
+#include "FillRingRefiller.h"
+#include "MultiBufferRing.h"
+#include "PacketHeaders.h"
+#include "SoftwareXsk.h"
+#include "TscClock.h"
+#include "UmemFramePool.h"
+
+static constexpr UINT32 BenchRingSize = 512;
+static constexpr UINT32 BenchChunks = 2 * BenchRingSize;
+static constexpr UINT32 BenchBurst = 32;
+static constexpr UINT32 MaxFrameLength = 9014;
+
+//
+// Ethernet, the longest IPv4 header and UDP.
+//
+static constexpr UINT32 MaxHeaderLength = sizeof(EthernetHeader) + 60 + sizeof(UdpHeader);
+
+//
+// Mostly small frames with the occasional full-size and jumbo frame, the mix
+// a 16 KiB chunk per frame is sized for.
+//
+static const UINT32 FrameMix[] = {64, 64, 64, 64, 64, 64, 64, 576, 576, 576, 576, 1514, MaxFrameLength};
+
+struct MultiBufferRunResult {
+    double RxMpps;
+    double RxGbps;
+    double TxMpps;
+    double BuffersPerFrame;
+    UINT64 Mismatches;
+    UINT64 Drops;
+};
+
+static UINT64 SumBytes(_In_reads_bytes_(Length) const UCHAR* Data, UINT32 Length)
+{
+    UINT64 Sum = 0;
+    for (UINT32 i = 0; i < Length; i++) {
+        Sum += Data[i];
+    }
+    return Sum;
+}
+
+//
+// What a receive handler does with a frame: find the UDP header and read
+// the whole payload. In place, the payload is read buffer by buffer;
+// linearized, the frame is first copied to scratch.
+//
+static UINT64 HandleFrame(const ChainedFrame& Frame, bool Linearize, _Inout_ UCHAR* Scratch)
+{
+    UCHAR Headers[MaxHeaderLength];
+    UINT32 HeaderLength = std::min(Frame.Length(), MaxHeaderLength);
+    const UCHAR* Bytes;
+    if (Linearize) {
+        Frame.Linearize(Scratch, MaxFrameLength);
+        Bytes = Scratch;
+    } else {
+        Bytes = Frame.Peek(0, HeaderLength, Headers);
+    }
+
+    Ipv4Frame Parsed;
+    if (!ParseIpv4Frame(Bytes, HeaderLength, &Parsed) || Parsed.Udp == nullptr) {
+        return 0;
+    }
+
+    UINT32 PayloadOffset = (UINT32)((const UCHAR*)(Parsed.Udp + 1) - Bytes);
+    UINT32 PayloadLength = Frame.Length() - PayloadOffset;
+    if (Linearize) {
+        return SumBytes(Scratch + PayloadOffset, PayloadLength);
+    }
+
+    UINT64 Sum = 0;
+    Frame.ForEach(PayloadOffset, PayloadLength, [&Sum](const UCHAR* Data, UINT32 Length) {
+        Sum += SumBytes(Data, Length);
+    });
+    return Sum;
+}
+
+static MultiBufferRunResult RunChunkSize(
+    const TscClock& Clock,
+    const std::vector<std::vector<UCHAR>>& Frames,
+    const std::vector<UINT64>& ExpectedSums,
+    UINT32 Count,
+    UINT32 ChunkSize,
+    bool Linearize)
+{
+    UINT64 UmemSize = (UINT64)BenchChunks * ChunkSize;
+    auto Umem = std::make_unique<UCHAR[]>(UmemSize);
+    auto Scratch = std::make_unique<UCHAR[]>(MaxFrameLength);
+    auto Wire = std::make_unique<UCHAR[]>(MaxFrameLength);
+
+    SoftwareXsk Xsk(Umem.get(), UmemSize, ChunkSize, BenchRingSize, true);
+    XSK_RING RxRing;
+    XSK_RING FillRing;
+    XSK_RING TxRing;
+    XSK_RING CompletionRing;
+    XskRingInitialize(&RxRing, &Xsk.RingInfo().Rx);
+    XskRingInitialize(&FillRing, &Xsk.RingInfo().Fill);
+    XskRingInitialize(&TxRing, &Xsk.RingInfo().Tx);
+    XskRingInitialize(&CompletionRing, &Xsk.RingInfo().Completion);
+
+    UmemFramePool Pool(BenchChunks);
+    Pool.AddRegion(0, BenchChunks, ChunkSize);
+    FillRingRefiller Refiller(&FillRing, &Pool, BenchRingSize / 2);
+    Refiller.Refill();
+
+    MultiBufferRx Rx(&RxRing, Xsk.FragmentOffset(), Umem.get(), &Pool);
+    MultiBufferTx Tx(&TxRing, Xsk.FragmentOffset());
+    MultiBufferRunResult Result {};
+    UINT64 Bytes = 0;
+
+    //
+    // Receive: the software NIC delivers a burst, the handler reads it.
+    //
+    UINT64 RxTicks = 0;
+    for (UINT32 Next = 0; Next < Count;) {
+        UINT32 Burst = std::min(BenchBurst, Count - Next);
+        for (UINT32 i = 0; i < Burst; i++) {
+            const std::vector<UCHAR>& Frame = Frames[(Next + i) % Frames.size()];
+            Result.Drops += !Xsk.Deliver(Frame.data(), (UINT32)Frame.size());
+        }
+
+        UINT64 Start = Clock.Now();
+        ChainedFrame Frame;
+        for (UINT32 i = 0; Rx.Receive(&Frame); i++) {
+            Result.Mismatches +=
+                HandleFrame(Frame, Linearize, Scratch.get()) != ExpectedSums[(Next + i) % Frames.size()];
+            Bytes += Frame.Length();
+            Frame.Release(&Pool);
+        }
+        Rx.Release();
+        Refiller.Refill();
+        RxTicks += Clock.Now() - Start;
+        Next += Burst;
+    }
+
+    //
+    // Transmit: scatter each frame over chunks, post a burst, let the
+    // software NIC send it and recycle the completions.
+    //
+    UINT64 TxStart = Clock.NowOrdered();
+    for (UINT32 Next = 0; Next < Count;) {
+        UINT32 Burst = std::min(BenchBurst, Count - Next);
+        UINT32 Posted = 0;
+        ChainedFrame Frame;
+        for (; Posted < Burst; Posted++) {
+            const std::vector<UCHAR>& Data = Frames[(Next + Posted) % Frames.size()];
+            if (!MultiBufferTx::Scatter(Data.data(), (UINT32)Data.size(), Umem.get(), ChunkSize, &Pool, &Frame)) {
+                break;
+            }
+            if (!Tx.Post(Frame)) {
+                Frame.Release(&Pool);
+                break;
+            }
+        }
+        Tx.Submit();
+
+        for (UINT32 i = 0; i < Posted; i++) {
+            const std::vector<UCHAR>& Data = Frames[(Next + i) % Frames.size()];
+            UINT32 Length = Xsk.Transmit(Wire.get(), MaxFrameLength);
+            Result.Mismatches += Length != Data.size() || memcmp(Wire.get(), Data.data(), Length) != 0;
+        }
+
+        UINT32 Index;
+        UINT32 Completed = XskRingConsumerReserve(&CompletionRing, MAXUINT32, &Index);
+        for (UINT32 i = 0; i < Completed; i++) {
+            Pool.Free(*(UINT64*)XskRingGetElement(&CompletionRing, Index + i));
+        }
+        XskRingConsumerRelease(&CompletionRing, Completed);
+        Next += Posted;
+    }
+    UINT64 TxNs = Clock.TicksToNs(Clock.NowOrdered() - TxStart);
+
+    const MultiBufferRxStats& Stats = Rx.Statistics();
+    UINT64 RxNs = Clock.TicksToNs(RxTicks);
+    Result.RxMpps = RxNs != 0 ? Stats.Frames * 1000.0 / RxNs : 0.0;
+    Result.RxGbps = RxNs != 0 ? Bytes * 8.0 / RxNs : 0.0;
+    Result.TxMpps = TxNs != 0 ? Count * 1000.0 / TxNs : 0.0;
+    Result.BuffersPerFrame = Stats.Frames != 0 ? (double)Stats.Buffers / Stats.Frames : 0.0;
+    return Result;
+}
+
+//
+// Receive and transmit through chained frames for several chunk sizes, with
+// the handler reading each frame in place or after linearizing it, and the
+// UMEM each chunk size needs for the same frame mix.
+//
+int MultiBufferBenchmark(int argc, char** argv)
+{
+    UINT32 Count = argc >= 1 ? atoi(argv[0]) : 1000000;
+    UINT32 InFlight = argc >= 2 ? atoi(argv[1]) : 4096;
+
+    if (Count == 0) {
+        fprintf(stderr, "frames must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    std::vector<std::vector<UCHAR>> Frames;
+    std::vector<UINT64> ExpectedSums;
+    UINT64 MixBytes = 0;
+    for (UINT32 Length : FrameMix) {
+        std::vector<UCHAR> Frame(Length);
+        BuildUdpFrame(Frame.data(), Length, 0x0a000001, 40000, 0xef000001, 5000);
+        UINT32 PayloadOffset = sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader);
+        for (UINT32 i = PayloadOffset; i < Length; i++) {
+            Frame[i] = (UCHAR)(i * 7 + Length);
+        }
+        ExpectedSums.push_back(SumBytes(Frame.data() + PayloadOffset, Length - PayloadOffset));
+        Frames.push_back(std::move(Frame));
+        MixBytes += Length;
+    }
+
+    printf(
+        "%u frames of %zu sizes from 64 to %u bytes, %u frames in flight for the UMEM column\n\n",
+        Count,
+        std::size(FrameMix),
+        MaxFrameLength,
+        InFlight);
+    printf(
+        "%-6s %-10s %10s %10s %10s %12s %10s %12s %6s\n",
+        "chunk",
+        "handler",
+        "RX Mpps",
+        "RX Gbps",
+        "TX Mpps",
+        "buffers/frm",
+        "used",
+        "UMEM",
+        "bad");
+
+    static const UINT32 ChunkSizes[] = {2048, 4096, 16384};
+    for (UINT32 ChunkSize : ChunkSizes) {
+        UINT64 MixChunkBytes = 0;
+        for (UINT32 Length : FrameMix) {
+            MixChunkBytes += (UINT64)((Length + ChunkSize - 1) / ChunkSize) * ChunkSize;
+        }
+        double Used = (double)MixBytes / MixChunkBytes;
+        double UmemMiB = (double)InFlight * MixChunkBytes / std::size(FrameMix) / (1024 * 1024);
+
+        for (bool Linearize : {false, true}) {
+            MultiBufferRunResult Result = RunChunkSize(Clock, Frames, ExpectedSums, Count, ChunkSize, Linearize);
+            printf(
+                "%-6u %-10s %10.3f %10.2f %10.3f %12.2f %9.1f%% %8.1f MiB %6llu\n",
+                ChunkSize,
+                Linearize ? "linearize" : "in place",
+                Result.RxMpps,
+                Result.RxGbps,
+                Result.TxMpps,
+                Result.BuffersPerFrame,
+                Used * 100,
+                UmemMiB,
+                (unsigned long long)(Result.Mismatches + Result.Drops));
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+#include "MultiBufferRing.h"
+
+bool MultiBufferRx::Receive(_Out_ ChainedFrame* Frame, _Out_opt_ const VOID** Descriptor)
+{
+    UINT32 Index;
+    UINT32 Available = XskRingConsumerReserve(Ring, MAXUINT32, &Index) - Consumed;
+    Index += Consumed;
+    Frame->Reset();
+    if (Available == 0) {
+        return false;
+    }
+
+    //
+    // XDP publishes a frame's descriptors together, so a chain that is not
+    // all there yet is not a frame yet either.
+    //
+    const XSK_BUFFER_DESCRIPTOR* First = (const XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(Ring, Index);
+    UINT32 Buffers = 1;
+    if (FragmentOffset != 0) {
+        Buffers += ((const XskFrameFragment*)((const UCHAR*)First + FragmentOffset))->FragmentBufferCount;
+    }
+    if (Buffers > Available) {
+        return false;
+    }
+
+    for (UINT32 i = 0; i < Buffers; i++) {
+        const XSK_BUFFER_DESCRIPTOR* Buffer = (const XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(Ring, Index + i);
+        if (!Frame->Append(
+                Buffer->Address.AddressAndOffset,
+                Umem + Buffer->Address.BaseAddress + Buffer->Address.Offset,
+                Buffer->Length)) {
+            Pool->Free(Buffer->Address.BaseAddress);
+            Stats.TruncatedFrames += i == ChainedFrame::MaxSegments;
+        }
+    }
+
+    if (Descriptor != nullptr) {
+        *Descriptor = First;
+    }
+    Consumed += Buffers;
+    Stats.Frames++;
+    Stats.ChainedFrames += Buffers > 1;
+    Stats.Buffers += Buffers;
+    return true;
+}
+
+bool MultiBufferTx::Post(const ChainedFrame& Frame)
+{
+    UINT32 Buffers = Frame.SegmentCount();
+    if (Buffers == 0) {
+        return true;
+    }
+    if (Buffers > 1 && FragmentOffset == 0) {
+        return false;
+    }
+
+    UINT32 Index;
+    if (XskRingProducerReserve(Ring, Posted + Buffers, &Index) != Posted + Buffers) {
+        return false;
+    }
+    Index += Posted;
+
+    for (UINT32 i = 0; i < Buffers; i++) {
+        XSK_BUFFER_DESCRIPTOR* Buffer = (XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(Ring, Index + i);
+        Buffer->Address.AddressAndOffset = Frame.Segment(i).Address;
+        Buffer->Length = Frame.Segment(i).Length;
+        Buffer->Reserved = 0;
+        if (FragmentOffset != 0) {
+            ((XskFrameFragment*)((UCHAR*)Buffer + FragmentOffset))->FragmentBufferCount =
+                (UINT8)(i == 0 ? Buffers - 1 : 0);
+        }
+    }
+
+    Posted += Buffers;
+    return true;
+}
+
+bool MultiBufferTx::Scatter(
+    _In_reads_bytes_(Length) const UCHAR* Data,
+    UINT32 Length,
+    _In_ UCHAR* Umem,
+    UINT32 ChunkSize,
+    _Inout_ UmemFramePool* Pool,
+    _Out_ ChainedFrame* Frame)
+{
+    Frame->Reset();
+
+    do {
+        UINT32 Piece = Length < ChunkSize ? Length : ChunkSize;
+        UINT64 Address;
+        if (!Pool->Allocate(&Address)) {
+            Frame->Release(Pool);
+            return false;
+        }
+        if (!Frame->Append(Address, Umem + Address, Piece)) {
+            Pool->Free(Address);
+            Frame->Release(Pool);
+            return false;
+        }
+
+        memcpy(Umem + Address, Data, Piece);
+        Data += Piece;
+        Length -= Piece;
+    } while (Length != 0);
+
+    return true;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <windows.h>
+#include <afxdp_helper.h>
+
+#include "ChainedFrame.h"
+#include "UmemFramePool.h"
+
+//
+// Multi-buffer frames on the AF_XDP RX and TX rings. A frame larger than one
+// chunk takes several consecutive ring descriptors: the first carries an
+// XDP_FRAME_FRAGMENT extension whose FragmentBufferCount is the number of
+// descriptors that follow it, and those carry the rest of the frame in order.
+// This is the layout XDP uses for fragmented frames on the data path.
+//
+// FragmentOffset is where the extension sits in a ring element, or zero when
+// the ring has none; every descriptor is then a whole frame. XDP 1.0.2 does
+// not let an AF_XDP socket negotiate the extension, so on real sockets it is
+// zero and frames larger than a chunk arrive truncated (RxTruncated).
+// SoftwareXsk provides the layout for the benchmarks.
+//
+
+//
+// XDP_FRAME_FRAGMENT as it appears in a ring element. <xdp/framefragment.h>
+// itself is a driver header and pulls in the kernel datapath definitions.
+//
+struct XskFrameFragment {
+    UINT8 FragmentBufferCount;
+};
+
+C_ASSERT(sizeof(XskFrameFragment) == 1);
+
+struct MultiBufferRxStats {
+    UINT64 Frames;
+    UINT64 ChainedFrames;
+    UINT64 Buffers;
+
+    //
+    // Frames with more buffers than a ChainedFrame holds. The frame keeps
+    // its first MaxSegments buffers and the rest go back to the pool.
+    //
+    UINT64 TruncatedFrames;
+};
+
+class MultiBufferRx {
+  public:
+    MultiBufferRx(_In_ XSK_RING* Ring, UINT32 FragmentOffset, _In_ UCHAR* Umem, _In_ UmemFramePool* Pool)
+        : Ring(Ring)
+        , FragmentOffset(FragmentOffset)
+        , Umem(Umem)
+        , Pool(Pool)
+    {
+    }
+
+    //
+    // Reads the next complete frame into Frame. Returns false if there is
+    // none yet. The frame's descriptors stay on the ring until Release();
+    // Descriptor, if given, receives the first of them, for code that reads
+    // other descriptor extensions.
+    //
+    bool Receive(_Out_ ChainedFrame* Frame, _Out_opt_ const VOID** Descriptor = nullptr);
+
+    //
+    // Hands every descriptor read so far back to XDP. Frames received before
+    // stay valid; their buffers belong to the caller.
+    //
+    void Release()
+    {
+        if (Consumed != 0) {
+            XskRingConsumerRelease(Ring, Consumed);
+            Consumed = 0;
+        }
+    }
+
+    const MultiBufferRxStats& Statistics() const { return Stats; }
+
+  private:
+    XSK_RING* Ring;
+    UINT32 FragmentOffset;
+    UCHAR* Umem;
+    UmemFramePool* Pool;
+    UINT32 Consumed = 0;
+    MultiBufferRxStats Stats {};
+};
+
+class MultiBufferTx {
+  public:
+    MultiBufferTx(_In_ XSK_RING* Ring, UINT32 FragmentOffset) : Ring(Ring), FragmentOffset(FragmentOffset) {}
+
+    //
+    // Queues Frame on the TX ring. Returns false if the ring has no room for
+    // all of its buffers, or if the frame has several buffers and the ring
+    // cannot chain them. Nothing is queued then.
+    //
+    bool Post(const ChainedFrame& Frame);
+
+    //
+    // Submits every frame posted since the last call.
+    //
+    void Submit()
+    {
+        if (Posted != 0) {
+            XskRingProducerSubmit(Ring, Posted);
+            Posted = 0;
+        }
+    }
+
+    //
+    // Copies Length bytes into as many ChunkSize buffers from Pool as it
+    // takes and describes them in Frame. Returns false, with the buffers back
+    // in the pool, if the pool runs out or the frame needs too many.
+    //
+    static bool Scatter(
+        _In_reads_bytes_(Length) const UCHAR* Data,
+        UINT32 Length,
+        _In_ UCHAR* Umem,
+        UINT32 ChunkSize,
+        _Inout_ UmemFramePool* Pool,
+        _Out_ ChainedFrame* Frame);
+
+  private:
+    XSK_RING* Ring;
+    UINT32 FragmentOffset;
+    UINT32 Posted = 0;
+};
@@ -0,0 +1,261 @@
+#include "SocketApi.h"
+
+#include "MulticastMembership.h"
+
+#include <algorithm>
+
+namespace {
+
+void SetIpv4(_Out_ sockaddr_storage* Storage, UINT32 Address)
+{
+    *Storage = {};
+    sockaddr_in* In = (sockaddr_in*)Storage;
+    In->sin_family = AF_INET;
+    In->sin_addr.s_addr = htonl(Address);
+}
+
+//
+// Sorted by group, then source, without duplicates and without the sources
+// of groups also subscribed from any source, which sorts first.
+//
+void Normalize(_Inout_ std::vector<MulticastSubscription>* Subscriptions)
+{
+    std::sort(Subscriptions->begin(), Subscriptions->end());
+    Subscriptions->erase(std::unique(Subscriptions->begin(), Subscriptions->end()), Subscriptions->end());
+
+    UINT32 AnySourceGroup = 0;
+    bool HaveAnySource = false;
+    std::erase_if(*Subscriptions, [&](const MulticastSubscription& Subscription) {
+        if (Subscription.Source == MulticastSubscription::AnySource) {
+            AnySourceGroup = Subscription.Group;
+            HaveAnySource = true;
+            return false;
+        }
+        return HaveAnySource && Subscription.Group == AnySourceGroup;
+    });
+}
+
+} // namespace
+
+MulticastMembership::MulticastMembership(UINT32 IfIndex) : IfIndex(IfIndex)
+{
+#if defined(_WIN32)
+    WSADATA WsaData;
+    Started = WSAStartup(MAKEWORD(2, 2), &WsaData) == 0;
+#else
+    Started = true;
+#endif
+}
+
+MulticastMembership::~MulticastMembership()
+{
+    //
+    // Closing a socket drops its memberships.
+    //
+    for (const MembershipSocket& Socket : Sockets) {
+        closesocket(Socket.Socket);
+    }
+#if defined(_WIN32)
+    if (Started) {
+        WSACleanup();
+    }
+#endif
+}
+
+MulticastMembership::GroupState* MulticastMembership::FindGroup(UINT32 Group)
+{
+    auto It = std::find_if(Groups.begin(), Groups.end(), [Group](const GroupState& State) {
+        return State.Group == Group;
+    });
+    return It != Groups.end() ? &*It : nullptr;
+}
+
+HRESULT MulticastMembership::SocketForGroup(UINT32 Group, _Out_ GroupState** State)
+{
+    *State = FindGroup(Group);
+    if (*State != nullptr) {
+        return S_OK;
+    }
+
+    auto Free = std::find_if(Sockets.begin(), Sockets.end(), [](const MembershipSocket& Socket) {
+        return Socket.Groups < GroupsPerSocket;
+    });
+    if (Free == Sockets.end()) {
+        UINT_PTR Socket = (UINT_PTR)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (Socket == (UINT_PTR)INVALID_SOCKET) {
+            return LastSocketError();
+        }
+
+        sockaddr_in Address {};
+        Address.sin_family = AF_INET;
+        Address.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(Socket, (sockaddr*)&Address, sizeof(Address)) != 0) {
+            HRESULT Result = LastSocketError();
+            closesocket(Socket);
+            return Result;
+        }
+
+        Sockets.push_back({Socket, 0});
+        Stats.Sockets = (UINT32)Sockets.size();
+        Free = Sockets.end() - 1;
+    }
+
+    Free->Groups++;
+    Groups.push_back({Group, (UINT32)(Free - Sockets.begin()), 0});
+    *State = &Groups.back();
+    return S_OK;
+}
+
+HRESULT MulticastMembership::SetMembership(UINT_PTR Socket, const MulticastSubscription& Subscription, bool Join)
+{
+    int Result;
+    if (Subscription.Source == MulticastSubscription::AnySource) {
+        group_req Request {};
+        Request.gr_interface = IfIndex;
+        SetIpv4(&Request.gr_group, Subscription.Group);
+        Result = setsockopt(
+            Socket,
+            IPPROTO_IP,
+            Join ? MCAST_JOIN_GROUP : MCAST_LEAVE_GROUP,
+            (const char*)&Request,
+            sizeof(Request));
+    } else {
+        group_source_req Request {};
+        Request.gsr_interface = IfIndex;
+        SetIpv4(&Request.gsr_group, Subscription.Group);
+        SetIpv4(&Request.gsr_source, Subscription.Source);
+        Result = setsockopt(
+            Socket,
+            IPPROTO_IP,
+            Join ? MCAST_JOIN_SOURCE_GROUP : MCAST_LEAVE_SOURCE_GROUP,
+            (const char*)&Request,
+            sizeof(Request));
+    }
+    return Result == 0 ? S_OK : LastSocketError();
+}
+
+HRESULT MulticastMembership::Join(const MulticastSubscription& Subscription)
+{
+    GroupState* State;
+    if (auto Result = SocketForGroup(Subscription.Group, &State); FAILED(Result)) {
+        return Result;
+    }
+
+    HRESULT Result = SetMembership(Sockets[State->SocketIndex].Socket, Subscription, true);
+    if (SUCCEEDED(Result)) {
+        State->Members++;
+        Stats.Joins++;
+    } else {
+        ReleaseIfUnused(State);
+    }
+    return Result;
+}
+
+HRESULT MulticastMembership::Leave(const MulticastSubscription& Subscription)
+{
+    GroupState* State = FindGroup(Subscription.Group);
+    if (State == nullptr) {
+        return E_INVALIDARG;
+    }
+
+    //
+    // The group's place on its socket is given up even if the stack refuses
+    // the leave; closing the socket is the only stronger leave there is.
+    //
+    HRESULT Result = SetMembership(Sockets[State->SocketIndex].Socket, Subscription, false);
+    Stats.Leaves++;
+    State->Members--;
+    ReleaseIfUnused(State);
+    return Result;
+}
+
+//
+// Gives a group without members its place on its socket back.
+//
+void MulticastMembership::ReleaseIfUnused(_In_ GroupState* State)
+{
+    if (State->Members == 0) {
+        Sockets[State->SocketIndex].Groups--;
+        Groups.erase(Groups.begin() + (State - Groups.data()));
+    }
+}
+
+HRESULT MulticastMembership::Apply(
+    std::vector<MulticastSubscription> Subscriptions,
+    _Out_opt_ MulticastMembershipDiff* Diff)
+{
+    if (!Started) {
+        return E_UNEXPECTED;
+    }
+
+    Normalize(&Subscriptions);
+
+    std::vector<MulticastSubscription> ToLeave;
+    std::vector<MulticastSubscription> ToJoin;
+    std::set_difference(
+        Active.begin(), Active.end(), Subscriptions.begin(), Subscriptions.end(), std::back_inserter(ToLeave));
+    std::set_difference(
+        Subscriptions.begin(), Subscriptions.end(), Active.begin(), Active.end(), std::back_inserter(ToJoin));
+
+    if (Diff != nullptr) {
+        Diff->Joined.clear();
+        Diff->Left = ToLeave;
+    }
+
+    HRESULT FirstError = S_OK;
+    for (const MulticastSubscription& Subscription : ToLeave) {
+        if (auto Result = Leave(Subscription); FAILED(Result) && SUCCEEDED(FirstError)) {
+            FirstError = Result;
+        }
+    }
+
+    std::vector<MulticastSubscription> Joined;
+    for (const MulticastSubscription& Subscription : ToJoin) {
+        if (auto Result = Join(Subscription); SUCCEEDED(Result)) {
+            Joined.push_back(Subscription);
+        } else {
+            Stats.FailedJoins++;
+            if (SUCCEEDED(FirstError)) {
+                FirstError = Result;
+            }
+        }
+    }
+
+    std::vector<MulticastSubscription> Next;
+    std::set_difference(Active.begin(), Active.end(), ToLeave.begin(), ToLeave.end(), std::back_inserter(Next));
+    Next.insert(Next.end(), Joined.begin(), Joined.end());
+    std::sort(Next.begin(), Next.end());
+    Active = std::move(Next);
+
+    if (Diff != nullptr) {
+        Diff->Joined = std::move(Joined);
+    }
+    return FirstError;
+}
+
+//
+// A membership that cannot be rejoined is gone, and is dropped from the
+// active set like a failed join.
+//
+HRESULT MulticastMembership::Refresh()
+{
+    HRESULT FirstError = S_OK;
+    std::erase_if(Active, [&](const MulticastSubscription& Subscription) {
+        GroupState* State = FindGroup(Subscription.Group);
+        UINT_PTR Socket = Sockets[State->SocketIndex].Socket;
+        SetMembership(Socket, Subscription, false);
+        HRESULT Result = SetMembership(Socket, Subscription, true);
+        if (SUCCEEDED(Result)) {
+            return false;
+        }
+        Stats.FailedJoins++;
+        if (SUCCEEDED(FirstError)) {
+            FirstError = Result;
+        }
+        State->Members--;
+        ReleaseIfUnused(State);
+        return true;
+    });
+    Stats.Refreshes++;
+    return FirstError;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <windows.h>
+
+#include <compare>
+#include <vector>
+
+//
+// A multicast group to receive, from any source or from one. Addresses are
+// in host byte order. Several subscriptions to one group with different
+// sources make a source-specific (IGMPv3) membership with all of them.
+//
+struct MulticastSubscription {
+    static constexpr UINT32 AnySource = 0;
+
+    UINT32 Group;
+    UINT32 Source;
+
+    //
+    // By group, then source; AnySource sorts first.
+    //
+    auto operator<=>(const MulticastSubscription&) const = default;
+};
+
+struct MulticastMembershipDiff {
+    std::vector<MulticastSubscription> Joined;
+    std::vector<MulticastSubscription> Left;
+};
+
+struct MulticastMembershipStats {
+    UINT64 Joins;
+    UINT64 Leaves;
+    UINT64 Refreshes;
+    UINT64 FailedJoins;
+    UINT32 Sockets;
+};
+
+//
+// Holds the IGMP memberships the XSK's traffic needs, on the one interface
+// the socket is bound to and nowhere else, so other NICs do not pull in
+// copies nobody redirects.
+//
+// Memberships belong to sockets that live as long as the manager: UDP
+// sockets bound to an ephemeral port, which never match the groups' traffic
+// and so never queue any of it. A socket holds up to GroupsPerSocket groups
+// (the usual stack limit), with all sources of a group on the same socket,
+// and more sockets are opened as groups are added.
+//
+// Apply() diffs the requested subscriptions against the active ones, leaves
+// first so that groups can switch between any-source and source-specific,
+// then joins the rest in one pass. A source-specific subscription to a group
+// also subscribed from any source is covered by it and dropped. Failed joins
+// are skipped and reported; Memberships() is what is actually joined.
+//
+class MulticastMembership {
+  public:
+    static constexpr UINT32 GroupsPerSocket = 20;
+
+    explicit MulticastMembership(UINT32 IfIndex);
+    ~MulticastMembership();
+
+    MulticastMembership(const MulticastMembership&) = delete;
+    MulticastMembership& operator=(const MulticastMembership&) = delete;
+
+    //
+    // Replaces the memberships. Returns the first error of the pass, having
+    // still tried every other join and leave.
+    //
+    HRESULT Apply(std::vector<MulticastSubscription> Subscriptions, _Out_opt_ MulticastMembershipDiff* Diff = nullptr);
+
+    //
+    // Leaves and rejoins every group, so the stack sends fresh reports; for
+    // after the link or the querier lost state.
+    //
+    HRESULT Refresh();
+
+    const std::vector<MulticastSubscription>& Memberships() const { return Active; }
+    const MulticastMembershipStats& Statistics() const { return Stats; }
+
+  private:
+    struct MembershipSocket {
+        UINT_PTR Socket;
+        UINT32 Groups;
+    };
+
+    struct GroupState {
+        UINT32 Group;
+        UINT32 SocketIndex;
+        UINT32 Members;
+    };
+
+    HRESULT Join(const MulticastSubscription& Subscription);
+    HRESULT Leave(const MulticastSubscription& Subscription);
+    void ReleaseIfUnused(_In_ GroupState* State);
+    HRESULT SetMembership(UINT_PTR Socket, const MulticastSubscription& Subscription, bool Join);
+    HRESULT SocketForGroup(UINT32 Group, _Out_ GroupState** State);
+    GroupState* FindGroup(UINT32 Group);
+
+    UINT32 IfIndex;
+    bool Started = false;
+    std::vector<MembershipSocket> Sockets;
+    std::vector<GroupState> Groups;
+    std::vector<MulticastSubscription> Active;
+    MulticastMembershipStats Stats {};
+};
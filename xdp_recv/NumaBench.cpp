@@ -0,0 +1,157 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "NumaPlacement.h"
+#include "TscClock.h"
+
+static constexpr UINT32 BenchChunkSize = 2048;
+
+struct NumaRunResult {
+    double MissNs;
+    double ReadGbps;
+    UINT32 PagesOnNode;
+    UINT32 PagesSampled;
+};
+
+//
+// Reads a UMEM allocated on MemoryNode from the calling thread: a chain of
+// dependent loads through the chunks in random order, the latency of each
+// frame's first cache-line miss, then a sequential sum of the whole UMEM.
+//
+static bool RunPlacement(
+    const TscClock& Clock,
+    SIZE_T UmemSize,
+    USHORT MemoryNode,
+    UINT32 Accesses,
+    _Out_ NumaRunResult* Result)
+{
+    UCHAR* Umem = (UCHAR*)AllocateOnNode(UmemSize, MemoryNode);
+    if (Umem == nullptr) {
+        return false;
+    }
+    CountPagesOnNode(Umem, UmemSize, MemoryNode, 4096, &Result->PagesOnNode, &Result->PagesSampled);
+
+    UINT32 Chunks = (UINT32)(UmemSize / BenchChunkSize);
+    std::vector<UINT32> Order(Chunks);
+    std::iota(Order.begin(), Order.end(), 0);
+    std::shuffle(Order.begin(), Order.end(), std::mt19937_64(40));
+    for (UINT32 i = 0; i < Chunks; i++) {
+        *(UINT64*)(Umem + (UINT64)Order[i] * BenchChunkSize) = (UINT64)Order[(i + 1) % Chunks] * BenchChunkSize;
+    }
+
+    UINT64 Offset = 0;
+    UINT64 Start = Clock.NowOrdered();
+    for (UINT32 i = 0; i < Accesses; i++) {
+        Offset = *(volatile UINT64*)(Umem + Offset);
+    }
+    Result->MissNs = (double)Clock.TicksToNs(Clock.NowOrdered() - Start) / Accesses;
+
+    const UINT64* Words = (const UINT64*)Umem;
+    UINT64 Sum = Offset;
+    Start = Clock.NowOrdered();
+    for (SIZE_T i = 0; i < UmemSize / sizeof(UINT64); i++) {
+        Sum += Words[i];
+    }
+    UINT64 Ns = Clock.TicksToNs(Clock.NowOrdered() - Start);
+    Result->ReadGbps = Ns != 0 ? UmemSize * 8.0 / Ns : 0.0;
+
+    //
+    // Keeps the sum, and with it the reads, from being optimized away.
+    //
+    if (Sum == 1) {
+        printf(" ");
+    }
+
+    VirtualFree(Umem, 0, MEM_RELEASE);
+    return true;
+}
+
+//
+// The cost of a UMEM on the wrong node: the receive path's memory access
+// pattern from a thread on each node against a UMEM on each node.
+//
+int NumaBenchmark(int argc, char** argv)
+{
+    UINT32 UmemMiB = argc >= 1 ? atoi(argv[0]) : 512;
+    UINT32 Accesses = argc >= 2 ? atoi(argv[1]) : 10000000;
+
+    if (UmemMiB == 0 || Accesses == 0) {
+        fprintf(stderr, "umem-mib and accesses must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    ULONG HighestNode;
+    if (!GetNumaHighestNodeNumber(&HighestNode)) {
+        fprintf(stderr, "GetNumaHighestNodeNumber failed: %lu\n", GetLastError());
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    SIZE_T UmemSize = (SIZE_T)UmemMiB * 1024 * 1024;
+    printf("%u MiB UMEM, %u dependent chunk reads, %lu NUMA node(s)\n\n", UmemMiB, Accesses, HighestNode + 1);
+    if (HighestNode == 0) {
+        printf("Only one node: every placement is local; run on a multi-socket machine to see remote costs.\n\n");
+    }
+    printf(
+        "%-8s %-8s %10s %10s %10s %10s %14s\n",
+        "thread",
+        "memory",
+        "miss ns",
+        "vs local",
+        "read Gbps",
+        "vs local",
+        "pages on node");
+
+    for (USHORT ThreadNode = 0; ThreadNode <= HighestNode; ThreadNode++) {
+        GROUP_AFFINITY Processors;
+        if (!GetNumaNodeProcessorMaskEx(ThreadNode, &Processors) || Processors.Mask == 0) {
+            continue;
+        }
+        if (FAILED(PinCurrentThread(NthProcessor(Processors, 0)))) {
+            fprintf(stderr, "cannot run on node %u\n", ThreadNode);
+            return EXIT_FAILURE;
+        }
+
+        //
+        // Local first, so the remote rows can be compared with it.
+        //
+        std::vector<USHORT> MemoryNodes {ThreadNode};
+        for (USHORT Node = 0; Node <= HighestNode; Node++) {
+            if (Node != ThreadNode) {
+                MemoryNodes.push_back(Node);
+            }
+        }
+
+        NumaRunResult Local {};
+        for (USHORT MemoryNode : MemoryNodes) {
+            NumaRunResult Result {};
+            if (!RunPlacement(Clock, UmemSize, MemoryNode, Accesses, &Result)) {
+                fprintf(stderr, "cannot allocate %u MiB on node %u\n", UmemMiB, MemoryNode);
+                continue;
+            }
+            if (MemoryNode == ThreadNode) {
+                Local = Result;
+            }
+
+            printf(
+                "%-8u %-8u %10.1f %9.2fx %10.1f %9.2fx %8u/%u\n",
+                ThreadNode,
+                MemoryNode,
+                Result.MissNs,
+                Local.MissNs != 0 ? Result.MissNs / Local.MissNs : 0.0,
+                Result.ReadGbps,
+                Local.ReadGbps != 0 ? Result.ReadGbps / Local.ReadGbps : 0.0,
+                Result.PagesOnNode,
+                Result.PagesSampled);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
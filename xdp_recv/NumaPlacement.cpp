@@ -0,0 +1,251 @@
+#include <winsock2.h>
+#include <ws2ipdef.h>
+#include <windows.h>
+#include <initguid.h>
+#include <iphlpapi.h>
+#include <setupapi.h>
+#include <devguid.h>
+#include <devpkey.h>
+#include <psapi.h>
+#include <stdlib.h>
+
+#include <bit>
+#include <memory>
+
+#include "NumaPlacement.h"
+
+#pragma comment(lib, "iphlpapi.lib")
+#pragma comment(lib, "setupapi.lib")
+#pragma comment(lib, "ole32.lib")
+
+HRESULT QueryInterfaceNumaNode(UINT32 IfIndex, _Out_ USHORT* Node)
+{
+    *Node = NumaNodeUnknown;
+
+    MIB_IF_ROW2 Row {};
+    Row.InterfaceIndex = IfIndex;
+    if (DWORD Error = GetIfEntry2(&Row); Error != NO_ERROR) {
+        return HRESULT_FROM_WIN32(Error);
+    }
+
+    WCHAR InterfaceGuid[40];
+    if (StringFromGUID2(Row.InterfaceGuid, InterfaceGuid, ARRAYSIZE(InterfaceGuid)) == 0) {
+        return E_UNEXPECTED;
+    }
+
+    //
+    // The interface GUID is the NetCfgInstanceId in the driver key of the
+    // network adapter's device node, which carries the NUMA node.
+    //
+    HDEVINFO Devices = SetupDiGetClassDevsW(&GUID_DEVCLASS_NET, nullptr, nullptr, DIGCF_PRESENT);
+    if (Devices == INVALID_HANDLE_VALUE) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    HRESULT Result = HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+    SP_DEVINFO_DATA Device {sizeof(Device)};
+    for (DWORD Index = 0; SetupDiEnumDeviceInfo(Devices, Index, &Device); Index++) {
+        HKEY Key = SetupDiOpenDevRegKey(Devices, &Device, DICS_FLAG_GLOBAL, 0, DIREG_DRV, KEY_READ);
+        if (Key == INVALID_HANDLE_VALUE) {
+            continue;
+        }
+
+        WCHAR InstanceId[40] {};
+        DWORD Size = sizeof(InstanceId) - sizeof(WCHAR);
+        LSTATUS Status = RegQueryValueExW(Key, L"NetCfgInstanceId", nullptr, nullptr, (BYTE*)InstanceId, &Size);
+        RegCloseKey(Key);
+        if (Status != ERROR_SUCCESS || _wcsicmp(InstanceId, InterfaceGuid) != 0) {
+            continue;
+        }
+
+        DEVPROPTYPE Type;
+        INT32 NumaNode;
+        if (SetupDiGetDevicePropertyW(
+                Devices, &Device, &DEVPKEY_Device_Numa_Node, &Type, (BYTE*)&NumaNode, sizeof(NumaNode), nullptr, 0) &&
+            Type == DEVPROP_TYPE_INT32 && NumaNode >= 0) {
+            *Node = (USHORT)NumaNode;
+        }
+        Result = S_OK;
+        break;
+    }
+
+    SetupDiDestroyDeviceInfoList(Devices);
+    return Result;
+}
+
+HRESULT ParseNumaOverride(_In_opt_z_ const char* Overrides, UINT32 Queue, _Out_ USHORT* Node)
+{
+    *Node = NumaNodeUnknown;
+    if (Overrides == nullptr) {
+        return S_OK;
+    }
+
+    const char* Next = Overrides;
+    while (*Next != '\0') {
+        char* End;
+        unsigned long EntryQueue = strtoul(Next, &End, 10);
+        if (End == Next || *End != '=') {
+            return E_INVALIDARG;
+        }
+
+        Next = End + 1;
+        unsigned long EntryNode = strtoul(Next, &End, 10);
+        if (End == Next || (*End != ',' && *End != '\0') || EntryNode >= NumaNodeUnknown) {
+            return E_INVALIDARG;
+        }
+
+        if (EntryQueue == Queue) {
+            *Node = (USHORT)EntryNode;
+        }
+        Next = *End == ',' ? End + 1 : End;
+    }
+    return S_OK;
+}
+
+HRESULT ResolveNumaPlacement(UINT32 IfIndex, USHORT OverrideNode, _Out_ NumaPlacement* Placement)
+{
+    *Placement = {};
+
+    //
+    // An interface the device query cannot map leaves the node unknown;
+    // placement falls back rather than failing.
+    //
+    QueryInterfaceNumaNode(IfIndex, &Placement->NicNode);
+
+    if (OverrideNode != NumaNodeUnknown) {
+        Placement->Node = OverrideNode;
+        Placement->Source = NumaNodeSource::Override;
+    } else if (Placement->NicNode != NumaNodeUnknown) {
+        Placement->Node = Placement->NicNode;
+        Placement->Source = NumaNodeSource::Device;
+    } else {
+        PROCESSOR_NUMBER Processor;
+        GetCurrentProcessorNumberEx(&Processor);
+        if (!GetNumaProcessorNodeEx(&Processor, &Placement->Node)) {
+            Placement->Node = 0;
+        }
+        Placement->Source = NumaNodeSource::StartingProcessor;
+    }
+
+    ULONG HighestNode;
+    if (!GetNumaHighestNodeNumber(&HighestNode) || Placement->Node > HighestNode) {
+        return E_INVALIDARG;
+    }
+    if (!GetNumaNodeProcessorMaskEx(Placement->Node, &Placement->Processors)) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    Placement->RxProcessor = NthProcessor(Placement->Processors, 0);
+    return S_OK;
+}
+
+GROUP_AFFINITY NthProcessor(const GROUP_AFFINITY& Set, UINT32 Index)
+{
+    UINT32 Count = ProcessorCount(Set);
+    if (Count == 0) {
+        return Set;
+    }
+
+    KAFFINITY Mask = Set.Mask;
+    for (Index %= Count; Index > 0; Index--) {
+        Mask &= Mask - 1;
+    }
+
+    GROUP_AFFINITY Processor = Set;
+    Processor.Mask = Mask & (~Mask + 1);
+    return Processor;
+}
+
+UINT32 ProcessorCount(const GROUP_AFFINITY& Set)
+{
+    return (UINT32)std::popcount((UINT64)Set.Mask);
+}
+
+HRESULT PinCurrentThread(const GROUP_AFFINITY& Affinity)
+{
+    if (Affinity.Mask == 0) {
+        return S_OK;
+    }
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, nullptr)) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+    return S_OK;
+}
+
+_Ret_maybenull_ VOID* AllocateOnNode(SIZE_T Size, USHORT Node)
+{
+    UCHAR* Memory;
+    if (Node == NumaNodeUnknown) {
+        Memory = (UCHAR*)VirtualAlloc(nullptr, Size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    } else {
+        Memory = (UCHAR*)VirtualAllocExNuma(
+            GetCurrentProcess(), nullptr, Size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE, Node);
+    }
+    if (Memory == nullptr) {
+        return nullptr;
+    }
+
+    SYSTEM_INFO System;
+    GetSystemInfo(&System);
+    for (SIZE_T Offset = 0; Offset < Size; Offset += System.dwPageSize) {
+        ((volatile UCHAR*)Memory)[Offset] = 0;
+    }
+    return Memory;
+}
+
+HRESULT CountPagesOnNode(
+    _In_ const VOID* Address,
+    SIZE_T Size,
+    USHORT Node,
+    UINT32 MaxSamples,
+    _Out_ UINT32* OnNode,
+    _Out_ UINT32* Sampled)
+{
+    *OnNode = 0;
+    *Sampled = 0;
+
+    SYSTEM_INFO System;
+    GetSystemInfo(&System);
+    SIZE_T Pages = (Size + System.dwPageSize - 1) / System.dwPageSize;
+    UINT32 Count = Pages < MaxSamples ? (UINT32)Pages : MaxSamples;
+    if (Count == 0) {
+        return S_OK;
+    }
+
+    auto Info = std::make_unique<PSAPI_WORKING_SET_EX_INFORMATION[]>(Count);
+    for (UINT32 i = 0; i < Count; i++) {
+        Info[i].VirtualAddress = (UCHAR*)Address + (Pages * i / Count) * System.dwPageSize;
+    }
+    if (!QueryWorkingSetEx(GetCurrentProcess(), Info.get(), Count * sizeof(Info[0]))) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    for (UINT32 i = 0; i < Count; i++) {
+        if (Info[i].VirtualAttributes.Valid) {
+            (*Sampled)++;
+            *OnNode += Info[i].VirtualAttributes.Node == Node;
+        }
+    }
+    return S_OK;
+}
+
+void PrintNumaPlacement(_In_ FILE* File, UINT32 IfIndex, UINT32 Queue, const NumaPlacement& Placement)
+{
+    static const char* const Sources[] = {"NIC", "override", "starting processor"};
+
+    if (Placement.NicNode != NumaNodeUnknown) {
+        fprintf(File, "NUMA: interface %u is on node %u", IfIndex, Placement.NicNode);
+    } else {
+        fprintf(File, "NUMA: interface %u reports no node", IfIndex);
+    }
+    fprintf(
+        File,
+        "; queue %u placed on node %u (%s), processors %u:%016llx, RX thread on %u:%u\n",
+        Queue,
+        Placement.Node,
+        Sources[(UINT32)Placement.Source],
+        Placement.Processors.Group,
+        (unsigned long long)Placement.Processors.Mask,
+        Placement.RxProcessor.Group,
+        (UINT32)std::countr_zero((UINT64)Placement.RxProcessor.Mask));
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <windows.h>
+#include <stdio.h>
+
+constexpr USHORT NumaNodeUnknown = MAXUSHORT;
+
+enum class NumaNodeSource {
+    //
+    // The node the NIC's driver reports for the device.
+    //
+    Device,
+
+    //
+    // A per-queue override from the command line.
+    //
+    Override,
+
+    //
+    // The NIC reports no node (single-node systems, some virtual NICs); the
+    // node of the processor the receiver started on.
+    //
+    StartingProcessor,
+};
+
+//
+// Where the receiver of one RX queue puts its memory and threads.
+//
+struct NumaPlacement {
+    USHORT NicNode;
+    USHORT Node;
+    NumaNodeSource Source;
+
+    //
+    // Every processor of Node, and the one of them the RX thread runs on.
+    //
+    GROUP_AFFINITY Processors;
+    GROUP_AFFINITY RxProcessor;
+};
+
+//
+// Returns the NUMA node of the NIC behind IfIndex, from the device's
+// DEVPKEY_Device_Numa_Node, or NumaNodeUnknown if the driver reports none.
+//
+HRESULT QueryInterfaceNumaNode(UINT32 IfIndex, _Out_ USHORT* Node);
+
+//
+// Looks Queue up in Overrides, a list like "0=1,3=0" mapping RX queues to
+// NUMA nodes. Returns NumaNodeUnknown if Overrides is null or does not name
+// Queue, and fails on a malformed list.
+//
+HRESULT ParseNumaOverride(_In_opt_z_ const char* Overrides, UINT32 Queue, _Out_ USHORT* Node);
+
+//
+// Picks the node for Queue of IfIndex: the override if there is one, else
+// the NIC's node, else the node of the calling thread's processor.
+//
+HRESULT ResolveNumaPlacement(UINT32 IfIndex, USHORT OverrideNode, _Out_ NumaPlacement* Placement);
+
+//
+// The Index-th processor of Set, wrapping around; an empty Set comes back
+// unchanged.
+//
+GROUP_AFFINITY NthProcessor(const GROUP_AFFINITY& Set, UINT32 Index);
+
+UINT32 ProcessorCount(const GROUP_AFFINITY& Set);
+
+//
+// Restricts the calling thread to Affinity. Does nothing for an empty mask.
+//
+HRESULT PinCurrentThread(const GROUP_AFFINITY& Affinity);
+
+//
+// Commits Size bytes with Node as the preferred node and touches every page,
+// so the memory is backed now, from that node, rather than by page faults in
+// the receive loop. NumaNodeUnknown allocates without a preference.
+//
+_Ret_maybenull_ VOID* AllocateOnNode(SIZE_T Size, USHORT Node);
+
+//
+// Counts the resident pages of [Address, Address + Size) on Node, checking
+// at most MaxSamples pages spread evenly over the range.
+//
+HRESULT CountPagesOnNode(
+    _In_ const VOID* Address,
+    SIZE_T Size,
+    USHORT Node,
+    UINT32 MaxSamples,
+    _Out_ UINT32* OnNode,
+    _Out_ UINT32* Sampled);
+
+void PrintNumaPlacement(_In_ FILE* File, UINT32 IfIndex, UINT32 Queue, const NumaPlacement& Placement);
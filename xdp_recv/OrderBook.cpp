@@ -0,0 +1,347 @@
+#include "OrderBook.h"
+
+#include "PacketHeaders.h"
+
+//
+// Levels looked at from the top before Find() switches to a binary search.
+//
+static constexpr UINT32 LinearLevels = 8;
+
+UINT32 OrderBookSide::Find(UINT32 Price) const
+{
+    UINT32 End = (UINT32)Levels.size();
+    UINT32 Stop = End > LinearLevels ? End - LinearLevels : 0;
+    UINT32 Index = End;
+    while (Index > Stop && Better(Levels[Index - 1].Price, Price)) {
+        Index--;
+    }
+    if (Index > Stop || Stop == 0) {
+        return Index;
+    }
+
+    //
+    // Everything in [Index, End) is better; search below it.
+    //
+    UINT32 Low = 0;
+    UINT32 High = Index;
+    while (Low < High) {
+        UINT32 Middle = (Low + High) / 2;
+        if (Better(Levels[Middle].Price, Price)) {
+            High = Middle;
+        } else {
+            Low = Middle + 1;
+        }
+    }
+    return Low;
+}
+
+void OrderBookSide::Add(UINT32 Price, UINT32 Shares)
+{
+    //
+    // Find() gives the first level better than Price; the one before it is
+    // Price's own if it exists.
+    //
+    UINT32 Index = Find(Price);
+    if (Index > 0 && Levels[Index - 1].Price == Price) {
+        Levels[Index - 1].Orders++;
+        Levels[Index - 1].Shares += Shares;
+        return;
+    }
+    Levels.insert(Levels.begin() + Index, Level {Price, 1, Shares});
+}
+
+void OrderBookSide::Reduce(UINT32 Price, UINT32 Shares, bool OrderGone)
+{
+    UINT32 Index = Find(Price);
+    if (Index == 0 || Levels[Index - 1].Price != Price) {
+        return;
+    }
+
+    Level& At = Levels[Index - 1];
+    At.Shares -= Shares < At.Shares ? Shares : At.Shares;
+    At.Orders -= OrderGone ? 1 : 0;
+    if (At.Orders == 0) {
+        Levels.erase(Levels.begin() + (Index - 1));
+    }
+}
+
+OrderBookBuilder::OrderBookBuilder(const OrderBookConfig& Config) : Config(Config)
+{
+    if (this->Config.MaxOrders == 0) {
+        this->Config.MaxOrders = 1;
+    }
+
+    UINT32 SlotCount = 2;
+    while (SlotCount < this->Config.MaxOrders * 2ull) {
+        SlotCount <<= 1;
+    }
+    SlotMask = SlotCount - 1;
+    Slots = std::make_unique<OrderSlot[]>(SlotCount);
+    for (UINT32 Slot = 0; Slot < SlotCount; Slot++) {
+        Slots[Slot].Node = None;
+    }
+
+    Nodes = std::make_unique<OrderNode[]>(this->Config.MaxOrders);
+    for (UINT32 Index = this->Config.MaxOrders; Index-- > 0;) {
+        Nodes[Index].Next = FreeNodes;
+        FreeNodes = Index;
+    }
+
+    Books.resize((size_t)this->Config.MaxLocate + 1);
+}
+
+UINT64 OrderBookBuilder::HashOf(UINT64 Reference)
+{
+    //
+    // References are mostly sequential; mix them so runs do not cluster.
+    //
+    UINT64 Hash = Reference * 0x9e3779b97f4a7c15ull;
+    return Hash ^ (Hash >> 29);
+}
+
+UINT32 OrderBookBuilder::FindSlot(UINT64 Reference) const
+{
+    for (UINT32 Slot = (UINT32)HashOf(Reference) & SlotMask;; Slot = (Slot + 1) & SlotMask) {
+        if (Slots[Slot].Node == None || Slots[Slot].Reference == Reference) {
+            return Slot;
+        }
+    }
+}
+
+//
+// Backward-shift deletion: every entry after the hole that would be found
+// from the hole's position moves into it, so probes never cross a gap.
+//
+void OrderBookBuilder::EraseSlot(UINT32 Slot)
+{
+    UINT32 Hole = Slot;
+    for (UINT32 Next = (Hole + 1) & SlotMask; Slots[Next].Node != None; Next = (Next + 1) & SlotMask) {
+        UINT32 Home = (UINT32)HashOf(Slots[Next].Reference) & SlotMask;
+        if (((Next - Home) & SlotMask) >= ((Next - Hole) & SlotMask)) {
+            Slots[Hole] = Slots[Next];
+            Hole = Next;
+        }
+    }
+    Slots[Hole].Node = None;
+}
+
+OrderBook* OrderBookBuilder::BookFor(UINT16 Locate)
+{
+    if (Locate > Config.MaxLocate) {
+        return nullptr;
+    }
+
+    std::unique_ptr<OrderBook>& Book = Books[Locate];
+    if (Book == nullptr) {
+        Book = std::make_unique<OrderBook>();
+        Book->Bids.Reserve(Config.LevelsPerSide);
+        Book->Asks.Reserve(Config.LevelsPerSide);
+        Book->Top.Locate = Locate;
+    }
+    return Book.get();
+}
+
+void OrderBookBuilder::Touch(_Inout_ OrderBook* Book, UINT64 Timestamp)
+{
+    if (!Book->Changed) {
+        Book->Changed = true;
+        ChangedBooks.push_back(Book->Top.Locate);
+    }
+    Book->Top.Timestamp = Timestamp;
+    Stats.Updates++;
+}
+
+void OrderBookBuilder::AddOrder(
+    UINT16 Locate,
+    UINT64 Reference,
+    bool Buy,
+    UINT32 Shares,
+    UINT32 Price,
+    UINT64 Timestamp)
+{
+    OrderBook* Book = BookFor(Locate);
+    UINT32 Slot = FindSlot(Reference);
+    if (Book == nullptr || FreeNodes == None || Slots[Slot].Node != None) {
+        Stats.RejectedOrders++;
+        return;
+    }
+
+    UINT32 Index = FreeNodes;
+    OrderNode& Node = Nodes[Index];
+    FreeNodes = Node.Next;
+    Node = {Reference, Price, Shares, Locate, Buy, None};
+    Slots[Slot] = {Reference, Index};
+    LiveOrders++;
+
+    (Buy ? Book->Bids : Book->Asks).Add(Price, Shares);
+    Touch(Book, Timestamp);
+}
+
+void OrderBookBuilder::ReduceOrder(UINT64 Reference, UINT32 Shares, bool Remove, UINT64 Timestamp)
+{
+    UINT32 Slot = FindSlot(Reference);
+    if (Slots[Slot].Node == None) {
+        Stats.UnknownOrders++;
+        return;
+    }
+
+    UINT32 Index = Slots[Slot].Node;
+    OrderNode& Node = Nodes[Index];
+    if (Remove || Shares >= Node.Shares) {
+        Shares = Node.Shares;
+        Remove = true;
+    }
+
+    OrderBook* Book = Books[Node.Locate].get();
+    (Node.Buy ? Book->Bids : Book->Asks).Reduce(Node.Price, Shares, Remove);
+    Node.Shares -= Shares;
+    Touch(Book, Timestamp);
+
+    if (Remove) {
+        EraseSlot(Slot);
+        Node.Next = FreeNodes;
+        FreeNodes = Index;
+        LiveOrders--;
+    }
+}
+
+void OrderBookBuilder::On(const Itch::AddOrder& Message)
+{
+    AddOrder(
+        Message.StockLocate(),
+        Message.OrderReference(),
+        Message.BuySell() == 'B',
+        Message.Shares(),
+        Message.Price(),
+        Message.Timestamp());
+}
+
+void OrderBookBuilder::On(const Itch::AddOrderMpid& Message)
+{
+    AddOrder(
+        Message.StockLocate(),
+        Message.OrderReference(),
+        Message.BuySell() == 'B',
+        Message.Shares(),
+        Message.Price(),
+        Message.Timestamp());
+}
+
+void OrderBookBuilder::On(const Itch::OrderExecuted& Message)
+{
+    ReduceOrder(Message.OrderReference(), Message.ExecutedShares(), false, Message.Timestamp());
+}
+
+//
+// An execution at a price other than the order's takes shares off the
+// resting order just like one at its price; the book does not track prints.
+//
+void OrderBookBuilder::On(const Itch::OrderExecutedWithPrice& Message)
+{
+    ReduceOrder(Message.OrderReference(), Message.ExecutedShares(), false, Message.Timestamp());
+}
+
+void OrderBookBuilder::On(const Itch::OrderCancel& Message)
+{
+    ReduceOrder(Message.OrderReference(), Message.CancelledShares(), false, Message.Timestamp());
+}
+
+void OrderBookBuilder::On(const Itch::OrderDelete& Message)
+{
+    ReduceOrder(Message.OrderReference(), 0, true, Message.Timestamp());
+}
+
+//
+// A replace keeps the side and instrument of the original order and gives
+// up its place in the queue.
+//
+void OrderBookBuilder::On(const Itch::OrderReplace& Message)
+{
+    UINT32 Slot = FindSlot(Message.OriginalOrderReference());
+    if (Slots[Slot].Node == None) {
+        Stats.UnknownOrders++;
+        return;
+    }
+
+    const OrderNode& Original = Nodes[Slots[Slot].Node];
+    UINT16 Locate = Original.Locate;
+    bool Buy = Original.Buy;
+    ReduceOrder(Message.OriginalOrderReference(), 0, true, Message.Timestamp());
+    AddOrder(Locate, Message.NewOrderReference(), Buy, Message.Shares(), Message.Price(), Message.Timestamp());
+
+    //
+    // Both halves counted an update.
+    //
+    Stats.Updates--;
+}
+
+void OrderBookBuilder::ApplyDatagram(_In_reads_bytes_(Length) const UCHAR* Payload, UINT32 Length)
+{
+    Stats.Datagrams++;
+    Stats.Messages += WireDecode<Itch::Schema>(Payload, Length, *this, &Decode);
+}
+
+void OrderBookBuilder::ApplyBurst(_In_reads_(Count) const ChainedFrame* Frames, UINT32 Count)
+{
+    Stats.Bursts++;
+    for (UINT32 i = 0; i < Count; i++) {
+        //
+        // A MoldUDP64 datagram always fits one buffer.
+        //
+        const FrameSegment& Head = Frames[i].Segment(0);
+        Ipv4Frame Parsed;
+        if (Frames[i].SegmentCount() != 1 || !ParseIpv4Frame(Head.Data, Head.Length, &Parsed) ||
+            Parsed.Udp == nullptr) {
+            continue;
+        }
+        if (Config.Port != 0 && Parsed.Udp->DestinationPort != HostToNet16(Config.Port)) {
+            continue;
+        }
+        ApplyDatagram(Parsed.L4 + sizeof(UdpHeader), Parsed.L4Length - sizeof(UdpHeader));
+    }
+    Publish();
+}
+
+void OrderBookBuilder::Publish()
+{
+    LastPublished.clear();
+    for (UINT16 Locate : ChangedBooks) {
+        OrderBook* Book = Books[Locate].get();
+        Book->Changed = false;
+
+        TopOfBook& Top = Book->Top;
+        const OrderBookSide::Level* Bid = Book->Bids.Best();
+        const OrderBookSide::Level* Ask = Book->Asks.Best();
+        UINT32 BidPrice = Bid != nullptr ? Bid->Price : 0;
+        UINT32 AskPrice = Ask != nullptr ? Ask->Price : 0;
+        UINT64 BidShares = Bid != nullptr ? Bid->Shares : 0;
+        UINT64 AskShares = Ask != nullptr ? Ask->Shares : 0;
+
+        //
+        // Changes below the top leave nothing to publish.
+        //
+        if (BidPrice == Top.BidPrice && AskPrice == Top.AskPrice && BidShares == Top.BidShares &&
+            AskShares == Top.AskShares) {
+            continue;
+        }
+        Top.BidPrice = BidPrice;
+        Top.AskPrice = AskPrice;
+        Top.BidShares = BidShares;
+        Top.AskShares = AskShares;
+        Top.Version++;
+        LastPublished.push_back(Top);
+    }
+    ChangedBooks.clear();
+    Stats.Published += LastPublished.size();
+}
+
+const OrderBook* OrderBookBuilder::Book(UINT16 Locate) const
+{
+    return Locate <= Config.MaxLocate ? Books[Locate].get() : nullptr;
+}
+
+const TopOfBook* OrderBookBuilder::Top(UINT16 Locate) const
+{
+    const OrderBook* Found = Book(Locate);
+    return Found != nullptr ? &Found->Top : nullptr;
+}
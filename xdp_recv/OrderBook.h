@@ -0,0 +1,240 @@
+#pragma once
+
+#include <windows.h>
+
+#include <memory>
+#include <vector>
+
+#include "ChainedFrame.h"
+#include "ItchMessages.h"
+
+//
+// Best bid and offer of one instrument as published after a burst. A side
+// without orders has price and shares zero.
+//
+struct TopOfBook {
+    UINT16 Locate;
+    UINT32 BidPrice;
+    UINT32 AskPrice;
+    UINT64 BidShares;
+    UINT64 AskShares;
+
+    //
+    // ITCH timestamp of the last message that changed the book.
+    //
+    UINT64 Timestamp;
+
+    //
+    // Counts the snapshots published for the instrument.
+    //
+    UINT64 Version;
+};
+
+struct OrderBookConfig {
+    //
+    // Orders that can rest at once over all instruments; the order table and
+    // its nodes are allocated up front.
+    //
+    UINT32 MaxOrders = 1 << 22;
+
+    //
+    // Stock locate codes are at most this; ITCH numbers them from 1.
+    //
+    UINT32 MaxLocate = 16384;
+
+    //
+    // Price levels reserved per side of a book when it sees its first order.
+    //
+    UINT32 LevelsPerSide = 64;
+
+    //
+    // Only datagrams to this UDP port are decoded; zero takes every port.
+    //
+    UINT16 Port = 0;
+};
+
+struct OrderBookStats {
+    UINT64 Bursts;
+    UINT64 Datagrams;
+    UINT64 Messages;
+
+    //
+    // Messages that changed a book: adds, executions, cancels, deletes and
+    // replaces.
+    //
+    UINT64 Updates;
+
+    //
+    // Messages about an order the builder does not know, e.g. one added
+    // before it joined the feed.
+    //
+    UINT64 UnknownOrders;
+
+    //
+    // Adds dropped because every order node was in use, or for a locate
+    // above MaxLocate.
+    //
+    UINT64 RejectedOrders;
+
+    UINT64 Published;
+};
+
+//
+// One side of a book: the price levels with resting orders, sorted so that
+// the best level is last. Almost all activity is within a few levels of the
+// top, so finding a level scans back from the end of one contiguous array,
+// and adding or removing a level there moves a handful of 16-byte entries.
+// Levels far from the top are found by binary search instead.
+//
+class OrderBookSide {
+  public:
+    struct Level {
+        UINT32 Price;
+        UINT32 Orders;
+        UINT64 Shares;
+    };
+
+    explicit OrderBookSide(bool Bids) : Bids(Bids) {}
+
+    void Reserve(UINT32 Levels) { this->Levels.reserve(Levels); }
+
+    void Add(UINT32 Price, UINT32 Shares);
+
+    //
+    // Takes Shares off the level at Price, and an order with them if
+    // OrderGone; the level goes with its last order.
+    //
+    void Reduce(UINT32 Price, UINT32 Shares, bool OrderGone);
+
+    const Level* Best() const { return Levels.empty() ? nullptr : &Levels.back(); }
+    UINT32 Depth() const { return (UINT32)Levels.size(); }
+
+  private:
+    //
+    // Whether a level at Left is better than one at Right for this side.
+    //
+    bool Better(UINT32 Left, UINT32 Right) const { return Bids ? Left > Right : Left < Right; }
+
+    //
+    // The index of the level at Price, or of where it would be inserted.
+    //
+    UINT32 Find(UINT32 Price) const;
+
+    bool Bids;
+    std::vector<Level> Levels;
+};
+
+struct OrderBook {
+    OrderBookSide Bids {true};
+    OrderBookSide Asks {false};
+    TopOfBook Top {};
+    bool Changed = false;
+};
+
+//
+// Builds a limit order book per instrument from ITCH add, execute, cancel,
+// delete and replace messages, and publishes each book's top after every
+// burst that changed it.
+//
+// Orders are found by reference in an open-addressing table of 64-bit
+// references and node indexes, kept at most half full and probed linearly,
+// with deletions shifting the rest of a run back instead of leaving
+// tombstones. Nodes come from a preallocated pool with a free list, so
+// nothing is allocated per message once books have their levels.
+//
+// ApplyBurst() decodes every datagram of an RX burst in place and applies
+// all of its messages before publishing: a book that changed several times
+// within the burst is published once, with the state after the last change.
+// Published() lists the snapshots of the last burst; Top() is the latest for
+// any instrument.
+//
+// Single-threaded: the RX thread makes every call.
+//
+class OrderBookBuilder {
+  public:
+    explicit OrderBookBuilder(const OrderBookConfig& Config);
+
+    OrderBookBuilder(const OrderBookBuilder&) = delete;
+    OrderBookBuilder& operator=(const OrderBookBuilder&) = delete;
+
+    //
+    // Applies the MoldUDP64 datagrams among Frames and publishes. Frames
+    // that are not UDP to the configured port are skipped.
+    //
+    void ApplyBurst(_In_reads_(Count) const ChainedFrame* Frames, UINT32 Count);
+
+    //
+    // Applies one MoldUDP64 payload without publishing; for feeds that do
+    // not come as frames. Publish() ends the batch.
+    //
+    void ApplyDatagram(_In_reads_bytes_(Length) const UCHAR* Payload, UINT32 Length);
+    void Publish();
+
+    const std::vector<TopOfBook>& Published() const { return LastPublished; }
+    const TopOfBook* Top(UINT16 Locate) const;
+    const OrderBook* Book(UINT16 Locate) const;
+
+    UINT32 Orders() const { return LiveOrders; }
+    const OrderBookStats& Statistics() const { return Stats; }
+    const WireDecodeStats& DecodeStatistics() const { return Decode; }
+
+    //
+    // Called by WireDecode() for each message.
+    //
+    void On(const Itch::AddOrder& Message);
+    void On(const Itch::AddOrderMpid& Message);
+    void On(const Itch::OrderExecuted& Message);
+    void On(const Itch::OrderExecutedWithPrice& Message);
+    void On(const Itch::OrderCancel& Message);
+    void On(const Itch::OrderDelete& Message);
+    void On(const Itch::OrderReplace& Message);
+
+  private:
+    static constexpr UINT32 None = MAXUINT32;
+
+    struct OrderNode {
+        UINT64 Reference;
+        UINT32 Price;
+        UINT32 Shares;
+        UINT16 Locate;
+        bool Buy;
+
+        //
+        // The next free node while free.
+        //
+        UINT32 Next;
+    };
+
+    struct OrderSlot {
+        UINT64 Reference;
+        UINT32 Node;
+    };
+
+    static UINT64 HashOf(UINT64 Reference);
+
+    OrderBook* BookFor(UINT16 Locate);
+    void AddOrder(UINT16 Locate, UINT64 Reference, bool Buy, UINT32 Shares, UINT32 Price, UINT64 Timestamp);
+
+    //
+    // Takes Shares off the order, and removes it with its last share.
+    //
+    void ReduceOrder(UINT64 Reference, UINT32 Shares, bool Remove, UINT64 Timestamp);
+
+    UINT32 FindSlot(UINT64 Reference) const;
+    void EraseSlot(UINT32 Slot);
+    void Touch(_Inout_ OrderBook* Book, UINT64 Timestamp);
+
+    OrderBookConfig Config;
+    std::vector<std::unique_ptr<OrderBook>> Books;
+    std::vector<UINT16> ChangedBooks;
+    std::vector<TopOfBook> LastPublished;
+
+    std::unique_ptr<OrderSlot[]> Slots;
+    UINT32 SlotMask;
+    std::unique_ptr<OrderNode[]> Nodes;
+    UINT32 FreeNodes = None;
+    UINT32 LiveOrders = 0;
+
+    OrderBookStats Stats {};
+    WireDecodeStats Decode {};
+};
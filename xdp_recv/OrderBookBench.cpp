@@ -0,0 +1,215 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "ChainedFrame.h"
+#include "ItchFeed.h"
+#include "LatencyHistogram.h"
+#include "OrderBook.h"
+#include "PcapReader.h"
+#include "TscClock.h"
+
+static constexpr UINT32 BenchBurst = 32;
+static constexpr UINT32 BenchPasses = 3;
+static constexpr UINT32 CaptureChunkSize = 2048;
+
+//
+// The feed in the UMEM, one datagram per chunk.
+//
+struct ReplayFeed {
+    std::unique_ptr<UCHAR[]> Umem;
+    UINT32 ChunkSize;
+    std::vector<UINT32> Lengths;
+};
+
+static bool LoadCapture(_In_z_ const char* Path, _Out_ ReplayFeed* Feed)
+{
+    PcapReader Reader;
+    if (HRESULT Result = Reader.Open(Path); FAILED(Result)) {
+        fprintf(stderr, "cannot read %s: %x\n", Path, Result);
+        return false;
+    }
+
+    std::vector<UCHAR> Frames;
+    const UCHAR* Frame;
+    UINT32 Length;
+    Feed->ChunkSize = CaptureChunkSize;
+    while (Reader.Next(&Frame, &Length)) {
+        if (Length <= CaptureChunkSize) {
+            Frames.resize(Frames.size() + CaptureChunkSize);
+            memcpy(Frames.data() + Frames.size() - CaptureChunkSize, Frame, Length);
+            Feed->Lengths.push_back(Length);
+        }
+    }
+
+    Feed->Umem = std::make_unique<UCHAR[]>(Frames.size());
+    memcpy(Feed->Umem.get(), Frames.data(), Frames.size());
+    return true;
+}
+
+static void Synthesize(
+    UINT32 Datagrams,
+    UINT32 PerDatagram,
+    UINT32 Instruments,
+    _Out_ ReplayFeed* Feed,
+    _Out_ UINT32* LiveOrders)
+{
+    ItchFeedConfig Config;
+    Config.Instruments = Instruments;
+    Config.Seed = 48;
+    ItchFeed Generator(Config);
+
+    Feed->ChunkSize = std::bit_ceil(ItchFeed::FrameRoom(PerDatagram));
+    Feed->Umem = std::make_unique<UCHAR[]>((UINT64)Datagrams * Feed->ChunkSize);
+    Feed->Lengths.resize(Datagrams);
+    for (UINT32 i = 0; i < Datagrams; i++) {
+        Feed->Lengths[i] = Generator.NextDatagram(Feed->Umem.get() + (UINT64)i * Feed->ChunkSize, PerDatagram);
+    }
+    *LiveOrders = Generator.LiveOrders();
+}
+
+struct BookRunResult {
+    double Seconds;
+    UINT64 Messages;
+    UINT64 Updates;
+    UINT64 Published;
+    UINT32 LiveOrders;
+    UINT64 UnknownOrders;
+    UINT64 RejectedOrders;
+    LatencyHistogram<> UpdateNs;
+};
+
+//
+// Replays the whole feed into a new builder a burst at a time. With
+// Latency, every update is charged the time from its burst reaching the
+// builder to the burst's snapshots being published.
+//
+static void RunBuilder(
+    const TscClock& Clock,
+    const ReplayFeed& Feed,
+    const OrderBookConfig& Config,
+    bool Latency,
+    _Out_ BookRunResult* Run)
+{
+    OrderBookBuilder Builder(Config);
+    auto Frames = std::make_unique<ChainedFrame[]>(BenchBurst);
+    UINT32 Count = (UINT32)Feed.Lengths.size();
+    Run->UpdateNs.Reset();
+
+    UINT64 Start = Clock.NowOrdered();
+    for (UINT32 Next = 0; Next < Count; Next += BenchBurst) {
+        UINT32 Burst = std::min(BenchBurst, Count - Next);
+        for (UINT32 i = 0; i < Burst; i++) {
+            UINT64 Address = (UINT64)(Next + i) * Feed.ChunkSize;
+            Frames[i].Reset();
+            Frames[i].Append(Address, Feed.Umem.get() + Address, Feed.Lengths[Next + i]);
+        }
+
+        if (!Latency) {
+            Builder.ApplyBurst(Frames.get(), Burst);
+            continue;
+        }
+
+        UINT64 Updates = Builder.Statistics().Updates;
+        UINT64 Before = Clock.NowOrdered();
+        Builder.ApplyBurst(Frames.get(), Burst);
+        UINT64 Ns = Clock.TicksToNs(Clock.NowOrdered() - Before);
+        for (Updates = Builder.Statistics().Updates - Updates; Updates != 0; Updates--) {
+            Run->UpdateNs.Record(Ns);
+        }
+    }
+    Run->Seconds = Clock.TicksToNs(Clock.NowOrdered() - Start) / 1e9;
+
+    const OrderBookStats& Stats = Builder.Statistics();
+    Run->Messages = Stats.Messages;
+    Run->Updates = Stats.Updates;
+    Run->Published = Stats.Published;
+    Run->LiveOrders = Builder.Orders();
+    Run->UnknownOrders = Stats.UnknownOrders;
+    Run->RejectedOrders = Stats.RejectedOrders;
+}
+
+//
+// Order book updates/s and update latency replaying an ITCH feed through
+// the builder in RX bursts, from a capture of MoldUDP64 datagrams or from a
+// synthesized session.
+//
+int OrderBookBenchmark(int argc, char** argv)
+{
+    const char* Capture = argc >= 1 && strcmp(argv[0], "-") != 0 ? argv[0] : nullptr;
+    UINT32 Datagrams = argc >= 2 ? atoi(argv[1]) : 200000;
+    UINT32 Instruments = argc >= 3 ? atoi(argv[2]) : 1000;
+    UINT32 PerDatagram = argc >= 4 ? atoi(argv[3]) : 8;
+
+    if (Datagrams == 0 || Instruments == 0 || Instruments > 65535 || PerDatagram == 0 ||
+        ItchFeed::FrameRoom(PerDatagram) > 1514) {
+        fprintf(stderr, "book [capture.pcap|-] [datagrams] [instruments] [messages-per-datagram]\n");
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    ReplayFeed Feed;
+    UINT32 ExpectedOrders = 0;
+    OrderBookConfig Config;
+    if (Capture != nullptr) {
+        if (!LoadCapture(Capture, &Feed)) {
+            return EXIT_FAILURE;
+        }
+        Config.MaxLocate = 65535;
+        printf("%zu frames from %s", Feed.Lengths.size(), Capture);
+    } else {
+        Synthesize(Datagrams, PerDatagram, Instruments, &Feed, &ExpectedOrders);
+        Config.MaxLocate = Instruments;
+        Config.MaxOrders = std::max(65536u, ExpectedOrders * 2);
+        printf(
+            "%u synthesized datagrams of %u messages over %u instruments, %u orders resting at the end",
+            Datagrams,
+            PerDatagram,
+            Instruments,
+            ExpectedOrders);
+    }
+    printf(", bursts of %u, best of %u\n\n", BenchBurst, BenchPasses);
+
+    auto Run = std::make_unique<BookRunResult>();
+    double Best = 1e30;
+    for (UINT32 Pass = 0; Pass < BenchPasses; Pass++) {
+        RunBuilder(Clock, Feed, Config, false, Run.get());
+        Best = std::min(Best, Run->Seconds);
+    }
+
+    if (Capture == nullptr &&
+        (Run->LiveOrders != ExpectedOrders || Run->UnknownOrders != 0 || Run->RejectedOrders != 0)) {
+        fprintf(
+            stderr,
+            "book out of step with the feed: %u of %u orders, %llu unknown, %llu rejected\n",
+            Run->LiveOrders,
+            ExpectedOrders,
+            (unsigned long long)Run->UnknownOrders,
+            (unsigned long long)Run->RejectedOrders);
+        return EXIT_FAILURE;
+    }
+
+    printf(
+        "%llu messages, %llu book updates, %llu top-of-book snapshots (%.2f per burst), %llu unknown orders\n",
+        (unsigned long long)Run->Messages,
+        (unsigned long long)Run->Updates,
+        (unsigned long long)Run->Published,
+        (double)Run->Published * BenchBurst / std::max<size_t>(Feed.Lengths.size(), 1),
+        (unsigned long long)Run->UnknownOrders);
+    printf(
+        "%.2f M updates/s, %.2f M messages/s, %.1f ns/update\n\n",
+        Run->Updates / Best / 1e6,
+        Run->Messages / Best / 1e6,
+        Run->Updates != 0 ? Best * 1e9 / Run->Updates : 0.0);
+
+    RunBuilder(Clock, Feed, Config, true, Run.get());
+    PrintLatencySummary(stdout, "update to publish", Run->UpdateNs);
+    return EXIT_SUCCESS;
+}
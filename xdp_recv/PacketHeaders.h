@@ -0,0 +1,195 @@
+#pragma once
+
+#include <windows.h>
+
+#include <string.h>
+
+//
+// Wire formats of the headers the receive path looks at. Multi-byte fields
+// are in network byte order; addresses and ports stay that way because
+// XDP_RULE patterns use network order too.
+//
+#pragma pack(push, 1)
+
+struct EthernetHeader {
+    UINT8 Destination[6];
+    UINT8 Source[6];
+    UINT16 EtherType;
+};
+
+struct Ipv4Header {
+    UINT8 VersionAndHeaderLength;
+    UINT8 TypeOfService;
+    UINT16 TotalLength;
+    UINT16 Identification;
+    UINT16 FlagsAndFragmentOffset;
+    UINT8 TimeToLive;
+    UINT8 Protocol;
+    UINT16 HeaderChecksum;
+    UINT32 SourceAddress;
+    UINT32 DestinationAddress;
+};
+
+struct Ipv6Header {
+    UINT32 VersionClassAndFlowLabel;
+    UINT16 PayloadLength;
+    UINT8 NextHeader;
+    UINT8 HopLimit;
+    UINT8 SourceAddress[16];
+    UINT8 DestinationAddress[16];
+};
+
+struct UdpHeader {
+    UINT16 SourcePort;
+    UINT16 DestinationPort;
+    UINT16 Length;
+    UINT16 Checksum;
+};
+
+#pragma pack(pop)
+
+C_ASSERT(sizeof(EthernetHeader) == 14);
+C_ASSERT(sizeof(Ipv4Header) == 20);
+C_ASSERT(sizeof(Ipv6Header) == 40);
+C_ASSERT(sizeof(UdpHeader) == 8);
+
+constexpr UINT16 EtherTypeIpv4 = 0x0800;
+constexpr UINT16 EtherTypeIpv6 = 0x86dd;
+constexpr UINT16 EtherTypeVlan = 0x8100;
+constexpr UINT32 VlanTagLength = 4;
+constexpr UINT8 IpProtocolTcp = 6;
+constexpr UINT8 IpProtocolUdp = 17;
+
+constexpr UINT16 Ipv4MoreFragments = 0x2000;
+constexpr UINT16 Ipv4FragmentOffsetMask = 0x1fff;
+
+constexpr UINT16 NetToHost16(UINT16 Value)
+{
+    return (UINT16)((Value >> 8) | (Value << 8));
+}
+
+constexpr UINT32 NetToHost32(UINT32 Value)
+{
+    return ((Value & 0xff) << 24) | ((Value & 0xff00) << 8) | ((Value >> 8) & 0xff00) | (Value >> 24);
+}
+
+constexpr UINT16 HostToNet16(UINT16 Value)
+{
+    return NetToHost16(Value);
+}
+
+constexpr UINT32 HostToNet32(UINT32 Value)
+{
+    return NetToHost32(Value);
+}
+
+//
+// Header pointers into a received IPv4 frame. Udp is null for non-UDP
+// packets and for every fragment except the first.
+//
+struct Ipv4Frame {
+    const Ipv4Header* Ip;
+    const UdpHeader* Udp;
+    const UCHAR* L4;
+    UINT32 L4Length;
+};
+
+inline bool Ipv4IsFragment(const Ipv4Header* Ip)
+{
+    return (NetToHost16(Ip->FlagsAndFragmentOffset) & (Ipv4MoreFragments | Ipv4FragmentOffsetMask)) != 0;
+}
+
+//
+// Locates the IPv4 and UDP headers of an untagged Ethernet frame. Returns
+// false if the frame is not IPv4 or is truncated.
+//
+inline bool ParseIpv4Frame(_In_ const UCHAR* Frame, UINT32 Length, _Out_ Ipv4Frame* Parsed)
+{
+    if (Length < sizeof(EthernetHeader) + sizeof(Ipv4Header)) {
+        return false;
+    }
+
+    UINT16 EtherType;
+    memcpy(&EtherType, Frame + FIELD_OFFSET(EthernetHeader, EtherType), sizeof(EtherType));
+    if (EtherType != HostToNet16(EtherTypeIpv4)) {
+        return false;
+    }
+
+    const Ipv4Header* Ip = (const Ipv4Header*)(Frame + sizeof(EthernetHeader));
+    UINT32 HeaderLength = (Ip->VersionAndHeaderLength & 0xf) * 4;
+    if ((Ip->VersionAndHeaderLength >> 4) != 4 || HeaderLength < sizeof(Ipv4Header) ||
+        Length < sizeof(EthernetHeader) + HeaderLength) {
+        return false;
+    }
+
+    UINT32 IpLength = NetToHost16(Ip->TotalLength);
+    UINT32 Available = Length - sizeof(EthernetHeader);
+    if (IpLength < HeaderLength || IpLength > Available) {
+        IpLength = Available;
+    }
+
+    Parsed->Ip = Ip;
+    Parsed->L4 = (const UCHAR*)Ip + HeaderLength;
+    Parsed->L4Length = IpLength - HeaderLength;
+    Parsed->Udp = nullptr;
+
+    bool FirstFragment = (NetToHost16(Ip->FlagsAndFragmentOffset) & Ipv4FragmentOffsetMask) == 0;
+    if (Ip->Protocol == IpProtocolUdp && FirstFragment && Parsed->L4Length >= sizeof(UdpHeader)) {
+        Parsed->Udp = (const UdpHeader*)Parsed->L4;
+    }
+
+    return true;
+}
+
+//
+// Writes untagged Ethernet, IPv4 and UDP headers for a datagram of
+// PayloadLength bytes at Frame; the payload follows them. Addresses and
+// ports are in host byte order. MAC addresses and checksums are left zero.
+//
+inline void WriteUdpHeaders(
+    _Out_writes_bytes_(sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader)) UCHAR* Frame,
+    UINT32 PayloadLength,
+    UINT32 SourceAddress,
+    UINT16 SourcePort,
+    UINT32 DestinationAddress,
+    UINT16 DestinationPort)
+{
+    memset(Frame, 0, sizeof(EthernetHeader) + sizeof(Ipv4Header));
+
+    EthernetHeader* Ethernet = (EthernetHeader*)Frame;
+    Ethernet->EtherType = HostToNet16(EtherTypeIpv4);
+
+    Ipv4Header* Ip = (Ipv4Header*)(Ethernet + 1);
+    Ip->VersionAndHeaderLength = 0x45;
+    Ip->TotalLength = HostToNet16((UINT16)(sizeof(Ipv4Header) + sizeof(UdpHeader) + PayloadLength));
+    Ip->TimeToLive = 64;
+    Ip->Protocol = IpProtocolUdp;
+    Ip->SourceAddress = HostToNet32(SourceAddress);
+    Ip->DestinationAddress = HostToNet32(DestinationAddress);
+
+    UdpHeader* Udp = (UdpHeader*)(Ip + 1);
+    Udp->SourcePort = HostToNet16(SourcePort);
+    Udp->DestinationPort = HostToNet16(DestinationPort);
+    Udp->Length = HostToNet16((UINT16)(sizeof(UdpHeader) + PayloadLength));
+    Udp->Checksum = 0;
+}
+
+//
+// Writes an untagged Ethernet/IPv4/UDP frame of FrameLength bytes with a
+// zeroed payload. Addresses and ports are in host byte order. Used to
+// generate benchmark traffic; checksums are left zero.
+//
+inline void BuildUdpFrame(
+    _Out_writes_bytes_(FrameLength) UCHAR* Frame,
+    UINT32 FrameLength,
+    UINT32 SourceAddress,
+    UINT16 SourcePort,
+    UINT32 DestinationAddress,
+    UINT16 DestinationPort)
+{
+    constexpr UINT32 HeaderLength = sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader);
+
+    memset(Frame + HeaderLength, 0, FrameLength - HeaderLength);
+    WriteUdpHeaders(
+        Frame, FrameLength - HeaderLength, SourceAddress, SourcePort, DestinationAddress, DestinationPort);
+}
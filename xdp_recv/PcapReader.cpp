@@ -0,0 +1,87 @@
+#include "PcapReader.h"
+
+#include <string.h>
+
+static constexpr UINT32 PcapMagicMicroseconds = 0xa1b2c3d4;
+static constexpr UINT32 PcapMagicNanoseconds = 0xa1b23c4d;
+static constexpr UINT32 PcapFileHeaderLength = 24;
+static constexpr UINT32 PcapRecordHeaderLength = 16;
+static constexpr UINT32 PcapMaxSnapLength = 256 * 1024;
+
+static UINT32 ByteSwap32(UINT32 Value)
+{
+    return ((Value & 0xff) << 24) | ((Value & 0xff00) << 8) | ((Value >> 8) & 0xff00) | (Value >> 24);
+}
+
+PcapReader::~PcapReader()
+{
+    if (File != nullptr) {
+        fclose(File);
+    }
+}
+
+UINT32 PcapReader::Read32(const UCHAR* Bytes) const
+{
+    UINT32 Value;
+    memcpy(&Value, Bytes, sizeof(Value));
+    return Swapped ? ByteSwap32(Value) : Value;
+}
+
+HRESULT PcapReader::Open(_In_z_ const char* Path)
+{
+    File = fopen(Path, "rb");
+    if (File == nullptr) {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    UCHAR Header[PcapFileHeaderLength];
+    if (fread(Header, 1, sizeof(Header), File) != sizeof(Header)) {
+        return E_FAIL;
+    }
+
+    UINT32 Magic;
+    memcpy(&Magic, Header, sizeof(Magic));
+    if (Magic == ByteSwap32(PcapMagicMicroseconds) || Magic == ByteSwap32(PcapMagicNanoseconds)) {
+        Swapped = true;
+        Magic = ByteSwap32(Magic);
+    }
+    if (Magic != PcapMagicMicroseconds && Magic != PcapMagicNanoseconds) {
+        return E_FAIL;
+    }
+    Nanoseconds = Magic == PcapMagicNanoseconds;
+
+    SnapLength = Read32(Header + 16);
+    if (SnapLength == 0 || SnapLength > PcapMaxSnapLength) {
+        SnapLength = PcapMaxSnapLength;
+    }
+    if ((Read32(Header + 20) & 0xffff) != LinkTypeEthernet) {
+        return E_NOTIMPL;
+    }
+
+    Buffer = std::make_unique<UCHAR[]>(SnapLength);
+    return S_OK;
+}
+
+bool PcapReader::Next(_Out_ const UCHAR** Frame, _Out_ UINT32* Length, _Out_opt_ UINT64* TimestampNs)
+{
+    UCHAR Header[PcapRecordHeaderLength];
+
+    *Frame = nullptr;
+    *Length = 0;
+    if (File == nullptr || fread(Header, 1, sizeof(Header), File) != sizeof(Header)) {
+        return false;
+    }
+
+    UINT32 Captured = Read32(Header + 8);
+    if (Captured > SnapLength || fread(Buffer.get(), 1, Captured, File) != Captured) {
+        return false;
+    }
+
+    if (TimestampNs != nullptr) {
+        UINT64 Fraction = Read32(Header + 4);
+        *TimestampNs = Read32(Header) * 1000000000ull + (Nanoseconds ? Fraction : Fraction * 1000);
+    }
+    *Frame = Buffer.get();
+    *Length = Captured;
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <windows.h>
+#include <stdio.h>
+
+#include <memory>
+
+//
+// Sequential reader for classic libpcap capture files with Ethernet link
+// type, microsecond or nanosecond timestamps, in either byte order.
+//
+class PcapReader {
+  public:
+    static constexpr UINT32 LinkTypeEthernet = 1;
+
+    PcapReader() = default;
+    ~PcapReader();
+
+    PcapReader(const PcapReader&) = delete;
+    PcapReader& operator=(const PcapReader&) = delete;
+
+    //
+    // Fails if the file is missing, not a pcap file or not Ethernet.
+    //
+    HRESULT Open(_In_z_ const char* Path);
+
+    //
+    // Returns false at the end of the file. Frame stays valid until the next
+    // call. Length is the captured length, which may be shorter than the
+    // frame was on the wire.
+    //
+    bool Next(_Out_ const UCHAR** Frame, _Out_ UINT32* Length, _Out_opt_ UINT64* TimestampNs = nullptr);
+
+  private:
+    UINT32 Read32(const UCHAR* Bytes) const;
+
+    FILE* File = nullptr;
+    bool Swapped = false;
+    bool Nanoseconds = false;
+    UINT32 SnapLength = 0;
+    std::unique_ptr<UCHAR[]> Buffer;
+};
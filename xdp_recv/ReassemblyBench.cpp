@@ -0,0 +1,309 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Ipv4Reassembler.h"
+#include "PacketHeaders.h"
+#include "TscClock.h"
+#include "UmemFramePool.h"
+
+static constexpr UINT32 BenchChunkSize = 2048;
+static constexpr UINT32 BenchChunks = 16384;
+static constexpr UINT32 BenchMtu = 1500;
+static constexpr UINT32 FragmentPayload = (BenchMtu - sizeof(Ipv4Header)) & ~7u;
+static constexpr UINT32 HeaderBytes = sizeof(EthernetHeader) + sizeof(Ipv4Header);
+
+//
+// Simulated arrival interval, in ns of virtual time per frame.
+//
+static constexpr UINT64 FrameIntervalNs = 1000;
+
+struct FragmentSpec {
+    UINT16 Identification;
+    UINT32 Offset;
+    UINT32 Length;
+    bool MoreFragments;
+};
+
+static UINT32 BuildFragment(
+    _Out_writes_bytes_(BenchChunkSize) UCHAR* Frame,
+    UINT32 SourceAddress,
+    const FragmentSpec& Spec,
+    _In_reads_bytes_(Spec.Offset + Spec.Length) const UCHAR* Datagram)
+{
+    UINT32 Length = HeaderBytes + Spec.Length;
+    memset(Frame, 0, HeaderBytes);
+
+    EthernetHeader* Ethernet = (EthernetHeader*)Frame;
+    Ethernet->EtherType = HostToNet16(EtherTypeIpv4);
+
+    Ipv4Header* Ip = (Ipv4Header*)(Ethernet + 1);
+    Ip->VersionAndHeaderLength = 0x45;
+    Ip->TotalLength = HostToNet16((UINT16)(sizeof(Ipv4Header) + Spec.Length));
+    Ip->Identification = HostToNet16(Spec.Identification);
+    Ip->FlagsAndFragmentOffset =
+        HostToNet16((UINT16)((Spec.MoreFragments ? Ipv4MoreFragments : 0) | (Spec.Offset / 8)));
+    Ip->TimeToLive = 64;
+    Ip->Protocol = IpProtocolUdp;
+    Ip->SourceAddress = HostToNet32(SourceAddress);
+    Ip->DestinationAddress = HostToNet32(0xef000001);
+
+    memcpy(Frame + HeaderBytes, Datagram + Spec.Offset, Spec.Length);
+    return Length;
+}
+
+//
+// Feeds hand-made fragment sequences through a fresh reassembler and checks
+// each attack is rejected without completing a datagram.
+//
+static bool CheckAttacks()
+{
+    struct Case {
+        const char* Name;
+        std::vector<FragmentSpec> Fragments;
+        ReassemblyResult LastResult;
+    };
+    const Case Cases[] = {
+        {"in order", {{1, 0, 1480, true}, {1, 1480, 520, false}}, ReassemblyResult::Complete},
+        {"reversed", {{2, 1480, 520, false}, {2, 0, 1480, true}}, ReassemblyResult::Complete},
+        {"duplicate", {{3, 0, 1480, true}, {3, 0, 1480, true}}, ReassemblyResult::Dropped},
+        {"teardrop", {{4, 0, 1480, true}, {4, 1472, 24, false}}, ReassemblyResult::Dropped},
+        {"overlap", {{5, 1480, 520, false}, {5, 0, 1488, true}}, ReassemblyResult::Dropped},
+        {"ping of death", {{6, 65528, 16, false}}, ReassemblyResult::Dropped},
+        {"tiny first", {{7, 0, 0, true}}, ReassemblyResult::Dropped},
+        {"misaligned", {{8, 0, 1001, true}}, ReassemblyResult::Dropped},
+        {"two ends", {{9, 1480, 520, false}, {9, 1480, 528, false}}, ReassemblyResult::Dropped},
+    };
+
+    static UCHAR Datagram[65536 + 64];
+    auto Umem = std::make_unique<UCHAR[]>((size_t)8 * BenchChunkSize);
+    bool Passed = true;
+
+    for (const Case& Test : Cases) {
+        UmemFramePool Pool(8);
+        Pool.AddRegion(0, 8, BenchChunkSize);
+        Ipv4ReassemblerConfig Config;
+        Config.TimeoutTicks = 1000;
+        Ipv4Reassembler Reassembler(Config, &Pool);
+
+        ReassemblyResult Result = ReassemblyResult::NotFragment;
+        ReassembledDatagram Completed;
+        for (const FragmentSpec& Spec : Test.Fragments) {
+            UINT64 Address;
+            Pool.Allocate(&Address);
+            UINT32 Length = BuildFragment(&Umem[Address], 0x0a000001, Spec, Datagram);
+            Result = Reassembler.Submit(&Umem[Address], Address, 0, Length, 0, &Completed);
+        }
+        if (Result == ReassemblyResult::Complete) {
+            Reassembler.Release(Completed);
+        }
+        Reassembler.Expire(MAXUINT64 / 2);
+
+        if (Result != Test.LastResult || Pool.Available() != 8) {
+            fprintf(stderr, "reassembly check failed: %s\n", Test.Name);
+            Passed = false;
+        }
+    }
+    return Passed;
+}
+
+struct ReassemblyRunResult {
+    double MFragmentsPerSecond;
+    UINT64 Expected;
+    UINT64 Completed;
+    UINT64 Corrupt;
+    Ipv4ReassemblerStats Stats;
+};
+
+//
+// Sources interleave their datagrams, fragments of a datagram may arrive in
+// any order, and each fragment is lost with probability Loss. Time is
+// virtual: one frame every FrameIntervalNs.
+//
+static ReassemblyRunResult RunReassembly(
+    const TscClock& Clock,
+    UINT32 Datagrams,
+    UINT32 DatagramBytes,
+    double Loss,
+    UINT32 Slots,
+    UINT64 TimeoutNs,
+    bool Copy)
+{
+    constexpr UINT32 Sources = 8;
+    std::mt19937 Random(5);
+    std::bernoulli_distribution Lost(Loss);
+    std::vector<UCHAR> Payload(DatagramBytes);
+    std::vector<UCHAR> Scratch(DatagramBytes);
+    for (UINT32 i = 0; i < DatagramBytes; i++) {
+        Payload[i] = (UCHAR)(i * 7 + 1);
+    }
+
+    //
+    // The arrival order, generated up front so only reassembly is timed.
+    //
+    struct Arrival {
+        UINT32 Source;
+        FragmentSpec Spec;
+    };
+    std::vector<Arrival> Arrivals;
+    std::vector<FragmentSpec> Pieces;
+    for (UINT32 Round = 0; Round < Datagrams / Sources; Round++) {
+        std::vector<Arrival> RoundArrivals;
+        for (UINT32 Source = 0; Source < Sources; Source++) {
+            Pieces.clear();
+            for (UINT32 Offset = 0; Offset < DatagramBytes; Offset += FragmentPayload) {
+                UINT32 Length = std::min(FragmentPayload, DatagramBytes - Offset);
+                Pieces.push_back({(UINT16)Round, Offset, Length, Offset + Length < DatagramBytes});
+            }
+            if (Round % 4 == 3) {
+                std::shuffle(Pieces.begin(), Pieces.end(), Random);
+            }
+            for (const FragmentSpec& Spec : Pieces) {
+                if (!Lost(Random)) {
+                    RoundArrivals.push_back({Source, Spec});
+                }
+            }
+        }
+        std::stable_partition(RoundArrivals.begin(), RoundArrivals.end(), [](const Arrival& A) {
+            return A.Spec.Offset % (2 * FragmentPayload) == 0;
+        });
+        Arrivals.insert(Arrivals.end(), RoundArrivals.begin(), RoundArrivals.end());
+    }
+
+    auto Umem = std::make_unique<UCHAR[]>((size_t)BenchChunks * BenchChunkSize);
+    UmemFramePool Pool(BenchChunks);
+    Pool.AddRegion(0, BenchChunks, BenchChunkSize);
+
+    Ipv4ReassemblerConfig Config;
+    Config.MaxDatagrams = Slots;
+    Config.MaxFragments = (DatagramBytes + FragmentPayload - 1) / FragmentPayload;
+    Config.TimeoutTicks = TimeoutNs;
+    Ipv4Reassembler Reassembler(Config, &Pool);
+
+    ReassemblyRunResult Result {};
+    Result.Expected = (Datagrams / Sources) * Sources;
+    UINT64 Now = 0;
+    UINT64 Start = Clock.NowOrdered();
+
+    for (const Arrival& Entry : Arrivals) {
+        UINT64 Address;
+        if (!Pool.Allocate(&Address)) {
+            break;
+        }
+        UCHAR* Frame = &Umem[Address];
+        UINT32 Length = BuildFragment(Frame, 0x0a000000 | Entry.Source, Entry.Spec, Payload.data());
+
+        ReassembledDatagram Datagram;
+        if (Reassembler.Submit(Frame, Address, 0, Length, Now, &Datagram) == ReassemblyResult::Complete) {
+            Result.Completed++;
+            if (Copy) {
+                UINT32 Copied = Ipv4Reassembler::Linearize(Umem.get(), Datagram, Scratch.data(), DatagramBytes);
+                Result.Corrupt += Copied != DatagramBytes || memcmp(Scratch.data(), Payload.data(), Copied) != 0;
+            } else {
+                //
+                // Zero-copy consumers touch the fragments in place.
+                //
+                UINT32 Sum = 0;
+                for (UINT32 i = 0; i < Datagram.FragmentCount; i++) {
+                    Sum += Umem[Datagram.Fragments[i].Address + Datagram.Fragments[i].DataOffset];
+                }
+                Result.Corrupt += Sum == MAXUINT32;
+            }
+            Reassembler.Release(Datagram);
+        }
+
+        Now += FrameIntervalNs;
+        if ((Now / FrameIntervalNs) % 64 == 0) {
+            Reassembler.Expire(Now);
+        }
+    }
+
+    UINT64 Ns = Clock.TicksToNs(Clock.NowOrdered() - Start);
+    Result.Stats = Reassembler.Statistics();
+    Result.MFragmentsPerSecond = Ns != 0 ? Arrivals.size() * 1000.0 / Ns : 0.0;
+    return Result;
+}
+
+//
+// Reassembly rate, completion and memory held as fragment loss grows. The
+// reassembler's own memory is fixed at construction; what grows with loss is
+// the UMEM held by datagrams that will never complete, which the slot count
+// and timeout bound.
+//
+int ReassemblyBenchmark(int argc, char** argv)
+{
+    UINT32 Datagrams = argc >= 1 ? atoi(argv[0]) : 100000;
+    UINT32 DatagramBytes = argc >= 2 ? atoi(argv[1]) : 12000;
+    UINT32 TimeoutMs = argc >= 3 ? atoi(argv[2]) : 30;
+    UINT32 Slots = argc >= 4 ? atoi(argv[3]) : 256;
+
+    if (Datagrams < 8 || DatagramBytes <= FragmentPayload || DatagramBytes > 65000 || Slots == 0) {
+        fprintf(stderr, "need at least 8 datagrams of %u to 65000 bytes and one slot\n", FragmentPayload + 1);
+        return EXIT_FAILURE;
+    }
+
+    if (!CheckAttacks()) {
+        return EXIT_FAILURE;
+    }
+    printf("attack checks: ok\n");
+
+    TscClock Clock;
+    UINT32 FragmentsPerDatagram = (DatagramBytes + FragmentPayload - 1) / FragmentPayload;
+    printf(
+        "%u datagrams of %u bytes (%u fragments), %u ms timeout, %u slots, 1 frame per %llu ns\n\n",
+        Datagrams,
+        DatagramBytes,
+        FragmentsPerDatagram,
+        TimeoutMs,
+        Slots,
+        (unsigned long long)FrameIntervalNs);
+    printf(
+        "%6s %-6s %10s %10s %9s %9s %10s %12s %12s\n",
+        "loss",
+        "mode",
+        "Mfrag/s",
+        "complete",
+        "timeouts",
+        "evicted",
+        "overlaps",
+        "peak UMEM",
+        "state bytes");
+
+    for (double Loss : {0.0, 0.001, 0.01, 0.05}) {
+        for (bool Copy : {false, true}) {
+            ReassemblyRunResult Result =
+                RunReassembly(Clock, Datagrams, DatagramBytes, Loss, Slots, TimeoutMs * 1000000ull, Copy);
+            if (Result.Corrupt != 0) {
+                fprintf(stderr, "%llu datagrams reassembled wrong\n", (unsigned long long)Result.Corrupt);
+                return EXIT_FAILURE;
+            }
+
+            Ipv4ReassemblerConfig Config;
+            Config.MaxDatagrams = Slots;
+            Config.MaxFragments = FragmentsPerDatagram;
+            UmemFramePool Unused(1);
+            Ipv4Reassembler Sizing(Config, &Unused);
+
+            printf(
+                "%5.1f%% %-6s %10.2f %9.2f%% %9llu %9llu %10llu %10.1f MB %12llu\n",
+                100.0 * Loss,
+                Copy ? "copy" : "zero",
+                Result.MFragmentsPerSecond,
+                100.0 * Result.Completed / Result.Expected,
+                (unsigned long long)Result.Stats.Timeouts,
+                (unsigned long long)Result.Stats.Evictions,
+                (unsigned long long)Result.Stats.Overlaps,
+                Result.Stats.PeakHeldFrames * BenchChunkSize / 1e6,
+                (unsigned long long)Sizing.MemoryFootprint());
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
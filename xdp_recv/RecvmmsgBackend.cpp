@@ -0,0 +1,348 @@
+#if defined(__linux__)
+
+#include <windows.h>
+#include <afxdp_helper.h>
+#include <errno.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "UserRingSocket.h"
+#include "XskBackend.h"
+
+namespace {
+
+HRESULT LastError()
+{
+    return HRESULT_FROM_WIN32(errno);
+}
+
+//
+// Datagrams taken from the sockets per recvmmsg() call.
+//
+constexpr UINT32 RecvBatch = 64;
+
+//
+// Microseconds a blocking receive busy-polls the device queue before it
+// sleeps. Raising it above net.core.busy_read needs CAP_NET_ADMIN, so it is
+// best effort.
+//
+constexpr int BusyPollMicroseconds = 50;
+
+//
+// What a HANDLE from this backend points to: the user-space rings, one UDP
+// socket per redirected port, and the fill buffers taken off the ring but
+// not yet received into.
+//
+struct RecvmmsgPort {
+    int Fd;
+    UINT16 Port;
+};
+
+struct RecvmmsgSocket {
+    UserRingSocket Rings;
+    std::vector<RecvmmsgPort> Ports;
+    std::vector<UINT64> Spare;
+    UINT32 NextFd;
+};
+
+struct RecvmmsgRedirect {
+    RecvmmsgSocket* Socket;
+    std::vector<int> Fds;
+};
+
+class RecvmmsgBackend : public XskBackend {
+  public:
+    const char* Name() const override { return "Linux recvmmsg"; }
+
+    HRESULT CreateSocket(_Out_ HANDLE* Socket) override
+    {
+        *Socket = new RecvmmsgSocket {};
+        return S_OK;
+    }
+
+    void CloseSocket(HANDLE Socket) override { delete (RecvmmsgSocket*)Socket; }
+
+    _Ret_maybenull_ VOID* AllocateUmem(SIZE_T Size) override
+    {
+        VOID* Memory = mmap(nullptr, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        return Memory != MAP_FAILED ? Memory : nullptr;
+    }
+
+    void FreeUmem(_In_ VOID* Memory, SIZE_T Size) override { munmap(Memory, Size); }
+
+    HRESULT RegisterUmem(HANDLE Socket, const XSK_UMEM_REG& Umem) override
+    {
+        RecvmmsgSocket* Recv = (RecvmmsgSocket*)Socket;
+        if (Umem.ChunkSize <= UserRingSocket::HeaderLength) {
+            return E_INVALIDARG;
+        }
+        Recv->Rings.RegisterUmem(Umem);
+        return S_OK;
+    }
+
+    //
+    // Sockets receive what the stack delivers to the port on any queue, so
+    // QueueId only names the socket; the interface restricts it through
+    // SO_BINDTODEVICE when the sockets are created.
+    //
+    HRESULT Bind(
+        HANDLE Socket,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        XSK_BIND_FLAGS Flags,
+        const XskRingSizes& Sizes) override
+    {
+        UNREFERENCED_PARAMETER(IfIndex);
+        UNREFERENCED_PARAMETER(QueueId);
+
+        RecvmmsgSocket* Recv = (RecvmmsgSocket*)Socket;
+        if (Flags & XSK_BIND_FLAG_TX) {
+            return E_NOTIMPL;
+        }
+        if (!Recv->Rings.HasUmem()) {
+            return E_UNEXPECTED;
+        }
+        Recv->Spare.reserve(RecvBatch);
+        return Recv->Rings.CreateRings(Sizes.Rx, Sizes.Fill);
+    }
+
+    HRESULT GetRingInfo(HANDLE Socket, _Out_ XSK_RING_INFO_SET* Rings) override
+    {
+        *Rings = ((RecvmmsgSocket*)Socket)->Rings.RingInfo();
+        return S_OK;
+    }
+
+    HRESULT RedirectUdp(
+        HANDLE Socket,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        _In_reads_(PortCount) const UINT16* Ports,
+        UINT32 PortCount,
+        _Out_ HANDLE* Program) override
+    {
+        UNREFERENCED_PARAMETER(QueueId);
+
+        *Program = nullptr;
+
+        RecvmmsgSocket* Recv = (RecvmmsgSocket*)Socket;
+        RecvmmsgRedirect* Redirect = new RecvmmsgRedirect {Recv, {}};
+        for (UINT32 i = 0; i < PortCount; i++) {
+            int Fd;
+            if (auto Result = OpenUdpSocket(IfIndex, Ports[i], &Fd); FAILED(Result)) {
+                CloseProgram(Redirect);
+                return Result;
+            }
+            Redirect->Fds.push_back(Fd);
+            Recv->Ports.push_back({Fd, Ports[i]});
+        }
+
+        *Program = Redirect;
+        return S_OK;
+    }
+
+    void CloseProgram(HANDLE Program) override
+    {
+        RecvmmsgRedirect* Redirect = (RecvmmsgRedirect*)Program;
+        std::vector<RecvmmsgPort>& Ports = Redirect->Socket->Ports;
+        for (int Fd : Redirect->Fds) {
+            std::erase_if(Ports, [Fd](const RecvmmsgPort& Port) { return Port.Fd == Fd; });
+            close(Fd);
+        }
+        Redirect->Socket->NextFd = 0;
+        delete Redirect;
+    }
+
+    //
+    // The receiving happens here, in the caller's thread: a poke drains the
+    // sockets into the fill buffers, and a wait does the same, sleeping in
+    // poll() first if nothing is queued. The result comes from the RX ring.
+    //
+    HRESULT Notify(
+        HANDLE Socket,
+        XSK_NOTIFY_FLAGS Flags,
+        UINT32 TimeoutMs,
+        _Out_ XSK_NOTIFY_RESULT_FLAGS* Result) override
+    {
+        RecvmmsgSocket* Recv = (RecvmmsgSocket*)Socket;
+        *Result = XSK_NOTIFY_RESULT_FLAG_NONE;
+
+        if (Flags & (XSK_NOTIFY_FLAG_POKE_RX | XSK_NOTIFY_FLAG_WAIT_RX)) {
+            Pump(Recv);
+        }
+
+        if ((Flags & XSK_NOTIFY_FLAG_WAIT_RX) && !Recv->Rings.RxAvailable() && TimeoutMs != 0) {
+            std::vector<pollfd> Polls(Recv->Ports.size());
+            for (size_t i = 0; i < Polls.size(); i++) {
+                Polls[i].fd = Recv->Ports[i].Fd;
+                Polls[i].events = POLLIN;
+            }
+            if (poll(Polls.data(), Polls.size(), TimeoutMs == INFINITE ? -1 : (int)TimeoutMs) < 0 && errno != EINTR) {
+                return LastError();
+            }
+            Pump(Recv);
+        }
+
+        if ((Flags & XSK_NOTIFY_FLAG_WAIT_RX) && Recv->Rings.RxAvailable()) {
+            *Result |= XSK_NOTIFY_RESULT_FLAG_RX_AVAILABLE;
+        }
+        return S_OK;
+    }
+
+    //
+    // Nothing receives unless the caller pumps, so every refill is worth a
+    // poke.
+    //
+    bool NeedsPoke(const XSK_RING* Ring) const override
+    {
+        UNREFERENCED_PARAMETER(Ring);
+        return true;
+    }
+
+  private:
+    static HRESULT OpenUdpSocket(UINT32 IfIndex, UINT16 Port, _Out_ int* Socket)
+    {
+        *Socket = -1;
+
+        int Fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (Fd < 0) {
+            return LastError();
+        }
+
+        //
+        // IP_PKTINFO gives each datagram's destination address, which goes
+        // into the synthesized header. The rest only helps throughput.
+        //
+        int On = 1;
+        int BusyPoll = BusyPollMicroseconds;
+        int ReceiveBuffer = 8 << 20;
+        char IfName[IF_NAMESIZE];
+        if (setsockopt(Fd, IPPROTO_IP, IP_PKTINFO, &On, sizeof(On)) != 0) {
+            HRESULT Result = LastError();
+            close(Fd);
+            return Result;
+        }
+        setsockopt(Fd, SOL_SOCKET, SO_BUSY_POLL, &BusyPoll, sizeof(BusyPoll));
+        if (setsockopt(Fd, SOL_SOCKET, SO_RCVBUFFORCE, &ReceiveBuffer, sizeof(ReceiveBuffer)) != 0) {
+            setsockopt(Fd, SOL_SOCKET, SO_RCVBUF, &ReceiveBuffer, sizeof(ReceiveBuffer));
+        }
+        if (if_indextoname(IfIndex, IfName) != nullptr) {
+            setsockopt(Fd, SOL_SOCKET, SO_BINDTODEVICE, IfName, (socklen_t)strlen(IfName));
+        }
+
+        sockaddr_in Address {};
+        Address.sin_family = AF_INET;
+        Address.sin_port = htons(Port);
+        Address.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(Fd, (sockaddr*)&Address, sizeof(Address)) != 0) {
+            HRESULT Result = LastError();
+            close(Fd);
+            return Result;
+        }
+
+        *Socket = Fd;
+        return S_OK;
+    }
+
+    //
+    // Receives into fill buffers, a batch per socket in turn, until the
+    // sockets run dry or the fill or RX ring runs out. Truncated datagrams
+    // are dropped, the way an XDP socket drops frames longer than a chunk.
+    //
+    static void Pump(_Inout_ RecvmmsgSocket* Recv)
+    {
+        UserRingSocket& Rings = Recv->Rings;
+        UINT32 FdCount = (UINT32)Recv->Ports.size();
+        UINT32 IdleFds = 0;
+
+        mmsghdr Messages[RecvBatch];
+        iovec Vectors[RecvBatch];
+        sockaddr_in Sources[RecvBatch];
+        alignas(cmsghdr) char Controls[RecvBatch][CMSG_SPACE(sizeof(in_pktinfo))];
+
+        while (FdCount != 0 && IdleFds < FdCount) {
+            UINT32 Room = std::min(Rings.RxRoom(), RecvBatch);
+            UINT32 Have = (UINT32)Recv->Spare.size();
+            if (Have < Room) {
+                UINT64 Taken[RecvBatch];
+                UINT32 Count = Rings.TakeFillBuffers(Taken, Room - Have);
+                Recv->Spare.insert(Recv->Spare.end(), Taken, Taken + Count);
+            }
+            UINT32 Count = std::min(Room, (UINT32)Recv->Spare.size());
+            if (Count == 0) {
+                break;
+            }
+
+            UINT64* Buffers = Recv->Spare.data() + Recv->Spare.size() - Count;
+            for (UINT32 i = 0; i < Count; i++) {
+                Vectors[i].iov_base = Rings.Payload(Buffers[i]);
+                Vectors[i].iov_len = Rings.PayloadRoom();
+                Messages[i].msg_hdr = {};
+                Messages[i].msg_hdr.msg_name = &Sources[i];
+                Messages[i].msg_hdr.msg_namelen = sizeof(Sources[i]);
+                Messages[i].msg_hdr.msg_iov = &Vectors[i];
+                Messages[i].msg_hdr.msg_iovlen = 1;
+                Messages[i].msg_hdr.msg_control = Controls[i];
+                Messages[i].msg_hdr.msg_controllen = sizeof(Controls[i]);
+            }
+
+            const RecvmmsgPort& Port = Recv->Ports[Recv->NextFd];
+            Recv->NextFd = (Recv->NextFd + 1) % FdCount;
+            int Received = recvmmsg(Port.Fd, Messages, Count, MSG_DONTWAIT, nullptr);
+            if (Received <= 0) {
+                IdleFds++;
+                continue;
+            }
+            IdleFds = 0;
+
+            //
+            // Received buffers leave the spare list from its end; unused and
+            // truncated ones go back onto it.
+            //
+            UINT64 Unused[RecvBatch];
+            UINT32 UnusedCount = 0;
+            for (int i = Received; i < (int)Count; i++) {
+                Unused[UnusedCount++] = Buffers[i];
+            }
+            for (int i = 0; i < Received; i++) {
+                if (Messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    Unused[UnusedCount++] = Buffers[i];
+                    continue;
+                }
+                UINT32 Destination = INADDR_ANY;
+                for (cmsghdr* Control = CMSG_FIRSTHDR(&Messages[i].msg_hdr); Control != nullptr;
+                     Control = CMSG_NXTHDR(&Messages[i].msg_hdr, Control)) {
+                    if (Control->cmsg_level == IPPROTO_IP && Control->cmsg_type == IP_PKTINFO) {
+                        Destination = ntohl(((in_pktinfo*)CMSG_DATA(Control))->ipi_addr.s_addr);
+                    }
+                }
+                Rings.Deliver(
+                    Buffers[i],
+                    Messages[i].msg_len,
+                    ntohl(Sources[i].sin_addr.s_addr),
+                    ntohs(Sources[i].sin_port),
+                    Destination,
+                    Port.Port);
+            }
+
+            Recv->Spare.resize(Recv->Spare.size() - Count);
+            Recv->Spare.insert(Recv->Spare.end(), Unused, Unused + UnusedCount);
+            Rings.SubmitRx();
+        }
+    }
+};
+
+} // namespace
+
+std::unique_ptr<XskBackend> CreateSocketBackend()
+{
+    return std::make_unique<RecvmmsgBackend>();
+}
+
+#endif
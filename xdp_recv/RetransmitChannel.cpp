@@ -0,0 +1,233 @@
+#include "SocketApi.h"
+
+#include "GapRecovery.h"
+
+#include <string.h>
+
+#include <memory>
+
+namespace {
+
+HRESULT SetNonBlocking(UINT_PTR Socket)
+{
+#if defined(_WIN32)
+    u_long Enable = 1;
+    return ioctlsocket(Socket, FIONBIO, &Enable) == 0 ? S_OK : LastSocketError();
+#else
+    int Flags = fcntl((int)Socket, F_GETFL, 0);
+    return Flags >= 0 && fcntl((int)Socket, F_SETFL, Flags | O_NONBLOCK) == 0 ? S_OK : LastSocketError();
+#endif
+}
+
+sockaddr_in Ipv4Address(UINT32 Address, UINT16 Port)
+{
+    sockaddr_in In {};
+    In.sin_family = AF_INET;
+    In.sin_port = htons(Port);
+    In.sin_addr.s_addr = htonl(Address);
+    return In;
+}
+
+//
+// Owns the socket and, on Windows, a Winsock reference.
+//
+class SocketChannel : public RetransmitChannel {
+  public:
+    SocketChannel()
+    {
+#if defined(_WIN32)
+        WSADATA WsaData;
+        Started = WSAStartup(MAKEWORD(2, 2), &WsaData) == 0;
+#else
+        Started = true;
+#endif
+    }
+
+    ~SocketChannel() override
+    {
+        if (Socket != (UINT_PTR)INVALID_SOCKET) {
+            closesocket(Socket);
+        }
+#if defined(_WIN32)
+        if (Started) {
+            WSACleanup();
+        }
+#endif
+    }
+
+    //
+    // Opens a non-blocking socket of Type connected to Address:Port.
+    //
+    HRESULT Connect(int Type, int Protocol, UINT32 Address, UINT16 Port)
+    {
+        if (!Started) {
+            return E_FAIL;
+        }
+        Socket = (UINT_PTR)socket(AF_INET, Type, Protocol);
+        if (Socket == (UINT_PTR)INVALID_SOCKET) {
+            return LastSocketError();
+        }
+
+        //
+        // Answers come in bursts of packets; give UDP room to queue a large
+        // one, and keep TCP from holding back small requests.
+        //
+        if (Type == SOCK_DGRAM) {
+            int ReceiveBuffer = 4 << 20;
+            setsockopt(Socket, SOL_SOCKET, SO_RCVBUF, (const char*)&ReceiveBuffer, sizeof(ReceiveBuffer));
+        } else {
+            int NoDelay = 1;
+            setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&NoDelay, sizeof(NoDelay));
+        }
+
+        //
+        // TCP connects before going non-blocking, so Send() never meets a
+        // connection still being set up.
+        //
+        sockaddr_in Server = Ipv4Address(Address, Port);
+        if (connect(Socket, (sockaddr*)&Server, sizeof(Server)) != 0) {
+            return LastSocketError();
+        }
+        return SetNonBlocking(Socket);
+    }
+
+  protected:
+    UINT_PTR Socket = (UINT_PTR)INVALID_SOCKET;
+    bool Started = false;
+};
+
+class UdpRetransmitChannel : public SocketChannel {
+  public:
+    const char* Name() const override { return "udp"; }
+
+    HRESULT Send(_In_reads_bytes_(Length) const UCHAR* Request, UINT32 Length) override
+    {
+        return send(Socket, (const char*)Request, (int)Length, 0) == (int)Length ? S_OK : LastSocketError();
+    }
+
+    UINT32 Receive(_Out_writes_bytes_(Size) UCHAR* Packet, UINT32 Size) override
+    {
+        int Received = recv(Socket, (char*)Packet, (int)Size, 0);
+        return Received > 0 ? (UINT32)Received : 0;
+    }
+};
+
+class TcpRetransmitChannel : public SocketChannel {
+  public:
+    static constexpr UINT32 FramePrefix = 2;
+
+    const char* Name() const override { return "tcp"; }
+
+    //
+    // A request is queued whole or not at all, so the stream never carries
+    // half a frame; what the socket does not take now goes out on the next
+    // Send() or Receive(). With the queue full the request is refused and
+    // asked again after the timeout, like a lost datagram.
+    //
+    HRESULT Send(_In_reads_bytes_(Length) const UCHAR* Request, UINT32 Length) override
+    {
+        if (Length > RetransmitRequestFormat::MaxRequestSize) {
+            return E_INVALIDARG;
+        }
+        HRESULT Result = Flush();
+        if (FAILED(Result)) {
+            return Result;
+        }
+        if (Unsent + FramePrefix + Length > PendingSize) {
+            return HRESULT_FROM_WIN32(ERROR_BUSY);
+        }
+
+        Pending[Unsent] = (UCHAR)(Length >> 8);
+        Pending[Unsent + 1] = (UCHAR)Length;
+        memcpy(&Pending[Unsent + FramePrefix], Request, Length);
+        Unsent += FramePrefix + Length;
+        return Flush();
+    }
+
+    UINT32 Receive(_Out_writes_bytes_(Size) UCHAR* Packet, UINT32 Size) override
+    {
+        Flush();
+        for (;;) {
+            UINT32 Available = End - Start;
+            if (Available >= FramePrefix) {
+                UINT32 Length = ((UINT32)Buffer[Start] << 8) | Buffer[Start + 1];
+                if (Available >= FramePrefix + Length) {
+                    UINT32 Copied = Length <= Size ? Length : 0;
+                    memcpy(Packet, &Buffer[Start + FramePrefix], Copied);
+                    Start += FramePrefix + Length;
+                    if (Copied != 0) {
+                        return Copied;
+                    }
+                    continue;
+                }
+            }
+
+            //
+            // Keep the partial frame at the front and read more behind it;
+            // the buffer holds the largest frame with room to spare.
+            //
+            if (Start != 0) {
+                memmove(&Buffer[0], &Buffer[Start], Available);
+                Start = 0;
+                End = Available;
+            }
+            int Received = recv(Socket, (char*)&Buffer[End], (int)(BufferSize - End), 0);
+            if (Received <= 0) {
+                return 0;
+            }
+            End += (UINT32)Received;
+        }
+    }
+
+  private:
+    static constexpr UINT32 BufferSize = 2 * 65536;
+    static constexpr UINT32 PendingSize = 64 * (FramePrefix + RetransmitRequestFormat::MaxRequestSize);
+
+    //
+    // Sends as much of the queue as the socket takes. Only a broken
+    // connection fails; a full socket buffer leaves the rest for later.
+    //
+    HRESULT Flush()
+    {
+        while (Unsent != 0) {
+            int Sent = send(Socket, (const char*)Pending, (int)Unsent, MSG_NOSIGNAL);
+            if (Sent < 0) {
+                return SocketWouldBlock() ? S_OK : LastSocketError();
+            }
+            memmove(Pending, &Pending[Sent], Unsent - Sent);
+            Unsent -= (UINT32)Sent;
+        }
+        return S_OK;
+    }
+
+    std::unique_ptr<UCHAR[]> Buffer = std::make_unique<UCHAR[]>(BufferSize);
+    UINT32 Start = 0;
+    UINT32 End = 0;
+
+    UCHAR Pending[PendingSize];
+    UINT32 Unsent = 0;
+};
+
+} // namespace
+
+HRESULT CreateUdpRetransmitChannel(UINT32 Address, UINT16 Port, _Out_ std::unique_ptr<RetransmitChannel>* Channel)
+{
+    *Channel = nullptr;
+    auto Udp = std::make_unique<UdpRetransmitChannel>();
+    HRESULT Result = Udp->Connect(SOCK_DGRAM, IPPROTO_UDP, Address, Port);
+    if (SUCCEEDED(Result)) {
+        *Channel = std::move(Udp);
+    }
+    return Result;
+}
+
+HRESULT CreateTcpRetransmitChannel(UINT32 Address, UINT16 Port, _Out_ std::unique_ptr<RetransmitChannel>* Channel)
+{
+    *Channel = nullptr;
+    auto Tcp = std::make_unique<TcpRetransmitChannel>();
+    HRESULT Result = Tcp->Connect(SOCK_STREAM, IPPROTO_TCP, Address, Port);
+    if (SUCCEEDED(Result)) {
+        *Channel = std::move(Tcp);
+    }
+    return Result;
+}
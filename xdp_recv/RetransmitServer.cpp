@@ -0,0 +1,310 @@
+#include "SocketApi.h"
+
+#include "RetransmitServer.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+constexpr UINT32 FramePrefix = 2;
+
+//
+// How often an idle server thread looks at Stopping.
+//
+constexpr long IdleWaitUs = 10000;
+
+HRESULT OpenLoopback(int Type, int Protocol, UINT16 Port, _Out_ UINT_PTR* Socket)
+{
+    *Socket = (UINT_PTR)socket(AF_INET, Type, Protocol);
+    if (*Socket == (UINT_PTR)INVALID_SOCKET) {
+        return LastSocketError();
+    }
+
+    int Reuse = 1;
+    setsockopt(*Socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&Reuse, sizeof(Reuse));
+    sockaddr_in Address {};
+    Address.sin_family = AF_INET;
+    Address.sin_port = htons(Port);
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(*Socket, (sockaddr*)&Address, sizeof(Address)) != 0 ||
+        (Type == SOCK_STREAM && listen(*Socket, SOMAXCONN) != 0)) {
+        HRESULT Result = LastSocketError();
+        closesocket(*Socket);
+        *Socket = (UINT_PTR)INVALID_SOCKET;
+        return Result;
+    }
+    return S_OK;
+}
+
+} // namespace
+
+RetransmitServer::RetransmitServer(const RetransmitServerConfig& Config, _In_ const RetransmitRequestFormat* Format)
+    : Config(Config)
+    , Format(Format)
+    , UdpSocket((UINT_PTR)INVALID_SOCKET)
+    , ListenSocket((UINT_PTR)INVALID_SOCKET)
+{
+    History = std::make_unique<UCHAR[]>((size_t)Config.HistoryMessages * (FramePrefix + Config.MaxMessageSize));
+    memset(Session.Name, ' ', sizeof(Session.Name));
+}
+
+RetransmitServer::~RetransmitServer()
+{
+    Stop();
+}
+
+HRESULT RetransmitServer::Start()
+{
+#if defined(_WIN32)
+    WSADATA WsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0) {
+        return E_FAIL;
+    }
+#endif
+    Started = true;
+
+    HRESULT Result = OpenLoopback(SOCK_DGRAM, IPPROTO_UDP, Config.Port, &UdpSocket);
+    if (SUCCEEDED(Result)) {
+        Result = OpenLoopback(SOCK_STREAM, IPPROTO_TCP, Config.Port, &ListenSocket);
+    }
+    if (FAILED(Result)) {
+        Stop();
+        return Result;
+    }
+
+    Stopping = false;
+    Server = std::thread([this] { Serve(); });
+    return S_OK;
+}
+
+void RetransmitServer::Stop()
+{
+    Stopping = true;
+    if (Server.joinable()) {
+        Server.join();
+    }
+
+    for (const Connection& Client : Connections) {
+        closesocket(Client.Socket);
+    }
+    Connections.clear();
+    for (UINT_PTR* Socket : {&UdpSocket, &ListenSocket}) {
+        if (*Socket != (UINT_PTR)INVALID_SOCKET) {
+            closesocket(*Socket);
+            *Socket = (UINT_PTR)INVALID_SOCKET;
+        }
+    }
+
+#if defined(_WIN32)
+    if (Started) {
+        WSACleanup();
+    }
+#endif
+    Started = false;
+}
+
+void RetransmitServer::Record(_In_reads_bytes_(Length) const UCHAR* Payload, UINT32 Length)
+{
+    if (Length < Itch::MoldUdp64::Size) {
+        return;
+    }
+
+    Itch::MoldUdp64 Header(Payload);
+    UINT64 Sequence = Header.SequenceNumber();
+    UINT32 Count = Header.MessageCount();
+    UINT32 SlotSize = FramePrefix + Config.MaxMessageSize;
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    memcpy(Session.Name, Header.Session(), sizeof(Session.Name));
+    if (Sequence != Next) {
+        First = Sequence;
+        Next = Sequence;
+    }
+
+    //
+    // A message too large for a slot is kept as missing, which ends any
+    // answer that reaches it.
+    //
+    UINT32 Offset = Itch::MoldUdp64::Size;
+    for (UINT32 i = 0; i < Count && Length - Offset >= FramePrefix; i++) {
+        UINT32 MessageLength = ((UINT32)Payload[Offset] << 8) | Payload[Offset + 1];
+        if (Length - Offset - FramePrefix < MessageLength) {
+            break;
+        }
+
+        UCHAR* Slot = &History[(size_t)(Next % Config.HistoryMessages) * SlotSize];
+        if (MessageLength <= Config.MaxMessageSize) {
+            memcpy(Slot, Payload + Offset, FramePrefix + MessageLength);
+        } else {
+            WireStoreBig(Slot, 0xFFFF, FramePrefix);
+        }
+        Offset += FramePrefix + MessageLength;
+        Next++;
+    }
+    First = std::max(First, Next > Config.HistoryMessages ? Next - Config.HistoryMessages : 1);
+}
+
+UINT64 RetransmitServer::NextSequence() const
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    return Next;
+}
+
+RetransmitServerStats RetransmitServer::Statistics() const
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    return Stats;
+}
+
+template <typename Fn>
+void RetransmitServer::Answer(_In_reads_bytes_(Length) const UCHAR* Request, UINT32 Length, Fn&& Reply)
+{
+    MoldSession Wanted;
+    UINT64 Sequence;
+    UINT16 Count;
+    if (!Format->ParseRequest(Request, Length, &Wanted, &Sequence, &Count)) {
+        std::lock_guard<std::mutex> Guard(Lock);
+        Stats.BadRequests++;
+        return;
+    }
+
+    //
+    // Packets are built under the lock and sent after it, so the feed is
+    // never held up by a slow client.
+    //
+    std::vector<UCHAR> Packets;
+    std::vector<UINT32> Lengths;
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+        Stats.Requests++;
+        UINT64 End = std::min(Sequence + Count, Next);
+        if (memcmp(Wanted.Name, Session.Name, sizeof(Session.Name)) != 0 || Sequence < First || Sequence >= End) {
+            Stats.Unavailable++;
+            return;
+        }
+
+        UINT32 SlotSize = FramePrefix + Config.MaxMessageSize;
+        while (Sequence < End) {
+            size_t Start = Packets.size();
+            Packets.resize(Start + Config.MaxPacketSize);
+            UCHAR* Packet = &Packets[Start];
+            memcpy(Packet + Itch::MoldUdp64::SessionOffset, Session.Name, sizeof(Session.Name));
+            WireStoreBig(Packet + Itch::MoldUdp64::SequenceNumberOffset, Sequence, 8);
+
+            UINT32 Used = Itch::MoldUdp64::Size;
+            UINT32 Messages = 0;
+            for (; Sequence < End; Sequence++, Messages++) {
+                const UCHAR* Slot = &History[(size_t)(Sequence % Config.HistoryMessages) * SlotSize];
+                UINT32 MessageLength = ((UINT32)Slot[0] << 8) | Slot[1];
+                if (MessageLength > Config.MaxMessageSize) {
+                    End = Sequence;
+                    break;
+                }
+                if (Used + FramePrefix + MessageLength > Config.MaxPacketSize) {
+                    break;
+                }
+                memcpy(Packet + Used, Slot, FramePrefix + MessageLength);
+                Used += FramePrefix + MessageLength;
+            }
+            WireStoreBig(Packet + Itch::MoldUdp64::MessageCountOffset, Messages, 2);
+            Packets.resize(Start + Used);
+            if (Messages == 0) {
+                Packets.resize(Start);
+                break;
+            }
+            Lengths.push_back(Used);
+            Stats.Packets++;
+            Stats.Messages += Messages;
+        }
+    }
+
+    size_t Offset = 0;
+    for (UINT32 PacketLength : Lengths) {
+        Reply(&Packets[Offset], PacketLength);
+        Offset += PacketLength;
+    }
+}
+
+//
+// Reads what the client sent and answers every complete request in it.
+// Returns false once the client has gone.
+//
+bool RetransmitServer::ReadConnection(_Inout_ Connection* Client)
+{
+    UCHAR Buffer[4096];
+    int Received = recv(Client->Socket, (char*)Buffer, sizeof(Buffer), 0);
+    if (Received <= 0) {
+        return false;
+    }
+    Client->Stream.insert(Client->Stream.end(), Buffer, Buffer + Received);
+
+    size_t Consumed = 0;
+    while (Client->Stream.size() - Consumed >= FramePrefix) {
+        UINT32 Length = ((UINT32)Client->Stream[Consumed] << 8) | Client->Stream[Consumed + 1];
+        if (Client->Stream.size() - Consumed - FramePrefix < Length) {
+            break;
+        }
+        Answer(&Client->Stream[Consumed + FramePrefix], Length, [&](const UCHAR* Packet, UINT32 PacketLength) {
+            UCHAR Prefix[FramePrefix];
+            WireStoreBig(Prefix, PacketLength, FramePrefix);
+            send(Client->Socket, (const char*)Prefix, FramePrefix, 0);
+            send(Client->Socket, (const char*)Packet, (int)PacketLength, 0);
+        });
+        Consumed += FramePrefix + Length;
+    }
+    Client->Stream.erase(Client->Stream.begin(), Client->Stream.begin() + Consumed);
+    return true;
+}
+
+void RetransmitServer::Serve()
+{
+    UCHAR Request[RetransmitRequestFormat::MaxRequestSize * 2];
+    while (!Stopping.load(std::memory_order_relaxed)) {
+        fd_set Readable;
+        FD_ZERO(&Readable);
+        FD_SET(UdpSocket, &Readable);
+        FD_SET(ListenSocket, &Readable);
+        UINT_PTR Highest = std::max(UdpSocket, ListenSocket);
+        for (const Connection& Client : Connections) {
+            FD_SET(Client.Socket, &Readable);
+            Highest = std::max(Highest, Client.Socket);
+        }
+
+        timeval Wait {0, IdleWaitUs};
+        if (select((int)Highest + 1, &Readable, nullptr, nullptr, &Wait) <= 0) {
+            continue;
+        }
+
+        if (FD_ISSET(UdpSocket, &Readable)) {
+            sockaddr_in From {};
+            socklen_t FromLength = sizeof(From);
+            int Length = recvfrom(UdpSocket, (char*)Request, sizeof(Request), 0, (sockaddr*)&From, &FromLength);
+            if (Length > 0) {
+                Answer(Request, (UINT32)Length, [&](const UCHAR* Packet, UINT32 PacketLength) {
+                    sendto(UdpSocket, (const char*)Packet, (int)PacketLength, 0, (sockaddr*)&From, FromLength);
+                });
+            }
+        }
+
+        if (FD_ISSET(ListenSocket, &Readable)) {
+            UINT_PTR Accepted = (UINT_PTR)accept(ListenSocket, nullptr, nullptr);
+            if (Accepted != (UINT_PTR)INVALID_SOCKET) {
+                int NoDelay = 1;
+                setsockopt(Accepted, IPPROTO_TCP, TCP_NODELAY, (const char*)&NoDelay, sizeof(NoDelay));
+                Connections.push_back({Accepted, {}});
+                std::lock_guard<std::mutex> Guard(Lock);
+                Stats.Connections++;
+            }
+        }
+
+        std::erase_if(Connections, [&](Connection& Client) {
+            if (FD_ISSET(Client.Socket, &Readable) && !ReadConnection(&Client)) {
+                closesocket(Client.Socket);
+                return true;
+            }
+            return false;
+        });
+    }
+}
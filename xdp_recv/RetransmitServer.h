@@ -0,0 +1,115 @@
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GapRecovery.h"
+
+struct RetransmitServerConfig {
+    //
+    // Listens for requests on 127.0.0.1 at this UDP port and this TCP port.
+    //
+    UINT16 Port = 26401;
+
+    //
+    // The most recent messages kept for retransmission; older ones are
+    // gone, and a request for them gets no answer.
+    //
+    UINT32 HistoryMessages = 1 << 20;
+    UINT32 MaxMessageSize = 64;
+
+    //
+    // Answer packets are no larger than this.
+    //
+    UINT32 MaxPacketSize = 1472;
+};
+
+struct RetransmitServerStats {
+    UINT64 Requests;
+    UINT64 BadRequests;
+
+    //
+    // Requests for messages not yet sent or no longer in the history.
+    //
+    UINT64 Unavailable;
+
+    UINT64 Packets;
+    UINT64 Messages;
+    UINT64 Connections;
+};
+
+//
+// A stand-in for a feed's retransmission server, for testing loss and
+// recovery on one box: the feed records every datagram it sends, and a
+// thread answers requests from GapRecovery clients over UDP and TCP on
+// loopback with MoldUDP64 packets of the messages asked for.
+//
+// The history is a ring of fixed-size message slots indexed by sequence
+// number. Record() and the server thread share it under a lock, which is
+// fine for a test rig and would not be for a real server.
+//
+class RetransmitServer {
+  public:
+    RetransmitServer(const RetransmitServerConfig& Config, _In_ const RetransmitRequestFormat* Format);
+    ~RetransmitServer();
+
+    RetransmitServer(const RetransmitServer&) = delete;
+    RetransmitServer& operator=(const RetransmitServer&) = delete;
+
+    //
+    // Opens the sockets and starts answering.
+    //
+    HRESULT Start();
+    void Stop();
+
+    //
+    // Keeps the messages of a MoldUDP64 payload the feed sent.
+    //
+    void Record(_In_reads_bytes_(Length) const UCHAR* Payload, UINT32 Length);
+
+    //
+    // The sequence number of the next message the feed will send; a
+    // snapshot taken now covers everything before it.
+    //
+    UINT64 NextSequence() const;
+
+    RetransmitServerStats Statistics() const;
+
+  private:
+    struct Connection {
+        UINT_PTR Socket;
+        std::vector<UCHAR> Stream;
+    };
+
+    void Serve();
+
+    //
+    // Sends the answer to Request through Reply, one packet per call.
+    //
+    template <typename Fn>
+    void Answer(_In_reads_bytes_(Length) const UCHAR* Request, UINT32 Length, Fn&& Reply);
+
+    bool ReadConnection(_Inout_ Connection* Client);
+
+    RetransmitServerConfig Config;
+    const RetransmitRequestFormat* Format;
+    bool Started = false;
+
+    UINT_PTR UdpSocket;
+    UINT_PTR ListenSocket;
+    std::vector<Connection> Connections;
+    std::thread Server;
+    std::atomic<bool> Stopping {false};
+
+    mutable std::mutex Lock;
+    MoldSession Session {};
+    std::unique_ptr<UCHAR[]> History;
+    UINT64 First = 1;
+    UINT64 Next = 1;
+    RetransmitServerStats Stats {};
+};
@@ -0,0 +1,471 @@
+#if defined(_WIN32)
+
+#include "SocketApi.h"
+
+#include <mswsock.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "UserRingSocket.h"
+#include "XskBackend.h"
+
+namespace {
+
+//
+// Completions taken off the completion queue per dequeue.
+//
+constexpr UINT32 RioBatch = 64;
+
+//
+// The addresses of the datagram received into a chunk, kept in a registered
+// array beside the UMEM, one entry per chunk.
+//
+struct RioAddresses {
+    SOCKADDR_INET Local;
+    SOCKADDR_INET Remote;
+};
+
+//
+// One redirected port: a registered I/O socket, its request queue and the
+// receives posted on it. Its address is the queue's socket context.
+//
+struct RioPort {
+    SOCKET Socket;
+    RIO_RQ Queue;
+    UINT16 Port;
+    UINT32 Posted;
+};
+
+//
+// What a HANDLE from this backend points to: the user-space rings, the
+// registered UMEM and address array, one completion queue signalling an
+// event, the ports' sockets, and the fill buffers taken off the ring but
+// not yet posted or handed back by a failed receive.
+//
+struct RioSocket {
+    UserRingSocket Rings;
+    RIO_BUFFERID Umem = RIO_INVALID_BUFFERID;
+    std::unique_ptr<RioAddresses[]> Addresses;
+    RIO_BUFFERID AddressBuffer = RIO_INVALID_BUFFERID;
+    HANDLE Event = nullptr;
+    RIO_CQ Completions = RIO_INVALID_CQ;
+    UINT32 CompletionQueueSize = 0;
+    UINT32 ReceiveDepth = 0;
+    std::vector<std::unique_ptr<RioPort>> Ports;
+    std::vector<UINT64> Spare;
+};
+
+struct RioRedirect {
+    RioSocket* Socket;
+    std::vector<RioPort*> Ports;
+};
+
+class RioBackend : public XskBackend {
+  public:
+    RioBackend()
+    {
+        WSADATA WsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0) {
+            Status = HRESULT_FROM_WIN32(ERROR_NOT_READY);
+            return;
+        }
+        Started = true;
+
+        //
+        // The RIO function table hangs off any registered I/O socket.
+        //
+        SOCKET Socket = WSASocketW(AF_INET, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+        if (Socket == INVALID_SOCKET) {
+            Status = LastSocketError();
+            return;
+        }
+        GUID FunctionTableId = WSAID_MULTIPLE_RIO;
+        DWORD Bytes;
+        Functions.cbSize = sizeof(Functions);
+        if (WSAIoctl(
+                Socket,
+                SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER,
+                &FunctionTableId,
+                sizeof(FunctionTableId),
+                &Functions,
+                sizeof(Functions),
+                &Bytes,
+                nullptr,
+                nullptr) != 0) {
+            Status = LastSocketError();
+        }
+        closesocket(Socket);
+    }
+
+    ~RioBackend() override
+    {
+        if (Started) {
+            WSACleanup();
+        }
+    }
+
+    const char* Name() const override { return "Windows RIO"; }
+
+    HRESULT CreateSocket(_Out_ HANDLE* Socket) override
+    {
+        *Socket = nullptr;
+        if (FAILED(Status)) {
+            return Status;
+        }
+        *Socket = new RioSocket {};
+        return S_OK;
+    }
+
+    void CloseSocket(HANDLE Socket) override
+    {
+        RioSocket* Rio = (RioSocket*)Socket;
+        for (auto& Port : Rio->Ports) {
+            if (Port->Socket != INVALID_SOCKET) {
+                closesocket(Port->Socket);
+            }
+        }
+        if (Rio->Completions != RIO_INVALID_CQ) {
+            Functions.RIOCloseCompletionQueue(Rio->Completions);
+        }
+        if (Rio->Event != nullptr) {
+            CloseHandle(Rio->Event);
+        }
+        if (Rio->AddressBuffer != RIO_INVALID_BUFFERID) {
+            Functions.RIODeregisterBuffer(Rio->AddressBuffer);
+        }
+        if (Rio->Umem != RIO_INVALID_BUFFERID) {
+            Functions.RIODeregisterBuffer(Rio->Umem);
+        }
+        delete Rio;
+    }
+
+    _Ret_maybenull_ VOID* AllocateUmem(SIZE_T Size) override
+    {
+        return VirtualAlloc(nullptr, Size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    }
+
+    void FreeUmem(_In_ VOID* Memory, SIZE_T) override { VirtualFree(Memory, 0, MEM_RELEASE); }
+
+    //
+    // Both the UMEM and the per-chunk address array are registered once, so
+    // receives only name offsets into them.
+    //
+    HRESULT RegisterUmem(HANDLE Socket, const XSK_UMEM_REG& Umem) override
+    {
+        RioSocket* Rio = (RioSocket*)Socket;
+        if (Umem.ChunkSize <= UserRingSocket::HeaderLength || Umem.TotalSize > MAXDWORD) {
+            return E_INVALIDARG;
+        }
+        Rio->Rings.RegisterUmem(Umem);
+
+        Rio->Umem = Functions.RIORegisterBuffer((PCHAR)Umem.Address, (DWORD)Umem.TotalSize);
+        if (Rio->Umem == RIO_INVALID_BUFFERID) {
+            return LastSocketError();
+        }
+
+        UINT32 Chunks = Rio->Rings.ChunkCount();
+        Rio->Addresses = std::make_unique<RioAddresses[]>(Chunks);
+        Rio->AddressBuffer =
+            Functions.RIORegisterBuffer((PCHAR)Rio->Addresses.get(), (DWORD)(Chunks * sizeof(RioAddresses)));
+        if (Rio->AddressBuffer == RIO_INVALID_BUFFERID) {
+            return LastSocketError();
+        }
+        return S_OK;
+    }
+
+    //
+    // Sockets receive what the stack delivers to the port on any interface
+    // and queue; IfIndex and QueueId only name the socket. The completion
+    // queue starts with room for every chunk and grows with each port.
+    //
+    HRESULT Bind(
+        HANDLE Socket,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        XSK_BIND_FLAGS Flags,
+        const XskRingSizes& Sizes) override
+    {
+        UNREFERENCED_PARAMETER(IfIndex);
+        UNREFERENCED_PARAMETER(QueueId);
+
+        RioSocket* Rio = (RioSocket*)Socket;
+        if (Flags & XSK_BIND_FLAG_TX) {
+            return E_NOTIMPL;
+        }
+        if (!Rio->Rings.HasUmem()) {
+            return E_UNEXPECTED;
+        }
+        if (auto Result = Rio->Rings.CreateRings(Sizes.Rx, Sizes.Fill); FAILED(Result)) {
+            return Result;
+        }
+
+        Rio->Event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        if (Rio->Event == nullptr) {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        RIO_NOTIFICATION_COMPLETION Notification {};
+        Notification.Type = RIO_EVENT_COMPLETION;
+        Notification.Event.EventHandle = Rio->Event;
+        Notification.Event.NotifyReset = TRUE;
+        Rio->ReceiveDepth = Sizes.Fill;
+        Rio->CompletionQueueSize = Rio->Rings.ChunkCount();
+        Rio->Completions = Functions.RIOCreateCompletionQueue(Rio->CompletionQueueSize, &Notification);
+        if (Rio->Completions == RIO_INVALID_CQ) {
+            return LastSocketError();
+        }
+        Rio->Spare.reserve(Rio->Rings.ChunkCount());
+        return S_OK;
+    }
+
+    HRESULT GetRingInfo(HANDLE Socket, _Out_ XSK_RING_INFO_SET* Rings) override
+    {
+        *Rings = ((RioSocket*)Socket)->Rings.RingInfo();
+        return S_OK;
+    }
+
+    HRESULT RedirectUdp(
+        HANDLE Socket,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        _In_reads_(PortCount) const UINT16* Ports,
+        UINT32 PortCount,
+        _Out_ HANDLE* Program) override
+    {
+        UNREFERENCED_PARAMETER(IfIndex);
+        UNREFERENCED_PARAMETER(QueueId);
+
+        *Program = nullptr;
+
+        RioSocket* Rio = (RioSocket*)Socket;
+        if (Rio->Completions == RIO_INVALID_CQ) {
+            return E_UNEXPECTED;
+        }
+
+        //
+        // Each request queue adds its receives and its one unused send to
+        // what the completion queue has to hold.
+        //
+        UINT32 QueueSize = Rio->CompletionQueueSize + PortCount * (Rio->ReceiveDepth + 1);
+        if (!Functions.RIOResizeCompletionQueue(Rio->Completions, QueueSize)) {
+            return LastSocketError();
+        }
+        Rio->CompletionQueueSize = QueueSize;
+
+        RioRedirect* Redirect = new RioRedirect {Rio, {}};
+        for (UINT32 i = 0; i < PortCount; i++) {
+            auto Port = std::make_unique<RioPort>(RioPort {INVALID_SOCKET, RIO_INVALID_RQ, Ports[i], 0});
+            if (auto Result = OpenPort(Rio, Port.get()); FAILED(Result)) {
+                if (Port->Socket != INVALID_SOCKET) {
+                    closesocket(Port->Socket);
+                }
+                CloseProgram(Redirect);
+                return Result;
+            }
+            Redirect->Ports.push_back(Port.get());
+            Rio->Ports.push_back(std::move(Port));
+        }
+
+        *Program = Redirect;
+        Pump(Rio);
+        return S_OK;
+    }
+
+    //
+    // Closing a socket cancels its receives; their completions come back
+    // failed and return the chunks to the spare list on the next pump.
+    //
+    void CloseProgram(HANDLE Program) override
+    {
+        RioRedirect* Redirect = (RioRedirect*)Program;
+        for (RioPort* Port : Redirect->Ports) {
+            closesocket(Port->Socket);
+            Port->Socket = INVALID_SOCKET;
+            Port->Queue = RIO_INVALID_RQ;
+        }
+        delete Redirect;
+    }
+
+    //
+    // The receiving happens here, in the caller's thread: a poke posts fill
+    // buffers and moves completions to the RX ring, and a wait does the
+    // same, sleeping on the completion queue's event first if nothing has
+    // completed. The result comes from the RX ring.
+    //
+    HRESULT Notify(
+        HANDLE Socket,
+        XSK_NOTIFY_FLAGS Flags,
+        UINT32 TimeoutMs,
+        _Out_ XSK_NOTIFY_RESULT_FLAGS* Result) override
+    {
+        RioSocket* Rio = (RioSocket*)Socket;
+        *Result = XSK_NOTIFY_RESULT_FLAG_NONE;
+
+        if (Flags & (XSK_NOTIFY_FLAG_POKE_RX | XSK_NOTIFY_FLAG_WAIT_RX)) {
+            if (auto PumpResult = Pump(Rio); FAILED(PumpResult)) {
+                return PumpResult;
+            }
+        }
+
+        if ((Flags & XSK_NOTIFY_FLAG_WAIT_RX) && !Rio->Rings.RxAvailable() && TimeoutMs != 0) {
+            INT NotifyResult = Functions.RIONotify(Rio->Completions);
+            if (NotifyResult != ERROR_SUCCESS && NotifyResult != WSAEALREADY) {
+                return HRESULT_FROM_WIN32(NotifyResult);
+            }
+            if (WaitForSingleObject(Rio->Event, TimeoutMs) == WAIT_FAILED) {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+            if (auto PumpResult = Pump(Rio); FAILED(PumpResult)) {
+                return PumpResult;
+            }
+        }
+
+        if ((Flags & XSK_NOTIFY_FLAG_WAIT_RX) && Rio->Rings.RxAvailable()) {
+            *Result |= XSK_NOTIFY_RESULT_FLAG_RX_AVAILABLE;
+        }
+        return S_OK;
+    }
+
+    //
+    // Nothing is posted or completed unless the caller pumps, so every
+    // refill is worth a poke.
+    //
+    bool NeedsPoke(const XSK_RING* Ring) const override
+    {
+        UNREFERENCED_PARAMETER(Ring);
+        return true;
+    }
+
+  private:
+    HRESULT OpenPort(_Inout_ RioSocket* Rio, _Inout_ RioPort* Port)
+    {
+        Port->Socket = WSASocketW(AF_INET, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+        if (Port->Socket == INVALID_SOCKET) {
+            return LastSocketError();
+        }
+
+        int ReceiveBuffer = 8 << 20;
+        setsockopt(Port->Socket, SOL_SOCKET, SO_RCVBUF, (const char*)&ReceiveBuffer, sizeof(ReceiveBuffer));
+
+        sockaddr_in Address {};
+        Address.sin_family = AF_INET;
+        Address.sin_port = htons(Port->Port);
+        Address.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(Port->Socket, (sockaddr*)&Address, sizeof(Address)) != 0) {
+            return LastSocketError();
+        }
+
+        Port->Queue = Functions.RIOCreateRequestQueue(
+            Port->Socket, Rio->ReceiveDepth, 1, 1, 1, Rio->Completions, Rio->Completions, Port);
+        if (Port->Queue == RIO_INVALID_RQ) {
+            return LastSocketError();
+        }
+        return S_OK;
+    }
+
+    //
+    // Posts spare and fill buffers as receives, a deferred batch per port
+    // committed at once, then moves up to the RX ring's room of completions
+    // onto it. Failed and truncated receives put their chunk back on the
+    // spare list, the way an XDP socket drops frames longer than a chunk.
+    //
+    HRESULT Pump(_Inout_ RioSocket* Rio)
+    {
+        UserRingSocket& Rings = Rio->Rings;
+
+        for (auto& Port : Rio->Ports) {
+            if (Port->Queue == RIO_INVALID_RQ || Port->Posted >= Rio->ReceiveDepth) {
+                continue;
+            }
+
+            UINT32 Wanted = Rio->ReceiveDepth - Port->Posted;
+            UINT32 Have = (UINT32)Rio->Spare.size();
+            if (Have < Wanted) {
+                UINT64 Taken[RioBatch];
+                UINT32 Count = Rings.TakeFillBuffers(Taken, std::min(Wanted - Have, RioBatch));
+                Rio->Spare.insert(Rio->Spare.end(), Taken, Taken + Count);
+            }
+
+            UINT32 Posted = 0;
+            while (Posted < Wanted && !Rio->Spare.empty()) {
+                UINT64 Address = Rio->Spare.back();
+                UINT32 Chunk = Rings.Chunk(Address);
+
+                RIO_BUF Data {Rio->Umem, (ULONG)(Address + UserRingSocket::HeaderLength), Rings.PayloadRoom()};
+                RIO_BUF Local {
+                    Rio->AddressBuffer,
+                    (ULONG)(Chunk * sizeof(RioAddresses) + FIELD_OFFSET(RioAddresses, Local)),
+                    sizeof(SOCKADDR_INET)};
+                RIO_BUF Remote {
+                    Rio->AddressBuffer,
+                    (ULONG)(Chunk * sizeof(RioAddresses) + FIELD_OFFSET(RioAddresses, Remote)),
+                    sizeof(SOCKADDR_INET)};
+                if (!Functions.RIOReceiveEx(
+                        Port->Queue, &Data, 1, &Local, &Remote, nullptr, nullptr, RIO_MSG_DEFER, (PVOID)Address)) {
+                    break;
+                }
+                Rio->Spare.pop_back();
+                Posted++;
+            }
+            if (Posted != 0) {
+                Functions.RIOReceiveEx(
+                    Port->Queue, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr);
+                Port->Posted += Posted;
+            }
+        }
+
+        RIORESULT Results[RioBatch];
+        for (;;) {
+            UINT32 Room = std::min(Rings.RxRoom(), RioBatch);
+            if (Room == 0) {
+                break;
+            }
+            ULONG Count = Functions.RIODequeueCompletion(Rio->Completions, Results, Room);
+            if (Count == RIO_CORRUPT_CQ) {
+                return E_FAIL;
+            }
+            if (Count == 0) {
+                break;
+            }
+
+            for (ULONG i = 0; i < Count; i++) {
+                UINT64 Address = (UINT64)Results[i].RequestContext;
+                RioPort* Port = (RioPort*)Results[i].SocketContext;
+                Port->Posted--;
+
+                if (Results[i].Status != NO_ERROR || Port->Queue == RIO_INVALID_RQ) {
+                    Rio->Spare.push_back(Address);
+                    continue;
+                }
+
+                const RioAddresses& Addresses = Rio->Addresses[Rings.Chunk(Address)];
+                UINT32 Destination =
+                    Addresses.Local.si_family == AF_INET ? ntohl(Addresses.Local.Ipv4.sin_addr.s_addr) : INADDR_ANY;
+                Rings.Deliver(
+                    Address,
+                    Results[i].BytesTransferred,
+                    ntohl(Addresses.Remote.Ipv4.sin_addr.s_addr),
+                    ntohs(Addresses.Remote.Ipv4.sin_port),
+                    Destination,
+                    Port->Port);
+            }
+            Rings.SubmitRx();
+        }
+        return S_OK;
+    }
+
+    RIO_EXTENSION_FUNCTION_TABLE Functions {};
+    HRESULT Status = S_OK;
+    bool Started = false;
+};
+
+} // namespace
+
+std::unique_ptr<XskBackend> CreateSocketBackend()
+{
+    return std::make_unique<RioBackend>();
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+#include "PcapReader.h"
+#include "RssPredictor.h"
+
+static const struct {
+    const char* Name;
+    UINT32 HashTypes;
+} HashTypeNames[] = {
+    {"ipv4", XDP_RSS_HASH_TYPE_IPV4},
+    {"tcp4", XDP_RSS_HASH_TYPE_TCP_IPV4},
+    {"udp4", XDP_RSS_HASH_TYPE_UDP_IPV4},
+    {"ipv6", XDP_RSS_HASH_TYPE_IPV6},
+    {"tcp6", XDP_RSS_HASH_TYPE_TCP_IPV6},
+    {"udp6", XDP_RSS_HASH_TYPE_UDP_IPV6},
+    {"all", XDP_RSS_VALID_HASH_TYPES},
+};
+
+//
+// Hash types are a number or a comma separated list of names.
+//
+static bool ParseHashTypes(const char* Text, _Out_ UINT32* HashTypes)
+{
+    char* End;
+    *HashTypes = (UINT32)strtoul(Text, &End, 0);
+    if (End != Text && *End == '\0') {
+        return (*HashTypes & ~XDP_RSS_VALID_HASH_TYPES) == 0;
+    }
+
+    *HashTypes = 0;
+    while (*Text != '\0') {
+        size_t Length = strcspn(Text, ",");
+        bool Found = false;
+        for (const auto& Entry : HashTypeNames) {
+            if (strlen(Entry.Name) == Length && strncmp(Entry.Name, Text, Length) == 0) {
+                *HashTypes |= Entry.HashTypes;
+                Found = true;
+            }
+        }
+        if (!Found) {
+            return false;
+        }
+        Text += Length;
+        if (*Text == ',') {
+            Text++;
+        }
+    }
+    return true;
+}
+
+static bool ParseKey(const char* Text, std::vector<UINT8>* Key)
+{
+    Key->clear();
+    while (Text[0] != '\0') {
+        if (Text[1] == '\0' || Key->size() == ToeplitzHash::MaxKeySize) {
+            return false;
+        }
+        char Byte[3] = {Text[0], Text[1], '\0'};
+        char* End;
+        Key->push_back((UINT8)strtoul(Byte, &End, 16));
+        if (End != Byte + 2) {
+            return false;
+        }
+        Text += 2;
+    }
+    return Key->size() >= 4;
+}
+
+//
+// Reads a capture and prints the receive queue each frame would land on,
+// for a round-robin indirection table over Queues processors.
+//
+int RssPredictCommand(int argc, char** argv)
+{
+    if (argc < 1) {
+        fprintf(
+            stderr,
+            "xdp_recv.exe --rss-predict <file.pcap> [queues] [table-size] [hash-types] [key-hex]\n"
+            "\n"
+            "hash-types is a number or a list of ipv4,tcp4,udp4,ipv6,tcp6,udp6,all (default all).\n"
+            "key-hex defaults to the standard 40-byte Windows RSS key.\n");
+        return EXIT_FAILURE;
+    }
+
+    UINT32 Queues = argc >= 2 ? atoi(argv[1]) : 4;
+    UINT32 TableSize = argc >= 3 ? atoi(argv[2]) : 128;
+    UINT32 HashTypes = XDP_RSS_VALID_HASH_TYPES;
+    std::vector<UINT8> Key(RssPredictor::DefaultKey, RssPredictor::DefaultKey + sizeof(RssPredictor::DefaultKey));
+
+    //
+    // Queues are numbered by processor, and a PROCESSOR_NUMBER holds 256 of
+    // them per group.
+    //
+    if (Queues == 0 || Queues > 256) {
+        fprintf(stderr, "need 1 to 256 queues\n");
+        return EXIT_FAILURE;
+    }
+    if (TableSize < Queues) {
+        fprintf(stderr, "need a table of at least %u entries\n", Queues);
+        return EXIT_FAILURE;
+    }
+    if (argc >= 4 && !ParseHashTypes(argv[3], &HashTypes)) {
+        fprintf(stderr, "invalid hash types: %s\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+    if (argc >= 5 && !ParseKey(argv[4], &Key)) {
+        fprintf(stderr, "invalid key: %s\n", argv[4]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<PROCESSOR_NUMBER> Table(TableSize);
+    for (UINT32 Bucket = 0; Bucket < TableSize; Bucket++) {
+        Table[Bucket].Number = (BYTE)(Bucket % Queues);
+    }
+    std::unique_ptr<RssPredictor> Created;
+    if (FAILED(RssPredictor::Create(HashTypes, Key.data(), (UINT32)Key.size(), Table.data(), TableSize, &Created))) {
+        fprintf(stderr, "table size must be a power of two: %u\n", TableSize);
+        return EXIT_FAILURE;
+    }
+    const RssPredictor& Predictor = *Created;
+
+    PcapReader Reader;
+    if (HRESULT Result = Reader.Open(argv[0]); FAILED(Result)) {
+        fprintf(stderr, "cannot read %s: %x\n", argv[0], Result);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<UINT64> Frames(Queues);
+    std::vector<std::unordered_set<UINT32>> Flows(Queues);
+    UINT64 Total = 0;
+    UINT64 Unhashed = 0;
+    const UCHAR* Frame;
+    UINT32 Length;
+
+    while (Reader.Next(&Frame, &Length)) {
+        UINT32 Hash;
+        UINT32 Queue = 0;
+
+        if (Predictor.HashFrame(Frame, Length, &Hash)) {
+            Queue = Predictor.QueueOfHash(Hash);
+            Flows[Queue].insert(Hash);
+        } else {
+            Unhashed++;
+        }
+        Frames[Queue]++;
+        Total++;
+    }
+
+    printf(
+        "%llu frames, %llu not hashed (counted on queue 0), hash types 0x%x, %u-entry table\n\n",
+        (unsigned long long)Total,
+        (unsigned long long)Unhashed,
+        HashTypes,
+        TableSize);
+    printf("%6s %12s %8s %10s\n", "queue", "frames", "share", "flows");
+
+    UINT64 Hottest = 0;
+    for (UINT32 Queue = 0; Queue < Queues; Queue++) {
+        printf(
+            "%6u %12llu %7.2f%% %10zu\n",
+            Queue,
+            (unsigned long long)Frames[Queue],
+            Total != 0 ? 100.0 * Frames[Queue] / Total : 0.0,
+            Flows[Queue].size());
+        Hottest = std::max(Hottest, Frames[Queue]);
+    }
+    printf("\nhottest queue over mean: %.2f\n", Total != 0 ? (double)Hottest * Queues / Total : 0.0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,227 @@
+#include "RssPredictor.h"
+#include "PacketHeaders.h"
+
+#include <algorithm>
+#include <iterator>
+
+const UINT8 RssPredictor::DefaultKey[40] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3,
+    0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3,
+    0x80, 0x30, 0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+RssPredictor::RssPredictor(
+    UINT32 HashTypes,
+    _In_reads_(KeySize) const UINT8* Key,
+    UINT32 KeySize,
+    _In_reads_(TableEntries) const PROCESSOR_NUMBER* Table,
+    UINT32 TableEntries)
+    : HashTypes(HashTypes)
+    , Toeplitz(Key, KeySize)
+{
+    BucketQueue.resize(TableEntries);
+    BucketMask = TableEntries - 1;
+
+    for (UINT32 Bucket = 0; Bucket < TableEntries; Bucket++) {
+        UINT32 Queue = 0;
+        while (Queue < QueueProcessors.size() && (QueueProcessors[Queue].Group != Table[Bucket].Group ||
+                                                  QueueProcessors[Queue].Number != Table[Bucket].Number)) {
+            Queue++;
+        }
+        if (Queue == QueueProcessors.size()) {
+            QueueProcessors.push_back(Table[Bucket]);
+        }
+        BucketQueue[Bucket] = Queue;
+    }
+
+    if (QueueProcessors.empty()) {
+        QueueProcessors.push_back({});
+    }
+}
+
+HRESULT RssPredictor::Create(
+    UINT32 HashTypes,
+    _In_reads_(KeySize) const UINT8* Key,
+    UINT32 KeySize,
+    _In_reads_(TableEntries) const PROCESSOR_NUMBER* Table,
+    UINT32 TableEntries,
+    _Out_ std::unique_ptr<RssPredictor>* Predictor)
+{
+    if (TableEntries == 0 || (TableEntries & (TableEntries - 1)) != 0 || KeySize > ToeplitzHash::MaxKeySize) {
+        return E_INVALIDARG;
+    }
+
+    *Predictor = std::make_unique<RssPredictor>(HashTypes, Key, KeySize, Table, TableEntries);
+    return S_OK;
+}
+
+HRESULT RssPredictor::FromConfiguration(
+    _In_reads_bytes_(Size) const XDP_RSS_CONFIGURATION* Rss,
+    UINT32 Size,
+    _Out_ std::unique_ptr<RssPredictor>* Predictor)
+{
+    if (Size < sizeof(*Rss) || (UINT32)Rss->HashSecretKeyOffset + Rss->HashSecretKeySize > Size ||
+        (UINT32)Rss->IndirectionTableOffset + Rss->IndirectionTableSize > Size) {
+        return E_INVALIDARG;
+    }
+
+    const UCHAR* Base = (const UCHAR*)Rss;
+    return Create(
+        Rss->HashType,
+        Base + Rss->HashSecretKeyOffset,
+        Rss->HashSecretKeySize,
+        (const PROCESSOR_NUMBER*)(Base + Rss->IndirectionTableOffset),
+        Rss->IndirectionTableSize / sizeof(PROCESSOR_NUMBER),
+        Predictor);
+}
+
+bool RssPredictor::SelectFields(
+    _In_reads_bytes_(Length) const UCHAR* Frame,
+    UINT32 Length,
+    _Out_ RssHashInput* Input) const
+{
+    UINT32 Offset = FIELD_OFFSET(EthernetHeader, EtherType);
+    UINT16 EtherType;
+
+    Input->Length = 0;
+    if (Length < sizeof(EthernetHeader)) {
+        return false;
+    }
+    memcpy(&EtherType, Frame + Offset, sizeof(EtherType));
+    Offset = sizeof(EthernetHeader);
+
+    if (EtherType == HostToNet16(EtherTypeVlan)) {
+        if (Length < Offset + VlanTagLength) {
+            return false;
+        }
+        memcpy(&EtherType, Frame + Offset + 2, sizeof(EtherType));
+        Offset += VlanTagLength;
+    }
+
+    UINT8 Protocol;
+    const UCHAR* Addresses;
+    UINT32 AddressLength;
+    const UCHAR* L4;
+    UINT32 L4Length;
+    bool Fragment;
+    UINT32 AddressType;
+    UINT32 TcpType;
+    UINT32 UdpType;
+
+    if (EtherType == HostToNet16(EtherTypeIpv4)) {
+        if (Length < Offset + sizeof(Ipv4Header)) {
+            return false;
+        }
+        const Ipv4Header* Ip = (const Ipv4Header*)(Frame + Offset);
+        UINT32 HeaderLength = (Ip->VersionAndHeaderLength & 0xf) * 4;
+        if (HeaderLength < sizeof(Ipv4Header) || Length < Offset + HeaderLength) {
+            return false;
+        }
+
+        Protocol = Ip->Protocol;
+        Addresses = (const UCHAR*)&Ip->SourceAddress;
+        AddressLength = 8;
+        L4 = (const UCHAR*)Ip + HeaderLength;
+        L4Length = Length - Offset - HeaderLength;
+        Fragment = Ipv4IsFragment(Ip);
+        AddressType = XDP_RSS_HASH_TYPE_IPV4;
+        TcpType = XDP_RSS_HASH_TYPE_TCP_IPV4;
+        UdpType = XDP_RSS_HASH_TYPE_UDP_IPV4;
+    } else if (EtherType == HostToNet16(EtherTypeIpv6)) {
+        if (Length < Offset + sizeof(Ipv6Header)) {
+            return false;
+        }
+        const Ipv6Header* Ip = (const Ipv6Header*)(Frame + Offset);
+
+        Protocol = Ip->NextHeader;
+        Addresses = Ip->SourceAddress;
+        AddressLength = 32;
+        L4 = (const UCHAR*)(Ip + 1);
+        L4Length = Length - Offset - sizeof(Ipv6Header);
+        Fragment = false;
+        AddressType = XDP_RSS_HASH_TYPE_IPV6 | XDP_RSS_HASH_TYPE_IPV6_EX;
+        TcpType = XDP_RSS_HASH_TYPE_TCP_IPV6 | XDP_RSS_HASH_TYPE_TCP_IPV6_EX;
+        UdpType = XDP_RSS_HASH_TYPE_UDP_IPV6 | XDP_RSS_HASH_TYPE_UDP_IPV6_EX;
+    } else {
+        return false;
+    }
+
+    bool HashPorts = !Fragment && L4Length >= 4 &&
+                     ((Protocol == IpProtocolTcp && (HashTypes & TcpType) != 0) ||
+                      (Protocol == IpProtocolUdp && (HashTypes & UdpType) != 0));
+
+    if (!HashPorts && (HashTypes & AddressType) == 0) {
+        return false;
+    }
+
+    memcpy(Input->Bytes, Addresses, AddressLength);
+    Input->Length = AddressLength;
+    if (HashPorts) {
+        memcpy(Input->Bytes + AddressLength, L4, 4);
+        Input->Length += 4;
+    }
+    return true;
+}
+
+bool RssPredictor::HashFrame(_In_reads_bytes_(Length) const UCHAR* Frame, UINT32 Length, _Out_ UINT32* Hash) const
+{
+    RssHashInput Input;
+
+    if (!SelectFields(Frame, Length, &Input)) {
+        *Hash = 0;
+        return false;
+    }
+    *Hash = Toeplitz.Hash(Input.Bytes, Input.Length);
+    return true;
+}
+
+UINT32 RssPredictor::PredictQueue(_In_reads_bytes_(Length) const UCHAR* Frame, UINT32 Length) const
+{
+    UINT32 Hash;
+    return HashFrame(Frame, Length, &Hash) ? QueueOfHash(Hash) : 0;
+}
+
+void RssPredictor::PredictBatch(
+    _In_reads_(Count) const UCHAR* const* Frames,
+    _In_reads_(Count) const UINT32* Lengths,
+    UINT32 Count,
+    _Out_writes_(Count) UINT32* Queues) const
+{
+    //
+    // Inputs are 8, 12, 32 or 36 bytes long. Each length gets its own
+    // contiguous scratch array so HashBatch() can process it in one call.
+    //
+    constexpr UINT32 Chunk = 64;
+    constexpr UINT32 InputLengths[] = {8, 12, 32, 36};
+    constexpr UINT32 LengthClasses = (UINT32)std::size(InputLengths);
+    UINT8 Scratch[LengthClasses][Chunk * ToeplitzHash::MaxInputLength];
+    UINT32 Indices[LengthClasses][Chunk];
+    UINT32 Hashes[Chunk];
+
+    for (UINT32 Start = 0; Start < Count; Start += Chunk) {
+        UINT32 End = std::min(Start + Chunk, Count);
+        UINT32 Filled[LengthClasses] = {};
+
+        for (UINT32 i = Start; i < End; i++) {
+            RssHashInput Input;
+            Queues[i] = 0;
+            if (!SelectFields(Frames[i], Lengths[i], &Input)) {
+                continue;
+            }
+
+            UINT32 Class = 0;
+            while (InputLengths[Class] != Input.Length) {
+                Class++;
+            }
+            memcpy(&Scratch[Class][Filled[Class] * Input.Length], Input.Bytes, Input.Length);
+            Indices[Class][Filled[Class]++] = i;
+        }
+
+        for (UINT32 Class = 0; Class < LengthClasses; Class++) {
+            Toeplitz.HashBatch(Scratch[Class], InputLengths[Class], InputLengths[Class], Filled[Class], Hashes);
+            for (UINT32 j = 0; j < Filled[Class]; j++) {
+                Queues[Indices[Class][j]] = QueueOfHash(Hashes[j]);
+            }
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <windows.h>
+#include <xdpapi.h>
+#include <xdpapi_experimental.h>
+
+#include <memory>
+#include <vector>
+
+#include "ToeplitzHash.h"
+
+//
+// The bytes RSS hashes for one frame, in hash order: source address,
+// destination address and, for hash types that include them, source and
+// destination port.
+//
+struct RssHashInput {
+    UINT8 Bytes[ToeplitzHash::MaxInputLength];
+    UINT32 Length;
+};
+
+//
+// Predicts the receive queue a NIC picks for a frame, given the RSS hash
+// types, secret key and indirection table it was configured with.
+//
+// Field selection follows XDP_RSS_HASH_TYPE_*: TCP and UDP frames hash the
+// 4-tuple if their protocol's hash type is enabled, otherwise the address
+// pair if the IP version's hash type is; fragments never hash ports. The
+// IPV6_EX types are treated as their plain counterparts, since extension
+// header addresses are not parsed. Frames that hash nothing go to the first
+// queue, as the NIC's default queue.
+//
+// Queues are the distinct processors of the indirection table, in order of
+// first appearance, as in RssRebalanceService.
+//
+class RssPredictor {
+  public:
+    //
+    // The key Windows uses when none is configured.
+    //
+    static const UINT8 DefaultKey[40];
+
+    //
+    // NICs index the table with the low bits of the hash, so TableEntries
+    // must be a non-zero power of two and KeySize at most
+    // ToeplitzHash::MaxKeySize. Create() checks both; the constructor is for
+    // tables and keys known to be valid.
+    //
+    RssPredictor(
+        UINT32 HashTypes,
+        _In_reads_(KeySize) const UINT8* Key,
+        UINT32 KeySize,
+        _In_reads_(TableEntries) const PROCESSOR_NUMBER* Table,
+        UINT32 TableEntries);
+
+    static HRESULT Create(
+        UINT32 HashTypes,
+        _In_reads_(KeySize) const UINT8* Key,
+        UINT32 KeySize,
+        _In_reads_(TableEntries) const PROCESSOR_NUMBER* Table,
+        UINT32 TableEntries,
+        _Out_ std::unique_ptr<RssPredictor>* Predictor);
+
+    //
+    // From a configuration returned by XdpRssGet or about to be passed to
+    // XdpRssSet. Every field must be present.
+    //
+    static HRESULT FromConfiguration(
+        _In_reads_bytes_(Size) const XDP_RSS_CONFIGURATION* Rss,
+        UINT32 Size,
+        _Out_ std::unique_ptr<RssPredictor>* Predictor);
+
+    //
+    // Returns false if the frame is not hashed.
+    //
+    bool SelectFields(_In_reads_bytes_(Length) const UCHAR* Frame, UINT32 Length, _Out_ RssHashInput* Input) const;
+    bool HashFrame(_In_reads_bytes_(Length) const UCHAR* Frame, UINT32 Length, _Out_ UINT32* Hash) const;
+
+    UINT32 QueueOfHash(UINT32 Hash) const { return BucketQueue[Hash & BucketMask]; }
+    UINT32 PredictQueue(_In_reads_bytes_(Length) const UCHAR* Frame, UINT32 Length) const;
+
+    //
+    // Batch prediction. Inputs of the same length are hashed together
+    // through ToeplitzHash::HashBatch().
+    //
+    void PredictBatch(
+        _In_reads_(Count) const UCHAR* const* Frames,
+        _In_reads_(Count) const UINT32* Lengths,
+        UINT32 Count,
+        _Out_writes_(Count) UINT32* Queues) const;
+
+    UINT32 QueueCount() const { return (UINT32)QueueProcessors.size(); }
+    const PROCESSOR_NUMBER& QueueProcessor(UINT32 Queue) const { return QueueProcessors[Queue]; }
+    const ToeplitzHash& Hasher() const { return Toeplitz; }
+
+  private:
+    UINT32 HashTypes;
+    ToeplitzHash Toeplitz;
+    std::vector<UINT32> BucketQueue;
+    UINT32 BucketMask;
+    std::vector<PROCESSOR_NUMBER> QueueProcessors;
+};
+
+//
+// xdp_recv.exe --rss-predict: per-queue distribution of a pcap file.
+//
+int RssPredictCommand(int argc, char** argv);
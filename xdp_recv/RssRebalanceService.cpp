@@ -0,0 +1,197 @@
+#include "RssRebalanceService.h"
+
+#include <stdio.h>
+
+static bool SameProcessor(const PROCESSOR_NUMBER& A, const PROCESSOR_NUMBER& B)
+{
+    return A.Group == B.Group && A.Number == B.Number;
+}
+
+RssRebalanceService::RssRebalanceService(
+    _In_ const XDP_API_TABLE* XdpApi,
+    UINT32 IfIndex,
+    const RssRebalancerConfig& Config)
+    : XdpApi(XdpApi)
+    , IfIndex(IfIndex)
+    , Config(Config)
+{
+}
+
+RssRebalanceService::~RssRebalanceService()
+{
+    Stop();
+
+    if (Interface != nullptr) {
+        CloseHandle(Interface);
+    }
+}
+
+HRESULT RssRebalanceService::Open()
+{
+    RssGet = (XDP_RSS_GET_FN*)XdpApi->XdpGetRoutine(XDP_RSS_GET_FN_NAME);
+    RssSet = (XDP_RSS_SET_FN*)XdpApi->XdpGetRoutine(XDP_RSS_SET_FN_NAME);
+    if (RssGet == nullptr || RssSet == nullptr) {
+        return E_NOINTERFACE;
+    }
+
+    if (HRESULT Result = XdpApi->XdpInterfaceOpen(IfIndex, &Interface); FAILED(Result)) {
+        return Result;
+    }
+
+    if (HRESULT Result = ReadTable(); FAILED(Result)) {
+        return Result;
+    }
+
+    for (const PROCESSOR_NUMBER& Processor : Table) {
+        if (QueueOf(Processor) == MAXUINT32) {
+            QueueProcessors.push_back(Processor);
+        }
+    }
+
+    Rebalancer.emplace((UINT32)Table.size(), (UINT32)QueueProcessors.size(), Config);
+    SyncRebalancerTable();
+    return S_OK;
+}
+
+UINT32 RssRebalanceService::QueueOf(const PROCESSOR_NUMBER& Processor) const
+{
+    for (UINT32 Queue = 0; Queue < QueueProcessors.size(); Queue++) {
+        if (SameProcessor(QueueProcessors[Queue], Processor)) {
+            return Queue;
+        }
+    }
+    return MAXUINT32;
+}
+
+void RssRebalanceService::SyncRebalancerTable()
+{
+    std::vector<UINT32> BucketToQueue(Table.size());
+    for (size_t Bucket = 0; Bucket < Table.size(); Bucket++) {
+        BucketToQueue[Bucket] = QueueOf(Table[Bucket]);
+    }
+    Rebalancer->SetTable(BucketToQueue.data());
+}
+
+HRESULT RssRebalanceService::ReadTable()
+{
+    UINT32 Size = 0;
+    HRESULT Result = RssGet(Interface, nullptr, &Size);
+    if (Result != HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER)) {
+        return FAILED(Result) ? Result : E_UNEXPECTED;
+    }
+
+    Configuration.resize(Size);
+    XDP_RSS_CONFIGURATION* Rss = (XDP_RSS_CONFIGURATION*)Configuration.data();
+    if (Result = RssGet(Interface, Rss, &Size); FAILED(Result)) {
+        return Result;
+    }
+
+    if ((Rss->Flags & XDP_RSS_FLAG_DISABLED) != 0 || Rss->IndirectionTableSize < sizeof(PROCESSOR_NUMBER) ||
+        (UINT32)Rss->IndirectionTableOffset + Rss->IndirectionTableSize > Size) {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    UINT32 Entries = Rss->IndirectionTableSize / sizeof(PROCESSOR_NUMBER);
+    if ((Entries & (Entries - 1)) != 0) {
+        //
+        // Buckets are the low bits of the hash.
+        //
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    const PROCESSOR_NUMBER* Entry = (const PROCESSOR_NUMBER*)(Configuration.data() + Rss->IndirectionTableOffset);
+    Table.assign(Entry, Entry + Entries);
+    return S_OK;
+}
+
+HRESULT RssRebalanceService::CreateHasher(_Out_ std::unique_ptr<RssPredictor>* Hasher) const
+{
+    *Hasher = nullptr;
+    if (Configuration.empty()) {
+        return E_UNEXPECTED;
+    }
+    return RssPredictor::FromConfiguration(
+        (const XDP_RSS_CONFIGURATION*)Configuration.data(), (UINT32)Configuration.size(), Hasher);
+}
+
+HRESULT RssRebalanceService::WriteTable(const std::vector<UINT32>& BucketToQueue)
+{
+    UINT32 TableSize = (UINT32)(BucketToQueue.size() * sizeof(PROCESSOR_NUMBER));
+    UINT32 Size = sizeof(XDP_RSS_CONFIGURATION) + TableSize;
+    std::vector<UCHAR> Buffer(Size);
+    XDP_RSS_CONFIGURATION* Rss = (XDP_RSS_CONFIGURATION*)Buffer.data();
+
+    XdpInitializeRssConfiguration(Rss, Size);
+    Rss->Flags = XDP_RSS_FLAG_SET_INDIRECTION_TABLE;
+    Rss->IndirectionTableOffset = sizeof(XDP_RSS_CONFIGURATION);
+    Rss->IndirectionTableSize = (UINT16)TableSize;
+
+    PROCESSOR_NUMBER* Entry = (PROCESSOR_NUMBER*)(Buffer.data() + Rss->IndirectionTableOffset);
+    for (size_t Bucket = 0; Bucket < BucketToQueue.size(); Bucket++) {
+        Entry[Bucket] = QueueProcessors[BucketToQueue[Bucket]];
+    }
+
+    if (HRESULT Result = RssSet(Interface, Rss, Size); FAILED(Result)) {
+        return Result;
+    }
+
+    Table.assign(Entry, Entry + BucketToQueue.size());
+    return S_OK;
+}
+
+void RssRebalanceService::Start(const RssLoadCounters& Counters, UINT32 PeriodMs)
+{
+    if (!Rebalancer.has_value() || Thread.joinable()) {
+        return;
+    }
+
+    StopRequested = false;
+    Thread = std::thread(&RssRebalanceService::RebalanceThread, this, &Counters, PeriodMs);
+}
+
+void RssRebalanceService::Stop()
+{
+    if (!Thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+        StopRequested = true;
+    }
+    Wake.notify_all();
+    Thread.join();
+}
+
+void RssRebalanceService::RebalanceThread(const RssLoadCounters* Counters, UINT32 PeriodMs)
+{
+    std::vector<UINT64> Previous(Table.size());
+    std::vector<UINT64> Current(Table.size());
+    std::vector<UINT64> Delta(Table.size());
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Last;
+    LARGE_INTEGER Now;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Last);
+    Counters->Snapshot(Previous.data());
+
+    std::unique_lock<std::mutex> Guard(Lock);
+    while (!Wake.wait_for(Guard, std::chrono::milliseconds(PeriodMs), [this] { return StopRequested; })) {
+        QueryPerformanceCounter(&Now);
+        Counters->Snapshot(Current.data());
+        for (size_t Bucket = 0; Bucket < Table.size(); Bucket++) {
+            Delta[Bucket] = Current[Bucket] - Previous[Bucket];
+        }
+        double Seconds = (double)(Now.QuadPart - Last.QuadPart) / Frequency.QuadPart;
+        Previous.swap(Current);
+        Last = Now;
+
+        if (Rebalancer->Update(Delta.data(), Seconds)) {
+            if (HRESULT Result = WriteTable(Rebalancer->Table()); FAILED(Result)) {
+                fprintf(stderr, "ERR: XdpRssSet failed: %x\n", Result);
+                SyncRebalancerTable();
+            }
+        }
+    }
+}
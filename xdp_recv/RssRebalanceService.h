@@ -0,0 +1,89 @@
+#pragma once
+
+#include <windows.h>
+#include <xdpapi.h>
+#include <xdpapi_experimental.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "RssPredictor.h"
+#include "RssRebalancer.h"
+
+//
+// Keeps the RSS indirection table of an interface balanced. Every period the
+// service samples the RX workers' per-bucket counters, feeds them to an
+// RssRebalancer and writes the table back with XdpRssSet when it changes.
+// XDP 1.0.2 RX descriptors carry no RSS hash, so workers hash each frame
+// themselves with the NIC's hash types and key (see CreateHasher()).
+//
+// The NIC's table maps buckets to processors. The distinct processors of the
+// table as read at Open() are the service's queues, in order of first
+// appearance; rewrites only redistribute buckets among those processors.
+//
+// RSS settings revert to the NIC's own when the service closes the interface
+// handle.
+//
+class RssRebalanceService {
+  public:
+    RssRebalanceService(_In_ const XDP_API_TABLE* XdpApi, UINT32 IfIndex, const RssRebalancerConfig& Config = {});
+    ~RssRebalanceService();
+
+    RssRebalanceService(const RssRebalanceService&) = delete;
+    RssRebalanceService& operator=(const RssRebalanceService&) = delete;
+
+    //
+    // Opens the interface and reads its current RSS configuration.
+    //
+    HRESULT Open();
+
+    //
+    // Valid after Open(). Workers size their RssLoadCounters with
+    // BucketCount() and derive the bucket from the RSS hash of each frame as
+    // Hash & (BucketCount() - 1).
+    //
+    UINT32 BucketCount() const { return (UINT32)Table.size(); }
+
+    //
+    // A predictor with the NIC's hash types and key, as read at Open(), for
+    // workers to hash frames with. Its queue mapping is the table of that
+    // moment and goes stale with the first rewrite; only its hash is meant
+    // to be used.
+    //
+    HRESULT CreateHasher(_Out_ std::unique_ptr<RssPredictor>* Hasher) const;
+    const std::vector<PROCESSOR_NUMBER>& Processors() const { return QueueProcessors; }
+
+    void Start(const RssLoadCounters& Counters, UINT32 PeriodMs = 1000);
+    void Stop();
+
+    const RssRebalancerStats& Statistics() const { return Rebalancer->Statistics(); }
+
+  private:
+    HRESULT ReadTable();
+    UINT32 QueueOf(const PROCESSOR_NUMBER& Processor) const;
+    void SyncRebalancerTable();
+    HRESULT WriteTable(const std::vector<UINT32>& BucketToQueue);
+    void RebalanceThread(const RssLoadCounters* Counters, UINT32 PeriodMs);
+
+    const XDP_API_TABLE* XdpApi;
+    UINT32 IfIndex;
+    RssRebalancerConfig Config;
+
+    HANDLE Interface = nullptr;
+    XDP_RSS_GET_FN* RssGet = nullptr;
+    XDP_RSS_SET_FN* RssSet = nullptr;
+
+    std::vector<UCHAR> Configuration;
+    std::vector<PROCESSOR_NUMBER> Table;
+    std::vector<PROCESSOR_NUMBER> QueueProcessors;
+    std::optional<RssRebalancer> Rebalancer;
+
+    std::thread Thread;
+    std::mutex Lock;
+    std::condition_variable Wake;
+    bool StopRequested = false;
+};
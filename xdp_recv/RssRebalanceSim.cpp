@@ -0,0 +1,235 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "RssRebalancer.h"
+
+//
+// One recorded flow: its RSS hash and packet rate, active from FirstPeriod
+// through LastPeriod.
+//
+struct RecordedFlow {
+    UINT32 Hash;
+    double Rate;
+    UINT32 FirstPeriod;
+    UINT32 LastPeriod;
+};
+
+//
+// Reads "<hash> <pps> [first-period [last-period]]" lines; '#' starts a
+// comment. The hash may be given in hex with a 0x prefix.
+//
+static bool LoadRecording(const char* Path, std::vector<RecordedFlow>* Flows)
+{
+    FILE* File = fopen(Path, "r");
+    if (File == nullptr) {
+        return false;
+    }
+
+    char Line[256];
+    while (fgets(Line, sizeof(Line), File) != nullptr) {
+        if (char* Comment = strchr(Line, '#'); Comment != nullptr) {
+            *Comment = '\0';
+        }
+
+        char* Cursor = Line;
+        char* End;
+        UINT32 Hash = (UINT32)strtoul(Cursor, &End, 0);
+        if (End == Cursor) {
+            continue;
+        }
+        Cursor = End;
+        double Rate = strtod(Cursor, &End);
+        if (End == Cursor) {
+            continue;
+        }
+        Cursor = End;
+        UINT32 First = (UINT32)strtoul(Cursor, &End, 0);
+        UINT32 Last = MAXUINT32;
+        if (End != Cursor) {
+            Cursor = End;
+            Last = (UINT32)strtoul(Cursor, &End, 0);
+            if (End == Cursor) {
+                Last = MAXUINT32;
+            }
+        }
+        Flows->push_back({Hash, Rate, First, Last});
+    }
+
+    fclose(File);
+    return true;
+}
+
+//
+// Zipf-distributed unicast flows plus one hot multicast group that starts a
+// third of the way in and stops at two thirds, the case that saturates a core
+// while its neighbours idle.
+//
+static std::vector<RecordedFlow> SyntheticRecording(UINT32 Periods, double TotalRate, double HotRate)
+{
+    constexpr UINT32 FlowCount = 4000;
+    std::mt19937 Random(7);
+    std::vector<RecordedFlow> Flows;
+
+    double Norm = 0;
+    for (UINT32 i = 1; i <= FlowCount; i++) {
+        Norm += 1.0 / pow(i, 1.1);
+    }
+    for (UINT32 i = 1; i <= FlowCount; i++) {
+        Flows.push_back({(UINT32)Random(), TotalRate / pow(i, 1.1) / Norm, 0, MAXUINT32});
+    }
+
+    Flows.push_back({(UINT32)Random(), HotRate, Periods / 3, Periods * 2 / 3});
+    return Flows;
+}
+
+enum class SimMode {
+    Static,
+    PerBucket,
+    PerQueue,
+};
+
+struct SimResult {
+    double MeanImbalance;
+    double WorstImbalance;
+    UINT32 OverloadedPeriods;
+    double ExcessPackets;
+    RssRebalancerStats Stats;
+};
+
+static SimResult Simulate(
+    const std::vector<RecordedFlow>& Flows,
+    SimMode Mode,
+    UINT32 Queues,
+    UINT32 TableSize,
+    UINT32 Periods,
+    double Capacity)
+{
+    RssRebalancer Rebalancer(TableSize, Queues);
+    std::mt19937 Random(11);
+    std::normal_distribution<double> Noise(1.0, 0.05);
+    std::vector<UINT64> BucketPackets(TableSize);
+    std::vector<UINT64> QueuePackets(Queues);
+    SimResult Result {};
+
+    for (UINT32 Period = 0; Period < Periods; Period++) {
+        std::fill(BucketPackets.begin(), BucketPackets.end(), 0);
+        for (const RecordedFlow& Flow : Flows) {
+            if (Period >= Flow.FirstPeriod && Period <= Flow.LastPeriod) {
+                BucketPackets[Flow.Hash & (TableSize - 1)] += (UINT64)std::max(0.0, Flow.Rate * Noise(Random));
+            }
+        }
+
+        //
+        // Load under the table in effect during this period.
+        //
+        const std::vector<UINT32>& Table = Rebalancer.Table();
+        std::fill(QueuePackets.begin(), QueuePackets.end(), 0);
+        for (UINT32 Bucket = 0; Bucket < TableSize; Bucket++) {
+            QueuePackets[Table[Bucket]] += BucketPackets[Bucket];
+        }
+
+        UINT64 Total = 0;
+        UINT64 Hottest = 0;
+        bool Overloaded = false;
+        for (UINT64 Packets : QueuePackets) {
+            Total += Packets;
+            Hottest = std::max(Hottest, Packets);
+            if (Packets > Capacity) {
+                Result.ExcessPackets += Packets - Capacity;
+                Overloaded = true;
+            }
+        }
+
+        double Imbalance = Total > 0 ? (double)Hottest * Queues / Total : 1.0;
+        Result.MeanImbalance += Imbalance / Periods;
+        Result.WorstImbalance = std::max(Result.WorstImbalance, Imbalance);
+        Result.OverloadedPeriods += Overloaded;
+
+        if (Mode == SimMode::PerBucket) {
+            Rebalancer.Update(BucketPackets.data(), 1.0);
+        } else if (Mode == SimMode::PerQueue) {
+            Rebalancer.UpdateFromQueues(QueuePackets.data(), 1.0);
+        }
+    }
+
+    Result.Stats = Rebalancer.Statistics();
+    return Result;
+}
+
+//
+// Replays recorded per-flow rates, one-second periods, against the
+// rebalancer and reports how evenly the queues were loaded and how many
+// packets exceeded a core's capacity.
+//
+int RssRebalanceSimulation(int argc, char** argv)
+{
+    const char* Recording = argc >= 1 ? argv[0] : "-";
+    UINT32 Queues = argc >= 2 ? atoi(argv[1]) : 8;
+    UINT32 TableSize = argc >= 3 ? atoi(argv[2]) : 128;
+    UINT32 Periods = argc >= 4 ? atoi(argv[3]) : 90;
+    double Capacity = argc >= 5 ? atof(argv[4]) : 1200000;
+
+    if (Queues == 0 || TableSize < Queues || (TableSize & (TableSize - 1)) != 0 || Periods == 0) {
+        fprintf(stderr, "need queues > 0 and a power-of-two table of at least that many entries\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<RecordedFlow> Flows;
+    if (strcmp(Recording, "-") == 0) {
+        Flows = SyntheticRecording(Periods, 6000000, 900000);
+    } else if (!LoadRecording(Recording, &Flows)) {
+        fprintf(stderr, "cannot read %s\n", Recording);
+        return EXIT_FAILURE;
+    }
+
+    printf(
+        "%zu flows, %u queues, %u-entry table, %u periods, capacity %.0f pps per queue\n\n",
+        Flows.size(),
+        Queues,
+        TableSize,
+        Periods,
+        Capacity);
+    printf(
+        "%-11s %10s %10s %11s %14s %9s %8s %13s\n",
+        "mode",
+        "mean-imb",
+        "worst-imb",
+        "overloaded",
+        "excess-pkts",
+        "rewrites",
+        "moves",
+        "unsplittable");
+
+    const struct {
+        const char* Name;
+        SimMode Mode;
+    } Modes[] = {
+        {"static", SimMode::Static},
+        {"per-bucket", SimMode::PerBucket},
+        {"per-queue", SimMode::PerQueue},
+    };
+
+    for (const auto& Entry : Modes) {
+        SimResult Result = Simulate(Flows, Entry.Mode, Queues, TableSize, Periods, Capacity);
+        printf(
+            "%-11s %10.2f %10.2f %11u %14.0f %9llu %8llu %13llu\n",
+            Entry.Name,
+            Result.MeanImbalance,
+            Result.WorstImbalance,
+            Result.OverloadedPeriods,
+            Result.ExcessPackets,
+            (unsigned long long)Result.Stats.Rewrites,
+            (unsigned long long)Result.Stats.BucketsMoved,
+            (unsigned long long)Result.Stats.Unsplittable);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+#include "RssRebalancer.h"
+
+#include <algorithm>
+
+RssRebalancer::RssRebalancer(UINT32 BucketCount, UINT32 QueueCount, const RssRebalancerConfig& Config)
+    : Config(Config)
+    , QueueCount(QueueCount)
+    , BucketToQueue(BucketCount)
+    , BucketRates(BucketCount)
+{
+    //
+    // Round robin, the layout most drivers start with.
+    //
+    for (UINT32 Bucket = 0; Bucket < BucketCount; Bucket++) {
+        BucketToQueue[Bucket] = Bucket % QueueCount;
+    }
+}
+
+void RssRebalancer::SetTable(_In_reads_(BucketCount) const UINT32* Table)
+{
+    BucketToQueue.assign(Table, Table + BucketToQueue.size());
+}
+
+void RssRebalancer::QueueRates(_Out_writes_(QueueCount) double* Rates) const
+{
+    std::fill(Rates, Rates + QueueCount, 0.0);
+    for (size_t Bucket = 0; Bucket < BucketRates.size(); Bucket++) {
+        Rates[BucketToQueue[Bucket]] += BucketRates[Bucket];
+    }
+}
+
+double RssRebalancer::Imbalance() const
+{
+    std::vector<double> Rates(QueueCount);
+    QueueRates(Rates.data());
+
+    double Total = 0;
+    double Hottest = 0;
+    for (double Rate : Rates) {
+        Total += Rate;
+        Hottest = std::max(Hottest, Rate);
+    }
+    return Total > 0 ? Hottest * QueueCount / Total : 1.0;
+}
+
+bool RssRebalancer::Update(_In_reads_(BucketCount) const UINT64* BucketPackets, double PeriodSeconds)
+{
+    double Weight = Primed ? Config.Smoothing : 1.0;
+    for (size_t Bucket = 0; Bucket < BucketRates.size(); Bucket++) {
+        double Rate = BucketPackets[Bucket] / PeriodSeconds;
+        BucketRates[Bucket] += Weight * (Rate - BucketRates[Bucket]);
+    }
+    Primed = true;
+    Stats.Periods++;
+
+    if (Cooldown > 0) {
+        Cooldown--;
+        return false;
+    }
+    return Rebalance();
+}
+
+bool RssRebalancer::UpdateFromQueues(_In_reads_(QueueCount) const UINT64* QueuePackets, double PeriodSeconds)
+{
+    std::vector<UINT32> BucketsPerQueue(QueueCount);
+    for (UINT32 Queue : BucketToQueue) {
+        BucketsPerQueue[Queue]++;
+    }
+
+    std::vector<UINT64> BucketPackets(BucketToQueue.size());
+    for (size_t Bucket = 0; Bucket < BucketToQueue.size(); Bucket++) {
+        UINT32 Queue = BucketToQueue[Bucket];
+        BucketPackets[Bucket] = QueuePackets[Queue] / BucketsPerQueue[Queue];
+    }
+
+    return Update(BucketPackets.data(), PeriodSeconds);
+}
+
+bool RssRebalancer::Rebalance()
+{
+    std::vector<double> Rates(QueueCount);
+    QueueRates(Rates.data());
+
+    double Total = 0;
+    for (double Rate : Rates) {
+        Total += Rate;
+    }
+    if (Total <= 0) {
+        return false;
+    }
+
+    double Mean = Total / QueueCount;
+    auto Hottest = [&] { return (UINT32)(std::max_element(Rates.begin(), Rates.end()) - Rates.begin()); };
+    auto Coldest = [&] { return (UINT32)(std::min_element(Rates.begin(), Rates.end()) - Rates.begin()); };
+
+    if (Rates[Hottest()] < Config.TriggerImbalance * Mean) {
+        return false;
+    }
+
+    UINT32 Moves = 0;
+    while (Moves < Config.MaxMovesPerUpdate && Rates[Hottest()] > Config.TargetImbalance * Mean) {
+        UINT32 From = Hottest();
+        UINT32 To = Coldest();
+        double Gap = Rates[From] - Rates[To];
+
+        //
+        // Move the largest bucket that still leaves the source hotter than
+        // the destination was, so every move lowers the maximum.
+        //
+        UINT32 Best = MAXUINT32;
+        for (UINT32 Bucket = 0; Bucket < BucketToQueue.size(); Bucket++) {
+            if (BucketToQueue[Bucket] == From && BucketRates[Bucket] > 0 && BucketRates[Bucket] < Gap &&
+                (Best == MAXUINT32 || BucketRates[Bucket] > BucketRates[Best])) {
+                Best = Bucket;
+            }
+        }
+        if (Best == MAXUINT32) {
+            break;
+        }
+
+        BucketToQueue[Best] = To;
+        Rates[From] -= BucketRates[Best];
+        Rates[To] += BucketRates[Best];
+        Moves++;
+    }
+
+    if (Moves == 0) {
+        Stats.Unsplittable++;
+        return false;
+    }
+
+    Stats.Rewrites++;
+    Stats.BucketsMoved += Moves;
+    Cooldown = Config.CooldownPeriods;
+    return true;
+}
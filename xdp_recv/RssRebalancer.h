@@ -0,0 +1,145 @@
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+//
+// Per-worker packet counts for each RSS indirection table entry ("bucket").
+// Each RX worker owns one row and is its only writer, so Record() is a plain
+// load and store; the sampler reads every row with relaxed loads.
+//
+class RssLoadCounters {
+  public:
+    RssLoadCounters(UINT32 Workers, UINT32 Buckets)
+        : Counts(std::make_unique<std::atomic<UINT64>[]>((size_t)Workers * RowStride(Buckets)))
+        , Workers(Workers)
+        , Buckets(Buckets)
+    {
+    }
+
+    //
+    // Worker side. Bucket is the low bits of the frame's RSS hash.
+    //
+    void Record(UINT32 Worker, UINT32 Bucket, UINT64 Packets = 1)
+    {
+        std::atomic<UINT64>& Count = Counts[(size_t)Worker * RowStride(Buckets) + Bucket];
+        Count.store(Count.load(std::memory_order_relaxed) + Packets, std::memory_order_relaxed);
+    }
+
+    //
+    // Sampler side. Sums every worker's count for each bucket.
+    //
+    void Snapshot(_Out_writes_(Buckets) UINT64* Totals) const
+    {
+        for (UINT32 Bucket = 0; Bucket < Buckets; Bucket++) {
+            Totals[Bucket] = 0;
+        }
+        for (UINT32 Worker = 0; Worker < Workers; Worker++) {
+            const std::atomic<UINT64>* Row = &Counts[(size_t)Worker * RowStride(Buckets)];
+            for (UINT32 Bucket = 0; Bucket < Buckets; Bucket++) {
+                Totals[Bucket] += Row[Bucket].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    UINT32 BucketCount() const { return Buckets; }
+
+  private:
+    //
+    // Rows are padded to whole cache lines so workers never share one.
+    //
+    static size_t RowStride(UINT32 Buckets) { return ((size_t)Buckets + 7) & ~(size_t)7; }
+
+    std::unique_ptr<std::atomic<UINT64>[]> Counts;
+    UINT32 Workers;
+    UINT32 Buckets;
+};
+
+struct RssRebalancerConfig {
+    //
+    // A rewrite is considered once the hottest queue carries this many times
+    // the mean queue load, and moves buckets until it is below the target.
+    // The gap between the two is the hysteresis band.
+    //
+    double TriggerImbalance = 1.25;
+    double TargetImbalance = 1.10;
+
+    //
+    // Upper bound on buckets moved per rewrite. Every move reorders the flows
+    // of the bucket once and moves their cache footprint to another core.
+    //
+    UINT32 MaxMovesPerUpdate = 16;
+
+    //
+    // Sampling periods to wait after a rewrite before the next one, so the
+    // effect of a rewrite is measured before acting again.
+    //
+    UINT32 CooldownPeriods = 2;
+
+    //
+    // Weight of the newest sample in the smoothed bucket rates.
+    //
+    double Smoothing = 0.5;
+};
+
+struct RssRebalancerStats {
+    UINT64 Periods;
+    UINT64 Rewrites;
+    UINT64 BucketsMoved;
+
+    //
+    // Periods over the trigger that found no improving move: the hot queue's
+    // load is a single bucket, which no indirection table can split.
+    //
+    UINT64 Unsplittable;
+};
+
+//
+// Decides how to rewrite an RSS indirection table so the receive queues carry
+// even load. The table maps each bucket to a queue index; mapping queue
+// indices to processors is up to the caller (see RssRebalanceService).
+//
+// Update() takes the packets each bucket received during one sampling period.
+// Workers that can only count per queue use UpdateFromQueues(), which spreads
+// each queue's packets evenly over its buckets; rewrites then converge over
+// several periods rather than in one step.
+//
+class RssRebalancer {
+  public:
+    RssRebalancer(UINT32 BucketCount, UINT32 QueueCount, const RssRebalancerConfig& Config = {});
+
+    //
+    // Replaces the current table, for example with the one read from the NIC.
+    //
+    void SetTable(_In_reads_(BucketCount) const UINT32* BucketToQueue);
+    const std::vector<UINT32>& Table() const { return BucketToQueue; }
+
+    //
+    // Returns true if the table changed and should be written to the NIC.
+    //
+    bool Update(_In_reads_(BucketCount) const UINT64* BucketPackets, double PeriodSeconds);
+    bool UpdateFromQueues(_In_reads_(QueueCount) const UINT64* QueuePackets, double PeriodSeconds);
+
+    //
+    // Hottest queue load over the mean, from the smoothed rates under the
+    // current table.
+    //
+    double Imbalance() const;
+
+    void QueueRates(_Out_writes_(QueueCount) double* Rates) const;
+    const RssRebalancerStats& Statistics() const { return Stats; }
+
+  private:
+    bool Rebalance();
+
+    RssRebalancerConfig Config;
+    UINT32 QueueCount;
+    std::vector<UINT32> BucketToQueue;
+    std::vector<double> BucketRates;
+    UINT32 Cooldown = 0;
+    bool Primed = false;
+    RssRebalancerStats Stats {};
+};
@@ -0,0 +1,174 @@
+#include "RuleSetManager.h"
+#include "PacketHeaders.h"
+
+#include <algorithm>
+
+RuleSetManager::RuleSetManager(
+    _In_ const XDP_API_TABLE* XdpApi,
+    UINT32 IfIndex,
+    _In_ const XDP_HOOK_ID* HookId,
+    HANDLE Socket,
+    EpochDomain& Domain,
+    CloseProgramFn CloseProgram)
+    : XdpApi(XdpApi)
+    , IfIndex(IfIndex)
+    , HookId(*HookId)
+    , Socket(Socket)
+    , CloseProgram(CloseProgram)
+    , Table(Domain, new PortRoutingTable())
+{
+}
+
+RuleSetManager::~RuleSetManager()
+{
+    CloseCurrentProgram();
+}
+
+HRESULT RuleSetManager::CreateProgram(
+    const std::vector<PortRoute>& Routes,
+    _Out_ std::unique_ptr<CompiledRuleSet>* Rules,
+    _Out_ HANDLE* Program)
+{
+    std::vector<UdpSubscription> Subscriptions(Routes.size());
+    for (size_t i = 0; i < Routes.size(); i++) {
+        Subscriptions[i].DestinationPort = Routes[i].Port;
+    }
+
+    auto NewRules = std::make_unique<CompiledRuleSet>();
+    HRESULT Result =
+        UdpRuleCompiler::Compile(Subscriptions.data(), (UINT32)Subscriptions.size(), Socket, NewRules.get());
+    if (FAILED(Result)) {
+        return Result;
+    }
+
+    Result = XdpApi->XdpCreateProgram(
+        IfIndex, &HookId, 0, XDP_CREATE_PROGRAM_FLAG_ALL_QUEUES, NewRules->Rules(), NewRules->RuleCount(), Program);
+    if (SUCCEEDED(Result)) {
+        *Rules = std::move(NewRules);
+    }
+    return Result;
+}
+
+void RuleSetManager::CloseCurrentProgram()
+{
+    if (CurrentProgram != nullptr) {
+        CloseProgram(CurrentProgram);
+        CurrentProgram = nullptr;
+    }
+
+    //
+    // XdpCreateProgram copied the rules and the port set into the driver, so
+    // nothing reads them once the program is closed.
+    //
+    CurrentRules.reset();
+}
+
+void RuleSetManager::PublishRoutes(const std::vector<PortRoute>& Routes)
+{
+    auto Next = std::make_unique<PortRoutingTable>();
+    for (const PortRoute& Route : Routes) {
+        Next->Routes[HostToNet16(Route.Port)] = Route.Route;
+    }
+    Table.Publish(std::move(Next));
+}
+
+HRESULT RuleSetManager::SwapProgram(const std::vector<PortRoute>& Routes)
+{
+    std::unique_ptr<CompiledRuleSet> NewRules;
+    HANDLE NewProgram = nullptr;
+    HRESULT Result;
+
+    if (Routes.empty()) {
+        //
+        // No subscriptions, no program: frames fall through to the stack.
+        //
+        Result = S_OK;
+    } else if (SwapOrder == RuleSwapOrder::MakeBeforeBreak || CurrentProgram == nullptr) {
+        Result = CreateProgram(Routes, &NewRules, &NewProgram);
+        if (FAILED(Result) && CurrentProgram != nullptr) {
+            //
+            // Some hooks accept a single program per interface and queue. Give
+            // up the overlap rather than the update.
+            //
+            CloseCurrentProgram();
+            Stats.FallbackSwaps++;
+            Result = CreateProgram(Routes, &NewRules, &NewProgram);
+        }
+    } else {
+        CloseCurrentProgram();
+        Result = CreateProgram(Routes, &NewRules, &NewProgram);
+    }
+
+    if (FAILED(Result)) {
+        return Result;
+    }
+
+    CloseCurrentProgram();
+    CurrentProgram = NewProgram;
+    CurrentRules = std::move(NewRules);
+    Stats.Swaps++;
+    return S_OK;
+}
+
+HRESULT RuleSetManager::Apply(std::vector<PortRoute> Routes, _Out_opt_ RuleSetDiff* Diff)
+{
+    auto ByPort = [](const PortRoute& A, const PortRoute& B) { return A.Port < B.Port; };
+    auto SamePort = [](const PortRoute& A, const PortRoute& B) { return A.Port == B.Port; };
+
+    for (const PortRoute& Route : Routes) {
+        if (Route.Route == PortRoutingTable::NoRoute) {
+            return E_INVALIDARG;
+        }
+    }
+
+    //
+    // Sort by port and keep the first route given for each port.
+    //
+    std::stable_sort(Routes.begin(), Routes.end(), ByPort);
+    Routes.erase(std::unique(Routes.begin(), Routes.end(), SamePort), Routes.end());
+
+    RuleSetDiff Changes;
+    bool RoutesChanged = Routes.size() != Active.size();
+    size_t Old = 0;
+    size_t New = 0;
+
+    while (Old < Active.size() || New < Routes.size()) {
+        if (New == Routes.size() || (Old < Active.size() && Active[Old].Port < Routes[New].Port)) {
+            Changes.Removed.push_back(Active[Old++].Port);
+        } else if (Old == Active.size() || Routes[New].Port < Active[Old].Port) {
+            Changes.Added.push_back(Routes[New++].Port);
+        } else {
+            RoutesChanged |= Active[Old++].Route != Routes[New++].Route;
+        }
+    }
+
+    bool PortsChanged = !Changes.Added.empty() || !Changes.Removed.empty();
+    RoutesChanged |= PortsChanged;
+
+    if (RoutesChanged) {
+        //
+        // Publish the routes first: during a make-before-break swap both
+        // programs are attached and either may deliver an added port.
+        //
+        PublishRoutes(Routes);
+    }
+
+    if (PortsChanged) {
+        HRESULT Result = SwapProgram(Routes);
+        if (FAILED(Result)) {
+            if (CurrentProgram == nullptr) {
+                Active.clear();
+            }
+            PublishRoutes(Active);
+            return Result;
+        }
+    } else if (RoutesChanged) {
+        Stats.RouteOnlyUpdates++;
+    }
+
+    Active = std::move(Routes);
+    if (Diff != nullptr) {
+        *Diff = std::move(Changes);
+    }
+    return S_OK;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <windows.h>
+#include <xdpapi.h>
+
+#include <memory>
+#include <vector>
+
+#include "EpochReclaim.h"
+#include "UdpRuleCompiler.h"
+
+//
+// A UDP destination port subscription and the user-space route its frames
+// take. Ports are in host byte order; route ids are application defined and
+// must not be PortRoutingTable::NoRoute.
+//
+struct PortRoute {
+    UINT16 Port;
+    UINT16 Route;
+};
+
+//
+// Destination port to route lookup for the RX thread. The table is indexed by
+// the port as it appears on the wire, so lookups need no byte swap.
+//
+class PortRoutingTable {
+  public:
+    static constexpr UINT16 NoRoute = 0;
+
+    UINT16 Lookup(UINT16 NetworkPort) const { return Routes[NetworkPort]; }
+
+  private:
+    friend class RuleSetManager;
+    UINT16 Routes[MAXUINT16 + 1] {};
+};
+
+struct RuleSetDiff {
+    std::vector<UINT16> Added;
+    std::vector<UINT16> Removed;
+};
+
+enum class RuleSwapOrder {
+    //
+    // Create the new program on the hook, then close the old one. Frames keep
+    // matching one of the two programs throughout the swap.
+    //
+    MakeBeforeBreak,
+
+    //
+    // Close the old program, then create the new one. Only useful to measure
+    // what make-before-break saves.
+    //
+    BreakBeforeMake,
+};
+
+struct RuleSetStats {
+    UINT64 Swaps;
+    UINT64 RouteOnlyUpdates;
+
+    //
+    // Swaps that had to fall back to break-before-make because the hook
+    // refused a second program.
+    //
+    UINT64 FallbackSwaps;
+};
+
+//
+// Owns the XDP program that redirects subscribed UDP ports to an AF_XDP
+// socket and the matching user-space routing table.
+//
+// Apply() diffs the requested subscriptions against the active ones and, if
+// the port set changed, compiles a new program for the same hook (one port
+// set rule however many ports there are) and attaches it before closing the
+// old handle. The compiled rules, port set bitmap included, are freed with
+// the old program's handle, since the driver keeps its own copy. The routing
+// table is published first through an RcuPointer, so frames that arrive
+// through the new program already find their route; the RX thread reads it
+// inside an epoch section and never takes a lock. Apply() is called from a
+// single control thread.
+//
+class RuleSetManager {
+  public:
+    using CloseProgramFn = BOOL (*)(HANDLE Program);
+
+    RuleSetManager(
+        _In_ const XDP_API_TABLE* XdpApi,
+        UINT32 IfIndex,
+        _In_ const XDP_HOOK_ID* HookId,
+        HANDLE Socket,
+        EpochDomain& Domain,
+        CloseProgramFn CloseProgram = &RuleSetManager::CloseProgramHandle);
+    ~RuleSetManager();
+
+    RuleSetManager(const RuleSetManager&) = delete;
+    RuleSetManager& operator=(const RuleSetManager&) = delete;
+
+    //
+    // Replaces the subscriptions. On failure the previous program and routes
+    // stay in effect, unless a fallback swap had already closed the program.
+    //
+    HRESULT Apply(std::vector<PortRoute> Routes, _Out_opt_ RuleSetDiff* Diff = nullptr);
+
+    //
+    // RX thread, between EpochDomain::Enter() and Exit().
+    //
+    const PortRoutingTable* RoutingTable() const { return Table.Get(); }
+
+    const std::vector<PortRoute>& Subscriptions() const { return Active; }
+    HANDLE Program() const { return CurrentProgram; }
+    const RuleSetStats& Statistics() const { return Stats; }
+
+    void SetSwapOrder(RuleSwapOrder Order) { SwapOrder = Order; }
+
+  private:
+    static BOOL CloseProgramHandle(HANDLE Program) { return CloseHandle(Program); }
+
+    HRESULT CreateProgram(
+        const std::vector<PortRoute>& Routes,
+        _Out_ std::unique_ptr<CompiledRuleSet>* Rules,
+        _Out_ HANDLE* Program);
+    void CloseCurrentProgram();
+    HRESULT SwapProgram(const std::vector<PortRoute>& Routes);
+    void PublishRoutes(const std::vector<PortRoute>& Routes);
+
+    const XDP_API_TABLE* XdpApi;
+    UINT32 IfIndex;
+    XDP_HOOK_ID HookId;
+    HANDLE Socket;
+    CloseProgramFn CloseProgram;
+
+    RcuPointer<PortRoutingTable> Table;
+    std::vector<PortRoute> Active;
+    HANDLE CurrentProgram = nullptr;
+    std::unique_ptr<CompiledRuleSet> CurrentRules;
+    RuleSwapOrder SwapOrder = RuleSwapOrder::MakeBeforeBreak;
+    RuleSetStats Stats {};
+};
@@ -0,0 +1,250 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "EpochReclaim.h"
+#include "FillRingRefiller.h"
+#include "PacketHeaders.h"
+#include "RuleSetManager.h"
+#include "SoftwareXdp.h"
+#include "SoftwareXsk.h"
+#include "TscClock.h"
+#include "UmemFramePool.h"
+
+static constexpr UINT32 BenchChunkSize = 2048;
+static constexpr UINT32 BenchRingSize = 1024;
+static constexpr UINT32 BenchFrameLength = sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader) + 32;
+
+static constexpr UINT16 StablePortBase = 10000;
+static constexpr UINT16 ToggledPortBase = 20000;
+static constexpr UINT16 StableRoute = 1;
+static constexpr UINT16 ToggledRoute = 2;
+
+struct SwapRunResult {
+    UINT64 StableSent;
+    UINT64 StableMissedHook;
+    UINT64 StableUnrouted;
+    UINT64 Delivered;
+    UINT64 RingDrops;
+    UINT64 Swaps;
+    UINT64 FallbackSwaps;
+};
+
+//
+// Subscription set number Generation: the stable ports, which every set
+// contains, plus a block of toggled ports that moves on every generation.
+//
+static std::vector<PortRoute> SubscriptionSet(UINT32 Generation, UINT32 StablePorts, UINT32 ToggledPorts)
+{
+    std::vector<PortRoute> Routes;
+
+    for (UINT32 i = 0; i < StablePorts; i++) {
+        Routes.push_back({(UINT16)(StablePortBase + i), StableRoute});
+    }
+    for (UINT32 i = 0; i < ToggledPorts; i++) {
+        Routes.push_back({(UINT16)(ToggledPortBase + (Generation % 2) * ToggledPorts + i), ToggledRoute});
+    }
+    return Routes;
+}
+
+//
+// A software NIC sends a steady stream to the stable ports while the control
+// thread swaps the toggled half of the subscriptions back and forth. Every
+// stable frame that no program redirected was lost at the hook during a swap;
+// every stable frame the RX thread could not route saw a stale table.
+//
+static SwapRunResult RunSwaps(
+    const TscClock& Clock,
+    RuleSwapOrder Order,
+    UINT32 Rate,
+    UINT32 SwapCount,
+    UINT32 SwapIntervalMs,
+    UINT32 AttachDelayUs)
+{
+    constexpr UINT32 StablePorts = 16;
+    constexpr UINT32 ToggledPorts = 16;
+    constexpr UINT32 FrameCount = BenchRingSize * 2;
+    constexpr UINT64 UmemSize = (UINT64)FrameCount * BenchChunkSize;
+    auto Umem = std::make_unique<UCHAR[]>(UmemSize);
+
+    EpochDomain Domain(2);
+    SoftwareXsk Xsk(Umem.get(), UmemSize, BenchChunkSize, BenchRingSize);
+    SoftwareXdpHook Hook(Domain);
+    Hook.Install();
+
+    XDP_HOOK_ID HookId = {XDP_HOOK_L2, XDP_HOOK_RX, XDP_HOOK_INSPECT};
+    RuleSetManager Manager(
+        SoftwareXdpHook::ApiTable(), 0, &HookId, (HANDLE)&Xsk, Domain, &SoftwareXdpHook::CloseProgram);
+    Manager.SetSwapOrder(Order);
+    if (FAILED(Manager.Apply(SubscriptionSet(0, StablePorts, ToggledPorts)))) {
+        fprintf(stderr, "initial rule set failed\n");
+        exit(EXIT_FAILURE);
+    }
+    Hook.SetAttachDelay(AttachDelayUs);
+
+    XSK_RING RxRing;
+    XSK_RING FillRing;
+    XskRingInitialize(&RxRing, &Xsk.RingInfo().Rx);
+    XskRingInitialize(&FillRing, &Xsk.RingInfo().Fill);
+
+    UmemFramePool Pool(FrameCount);
+    Pool.AddRegion(0, FrameCount, BenchChunkSize);
+    FillRingRefiller Refiller(&FillRing, &Pool, BenchRingSize / 2);
+    Refiller.Refill();
+
+    std::atomic<bool> Stop {false};
+    std::atomic<bool> NicDone {false};
+    UINT64 StableSent = 0;
+    UINT64 StableMissedHook = 0;
+
+    std::thread Nic([&] {
+        UINT32 Reader = Domain.RegisterReader();
+        UCHAR Frames[StablePorts][BenchFrameLength];
+        for (UINT32 i = 0; i < StablePorts; i++) {
+            BuildUdpFrame(Frames[i], BenchFrameLength, 0x0a000001, 4000, 0x0a000002, (UINT16)(StablePortBase + i));
+        }
+
+        UINT64 TicksPerFrame = Clock.NsToTicks(1000000000ull / Rate);
+        UINT64 Next = Clock.Now();
+        while (!Stop.load(std::memory_order_acquire)) {
+            while (Clock.Now() < Next) {
+                std::this_thread::yield();
+            }
+            if (!Hook.Receive(Reader, Frames[StableSent % StablePorts], BenchFrameLength)) {
+                StableMissedHook++;
+            }
+            StableSent++;
+            Next += TicksPerFrame;
+        }
+        NicDone.store(true, std::memory_order_release);
+    });
+
+    UINT64 StableUnrouted = 0;
+    std::thread Rx([&] {
+        UINT32 Reader = Domain.RegisterReader();
+        const UCHAR* Base = Umem.get();
+
+        while (TRUE) {
+            bool Done = NicDone.load(std::memory_order_acquire);
+            UINT32 Index;
+            UINT32 Count = XskRingConsumerReserve(&RxRing, 64, &Index);
+            if (Count == 0) {
+                if (Done) {
+                    break;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+
+            Domain.Enter(Reader);
+            const PortRoutingTable* Table = Manager.RoutingTable();
+            for (UINT32 i = 0; i < Count; i++) {
+                XSK_BUFFER_DESCRIPTOR* Descriptor = (XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&RxRing, Index + i);
+                const XSK_BUFFER_ADDRESS& Address = Descriptor->Address;
+                Ipv4Frame Parsed;
+
+                if (ParseIpv4Frame(Base + Address.BaseAddress + Address.Offset, Descriptor->Length, &Parsed) &&
+                    Parsed.Udp != nullptr && Table->Lookup(Parsed.Udp->DestinationPort) != StableRoute) {
+                    StableUnrouted++;
+                }
+                Pool.Free(Address.BaseAddress);
+            }
+            Domain.Exit(Reader);
+
+            XskRingConsumerRelease(&RxRing, Count);
+            Refiller.Refill();
+        }
+    });
+
+    for (UINT32 Swap = 1; Swap <= SwapCount; Swap++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(SwapIntervalMs));
+        if (FAILED(Manager.Apply(SubscriptionSet(Swap, StablePorts, ToggledPorts)))) {
+            fprintf(stderr, "rule set swap %u failed\n", Swap);
+        }
+        Domain.Reclaim();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(SwapIntervalMs));
+
+    Stop.store(true, std::memory_order_release);
+    Nic.join();
+    Rx.join();
+    Domain.Synchronize();
+
+    return {
+        StableSent,
+        StableMissedHook,
+        StableUnrouted,
+        Xsk.Delivered(),
+        Xsk.FillStarved() + Xsk.RxFull(),
+        Manager.Statistics().Swaps,
+        Manager.Statistics().FallbackSwaps};
+}
+
+//
+// Frames lost while the rule set is swapped, make-before-break against
+// break-before-make.
+//
+int RuleSwapBenchmark(int argc, char** argv)
+{
+    UINT32 Rate = argc >= 1 ? atoi(argv[0]) : 200000;
+    UINT32 SwapCount = argc >= 2 ? atoi(argv[1]) : 50;
+    UINT32 SwapIntervalMs = argc >= 3 ? atoi(argv[2]) : 20;
+    UINT32 AttachDelayUs = argc >= 4 ? atoi(argv[3]) : 200;
+
+    if (Rate == 0) {
+        fprintf(stderr, "rate must be non-zero\n");
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    const struct {
+        const char* Name;
+        RuleSwapOrder Order;
+    } Orders[] = {
+        {"make-before-break", RuleSwapOrder::MakeBeforeBreak},
+        {"break-before-make", RuleSwapOrder::BreakBeforeMake},
+    };
+
+    printf(
+        "rate=%u pps, %u swaps every %u ms, attach delay %u us\n\n",
+        Rate,
+        SwapCount,
+        SwapIntervalMs,
+        AttachDelayUs);
+    printf(
+        "%-18s %8s %12s %12s %12s %12s %12s %10s\n",
+        "order",
+        "swaps",
+        "sent",
+        "hook-miss",
+        "unrouted",
+        "delivered",
+        "ring-drops",
+        "lost/swap");
+
+    for (const auto& Entry : Orders) {
+        SwapRunResult Result = RunSwaps(Clock, Entry.Order, Rate, SwapCount, SwapIntervalMs, AttachDelayUs);
+        UINT64 Lost = Result.StableMissedHook + Result.StableUnrouted;
+        printf(
+            "%-18s %8llu %12llu %12llu %12llu %12llu %12llu %10.2f\n",
+            Entry.Name,
+            (unsigned long long)Result.Swaps,
+            (unsigned long long)Result.StableSent,
+            (unsigned long long)Result.StableMissedHook,
+            (unsigned long long)Result.StableUnrouted,
+            (unsigned long long)Result.Delivered,
+            (unsigned long long)Result.RingDrops,
+            Result.Swaps != 0 ? (double)Lost / Result.Swaps : 0.0);
+        if (Result.FallbackSwaps != 0) {
+            printf("  %llu swaps fell back to break-before-make\n", (unsigned long long)Result.FallbackSwaps);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
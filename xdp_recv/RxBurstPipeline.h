@@ -0,0 +1,113 @@
+#pragma once
+
+#include <windows.h>
+#include <immintrin.h>
+
+#include "ChainedFrame.h"
+#include "FlowTable.h"
+#include "PacketHeaders.h"
+
+//
+// Reads the 5-tuple of an IPv4 frame, peeking at the headers in place.
+//
+inline bool ParseFlowKey(const ChainedFrame& Frame, _Out_ FlowKey* Key)
+{
+    UCHAR Scratch[sizeof(EthernetHeader) + 60 + sizeof(UdpHeader)];
+    UINT32 Length = Frame.Length() < sizeof(Scratch) ? Frame.Length() : (UINT32)sizeof(Scratch);
+    const UCHAR* Headers = Frame.Peek(0, Length, Scratch);
+
+    Ipv4Frame Parsed;
+    if (Headers == nullptr || !ParseIpv4Frame(Headers, Length, &Parsed)) {
+        return false;
+    }
+    *Key = MakeFlowKey(Parsed);
+    return true;
+}
+
+//
+// Runs a burst of received frames through flow lookup and a handler as a
+// software pipeline. Frame headers in the UMEM and flow-table buckets are
+// cold for nearly every frame at high rates; handled one frame at a time,
+// each of those misses stalls the loop in turn. Here every step of the loop
+// works on several frames, each Distance frames behind the last:
+//
+//     prefetch the headers of frame i
+//     parse frame i - k, hash its 5-tuple, prefetch its bucket
+//     prefetch the flow that frame i - 2k's bucket points at
+//     look up frame i - 3k's flow and run the handler
+//
+// so each miss has k steps of other frames' work to hide behind. Frames are
+// handled in order. Distance 0 handles each frame start to finish, which is
+// the unpipelined loop; the best k depends on how long the handler runs.
+//
+template <typename State>
+class RxBurstPipeline {
+  public:
+    static constexpr UINT32 MaxBurst = 64;
+    static constexpr UINT32 MaxDistance = 16;
+
+    RxBurstPipeline(_In_ FlowTable<State>* Flows, UINT32 Distance) : Flows(Flows) { SetDistance(Distance); }
+
+    void SetDistance(UINT32 Value) { Distance = Value < MaxDistance ? Value : MaxDistance; }
+    UINT32 PrefetchDistance() const { return Distance; }
+
+    //
+    // Calls Handle(UINT32 Index, State* Flow) for each of up to MaxBurst
+    // frames, in order. Flow is the frame's entry in the flow table, added
+    // if new, or nullptr if the frame is not IPv4.
+    //
+    template <typename HandlerFn>
+    void Run(_In_reads_(Count) const ChainedFrame* Frames, UINT32 Count, UINT64 NowTick, HandlerFn&& Handle)
+    {
+        if (Count > MaxBurst) {
+            Count = MaxBurst;
+        }
+
+        UINT32 K = Distance;
+        for (UINT32 Step = 0; Step < Count + 3 * K; Step++) {
+            if (Step < Count) {
+                PrefetchHeaders(Frames[Step]);
+            }
+
+            UINT32 Index = Step - K;
+            if (Step >= K && Index < Count) {
+                Parsed[Index] = ParseFlowKey(Frames[Index], &Keys[Index]);
+                if (Parsed[Index]) {
+                    Hashes[Index] = FlowKeyHash(Keys[Index]);
+                    Flows->Prefetch(Hashes[Index]);
+                }
+            }
+
+            Index = Step - 2 * K;
+            if (Step >= 2 * K && Index < Count && Parsed[Index]) {
+                Flows->PrefetchFlow(Hashes[Index]);
+            }
+
+            Index = Step - 3 * K;
+            if (Step >= 3 * K && Index < Count) {
+                Handle(Index, Parsed[Index] ? Flows->FindOrInsertHashed(Keys[Index], Hashes[Index], NowTick) : nullptr);
+            }
+        }
+    }
+
+  private:
+    //
+    // Ethernet, IPv4 and UDP headers fit in the frame's first 64 bytes,
+    // which may straddle two cache lines.
+    //
+    static void PrefetchHeaders(const ChainedFrame& Frame)
+    {
+        if (Frame.SegmentCount() != 0) {
+            const UCHAR* Data = Frame.Segment(0).Data;
+            _mm_prefetch((const char*)Data, _MM_HINT_T0);
+            _mm_prefetch((const char*)Data + 63, _MM_HINT_T0);
+        }
+    }
+
+    FlowTable<State>* Flows;
+    UINT32 Distance;
+
+    FlowKey Keys[MaxBurst];
+    UINT64 Hashes[MaxBurst];
+    bool Parsed[MaxBurst];
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <windows.h>
+#include <stdio.h>
+#include <iterator>
+#include <afxdp.h>
+#include <xdp/offload.h>
+
+#include "LatencyHistogram.h"
+#include "TscClock.h"
+
+//
+// Per-stage RX latency instrumentation for the receive loop.
+//
+//   NicToRing            NIC timestamp -> descriptor dequeued from the RX ring
+//   RingToParse          descriptor dequeued -> headers parsed
+//   ParseToHandlerDone   headers parsed -> frame handler returned
+//
+// The NicToRing stage is only recorded when the RX ring carries an
+// XDP_FRAME_TIMESTAMP descriptor extension; otherwise the dequeue TSC is the
+// first timestamp of a frame. All stamps come from the TscClock, so recording
+// never calls into the OS and never allocates; Dump() prints the
+// interval percentiles and starts a new interval. The receive loop calls it
+// from a timer on its wheel.
+//
+enum class RxStage : UINT32 {
+    NicToRing,
+    RingToParse,
+    ParseToHandlerDone,
+    Count,
+};
+
+class RxLatencyRecorder {
+  public:
+    explicit RxLatencyRecorder(const TscClock& Clock) : Clock(Clock)
+    {
+        LARGE_INTEGER Frequency;
+        QueryPerformanceFrequency(&Frequency);
+        NsPerQpcTick = 1e9 / (double)Frequency.QuadPart;
+    }
+
+    //
+    // Looks for an XDP_FRAME_TIMESTAMP extension on the RX ring. XDP 1.0.2 does
+    // not enable RX descriptor extensions on AF_XDP sockets, so the stride is
+    // normally sizeof(XSK_BUFFER_DESCRIPTOR) and the NicToRing stage stays empty.
+    // When the stride grows, the timestamp is the first extension after the
+    // buffer descriptor.
+    //
+    void ConfigureRxRing(_In_ const XSK_RING_INFO* RxRingInfo)
+    {
+        if (RxRingInfo->ElementStride >= sizeof(XSK_FRAME_DESCRIPTOR) + sizeof(XDP_FRAME_TIMESTAMP)) {
+            TimestampOffset = sizeof(XSK_FRAME_DESCRIPTOR);
+        } else {
+            TimestampOffset = 0;
+        }
+    }
+
+    bool HasFrameTimestamps() const { return TimestampOffset != 0; }
+
+    //
+    // Called right after XskRingConsumerReserve() handed out Descriptor.
+    // Returns the dequeue tick, which is the start of the RingToParse stage.
+    //
+    UINT64 OnDequeue(_In_ const VOID* Descriptor)
+    {
+        UINT64 Now = Clock.Now();
+
+        if (TimestampOffset != 0) {
+            //
+            // Frame timestamps are in QueryPerformanceCounter units, which is
+            // the monotonic time base of the TscClock.
+            //
+            const XDP_FRAME_TIMESTAMP* Timestamp =
+                (const XDP_FRAME_TIMESTAMP*)((const UCHAR*)Descriptor + TimestampOffset);
+            UINT64 NicNs = (UINT64)((double)Timestamp->Timestamp * NsPerQpcTick);
+            UINT64 NowNs = Clock.ToMonotonicNs(Now);
+            if (NowNs >= NicNs) {
+                Record(RxStage::NicToRing, NowNs - NicNs);
+            }
+        }
+
+        return Now;
+    }
+
+    void RecordTicks(RxStage Stage, UINT64 StartTick, UINT64 EndTick)
+    {
+        Record(Stage, Clock.TicksToNs(EndTick - StartTick));
+    }
+
+    void Record(RxStage Stage, UINT64 Nanoseconds) { Stages[(UINT32)Stage].Record(Nanoseconds); }
+
+    void Dump(FILE* Stream)
+    {
+        static const char* const StageNames[] = {
+            "nic->ring",
+            "ring->parse",
+            "parse->handler-done",
+        };
+        static_assert(std::size(StageNames) == (size_t)RxStage::Count);
+
+        for (UINT32 i = 0; i < (UINT32)RxStage::Count; i++) {
+            if (i == (UINT32)RxStage::NicToRing && !HasFrameTimestamps())
+                continue;
+            PrintLatencySummary(Stream, StageNames[i], Stages[i]);
+            Stages[i].Reset();
+        }
+    }
+
+  private:
+    const TscClock& Clock;
+    LatencyHistogram<> Stages[(UINT32)RxStage::Count];
+    UINT32 TimestampOffset = 0;
+    double NsPerQpcTick = 0;
+};
@@ -0,0 +1,172 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "ChainedFrame.h"
+#include "FlowTable.h"
+#include "PacketHeaders.h"
+#include "RxBurstPipeline.h"
+#include "TscClock.h"
+
+static constexpr UINT32 BenchChunkSize = 2048;
+static constexpr UINT32 BenchFrameLength = 128;
+static constexpr UINT32 BenchBurst = 32;
+
+struct PipelineFlow {
+    UINT64 Frames;
+    UINT64 Bytes;
+    UINT32 LastSequence;
+    UINT32 Gaps;
+};
+
+//
+// Processes every chunk of the UMEM once, in the shuffled order a busy fill
+// ring ends up handing chunks out in, a burst at a time. The handler counts
+// the frame against its flow and checks the sequence number at the start of
+// the payload, then spins for WorkTicks.
+//
+static double RunDistance(
+    const TscClock& Clock,
+    _In_ UCHAR* Umem,
+    const std::vector<UINT32>& Order,
+    _Inout_ FlowTable<PipelineFlow>* Flows,
+    UINT32 Distance,
+    UINT64 WorkTicks,
+    _Out_ UINT64* Checksum)
+{
+    RxBurstPipeline<PipelineFlow> Pipeline(Flows, Distance);
+    auto Frames = std::make_unique<ChainedFrame[]>(BenchBurst);
+    UINT32 PayloadOffset = sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader);
+    UINT64 Sum = 0;
+
+    UINT64 Start = Clock.NowOrdered();
+    for (UINT32 Next = 0; Next < Order.size(); Next += BenchBurst) {
+        UINT32 Burst = std::min(BenchBurst, (UINT32)Order.size() - Next);
+        for (UINT32 i = 0; i < Burst; i++) {
+            UINT64 Address = (UINT64)Order[Next + i] * BenchChunkSize;
+            Frames[i].Reset();
+            Frames[i].Append(Address, Umem + Address, BenchFrameLength);
+        }
+
+        Pipeline.Run(Frames.get(), Burst, Next, [&](UINT32 Index, PipelineFlow* Flow) {
+            const FrameSegment& Head = Frames[Index].Segment(0);
+            UINT32 Sequence;
+            memcpy(&Sequence, Head.Data + PayloadOffset, sizeof(Sequence));
+            if (Flow != nullptr) {
+                Flow->Gaps += Flow->Frames != 0 && Sequence != Flow->LastSequence + 1;
+                Flow->LastSequence = Sequence;
+                Flow->Frames++;
+                Flow->Bytes += Head.Length;
+            }
+            Sum += Sequence;
+
+            if (WorkTicks != 0) {
+                UINT64 Until = Clock.Now() + WorkTicks;
+                while (Clock.Now() < Until) {
+                }
+            }
+        });
+    }
+    UINT64 Ns = Clock.TicksToNs(Clock.NowOrdered() - Start);
+
+    *Checksum = Sum;
+    return (double)Ns / Order.size();
+}
+
+//
+// Receive-loop cost per frame for a range of prefetch distances, on a UMEM
+// larger than the last-level cache and a flow table too big for it.
+//
+int RxPipelineBenchmark(int argc, char** argv)
+{
+    UINT32 UmemMiB = argc >= 1 ? atoi(argv[0]) : 1024;
+    UINT32 FlowCount = argc >= 2 ? atoi(argv[1]) : 1000000;
+    UINT32 WorkNs = argc >= 3 ? atoi(argv[2]) : 0;
+
+    if (UmemMiB == 0 || FlowCount == 0) {
+        fprintf(stderr, "umem-mib and flows must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    UINT64 UmemSize = (UINT64)UmemMiB * 1024 * 1024;
+    UINT32 Chunks = (UINT32)(UmemSize / BenchChunkSize);
+    auto Umem = std::make_unique<UCHAR[]>(UmemSize);
+
+    FlowTableConfig Config;
+    Config.MaxFlows = FlowCount;
+    FlowTable<PipelineFlow> Flows(Config);
+
+    //
+    // Every chunk holds a frame of a random flow; the flows are all in the
+    // table before the first run.
+    //
+    std::mt19937_64 Random(39);
+    std::vector<UINT32> Sequences(FlowCount);
+    for (UINT32 Chunk = 0; Chunk < Chunks; Chunk++) {
+        UINT32 Flow = (UINT32)(Random() % FlowCount);
+        UCHAR* Data = Umem.get() + (UINT64)Chunk * BenchChunkSize;
+        BuildUdpFrame(Data, BenchFrameLength, 0x0a000000 | Flow, (UINT16)(10000 + Flow % 50000), 0xef000001, 5000);
+        memcpy(Data + sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader), &Sequences[Flow], 4);
+        Sequences[Flow]++;
+    }
+    for (UINT32 Flow = 0; Flow < FlowCount; Flow++) {
+        UCHAR Data[BenchFrameLength];
+        BuildUdpFrame(Data, BenchFrameLength, 0x0a000000 | Flow, (UINT16)(10000 + Flow % 50000), 0xef000001, 5000);
+        ChainedFrame Frame;
+        Frame.Append(0, Data, BenchFrameLength);
+        FlowKey Key;
+        ParseFlowKey(Frame, &Key);
+        Flows.FindOrInsert(Key, 0);
+    }
+
+    std::vector<UINT32> Order(Chunks);
+    for (UINT32 i = 0; i < Chunks; i++) {
+        Order[i] = i;
+    }
+    std::shuffle(Order.begin(), Order.end(), Random);
+
+    printf(
+        "%u MiB UMEM, %u frames of %u bytes in shuffled %u-byte chunks, %u flows (%.0f MiB table), "
+        "bursts of %u, %u ns handler\n\n",
+        UmemMiB,
+        Chunks,
+        BenchFrameLength,
+        BenchChunkSize,
+        FlowCount,
+        Flows.MemoryFootprint() / (1024.0 * 1024.0),
+        BenchBurst,
+        WorkNs);
+    printf("%-10s %10s %10s %10s\n", "distance", "ns/frame", "Mpps", "speedup");
+
+    UINT64 WorkTicks = Clock.NsToTicks(WorkNs);
+    UINT64 Expected = 0;
+    double Baseline = 0;
+    static const UINT32 Distances[] = {0, 1, 2, 4, 8, 16};
+    for (UINT32 Distance : Distances) {
+        UINT64 Checksum;
+        double NsPerFrame = RunDistance(Clock, Umem.get(), Order, &Flows, Distance, WorkTicks, &Checksum);
+        if (Distance == 0) {
+            Baseline = NsPerFrame;
+            Expected = Checksum;
+        } else if (Checksum != Expected) {
+            fprintf(stderr, "distance %u handled different frames\n", Distance);
+            return EXIT_FAILURE;
+        }
+        printf("%-10u %10.1f %10.2f %9.2fx\n", Distance, NsPerFrame, 1000.0 / NsPerFrame, Baseline / NsPerFrame);
+    }
+
+    const FlowTableStats& Stats = Flows.Statistics();
+    if (Stats.Inserts != FlowCount) {
+        fprintf(stderr, "%llu frames missed the flow table\n", (unsigned long long)(Stats.Inserts - FlowCount));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+#include <windows.h>
+#include <xdpapi.h>
+#include <afxdp_helper.h>
+
+#include "SharedUmem.h"
+
+SharedUmem::SharedUmem(const SharedUmemConfig& Config)
+    : Config(Config)
+    , Memory((UCHAR*)AllocateOnNode((SIZE_T)Config.ChunkCount * Config.ChunkSize, Config.Node))
+    , FreeFrames(Config.ChunkCount)
+{
+    if (Memory != nullptr) {
+        FreeFrames.AddRegion(0, Config.ChunkCount, Config.ChunkSize);
+    }
+}
+
+SharedUmem::~SharedUmem()
+{
+    if (Memory != nullptr) {
+        VirtualFree(Memory, 0, MEM_RELEASE);
+    }
+}
+
+XSK_UMEM_REG SharedUmem::Registration() const
+{
+    return XSK_UMEM_REG {
+        .TotalSize = TotalSize(),
+        .ChunkSize = Config.ChunkSize,
+        .Address = Memory,
+    };
+}
+
+//
+// A socket bound for RX only has no TX or completion ring; their ring info
+// is all zero and the rings stay empty, with a Size of zero.
+//
+static XSK_RING* InitializeRing(_Inout_ XSK_RING* Ring, const XSK_RING_INFO& Info)
+{
+    if (Info.Ring != nullptr) {
+        XskRingInitialize(Ring, &Info);
+    }
+    return Ring;
+}
+
+SharedUmemSocket::SharedUmemSocket(_In_ SharedUmem* Umem, const XSK_RING_INFO_SET& Rings, UINT32 FillLowWatermark)
+    : Cache(Umem->Configuration().CacheSize, Umem->Depot(), Umem->Configuration().CacheBatch)
+    , FillRefiller(InitializeRing(&FillRing, Rings.Fill), &Cache, FillLowWatermark)
+{
+    InitializeRing(&RxRing, Rings.Rx);
+    InitializeRing(&TxRing, Rings.Tx);
+    InitializeRing(&CompletionRing, Rings.Completion);
+}
+
+UINT32 SharedUmemSocket::Complete()
+{
+    if (CompletionRing.Size == 0) {
+        return 0;
+    }
+
+    UINT32 Index;
+    UINT32 Count = XskRingConsumerReserve(&CompletionRing, MAXUINT32, &Index);
+    for (UINT32 i = 0; i < Count; i++) {
+        XSK_BUFFER_ADDRESS Address;
+        Address.AddressAndOffset = *(UINT64*)XskRingGetElement(&CompletionRing, Index + i);
+        Cache.Free(Address.BaseAddress);
+    }
+    if (Count != 0) {
+        XskRingConsumerRelease(&CompletionRing, Count);
+        Stats.Completed += Count;
+    }
+    return Count;
+}
+
+UINT32 SharedUmemSocket::ForwardTo(_Inout_ SharedUmemSocket* Target, UINT32 MaxFrames)
+{
+    UINT32 RxIndex;
+    UINT32 Count = XskRingConsumerReserve(&RxRing, MaxFrames, &RxIndex);
+    if (Count == 0) {
+        return 0;
+    }
+
+    UINT32 TxIndex = 0;
+    UINT32 Sent = Target->TxRing.Size != 0 ? XskRingProducerReserve(&Target->TxRing, Count, &TxIndex) : 0;
+    for (UINT32 i = 0; i < Sent; i++) {
+        *(XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&Target->TxRing, TxIndex + i) =
+            *(const XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&RxRing, RxIndex + i);
+    }
+    for (UINT32 i = Sent; i < Count; i++) {
+        Cache.Free(((const XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&RxRing, RxIndex + i))->Address.BaseAddress);
+    }
+
+    if (Sent != 0) {
+        XskRingProducerSubmit(&Target->TxRing, Sent);
+    }
+    XskRingConsumerRelease(&RxRing, Count);
+
+    Stats.Forwarded += Sent;
+    Stats.TxFullDrops += Count - Sent;
+    return Count;
+}
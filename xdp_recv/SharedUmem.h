@@ -0,0 +1,112 @@
+#pragma once
+
+#include <windows.h>
+#include <xdpapi.h>
+#include <afxdp_helper.h>
+
+#include "FillRingRefiller.h"
+#include "NumaPlacement.h"
+#include "UmemFramePool.h"
+
+struct SharedUmemConfig {
+    UINT32 ChunkCount = 0;
+    UINT32 ChunkSize = 2048;
+    USHORT Node = NumaNodeUnknown;
+
+    //
+    // Frames each socket keeps in its own cache, and how many it moves to or
+    // from the shared depot at a time.
+    //
+    UINT32 CacheSize = 256;
+    UINT32 CacheBatch = 64;
+};
+
+//
+// One UMEM for a set of AF_XDP sockets, e.g. one per RX queue. XDP 1.0.2 has
+// no option to attach a socket to another socket's UMEM, so every socket
+// registers the same memory with XSK_UMEM_REG: the offsets are then the
+// same on every socket and a frame received on one can be posted to the TX
+// ring of another without a copy. Free frames live in a depot shared by all
+// sockets; each socket works out of its own cache of it.
+//
+class SharedUmem {
+  public:
+    explicit SharedUmem(const SharedUmemConfig& Config);
+    ~SharedUmem();
+
+    SharedUmem(const SharedUmem&) = delete;
+    SharedUmem& operator=(const SharedUmem&) = delete;
+
+    bool IsValid() const { return Memory != nullptr; }
+
+    UCHAR* Address() const { return Memory; }
+    UINT64 TotalSize() const { return (UINT64)Config.ChunkCount * Config.ChunkSize; }
+    const SharedUmemConfig& Configuration() const { return Config; }
+    SharedFrameDepot* Depot() { return &FreeFrames; }
+
+    //
+    // The registration for XSK_UMEM_REG. Register it with every socket of the
+    // set, before binding it.
+    //
+    XSK_UMEM_REG Registration() const;
+
+  private:
+    SharedUmemConfig Config;
+    UCHAR* Memory;
+    SharedFrameDepot FreeFrames;
+};
+
+struct SharedUmemSocketStats {
+    UINT64 Forwarded;
+    UINT64 TxFullDrops;
+    UINT64 Completed;
+};
+
+//
+// One socket's share of a SharedUmem. Fill and completion rings stay per
+// socket: the fill ring is posted from this socket's cache only and the
+// completion ring drains back into it, so a socket never holds more than
+// its fill ring and cache worth of idle frames and the others are not
+// starved. Frames move between sockets through the depot.
+//
+// A socket is serviced by a single thread. Forwarding produces to the
+// target's TX ring, so the target's TX side belongs to the same thread.
+//
+class SharedUmemSocket {
+  public:
+    SharedUmemSocket(_In_ SharedUmem* Umem, const XSK_RING_INFO_SET& Rings, UINT32 FillLowWatermark);
+    ~SharedUmemSocket() { Cache.Flush(); }
+
+    SharedUmemSocket(const SharedUmemSocket&) = delete;
+    SharedUmemSocket& operator=(const SharedUmemSocket&) = delete;
+
+    XSK_RING* Rx() { return &RxRing; }
+    XSK_RING* Tx() { return &TxRing; }
+    UmemFramePool* Pool() { return &Cache; }
+    const FillRingRefiller& Refiller() const { return FillRefiller; }
+    const SharedUmemSocketStats& Statistics() const { return Stats; }
+
+    UINT32 Refill() { return FillRefiller.Refill(); }
+
+    //
+    // Returns the frames the TX path is done with to this socket's cache.
+    //
+    UINT32 Complete();
+
+    //
+    // Moves up to MaxFrames received frames from this socket's RX ring to
+    // Target's TX ring, descriptor for descriptor. Frames that do not fit on
+    // the TX ring are dropped into this socket's cache. Returns the number
+    // of frames taken off the RX ring.
+    //
+    UINT32 ForwardTo(_Inout_ SharedUmemSocket* Target, UINT32 MaxFrames);
+
+  private:
+    XSK_RING RxRing {};
+    XSK_RING FillRing {};
+    XSK_RING TxRing {};
+    XSK_RING CompletionRing {};
+    UmemFramePool Cache;
+    FillRingRefiller FillRefiller;
+    SharedUmemSocketStats Stats {};
+};
@@ -0,0 +1,337 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "FillRingRefiller.h"
+#include "PacketHeaders.h"
+#include "SharedUmem.h"
+#include "SoftwareXsk.h"
+#include "TscClock.h"
+#include "UmemFramePool.h"
+
+static constexpr UINT32 BenchRingSize = 512;
+static constexpr UINT32 BenchChunkSize = 2048;
+static constexpr UINT32 BenchBurst = 32;
+static constexpr UINT32 BenchCacheSize = 128;
+static constexpr UINT32 BenchCacheBatch = 32;
+
+struct ForwardRunResult {
+    double ForwardNs;
+    double Mpps;
+    UINT64 Forwarded;
+    UINT64 Drops;
+    UINT64 Mismatches;
+    UINT64 LostFrames;
+    UINT64 UmemBytes;
+};
+
+//
+// A socket with a UMEM of its own. Forwarding to another such socket copies
+// the frame into a chunk of the target's UMEM.
+//
+struct PrivateUmemSocket {
+    explicit PrivateUmemSocket(UINT32 Chunks)
+        : Umem(std::make_unique<UCHAR[]>((UINT64)Chunks * BenchChunkSize))
+        , Xsk(Umem.get(), (UINT64)Chunks * BenchChunkSize, BenchChunkSize, BenchRingSize)
+        , Pool(Chunks)
+        , Refiller(InitializeRings(), &Pool, BenchRingSize / 2)
+    {
+        Pool.AddRegion(0, Chunks, BenchChunkSize);
+    }
+
+    XSK_RING* InitializeRings()
+    {
+        XskRingInitialize(&Rx, &Xsk.RingInfo().Rx);
+        XskRingInitialize(&Fill, &Xsk.RingInfo().Fill);
+        XskRingInitialize(&Tx, &Xsk.RingInfo().Tx);
+        XskRingInitialize(&Completion, &Xsk.RingInfo().Completion);
+        return &Fill;
+    }
+
+    void Complete()
+    {
+        UINT32 Index;
+        UINT32 Count = XskRingConsumerReserve(&Completion, MAXUINT32, &Index);
+        for (UINT32 i = 0; i < Count; i++) {
+            Pool.Free(*(UINT64*)XskRingGetElement(&Completion, Index + i));
+        }
+        if (Count != 0) {
+            XskRingConsumerRelease(&Completion, Count);
+        }
+    }
+
+    UINT64 ForwardTo(_Inout_ PrivateUmemSocket* Target, _Inout_ UINT64* Drops)
+    {
+        UINT32 RxIndex;
+        UINT32 Count = XskRingConsumerReserve(&Rx, BenchBurst, &RxIndex);
+        if (Count == 0) {
+            return 0;
+        }
+
+        UINT32 TxIndex;
+        UINT32 Sent = XskRingProducerReserve(&Target->Tx, Count, &TxIndex);
+        UINT32 Posted = 0;
+        for (UINT32 i = 0; i < Count; i++) {
+            const XSK_BUFFER_DESCRIPTOR* Received = (const XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&Rx, RxIndex + i);
+            UINT64 Address;
+            if (i < Sent && Target->Pool.Allocate(&Address)) {
+                memcpy(
+                    Target->Umem.get() + Address,
+                    Umem.get() + Received->Address.BaseAddress + Received->Address.Offset,
+                    Received->Length);
+                XSK_BUFFER_DESCRIPTOR* Descriptor =
+                    (XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&Target->Tx, TxIndex + Posted++);
+                Descriptor->Address.AddressAndOffset = Address;
+                Descriptor->Length = Received->Length;
+                Descriptor->Reserved = 0;
+            } else {
+                (*Drops)++;
+            }
+            Pool.Free(Received->Address.BaseAddress);
+        }
+        if (Posted != 0) {
+            XskRingProducerSubmit(&Target->Tx, Posted);
+        }
+        XskRingConsumerRelease(&Rx, Count);
+        return Posted;
+    }
+
+    std::unique_ptr<UCHAR[]> Umem;
+    SoftwareXsk Xsk;
+    XSK_RING Rx;
+    XSK_RING Fill;
+    XSK_RING Tx;
+    XSK_RING Completion;
+    UmemFramePool Pool;
+    FillRingRefiller Refiller;
+};
+
+//
+// Everything that is not the application: delivers a burst to every socket,
+// stamped with a per-socket sequence number, and puts the frames on every
+// TX ring on the wire, checking they arrive unchanged and in order.
+//
+struct ForwardNic {
+    ForwardNic(UINT32 Sockets, UINT32 FrameLength)
+        : FrameLength(FrameLength), NextSequence(Sockets), ExpectedSequence(Sockets)
+    {
+        BuildUdpFrame(Frame, FrameLength, 0x0a000001, 10000, 0x0a000002, 5000);
+    }
+
+    void Deliver(_Inout_ SoftwareXsk* Xsk, UINT32 Socket, _Inout_ UINT64* Drops)
+    {
+        for (UINT32 i = 0; i < BenchBurst; i++) {
+            memcpy(Frame + PayloadOffset, &NextSequence[Socket], sizeof(UINT64));
+            if (Xsk->Deliver(Frame, FrameLength)) {
+                NextSequence[Socket]++;
+            } else {
+                (*Drops)++;
+            }
+        }
+    }
+
+    //
+    // Socket's TX ring carries the frames received on Source.
+    //
+    void Transmit(_Inout_ SoftwareXsk* Xsk, UINT32 Source, _Inout_ UINT64* Mismatches)
+    {
+        UCHAR Wire[BenchChunkSize];
+        UINT32 Length;
+        while ((Length = Xsk->Transmit(Wire, sizeof(Wire))) != 0) {
+            UINT64 Sequence;
+            memcpy(&Sequence, Wire + PayloadOffset, sizeof(Sequence));
+            *Mismatches += Length != FrameLength || Sequence < ExpectedSequence[Source];
+            ExpectedSequence[Source] = Sequence + 1;
+        }
+    }
+
+    static constexpr UINT32 PayloadOffset = sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader);
+
+    UCHAR Frame[BenchChunkSize];
+    UINT32 FrameLength;
+    std::vector<UINT64> NextSequence;
+    std::vector<UINT64> ExpectedSequence;
+};
+
+//
+// Each socket forwards what it receives to the TX ring of the next one, the
+// last to the first. The forward step of every round is timed on its own.
+//
+static ForwardRunResult RunPrivate(
+    const TscClock& Clock,
+    UINT32 Sockets,
+    UINT32 ChunksPerSocket,
+    UINT32 Rounds,
+    UINT32 FrameLength)
+{
+    std::vector<std::unique_ptr<PrivateUmemSocket>> Socket;
+    for (UINT32 i = 0; i < Sockets; i++) {
+        Socket.push_back(std::make_unique<PrivateUmemSocket>(ChunksPerSocket));
+        Socket[i]->Refiller.Refill();
+    }
+
+    ForwardNic Nic(Sockets, FrameLength);
+    ForwardRunResult Result {};
+    UINT64 ForwardTicks = 0;
+    UINT64 Start = Clock.NowOrdered();
+    for (UINT32 Round = 0; Round < Rounds; Round++) {
+        for (UINT32 i = 0; i < Sockets; i++) {
+            Nic.Deliver(&Socket[i]->Xsk, i, &Result.Drops);
+        }
+
+        UINT64 ForwardStart = Clock.Now();
+        for (UINT32 i = 0; i < Sockets; i++) {
+            Socket[i]->Complete();
+            Result.Forwarded += Socket[i]->ForwardTo(Socket[(i + 1) % Sockets].get(), &Result.Drops);
+            Socket[i]->Refiller.Refill();
+        }
+        ForwardTicks += Clock.Now() - ForwardStart;
+
+        for (UINT32 i = 0; i < Sockets; i++) {
+            Nic.Transmit(&Socket[(i + 1) % Sockets]->Xsk, i, &Result.Mismatches);
+        }
+    }
+    UINT64 Ns = Clock.TicksToNs(Clock.NowOrdered() - Start);
+
+    for (UINT32 i = 0; i < Sockets; i++) {
+        Result.LostFrames += Socket[i]->Pool.Lost();
+    }
+    Result.ForwardNs = Result.Forwarded != 0 ? (double)Clock.TicksToNs(ForwardTicks) / Result.Forwarded : 0.0;
+    Result.Mpps = Ns != 0 ? Result.Forwarded * 1000.0 / Ns : 0.0;
+    Result.UmemBytes = (UINT64)Sockets * ChunksPerSocket * BenchChunkSize;
+    return Result;
+}
+
+static ForwardRunResult RunShared(
+    const TscClock& Clock,
+    UINT32 Sockets,
+    UINT32 ChunksPerSocket,
+    UINT32 Rounds,
+    UINT32 FrameLength)
+{
+    SharedUmemConfig Config;
+    Config.ChunkCount = Sockets * ChunksPerSocket;
+    Config.ChunkSize = BenchChunkSize;
+    Config.CacheSize = BenchCacheSize;
+    Config.CacheBatch = BenchCacheBatch;
+    SharedUmem Umem(Config);
+    ForwardRunResult Result {};
+    if (!Umem.IsValid()) {
+        return Result;
+    }
+
+    std::vector<std::unique_ptr<SoftwareXsk>> Xsk;
+    std::vector<std::unique_ptr<SharedUmemSocket>> Socket;
+    for (UINT32 i = 0; i < Sockets; i++) {
+        Xsk.push_back(std::make_unique<SoftwareXsk>(Umem.Address(), Umem.TotalSize(), BenchChunkSize, BenchRingSize));
+        Socket.push_back(std::make_unique<SharedUmemSocket>(&Umem, Xsk[i]->RingInfo(), BenchRingSize / 2));
+        Socket[i]->Refill();
+    }
+
+    ForwardNic Nic(Sockets, FrameLength);
+    UINT64 ForwardTicks = 0;
+    UINT64 Start = Clock.NowOrdered();
+    for (UINT32 Round = 0; Round < Rounds; Round++) {
+        for (UINT32 i = 0; i < Sockets; i++) {
+            Nic.Deliver(Xsk[i].get(), i, &Result.Drops);
+        }
+
+        UINT64 ForwardStart = Clock.Now();
+        for (UINT32 i = 0; i < Sockets; i++) {
+            Socket[i]->Complete();
+            Socket[i]->ForwardTo(Socket[(i + 1) % Sockets].get(), BenchBurst);
+            Socket[i]->Refill();
+        }
+        ForwardTicks += Clock.Now() - ForwardStart;
+
+        for (UINT32 i = 0; i < Sockets; i++) {
+            Nic.Transmit(Xsk[(i + 1) % Sockets].get(), i, &Result.Mismatches);
+        }
+    }
+    UINT64 Ns = Clock.TicksToNs(Clock.NowOrdered() - Start);
+
+    for (UINT32 i = 0; i < Sockets; i++) {
+        Result.Forwarded += Socket[i]->Statistics().Forwarded;
+        Result.Drops += Socket[i]->Statistics().TxFullDrops;
+        Result.LostFrames += Socket[i]->Pool()->Lost();
+    }
+    Result.ForwardNs = Result.Forwarded != 0 ? (double)Clock.TicksToNs(ForwardTicks) / Result.Forwarded : 0.0;
+    Result.Mpps = Ns != 0 ? Result.Forwarded * 1000.0 / Ns : 0.0;
+    Result.UmemBytes = Umem.TotalSize();
+    return Result;
+}
+
+//
+// Forwarding between AF_XDP sockets with a UMEM each against one UMEM they
+// share, over a range of UMEM sizes: the forward cost per frame, the rate
+// through the whole loop, and how small the UMEMs get before frames drop.
+//
+int SharedUmemBenchmark(int argc, char** argv)
+{
+    UINT32 Sockets = argc >= 1 ? atoi(argv[0]) : 4;
+    UINT32 Frames = argc >= 2 ? atoi(argv[1]) : 4000000;
+    UINT32 FrameLength = argc >= 3 ? atoi(argv[2]) : 1024;
+
+    if (Sockets < 2 || Frames == 0) {
+        fprintf(stderr, "sockets must be at least 2 and frames positive\n");
+        return EXIT_FAILURE;
+    }
+    if (FrameLength < ForwardNic::PayloadOffset + sizeof(UINT64) || FrameLength > BenchChunkSize) {
+        fprintf(stderr, "frame-bytes must be %u to %u\n", ForwardNic::PayloadOffset + 8, BenchChunkSize);
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    UINT32 Rounds = (Frames + Sockets * BenchBurst - 1) / (Sockets * BenchBurst);
+    printf(
+        "%u sockets in a ring, %u-byte frames, %u-entry rings, bursts of %u, %u-frame caches\n\n",
+        Sockets,
+        FrameLength,
+        BenchRingSize,
+        BenchBurst,
+        BenchCacheSize);
+    printf("%-8s %-8s %10s %12s %10s %10s\n", "chunks", "umem", "UMEM MiB", "forward ns", "Mpps", "drops");
+
+    //
+    // From room for a full fill ring, a full TX ring and a cache per socket
+    // down to less than the fill ring alone.
+    //
+    static const UINT32 ChunksPerSocket[] = {
+        2 * BenchRingSize + BenchCacheSize,
+        2 * BenchRingSize,
+        BenchRingSize + BenchCacheSize,
+        BenchRingSize + BenchBurst,
+        BenchRingSize,
+        BenchRingSize / 2,
+    };
+    for (UINT32 Chunks : ChunksPerSocket) {
+        for (bool Shared : {false, true}) {
+            ForwardRunResult Result = Shared ? RunShared(Clock, Sockets, Chunks, Rounds, FrameLength)
+                                             : RunPrivate(Clock, Sockets, Chunks, Rounds, FrameLength);
+            if (Result.Mismatches != 0) {
+                fprintf(stderr, "%llu frames arrived changed or out of order\n", (unsigned long long)Result.Mismatches);
+                return EXIT_FAILURE;
+            }
+            if (Result.LostFrames != 0) {
+                fprintf(stderr, "%llu frames found no room in a pool\n", (unsigned long long)Result.LostFrames);
+                return EXIT_FAILURE;
+            }
+            UINT64 Offered = Result.Forwarded + Result.Drops;
+            printf(
+                "%-8u %-8s %10.1f %12.1f %10.2f %9.2f%%\n",
+                Chunks,
+                Shared ? "shared" : "private",
+                Result.UmemBytes / (1024.0 * 1024.0),
+                Result.ForwardNs,
+                Result.Mpps,
+                Offered != 0 ? Result.Drops * 100.0 / Offered : 0.0);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+//
+// The Winsock names the socket code is written against, with the same
+// meaning on Linux, so the loopback rigs and the socket backends share one
+// set of includes and one idea of an invalid socket. Sockets are kept as
+// UINT_PTR, which holds a SOCKET and a file descriptor alike. On Windows
+// WSAStartup() still has to come first; on Linux a send() with MSG_NOSIGNAL
+// to a peer that has gone fails instead of raising SIGPIPE.
+//
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#define MSG_NOSIGNAL 0
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+#include <windows.h>
+
+inline HRESULT LastSocketError()
+{
+#if defined(_WIN32)
+    return HRESULT_FROM_WIN32(WSAGetLastError());
+#else
+    return HRESULT_FROM_WIN32(errno);
+#endif
+}
+
+//
+// Whether the last call failed only because a non-blocking socket had no
+// room or nothing to read.
+//
+inline bool SocketWouldBlock()
+{
+#if defined(_WIN32)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
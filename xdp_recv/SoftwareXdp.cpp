@@ -0,0 +1,210 @@
+#include "SoftwareXdp.h"
+#include "PacketHeaders.h"
+
+#include <string.h>
+
+#include <thread>
+
+static SoftwareXdpHook* InstalledHook = nullptr;
+
+//
+// Port sets are indexed by the port as it appears on the wire.
+//
+static bool PortSetContains(_In_ const UINT8* PortSet, UINT16 NetworkPort)
+{
+    return (PortSet[NetworkPort >> 3] & (1 << (NetworkPort & 7))) != 0;
+}
+
+SoftwareXdpProgram::SoftwareXdpProgram(_In_reads_(RuleCount) const XDP_RULE* Rules, UINT32 RuleCount)
+    : Rules(Rules, Rules + RuleCount)
+{
+    for (XDP_RULE& Rule : this->Rules) {
+        XDP_PORT_SET* PortSet = nullptr;
+        if (Rule.Match == XDP_MATCH_UDP_PORT_SET) {
+            PortSet = &Rule.Pattern.PortSet;
+        } else if (Rule.Match == XDP_MATCH_IPV4_UDP_PORT_SET) {
+            PortSet = &Rule.Pattern.IpPortSet.PortSet;
+        }
+        if (PortSet != nullptr && PortSet->PortSet != nullptr) {
+            PortSets.push_back(std::make_unique<UINT8[]>(XDP_PORT_SET_BUFFER_SIZE));
+            memcpy(PortSets.back().get(), PortSet->PortSet, XDP_PORT_SET_BUFFER_SIZE);
+            PortSet->PortSet = PortSets.back().get();
+        }
+    }
+}
+
+XDP_RULE_ACTION SoftwareXdpProgram::Classify(_In_ const UCHAR* Frame, UINT32 Length, _Out_ HANDLE* Target) const
+{
+    Ipv4Frame Parsed;
+    bool IsIpv4 = ParseIpv4Frame(Frame, Length, &Parsed);
+    bool IsUdp = IsIpv4 && Parsed.Udp != nullptr;
+
+    *Target = nullptr;
+
+    for (const XDP_RULE& Rule : Rules) {
+        bool Match = false;
+
+        switch (Rule.Match) {
+        case XDP_MATCH_ALL:
+            Match = true;
+            break;
+
+        case XDP_MATCH_UDP:
+            Match = IsUdp;
+            break;
+
+        case XDP_MATCH_UDP_DST:
+            Match = IsUdp && Parsed.Udp->DestinationPort == Rule.Pattern.Port;
+            break;
+
+        case XDP_MATCH_IPV4_DST_MASK:
+            Match = IsIpv4 && (Parsed.Ip->DestinationAddress & Rule.Pattern.IpMask.Mask.Ipv4.s_addr) ==
+                                  Rule.Pattern.IpMask.Address.Ipv4.s_addr;
+            break;
+
+        case XDP_MATCH_IPV4_UDP_TUPLE:
+            Match = IsUdp && Parsed.Ip->SourceAddress == Rule.Pattern.Tuple.SourceAddress.Ipv4.s_addr &&
+                    Parsed.Ip->DestinationAddress == Rule.Pattern.Tuple.DestinationAddress.Ipv4.s_addr &&
+                    Parsed.Udp->SourcePort == Rule.Pattern.Tuple.SourcePort &&
+                    Parsed.Udp->DestinationPort == Rule.Pattern.Tuple.DestinationPort;
+            break;
+
+        case XDP_MATCH_UDP_PORT_SET:
+            Match = IsUdp && PortSetContains(Rule.Pattern.PortSet.PortSet, Parsed.Udp->DestinationPort);
+            break;
+
+        case XDP_MATCH_IPV4_UDP_PORT_SET:
+            Match = IsUdp && Parsed.Ip->DestinationAddress == Rule.Pattern.IpPortSet.Address.Ipv4.s_addr &&
+                    PortSetContains(Rule.Pattern.IpPortSet.PortSet.PortSet, Parsed.Udp->DestinationPort);
+            break;
+
+        default:
+            //
+            // IPv6, TCP and QUIC matches never match IPv4/UDP test traffic.
+            //
+            break;
+        }
+
+        if (Match) {
+            if (Rule.Action == XDP_PROGRAM_ACTION_REDIRECT) {
+                *Target = Rule.Redirect.Target;
+            }
+            return Rule.Action;
+        }
+    }
+
+    return XDP_PROGRAM_ACTION_PASS;
+}
+
+SoftwareXdpHook::SoftwareXdpHook(EpochDomain& Domain) : Domain(Domain) {}
+
+SoftwareXdpHook::~SoftwareXdpHook()
+{
+    if (InstalledHook == this) {
+        InstalledHook = nullptr;
+    }
+
+    for (std::atomic<SoftwareXdpProgram*>& Slot : Programs) {
+        delete Slot.exchange(nullptr);
+    }
+}
+
+void SoftwareXdpHook::Install()
+{
+    InstalledHook = this;
+}
+
+HRESULT SoftwareXdpHook::CreateProgramThunk(
+    _In_ UINT32 InterfaceIndex,
+    _In_ CONST XDP_HOOK_ID* HookId,
+    _In_ UINT32 QueueId,
+    _In_ XDP_CREATE_PROGRAM_FLAGS Flags,
+    _In_reads_(RuleCount) CONST XDP_RULE* Rules,
+    _In_ UINT32 RuleCount,
+    _Out_ HANDLE* Program)
+{
+    UNREFERENCED_PARAMETER(InterfaceIndex);
+    UNREFERENCED_PARAMETER(HookId);
+    UNREFERENCED_PARAMETER(QueueId);
+    UNREFERENCED_PARAMETER(Flags);
+
+    if (InstalledHook == nullptr) {
+        return E_NOINTERFACE;
+    }
+    return InstalledHook->Attach(Rules, RuleCount, Program);
+}
+
+const XDP_API_TABLE* SoftwareXdpHook::ApiTable()
+{
+    static const XDP_API_TABLE Table = [] {
+        XDP_API_TABLE Api {};
+        Api.XdpCreateProgram = &SoftwareXdpHook::CreateProgramThunk;
+        Api.XskNotifyAsync = &SoftwareXsk::NotifyAsyncThunk;
+        Api.XskGetNotifyAsyncResult = &SoftwareXsk::GetNotifyAsyncResultThunk;
+        return Api;
+    }();
+    return &Table;
+}
+
+BOOL SoftwareXdpHook::CloseProgram(HANDLE Program)
+{
+    return InstalledHook != nullptr && InstalledHook->Detach(Program);
+}
+
+HRESULT SoftwareXdpHook::Attach(_In_reads_(RuleCount) const XDP_RULE* Rules, UINT32 RuleCount, _Out_ HANDLE* Program)
+{
+    if (AttachDelayUs != 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(AttachDelayUs));
+    }
+
+    auto* NewProgram = new SoftwareXdpProgram(Rules, RuleCount);
+    for (std::atomic<SoftwareXdpProgram*>& Slot : Programs) {
+        SoftwareXdpProgram* Expected = nullptr;
+        if (Slot.compare_exchange_strong(Expected, NewProgram)) {
+            *Program = NewProgram;
+            return S_OK;
+        }
+    }
+
+    delete NewProgram;
+    return E_OUTOFMEMORY;
+}
+
+BOOL SoftwareXdpHook::Detach(HANDLE Program)
+{
+    for (std::atomic<SoftwareXdpProgram*>& Slot : Programs) {
+        SoftwareXdpProgram* Expected = (SoftwareXdpProgram*)Program;
+        if (Slot.compare_exchange_strong(Expected, nullptr)) {
+            Domain.Retire(Expected);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+bool SoftwareXdpHook::Receive(UINT32 Reader, _In_reads_bytes_(Length) const UCHAR* Frame, UINT32 Length)
+{
+    bool Redirected = false;
+
+    Domain.Enter(Reader);
+    for (std::atomic<SoftwareXdpProgram*>& Slot : Programs) {
+        const SoftwareXdpProgram* Program = Slot.load(std::memory_order_seq_cst);
+        HANDLE Target;
+        if (Program == nullptr) {
+            continue;
+        }
+
+        XDP_RULE_ACTION Action = Program->Classify(Frame, Length, &Target);
+        if (Action == XDP_PROGRAM_ACTION_PASS) {
+            continue;
+        }
+        if (Action == XDP_PROGRAM_ACTION_REDIRECT && Target != nullptr) {
+            ((SoftwareXsk*)Target)->Deliver(Frame, Length);
+            Redirected = true;
+        }
+        break;
+    }
+    Domain.Exit(Reader);
+
+    return Redirected;
+}
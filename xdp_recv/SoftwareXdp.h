@@ -0,0 +1,80 @@
+#pragma once
+
+#include <windows.h>
+#include <xdpapi.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "EpochReclaim.h"
+#include "SoftwareXsk.h"
+
+//
+// Software evaluation of an XDP program, used by the benchmarks in place of
+// the XDP driver. Rules are evaluated in order and the first match decides
+// the action, as in XDP. Port set bitmaps are copied when the program is
+// created, as XdpCreateProgram copies them into the driver, so the caller's
+// may be freed as soon as the program exists.
+//
+class SoftwareXdpProgram {
+  public:
+    SoftwareXdpProgram(_In_reads_(RuleCount) const XDP_RULE* Rules, UINT32 RuleCount);
+
+    //
+    // Returns the action of the first matching rule, or XDP_PROGRAM_ACTION_PASS
+    // if no rule matches. Target receives the redirect target, if any.
+    //
+    XDP_RULE_ACTION Classify(_In_ const UCHAR* Frame, UINT32 Length, _Out_ HANDLE* Target) const;
+
+    UINT32 RuleCount() const { return (UINT32)Rules.size(); }
+
+  private:
+    std::vector<XDP_RULE> Rules;
+    std::vector<std::unique_ptr<UINT8[]>> PortSets;
+};
+
+//
+// A software receive hook with any number of attached programs. Programs
+// attach and detach while the NIC thread is receiving; the NIC thread reads
+// the program list under the epoch domain, so detaching never stalls it.
+//
+// Install() makes this hook the target of ApiTable()->XdpCreateProgram and of
+// CloseProgram(), so code written against XDP_API_TABLE runs unchanged.
+// Redirect targets are SoftwareXsk pointers passed as HANDLEs. The table's
+// XskNotifyAsync and XskGetNotifyAsyncResult work on those handles.
+//
+class SoftwareXdpHook {
+  public:
+    static constexpr UINT32 MaxPrograms = 8;
+
+    explicit SoftwareXdpHook(EpochDomain& Domain);
+    ~SoftwareXdpHook();
+
+    void Install();
+    static const XDP_API_TABLE* ApiTable();
+    static BOOL CloseProgram(HANDLE Program);
+
+    //
+    // Simulated cost of attaching a program, which is what opens the loss
+    // window of a break-before-make swap.
+    //
+    void SetAttachDelay(UINT32 Microseconds) { AttachDelayUs = Microseconds; }
+
+    //
+    // NIC side. Runs the frame through the attached programs and delivers it
+    // to the redirect target. Returns false if no program redirected it.
+    // Reader identifies the calling thread in the epoch domain.
+    //
+    bool Receive(UINT32 Reader, _In_reads_bytes_(Length) const UCHAR* Frame, UINT32 Length);
+
+  private:
+    static XDP_CREATE_PROGRAM_FN CreateProgramThunk;
+
+    HRESULT Attach(_In_reads_(RuleCount) const XDP_RULE* Rules, UINT32 RuleCount, _Out_ HANDLE* Program);
+    BOOL Detach(HANDLE Program);
+
+    EpochDomain& Domain;
+    std::atomic<SoftwareXdpProgram*> Programs[MaxPrograms] {};
+    UINT32 AttachDelayUs = 0;
+};
@@ -0,0 +1,259 @@
+#include "SoftwareXsk.h"
+#include "MultiBufferRing.h"
+
+//
+// Producer index, consumer index and flags each get their own cache line,
+// followed by the descriptor array.
+//
+static constexpr UINT32 RingCacheLine = 64;
+static constexpr UINT32 RingHeaderSize = 3 * RingCacheLine;
+
+//
+// Frame descriptor plus the fragment extension, padded to keep descriptors
+// 8-byte aligned.
+//
+static constexpr UINT32 MultiBufferStride =
+    (sizeof(XSK_FRAME_DESCRIPTOR) + sizeof(XskFrameFragment) + 7) & ~7u;
+
+SoftwareXsk::SoftwareXsk(_In_ VOID* Umem, UINT64 UmemSize, UINT32 ChunkSize, UINT32 RingSize, bool MultiBuffer)
+    : Umem((UCHAR*)Umem)
+    , UmemSize(UmemSize)
+    , ChunkSize(ChunkSize)
+    , MultiBuffer(MultiBuffer)
+{
+    UINT32 DescriptorStride = MultiBuffer ? MultiBufferStride : sizeof(XSK_BUFFER_DESCRIPTOR);
+    UINT64 Total = 2 * (RingHeaderSize + (UINT64)RingSize * sizeof(UINT64)) +
+                   2 * (RingHeaderSize + (UINT64)RingSize * DescriptorStride) + 4 * RingCacheLine;
+    RingMemory = std::make_unique<UCHAR[]>(Total);
+    memset(RingMemory.get(), 0, Total);
+
+    Rings.Fill = AllocateRing(RingSize, sizeof(UINT64));
+    Rings.Completion = AllocateRing(RingSize, sizeof(UINT64));
+    Rings.Rx = AllocateRing(RingSize, DescriptorStride);
+    Rings.Tx = AllocateRing(RingSize, DescriptorStride);
+
+    XskRingInitialize(&NicFill, &Rings.Fill);
+    XskRingInitialize(&NicRx, &Rings.Rx);
+    XskRingInitialize(&NicTx, &Rings.Tx);
+    XskRingInitialize(&NicCompletion, &Rings.Completion);
+}
+
+XSK_RING_INFO SoftwareXsk::AllocateRing(UINT32 Size, UINT32 ElementStride)
+{
+    UCHAR* Base = RingMemory.get();
+    UINT64 Offset = (RingMemoryUsed + RingCacheLine - 1) & ~(UINT64)(RingCacheLine - 1);
+    RingMemoryUsed = Offset + RingHeaderSize + (UINT64)Size * ElementStride;
+
+    XSK_RING_INFO Info {};
+    Info.Ring = Base + Offset;
+    Info.ProducerIndexOffset = 0;
+    Info.ConsumerIndexOffset = RingCacheLine;
+    Info.FlagsOffset = 2 * RingCacheLine;
+    Info.DescriptorsOffset = RingHeaderSize;
+    Info.Size = Size;
+    Info.ElementStride = ElementStride;
+    return Info;
+}
+
+bool SoftwareXsk::Deliver(_In_reads_bytes_(Length) const VOID* Frame, UINT32 Length)
+{
+    UINT32 FillIndex;
+    UINT32 RxIndex;
+
+    //
+    // A multi-buffer frame takes a fill buffer and an RX descriptor per
+    // chunk, all or nothing.
+    //
+    UINT32 Buffers = 1;
+    if (MultiBuffer && Length > ChunkSize) {
+        Buffers = (Length + ChunkSize - 1) / ChunkSize;
+        if (Buffers > (UINT32)MAXUINT8 + 1) {
+            Buffers = (UINT32)MAXUINT8 + 1;
+        }
+    }
+
+    if (XskRingProducerReserve(&NicRx, Buffers, &RxIndex) != Buffers) {
+        RxFullDrops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (XskRingConsumerReserve(&NicFill, Buffers, &FillIndex) != Buffers) {
+        FillStarvedDrops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const UCHAR* Bytes = (const UCHAR*)Frame;
+    for (UINT32 i = 0; i < Buffers; i++) {
+        XSK_BUFFER_ADDRESS Address;
+        Address.AddressAndOffset = *(UINT64*)XskRingGetElement(&NicFill, FillIndex + i);
+
+        UINT64 Offset = Address.BaseAddress + Address.Offset;
+        UINT64 Room = ChunkSize - (Offset % ChunkSize);
+        if (Offset + Room > UmemSize) {
+            Room = Offset < UmemSize ? UmemSize - Offset : 0;
+        }
+        UINT32 Piece = Length;
+        if (Piece > Room) {
+            Piece = (UINT32)Room;
+        }
+        memcpy(Umem + Offset, Bytes, Piece);
+        Bytes += Piece;
+        Length -= Piece;
+
+        XSK_BUFFER_DESCRIPTOR* Descriptor = (XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&NicRx, RxIndex + i);
+        Descriptor->Address = Address;
+        Descriptor->Length = Piece;
+        Descriptor->Reserved = 0;
+        if (MultiBuffer) {
+            ((XskFrameFragment*)((UCHAR*)Descriptor + sizeof(XSK_FRAME_DESCRIPTOR)))->FragmentBufferCount =
+                (UINT8)(i == 0 ? Buffers - 1 : 0);
+        }
+    }
+    WriteUInt32Release(NicFill.SharedConsumer, *NicFill.SharedConsumer + Buffers);
+    XskRingProducerSubmit(&NicRx, Buffers);
+
+    if (Length != 0) {
+        TruncatedFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    DeliveredFrames.fetch_add(1, std::memory_order_relaxed);
+    SignalNotify();
+    return true;
+}
+
+UINT32 SoftwareXsk::Transmit(_Out_writes_bytes_(BufferLength) VOID* Buffer, UINT32 BufferLength)
+{
+    UINT32 TxIndex;
+    UINT32 CompletionIndex;
+
+    UINT32 Available = XskRingConsumerReserve(&NicTx, MAXUINT32, &TxIndex);
+    if (Available == 0) {
+        return 0;
+    }
+
+    const UCHAR* First = (const UCHAR*)XskRingGetElement(&NicTx, TxIndex);
+    UINT32 Buffers = 1;
+    if (MultiBuffer) {
+        Buffers += ((const XskFrameFragment*)(First + sizeof(XSK_FRAME_DESCRIPTOR)))->FragmentBufferCount;
+    }
+    if (Buffers > Available || XskRingProducerReserve(&NicCompletion, Buffers, &CompletionIndex) != Buffers) {
+        return 0;
+    }
+
+    UINT32 Length = 0;
+    for (UINT32 i = 0; i < Buffers; i++) {
+        const XSK_BUFFER_DESCRIPTOR* Descriptor = (const XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&NicTx, TxIndex + i);
+        if (Length + Descriptor->Length > BufferLength) {
+            return 0;
+        }
+        memcpy(
+            (UCHAR*)Buffer + Length,
+            Umem + Descriptor->Address.BaseAddress + Descriptor->Address.Offset,
+            Descriptor->Length);
+        Length += Descriptor->Length;
+        *(UINT64*)XskRingGetElement(&NicCompletion, CompletionIndex + i) = Descriptor->Address.AddressAndOffset;
+    }
+    WriteUInt32Release(NicTx.SharedConsumer, *NicTx.SharedConsumer + Buffers);
+    XskRingProducerSubmit(&NicCompletion, Buffers);
+    SignalNotify();
+
+    return Length;
+}
+
+XSK_NOTIFY_RESULT_FLAGS SoftwareXsk::ReadyRings(XSK_NOTIFY_FLAGS Flags) const
+{
+    XSK_NOTIFY_RESULT_FLAGS Ready = XSK_NOTIFY_RESULT_FLAG_NONE;
+    if ((Flags & XSK_NOTIFY_FLAG_WAIT_RX) != 0 &&
+        ReadUInt32Acquire(NicRx.SharedProducer) != ReadUInt32Acquire(NicRx.SharedConsumer)) {
+        Ready |= XSK_NOTIFY_RESULT_FLAG_RX_AVAILABLE;
+    }
+    if ((Flags & XSK_NOTIFY_FLAG_WAIT_TX) != 0 &&
+        ReadUInt32Acquire(NicCompletion.SharedProducer) != ReadUInt32Acquire(NicCompletion.SharedConsumer)) {
+        Ready |= XSK_NOTIFY_RESULT_FLAG_TX_COMP_AVAILABLE;
+    }
+    return Ready;
+}
+
+HRESULT SoftwareXsk::NotifyAsync(XSK_NOTIFY_FLAGS Flags, _Inout_ OVERLAPPED* Overlapped)
+{
+    std::lock_guard Guard(NotifyLock);
+    if (NotifyPort == nullptr) {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_HANDLE);
+    }
+    if (NotifyOverlapped != nullptr) {
+        return HRESULT_FROM_WIN32(ERROR_BUSY);
+    }
+
+    NotifyOverlapped = Overlapped;
+    NotifyFlags = Flags;
+
+    //
+    // Armed before the rings are checked, and the NIC side checks the flag
+    // after publishing: one of the two sees the other, so no frame goes
+    // unnotified. A wait that is satisfied at once still completes through
+    // the port, as overlapped IO does without FILE_SKIP_COMPLETION_PORT_ON_SUCCESS.
+    //
+    NotifyArmed.store(true, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (XSK_NOTIFY_RESULT_FLAGS Ready = ReadyRings(Flags); Ready != XSK_NOTIFY_RESULT_FLAG_NONE) {
+        CompleteNotify(S_OK, Ready);
+        return S_OK;
+    }
+    return HRESULT_FROM_WIN32(ERROR_IO_PENDING);
+}
+
+void SoftwareXsk::CompleteNotify(HRESULT Status, XSK_NOTIFY_RESULT_FLAGS Ready)
+{
+    OVERLAPPED* Overlapped = NotifyOverlapped;
+    NotifyOverlapped = nullptr;
+    NotifyArmed.store(false, std::memory_order_relaxed);
+
+    Overlapped->Internal = (ULONG_PTR)(ULONG)Status;
+    Overlapped->InternalHigh = (ULONG_PTR)Ready;
+    PostQueuedCompletionStatus(NotifyPort, 0, NotifyKey, Overlapped);
+}
+
+void SoftwareXsk::SignalNotify()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!NotifyArmed.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::lock_guard Guard(NotifyLock);
+    if (NotifyOverlapped != nullptr) {
+        if (XSK_NOTIFY_RESULT_FLAGS Ready = ReadyRings(NotifyFlags); Ready != XSK_NOTIFY_RESULT_FLAG_NONE) {
+            CompleteNotify(S_OK, Ready);
+        }
+    }
+}
+
+void SoftwareXsk::CancelNotify()
+{
+    std::lock_guard Guard(NotifyLock);
+    if (NotifyOverlapped != nullptr) {
+        CompleteNotify(HRESULT_FROM_WIN32(ERROR_OPERATION_ABORTED), XSK_NOTIFY_RESULT_FLAG_NONE);
+    }
+}
+
+HRESULT SoftwareXsk::NotifyAsyncThunk(_In_ HANDLE Socket, _In_ XSK_NOTIFY_FLAGS Flags, _Inout_ OVERLAPPED* Overlapped)
+{
+    return ((SoftwareXsk*)Socket)->NotifyAsync(Flags, Overlapped);
+}
+
+HRESULT SoftwareXsk::GetNotifyAsyncResultThunk(_In_ OVERLAPPED* Overlapped, _Out_ XSK_NOTIFY_RESULT_FLAGS* Result)
+{
+    *Result = (XSK_NOTIFY_RESULT_FLAGS)Overlapped->InternalHigh;
+    return (HRESULT)(ULONG)Overlapped->Internal;
+}
+
+HANDLE SoftwareXsk::AssociateCompletionPort(HANDLE Socket, HANDLE Port, ULONG_PTR Key, DWORD Threads)
+{
+    UNREFERENCED_PARAMETER(Threads);
+
+    SoftwareXsk* Xsk = (SoftwareXsk*)Socket;
+    std::lock_guard Guard(Xsk->NotifyLock);
+    Xsk->NotifyPort = Port;
+    Xsk->NotifyKey = Key;
+    return Port;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <windows.h>
+#include <afxdp_helper.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+//
+// In-process stand-in for an AF_XDP socket, used by the benchmarks. It lays
+// out RX, fill, TX and completion rings exactly like XSK_SOCKOPT_RING_INFO
+// describes them, so application code initializes its XSK_RINGs from
+// RingInfo() and runs unchanged. The "NIC" side is driven by the benchmark:
+// Deliver() plays the XDP receive path (pop a fill descriptor, copy the frame
+// into the UMEM, post an RX descriptor) and counts drops the same way XDP
+// does. Transmit() plays the XDP send path. The NIC side may run on its own
+// thread.
+//
+// With MultiBuffer, RX and TX ring elements carry an XskFrameFragment
+// extension at FragmentOffset() and a frame larger than a chunk is spread
+// over consecutive descriptors, as MultiBufferRx and MultiBufferTx expect.
+//
+// The socket's HANDLE is the SoftwareXsk pointer. Notifications follow
+// XskNotifyAsync on an IO completion port: a wait completes, through the
+// port it was associated with, once a ring it waits on has entries.
+//
+class SoftwareXsk {
+  public:
+    SoftwareXsk(_In_ VOID* Umem, UINT64 UmemSize, UINT32 ChunkSize, UINT32 RingSize, bool MultiBuffer = false);
+
+    SoftwareXsk(const SoftwareXsk&) = delete;
+    SoftwareXsk& operator=(const SoftwareXsk&) = delete;
+
+    const XSK_RING_INFO_SET& RingInfo() const { return Rings; }
+    UINT32 FragmentOffset() const { return MultiBuffer ? sizeof(XSK_FRAME_DESCRIPTOR) : 0; }
+
+    //
+    // Receives one frame. Returns false if the frame was dropped because the
+    // fill ring was empty or the RX ring was full.
+    //
+    bool Deliver(_In_reads_bytes_(Length) const VOID* Frame, UINT32 Length);
+
+    //
+    // Sends the next frame on the TX ring: copies it to Buffer and completes
+    // its buffers. Returns the frame length, or 0 if the TX ring is empty,
+    // the completion ring is full or the frame does not fit in Buffer.
+    //
+    UINT32 Transmit(_Out_writes_bytes_(BufferLength) VOID* Buffer, UINT32 BufferLength);
+
+    XSK_STATISTICS Statistics() const
+    {
+        XSK_STATISTICS Stats {};
+        Stats.RxDropped =
+            FillStarvedDrops.load(std::memory_order_relaxed) + RxFullDrops.load(std::memory_order_relaxed);
+        Stats.RxTruncated = TruncatedFrames.load(std::memory_order_relaxed);
+        return Stats;
+    }
+
+    //
+    // XskNotifyAsync and XskGetNotifyAsyncResult for software sockets, and
+    // the CreateIoCompletionPort that associates one with a port. Only one
+    // wait may be outstanding per socket.
+    //
+    static XSK_NOTIFY_ASYNC_FN NotifyAsyncThunk;
+    static XSK_GET_NOTIFY_ASYNC_RESULT_FN GetNotifyAsyncResultThunk;
+    static HANDLE AssociateCompletionPort(HANDLE Socket, HANDLE Port, ULONG_PTR Key, DWORD Threads);
+
+    //
+    // Completes an outstanding wait as aborted, like CancelIoEx.
+    //
+    void CancelNotify();
+
+    UINT64 Delivered() const { return DeliveredFrames.load(std::memory_order_relaxed); }
+    UINT64 FillStarved() const { return FillStarvedDrops.load(std::memory_order_relaxed); }
+    UINT64 RxFull() const { return RxFullDrops.load(std::memory_order_relaxed); }
+
+  private:
+    XSK_RING_INFO AllocateRing(UINT32 Size, UINT32 ElementStride);
+    XSK_NOTIFY_RESULT_FLAGS ReadyRings(XSK_NOTIFY_FLAGS Flags) const;
+    HRESULT NotifyAsync(XSK_NOTIFY_FLAGS Flags, _Inout_ OVERLAPPED* Overlapped);
+    void CompleteNotify(HRESULT Status, XSK_NOTIFY_RESULT_FLAGS Ready);
+    void SignalNotify();
+
+    UCHAR* Umem;
+    UINT64 UmemSize;
+    UINT32 ChunkSize;
+    bool MultiBuffer;
+    std::unique_ptr<UCHAR[]> RingMemory;
+    UINT64 RingMemoryUsed = 0;
+    XSK_RING_INFO_SET Rings;
+
+    //
+    // The rings as seen from the XDP side: fill and TX are consumed, RX and
+    // completion are produced.
+    //
+    XSK_RING NicFill;
+    XSK_RING NicRx;
+    XSK_RING NicTx;
+    XSK_RING NicCompletion;
+
+    std::atomic<UINT64> DeliveredFrames {0};
+    std::atomic<UINT64> FillStarvedDrops {0};
+    std::atomic<UINT64> RxFullDrops {0};
+    std::atomic<UINT64> TruncatedFrames {0};
+
+    std::mutex NotifyLock;
+    std::atomic<bool> NotifyArmed {false};
+    HANDLE NotifyPort = nullptr;
+    ULONG_PTR NotifyKey = 0;
+    OVERLAPPED* NotifyOverlapped = nullptr;
+    XSK_NOTIFY_FLAGS NotifyFlags = XSK_NOTIFY_FLAG_NONE;
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <memory>
+
+//
+// Bounded single-producer single-consumer ring of trivially copyable
+// elements. The size is rounded up to a power of two.
+//
+// Each side keeps its own index and a cached copy of the other side's on its
+// own cache line, so in steady state the producer and consumer only touch the
+// shared indices when the cached copy says the ring looks full or empty.
+// Pushes are staged until Publish(), which lets the producer make a whole
+// burst visible with one release store.
+//
+template <typename T>
+class SpscRing {
+  public:
+    explicit SpscRing(UINT32 Size)
+    {
+        Capacity = 1;
+        while (Capacity < Size) {
+            Capacity <<= 1;
+        }
+        Mask = Capacity - 1;
+        Elements = std::make_unique<T[]>(Capacity);
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    //
+    // Producer side. The element is not visible to the consumer until the
+    // next Publish().
+    //
+    bool Push(const T& Element)
+    {
+        if (Producer.Next - Producer.CachedHead == Capacity) {
+            Producer.CachedHead = Head.load(std::memory_order_acquire);
+            if (Producer.Next - Producer.CachedHead == Capacity) {
+                return false;
+            }
+        }
+        Elements[Producer.Next & Mask] = Element;
+        Producer.Next++;
+        return true;
+    }
+
+    void Publish() { Tail.store(Producer.Next, std::memory_order_release); }
+
+    //
+    // Producer side. Elements that can be pushed without failing.
+    //
+    UINT32 Room() const { return Capacity - (Producer.Next - Head.load(std::memory_order_acquire)); }
+
+    //
+    // Consumer side. Returns the number of elements copied to Out.
+    //
+    UINT32 Pop(_Out_writes_to_(Max, return) T* Out, UINT32 Max)
+    {
+        if (Consumer.CachedTail == Consumer.Next) {
+            Consumer.CachedTail = Tail.load(std::memory_order_acquire);
+        }
+
+        UINT32 Count = Consumer.CachedTail - Consumer.Next;
+        if (Count > Max) {
+            Count = Max;
+        }
+        for (UINT32 i = 0; i < Count; i++) {
+            Out[i] = Elements[(Consumer.Next + i) & Mask];
+        }
+        if (Count > 0) {
+            Consumer.Next += Count;
+            Head.store(Consumer.Next, std::memory_order_release);
+        }
+        return Count;
+    }
+
+    //
+    // Approximate; exact only when called from either side while the other
+    // is idle.
+    //
+    UINT32 Occupancy() const { return Tail.load(std::memory_order_acquire) - Head.load(std::memory_order_acquire); }
+    UINT32 Size() const { return Capacity; }
+
+  private:
+    struct alignas(64) ProducerState {
+        UINT32 Next = 0;
+        UINT32 CachedHead = 0;
+    };
+
+    struct alignas(64) ConsumerState {
+        UINT32 Next = 0;
+        UINT32 CachedTail = 0;
+    };
+
+    alignas(64) std::atomic<UINT32> Tail {0};
+    alignas(64) std::atomic<UINT32> Head {0};
+    ProducerState Producer;
+    ConsumerState Consumer;
+    std::unique_ptr<T[]> Elements;
+    UINT32 Capacity;
+    UINT32 Mask;
+};
@@ -0,0 +1,306 @@
+#include "TimerWheel.h"
+
+#include <bit>
+
+TimerWheel::TimerWheel(const TimerWheelConfig& Config, UINT64 NowTick)
+    : CascadeBudget(Config.CascadeBudget)
+    , Capacity(Config.MaxTimers != 0 ? Config.MaxTimers : 1)
+{
+    while (Shift < 63 && (1ull << Shift) < Config.ResolutionTicks) {
+        Shift++;
+    }
+    Current = NowTick >> Shift;
+
+    Nodes = std::make_unique<Node[]>(Capacity);
+    for (UINT32 Index = Capacity; Index-- > 0;) {
+        Nodes[Index] = {0, 0, None, FreeList, None, 1};
+        FreeList = Index;
+    }
+    for (UINT32& Head : Heads) {
+        Head = None;
+    }
+}
+
+TimerHandle TimerWheel::Schedule(UINT64 DeadlineTick, UINT64 Context)
+{
+    if (FreeList == None) {
+        Stats.Exhausted++;
+        return InvalidTimer;
+    }
+
+    UINT32 Index = FreeList;
+    Node& Timer = Nodes[Index];
+    FreeList = Timer.Next;
+    Timer.Deadline = DeadlineTick;
+    Timer.Context = Context;
+    Insert(Index);
+
+    Active++;
+    Stats.Scheduled++;
+    return MakeHandle(Index, Timer.Generation);
+}
+
+bool TimerWheel::Cancel(TimerHandle Handle)
+{
+    Node* Timer = Lookup(Handle);
+    if (Timer == nullptr) {
+        return false;
+    }
+
+    Unlink((UINT32)Handle);
+    Release((UINT32)Handle);
+    Stats.Cancelled++;
+    return true;
+}
+
+bool TimerWheel::Reschedule(TimerHandle Handle, UINT64 DeadlineTick)
+{
+    Node* Timer = Lookup(Handle);
+    if (Timer == nullptr) {
+        return false;
+    }
+
+    Unlink((UINT32)Handle);
+    Timer->Deadline = DeadlineTick;
+    Insert((UINT32)Handle);
+
+    Stats.Rescheduled++;
+    return true;
+}
+
+UINT32 TimerWheel::Advance(UINT64 NowTick, _Out_writes_to_(MaxExpired, return) UINT64* Expired, UINT32 MaxExpired)
+{
+    UINT64 Target = NowTick >> Shift;
+    UINT32 Count = 0;
+
+    while (Current <= Target) {
+        if (Active == 0) {
+            Current = Target;
+            break;
+        }
+
+        //
+        // Crossing into a new block of level-0 slots: move down whatever
+        // CascadeAhead() has not, top level first. Resuming a slot that a
+        // full batch cut short repeats this for lists that are already empty.
+        //
+        if (((UINT32)Current & SlotMask) == 0) {
+            UINT32 Top = 1;
+            while (Top + 1 < Levels && ((Current >> (SlotBits * Top)) & SlotMask) == 0) {
+                Top++;
+            }
+            for (UINT32 Level = Top; Level >= 1; Level--) {
+                Cascade(ListOf(Level, Current));
+            }
+        }
+
+        UINT32 List = ListOf(0, Current);
+        while (Heads[List] != None) {
+            if (Count == MaxExpired) {
+                return Count;
+            }
+
+            UINT32 Index = Heads[List];
+            Expired[Count++] = Nodes[Index].Context;
+            Unlink(Index);
+            Release(Index);
+            Stats.Expired++;
+        }
+
+        //
+        // The wheel stops on the target granule rather than past it, so a
+        // timer scheduled for now before the next call still fires then.
+        //
+        UINT64 Next = NextDue();
+        if (Next > Target) {
+            Current = Target;
+            break;
+        }
+        Current = Next;
+    }
+
+    if (Active != 0) {
+        CascadeAhead(CascadeBudget);
+    }
+    return Count;
+}
+
+UINT64 TimerWheel::MemoryFootprint() const
+{
+    return (UINT64)Capacity * sizeof(Node) + sizeof(Heads) + sizeof(Occupied);
+}
+
+UINT64 TimerWheel::GranuleOf(const Node& Timer) const
+{
+    //
+    // Round the deadline up to a granule so the timer never fires early.
+    //
+    UINT64 Mask = (1ull << Shift) - 1;
+    return Timer.Deadline > MAXUINT64 - Mask ? MAXUINT64 >> Shift : (Timer.Deadline + Mask) >> Shift;
+}
+
+TimerWheel::Node* TimerWheel::Lookup(TimerHandle Handle)
+{
+    UINT32 Index = (UINT32)Handle;
+    if (Index >= Capacity) {
+        return nullptr;
+    }
+
+    Node* Timer = &Nodes[Index];
+    if (Timer->Slot == None || Timer->Generation != (UINT32)(Handle >> 32)) {
+        return nullptr;
+    }
+    return Timer;
+}
+
+void TimerWheel::Release(UINT32 Index)
+{
+    Node& Timer = Nodes[Index];
+    Timer.Slot = None;
+    Timer.Generation = Timer.Generation + 1 != 0 ? Timer.Generation + 1 : 1;
+    Timer.Next = FreeList;
+    FreeList = Index;
+    Active--;
+}
+
+void TimerWheel::Insert(UINT32 Index)
+{
+    UINT64 Granule = GranuleOf(Nodes[Index]);
+    if (Granule < Current) {
+        Granule = Current;
+    }
+
+    //
+    // The lowest level whose slots reach the deadline. A timer at level L is
+    // at least a level-L slot away, so the wheel turns into its slot and
+    // round no later than the deadline.
+    //
+    UINT64 Delta = Granule - Current;
+    UINT32 Level = 0;
+    while (Level + 1 < Levels && Delta >= 1ull << (SlotBits * (Level + 1))) {
+        Level++;
+    }
+
+    //
+    // Beyond the horizon: park in the farthest top-level slot, which is
+    // placed again before the real deadline comes up.
+    //
+    if (Delta >= 1ull << (SlotBits * Levels)) {
+        Granule = Current + (1ull << (SlotBits * Levels)) - 1;
+    }
+
+    Link(Index, ListOf(Level, Granule));
+}
+
+void TimerWheel::Link(UINT32 Index, UINT32 List)
+{
+    Node& Timer = Nodes[Index];
+    Timer.Slot = List;
+    Timer.Prev = None;
+    Timer.Next = Heads[List];
+    if (Timer.Next != None) {
+        Nodes[Timer.Next].Prev = Index;
+    }
+    Heads[List] = Index;
+    Occupied[List / SlotsPerLevel][(List % SlotsPerLevel) / 64] |= 1ull << (List % 64);
+}
+
+void TimerWheel::Unlink(UINT32 Index)
+{
+    Node& Timer = Nodes[Index];
+
+    if (Timer.Prev != None) {
+        Nodes[Timer.Prev].Next = Timer.Next;
+    } else {
+        Heads[Timer.Slot] = Timer.Next;
+    }
+    if (Timer.Next != None) {
+        Nodes[Timer.Next].Prev = Timer.Prev;
+    }
+
+    if (Heads[Timer.Slot] == None) {
+        Occupied[Timer.Slot / SlotsPerLevel][(Timer.Slot % SlotsPerLevel) / 64] &= ~(1ull << (Timer.Slot % 64));
+    }
+}
+
+void TimerWheel::Cascade(UINT32 List)
+{
+    UINT32 Index = Heads[List];
+    Heads[List] = None;
+    Occupied[List / SlotsPerLevel][(List % SlotsPerLevel) / 64] &= ~(1ull << (List % 64));
+
+    while (Index != None) {
+        UINT32 Next = Nodes[Index].Next;
+        Insert(Index);
+        Stats.Cascaded++;
+        Index = Next;
+    }
+}
+
+void TimerWheel::CascadeAhead(UINT32 Budget)
+{
+    //
+    // Every timer in the slot a level turns into next is due in that slot's
+    // span, which is the next round of the level below; move it into the
+    // next-round list of its slot there, where the current round never
+    // looks. Timers parked beyond the horizon are placed again instead.
+    //
+    for (UINT32 Level = 1; Level < Levels && Budget != 0; Level++) {
+        UINT32 Bits = SlotBits * Level;
+        UINT64 Start = ((Current >> Bits) + 1) << Bits;
+        UINT32 List = ListOf(Level, Start);
+
+        while (Heads[List] != None && Budget != 0) {
+            UINT32 Index = Heads[List];
+            UINT64 Granule = GranuleOf(Nodes[Index]);
+            Unlink(Index);
+            if (Granule >= Start + (1ull << Bits)) {
+                Insert(Index);
+            } else {
+                Link(Index, ListOf(Level - 1, Granule));
+            }
+            Stats.Cascaded++;
+            Budget--;
+        }
+    }
+}
+
+UINT32 TimerWheel::NextOccupied(UINT32 Level, UINT32 Round, UINT32 From) const
+{
+    const UINT64* Bitmap = Occupied[Level * Rounds + Round];
+    for (UINT32 Word = From / 64; Word < BitmapWords; Word++) {
+        UINT64 Bits = Bitmap[Word];
+        if (Word == From / 64) {
+            Bits &= ~0ull << (From % 64);
+        }
+        if (Bits != 0) {
+            return Word * 64 + std::countr_zero(Bits);
+        }
+    }
+    return SlotsPerLevel;
+}
+
+UINT64 TimerWheel::NextDue() const
+{
+    //
+    // The next granule with work: an occupied level-0 slot ahead in this
+    // block, else the start of the next occupied slot of the lowest level
+    // that has one ahead in its current round. A level with timers only in
+    // its next round has nothing to do before the level above turns.
+    //
+    for (UINT32 Level = 0; Level < Levels; Level++) {
+        UINT32 Bits = SlotBits * Level;
+        UINT32 Position = (UINT32)(Current >> Bits) & SlotMask;
+        UINT32 Round = (UINT32)(Current >> (Bits + SlotBits)) & (Rounds - 1);
+
+        UINT32 Found = NextOccupied(Level, Round, Position + 1);
+        if (Found != SlotsPerLevel) {
+            return (((Current >> Bits) & ~(UINT64)SlotMask) + Found) << Bits;
+        }
+        if (NextOccupied(Level, Round ^ 1, 0) != SlotsPerLevel || NextOccupied(Level, Round, 0) != SlotsPerLevel) {
+            return ((Current >> (Bits + SlotBits)) + 1) << (Bits + SlotBits);
+        }
+    }
+
+    return ((Current >> (SlotBits * Levels)) + 1) << (SlotBits * Levels);
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <windows.h>
+
+#include <memory>
+
+//
+// Identifies a scheduled timer. Handles are never reused while their timer is
+// live, and a stale handle is safely rejected by Cancel() and Reschedule().
+//
+using TimerHandle = UINT64;
+constexpr TimerHandle InvalidTimer = 0;
+
+struct TimerWheelConfig {
+    //
+    // Timers that can be live at once; all of them are allocated up front.
+    //
+    UINT32 MaxTimers = 65536;
+
+    //
+    // Expiry granularity, rounded up to a power of two. A timer fires no
+    // earlier than its deadline and at most one granule after it, plus
+    // however long the caller takes to call Advance().
+    //
+    UINT64 ResolutionTicks = 1;
+
+    //
+    // Timers Advance() moves down a level ahead of time on each call; see
+    // below.
+    //
+    UINT32 CascadeBudget = 32;
+};
+
+struct TimerWheelStats {
+    UINT64 Scheduled;
+    UINT64 Cancelled;
+    UINT64 Rescheduled;
+    UINT64 Expired;
+
+    //
+    // Timers moved down a level as the wheel turned.
+    //
+    UINT64 Cascaded;
+
+    //
+    // Schedule() calls that failed because every timer was in use.
+    //
+    UINT64 Exhausted;
+};
+
+//
+// Hierarchical timing wheel for the RX thread, driven by the TSC reads the
+// loop already makes. Four levels of 256 slots cover 2^32 granules; a timer
+// further out waits in the top level and is placed again as the wheel turns.
+//
+// Schedule, Cancel and Reschedule are O(1): timers are intrusive list nodes
+// taken from a preallocated pool, and nothing is allocated after
+// construction. Advance() hands out expired timers in batches of the
+// caller's choosing, so a burst of expiries can be spread over several RX
+// iterations instead of stalling one of them. Empty slots are skipped with an
+// occupancy bitmap, so a long gap between calls costs little.
+//
+// A classic wheel moves a whole upper-level slot down when the wheel turns
+// into it, which with a million timers is a stall of tens of milliseconds.
+// Here every slot has two lists, one per round of the level, so the slot a
+// level turns into next can be moved down into the next round's lists a few
+// timers per Advance() call, long before it is due. Whatever is left at the
+// boundary is moved then.
+//
+// Single-threaded: the owning thread makes every call.
+//
+class TimerWheel {
+  public:
+    TimerWheel(const TimerWheelConfig& Config, UINT64 NowTick);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    //
+    // Schedules Context to expire at DeadlineTick. A deadline in the past
+    // expires on the next Advance(). Returns InvalidTimer if every timer is
+    // in use.
+    //
+    TimerHandle Schedule(UINT64 DeadlineTick, UINT64 Context);
+
+    //
+    // Returns false if the timer already expired or was cancelled.
+    //
+    bool Cancel(TimerHandle Handle);
+
+    //
+    // Moves a live timer to a new deadline, keeping its handle; this is how
+    // an idle timeout is pushed back on every frame of a flow.
+    //
+    bool Reschedule(TimerHandle Handle, UINT64 DeadlineTick);
+
+    //
+    // Turns the wheel to NowTick and writes up to MaxExpired contexts of
+    // expired timers to Expired. Returns the number written; if it equals
+    // MaxExpired, more may be due and the next call continues where this one
+    // stopped. Expired timers are freed before they are handed out.
+    //
+    UINT32 Advance(UINT64 NowTick, _Out_writes_to_(MaxExpired, return) UINT64* Expired, UINT32 MaxExpired);
+
+    UINT32 ActiveTimers() const { return Active; }
+    UINT64 GranuleTicks() const { return 1ull << Shift; }
+    const TimerWheelStats& Statistics() const { return Stats; }
+
+    //
+    // Bytes preallocated for timer nodes, slots and bitmaps.
+    //
+    UINT64 MemoryFootprint() const;
+
+  private:
+    static constexpr UINT32 None = MAXUINT32;
+    static constexpr UINT32 Levels = 4;
+    static constexpr UINT32 SlotBits = 8;
+    static constexpr UINT32 SlotsPerLevel = 1 << SlotBits;
+    static constexpr UINT32 SlotMask = SlotsPerLevel - 1;
+    static constexpr UINT32 BitmapWords = SlotsPerLevel / 64;
+    static constexpr UINT32 Rounds = 2;
+
+    struct Node {
+        UINT64 Deadline;
+        UINT64 Context;
+        UINT32 Prev;
+        UINT32 Next;
+
+        //
+        // List index, (level * Rounds + round) * SlotsPerLevel + slot, while
+        // scheduled; None while free.
+        //
+        UINT32 Slot;
+        UINT32 Generation;
+    };
+
+    static TimerHandle MakeHandle(UINT32 Index, UINT32 Generation)
+    {
+        return ((UINT64)Generation << 32) | Index;
+    }
+
+    static UINT32 ListOf(UINT32 Level, UINT64 Granule)
+    {
+        UINT32 Round = (UINT32)(Granule >> (SlotBits * (Level + 1))) & (Rounds - 1);
+        UINT32 Slot = (UINT32)(Granule >> (SlotBits * Level)) & SlotMask;
+        return (Level * Rounds + Round) * SlotsPerLevel + Slot;
+    }
+
+    UINT64 GranuleOf(const Node& Timer) const;
+    Node* Lookup(TimerHandle Handle);
+    void Release(UINT32 Index);
+    void Insert(UINT32 Index);
+    void Link(UINT32 Index, UINT32 List);
+    void Unlink(UINT32 Index);
+    void Cascade(UINT32 List);
+    void CascadeAhead(UINT32 Budget);
+    UINT32 NextOccupied(UINT32 Level, UINT32 Round, UINT32 From) const;
+    UINT64 NextDue() const;
+
+    UINT32 Shift = 0;
+    UINT32 CascadeBudget;
+
+    //
+    // Every granule before Current has been processed; Current itself may
+    // have been, and processing it again finds nothing new.
+    //
+    UINT64 Current;
+    UINT32 Active = 0;
+    UINT32 FreeList = None;
+
+    std::unique_ptr<Node[]> Nodes;
+    UINT32 Capacity;
+    UINT32 Heads[Levels * Rounds * SlotsPerLevel];
+    UINT64 Occupied[Levels * Rounds][BitmapWords] = {};
+
+    TimerWheelStats Stats {};
+};
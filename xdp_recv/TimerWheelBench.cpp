@@ -0,0 +1,241 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "LatencyHistogram.h"
+#include "TimerWheel.h"
+#include "TscClock.h"
+
+static constexpr UINT64 StepNs = 10000;
+
+//
+// The usual alternative: a binary heap of deadlines. Cancel and reschedule
+// mark the old entry stale and leave it in the heap until it surfaces.
+//
+class HeapTimers {
+  public:
+    explicit HeapTimers(UINT32 Timers) : Generation(Timers, 0) {}
+
+    void Schedule(UINT32 Id, UINT64 Deadline) { Heap.push({Deadline, ((UINT64)Generation[Id] << 32) | Id}); }
+
+    void Cancel(UINT32 Id) { Generation[Id]++; }
+
+    void Reschedule(UINT32 Id, UINT64 Deadline)
+    {
+        Generation[Id]++;
+        Schedule(Id, Deadline);
+    }
+
+    UINT32 Advance(UINT64 Now, _Out_writes_to_(MaxExpired, return) UINT64* Expired, UINT32 MaxExpired)
+    {
+        UINT32 Count = 0;
+        while (Count < MaxExpired && !Heap.empty() && Heap.top().first <= Now) {
+            UINT32 Id = (UINT32)Heap.top().second;
+            if ((UINT32)(Heap.top().second >> 32) == Generation[Id]) {
+                Expired[Count++] = Id;
+                Generation[Id]++;
+            }
+            Heap.pop();
+        }
+        return Count;
+    }
+
+    UINT64 MemoryFootprint() const { return Heap.size() * sizeof(Entry) + Generation.size() * sizeof(UINT32); }
+
+  private:
+    using Entry = std::pair<UINT64, UINT64>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> Heap;
+    std::vector<UINT32> Generation;
+};
+
+struct TimerRunResult {
+    double ScheduleNs;
+    double RescheduleNs;
+    double CancelNs;
+    double ExpireNs;
+    UINT64 Expired;
+    UINT64 Early;
+    UINT64 MaxLateNs;
+    UINT64 PeakBytes;
+    LatencyHistogram<> AdvanceNs;
+};
+
+//
+// Schedules Timers timers over Span ticks, pushes every one of them back
+// once (idle refresh), cancels and re-arms a tenth, then runs virtual time
+// forward in RX-iteration steps until all have fired, expiring at most Batch
+// per step.
+//
+template <typename Timers, typename ScheduleFn, typename RescheduleFn, typename CancelFn>
+static void RunTimers(
+    const TscClock& Clock,
+    Timers& Set,
+    UINT32 Count,
+    UINT64 Span,
+    UINT32 Batch,
+    ScheduleFn&& Schedule,
+    RescheduleFn&& Reschedule,
+    CancelFn&& Cancel,
+    _Out_ TimerRunResult* Result)
+{
+    std::mt19937_64 Random(5);
+    std::vector<UINT64> Deadlines(Count);
+    std::vector<UINT32> Order(Count);
+    for (UINT32 i = 0; i < Count; i++) {
+        Deadlines[i] = Random() % Span;
+        Order[i] = i;
+    }
+    std::shuffle(Order.begin(), Order.end(), Random);
+
+    UINT64 Start = Clock.NowOrdered();
+    for (UINT32 i = 0; i < Count; i++) {
+        Schedule(i, Deadlines[i]);
+    }
+    Result->ScheduleNs = (double)Clock.TicksToNs(Clock.NowOrdered() - Start) / Count;
+
+    Start = Clock.NowOrdered();
+    for (UINT32 i : Order) {
+        Deadlines[i] = Random() % Span;
+        Reschedule(i, Deadlines[i]);
+    }
+    Result->RescheduleNs = (double)Clock.TicksToNs(Clock.NowOrdered() - Start) / Count;
+
+    UINT32 Cancels = std::max(Count / 10, 1u);
+    Start = Clock.NowOrdered();
+    for (UINT32 i = 0; i < Cancels; i++) {
+        Cancel(Order[i]);
+    }
+    Result->CancelNs = (double)Clock.TicksToNs(Clock.NowOrdered() - Start) / Cancels;
+    for (UINT32 i = 0; i < Cancels; i++) {
+        Schedule(Order[i], Deadlines[Order[i]]);
+    }
+    Result->PeakBytes = Set.MemoryFootprint();
+
+    std::vector<UINT64> Expired(Batch);
+    UINT64 Step = Clock.NsToTicks(StepNs);
+    UINT64 ExpireTicks = 0;
+    for (UINT64 Now = 0; Result->Expired < Count; Now += Step) {
+        UINT64 CallStart = Clock.NowOrdered();
+        UINT32 Fired = Set.Advance(Now, Expired.data(), Batch);
+        UINT64 CallTicks = Clock.NowOrdered() - CallStart;
+        ExpireTicks += CallTicks;
+        Result->AdvanceNs.Record(Clock.TicksToNs(CallTicks));
+
+        for (UINT32 i = 0; i < Fired; i++) {
+            UINT64 Deadline = Deadlines[Expired[i]];
+            if (Deadline > Now) {
+                Result->Early++;
+            } else {
+                Result->MaxLateNs = std::max(Result->MaxLateNs, Clock.TicksToNs(Now - Deadline));
+            }
+        }
+        Result->Expired += Fired;
+    }
+    Result->ExpireNs = (double)Clock.TicksToNs(ExpireTicks) / Count;
+}
+
+static void PrintResult(const char* Name, const TimerRunResult& Result)
+{
+    printf(
+        "%-6s %10.1f %12.1f %10.1f %10.1f %9.1f MiB %8llu %10.1f\n",
+        Name,
+        Result.ScheduleNs,
+        Result.RescheduleNs,
+        Result.CancelNs,
+        Result.ExpireNs,
+        Result.PeakBytes / (1024.0 * 1024.0),
+        (unsigned long long)Result.Early,
+        Result.MaxLateNs / 1000.0);
+}
+
+//
+// Timer wheel against a binary heap with a million live timers: cost of
+// each operation, per-iteration expiry cost, memory, and how late timers
+// fire.
+//
+int TimerWheelBenchmark(int argc, char** argv)
+{
+    UINT32 Count = argc >= 1 ? atoi(argv[0]) : 1000000;
+    UINT32 SpanMs = argc >= 2 ? atoi(argv[1]) : 1000;
+    UINT32 Batch = argc >= 3 ? atoi(argv[2]) : 64;
+    UINT32 ResolutionNs = argc >= 4 ? atoi(argv[3]) : 1000;
+
+    if (Count == 0 || SpanMs == 0 || Batch == 0) {
+        fprintf(stderr, "timers, span-ms and batch must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    UINT64 Span = Clock.NsToTicks((UINT64)SpanMs * 1000000);
+
+    TimerWheelConfig Config;
+    Config.MaxTimers = Count;
+    Config.ResolutionTicks = Clock.NsToTicks(ResolutionNs);
+    TimerWheel Wheel(Config, 0);
+    std::vector<TimerHandle> Handles(Count);
+
+    printf(
+        "%u timers over %u ms, %llu ns granule, %llu ns RX iterations expiring up to %u each\n\n",
+        Count,
+        SpanMs,
+        (unsigned long long)Clock.TicksToNs(Wheel.GranuleTicks()),
+        (unsigned long long)StepNs,
+        Batch);
+    printf(
+        "%-6s %10s %12s %10s %10s %13s %8s %10s\n",
+        "",
+        "schedule",
+        "reschedule",
+        "cancel",
+        "expire",
+        "memory",
+        "early",
+        "late max");
+    printf("%-6s %10s %12s %10s %10s %13s %8s %10s\n", "", "ns", "ns", "ns", "ns", "", "", "us");
+
+    auto WheelResult = std::make_unique<TimerRunResult>();
+    RunTimers(
+        Clock,
+        Wheel,
+        Count,
+        Span,
+        Batch,
+        [&](UINT32 Id, UINT64 Deadline) { Handles[Id] = Wheel.Schedule(Deadline, Id); },
+        [&](UINT32 Id, UINT64 Deadline) { Wheel.Reschedule(Handles[Id], Deadline); },
+        [&](UINT32 Id) { Wheel.Cancel(Handles[Id]); },
+        WheelResult.get());
+    PrintResult("wheel", *WheelResult);
+
+    HeapTimers Heap(Count);
+    auto HeapResult = std::make_unique<TimerRunResult>();
+    RunTimers(
+        Clock,
+        Heap,
+        Count,
+        Span,
+        Batch,
+        [&](UINT32 Id, UINT64 Deadline) { Heap.Schedule(Id, Deadline); },
+        [&](UINT32 Id, UINT64 Deadline) { Heap.Reschedule(Id, Deadline); },
+        [&](UINT32 Id) { Heap.Cancel(Id); },
+        HeapResult.get());
+    PrintResult("heap", *HeapResult);
+
+    printf("\nAdvance() per RX iteration:\n");
+    PrintLatencySummary(stdout, "wheel", WheelResult->AdvanceNs);
+    PrintLatencySummary(stdout, "heap", HeapResult->AdvanceNs);
+
+    const TimerWheelStats& Stats = Wheel.Statistics();
+    printf(
+        "\nwheel: %llu expired, %llu cascaded, %llu exhausted\n",
+        (unsigned long long)Stats.Expired,
+        (unsigned long long)Stats.Cascaded,
+        (unsigned long long)Stats.Exhausted);
+    return EXIT_SUCCESS;
+}
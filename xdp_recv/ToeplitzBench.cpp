@@ -0,0 +1,195 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "PacketHeaders.h"
+#include "RssPredictor.h"
+#include "TscClock.h"
+#include "ToeplitzHash.h"
+
+//
+// Known answers from the Microsoft RSS verification suite, default key.
+//
+struct ToeplitzVector {
+    UINT8 Input[ToeplitzHash::MaxInputLength];
+    UINT32 Length;
+    UINT32 Expected;
+};
+
+static const ToeplitzVector KnownAnswers[] = {
+    // 66.9.149.187:2794 -> 161.142.100.80:1766
+    {{66, 9, 149, 187, 161, 142, 100, 80}, 8, 0x323e8fc2},
+    {{66, 9, 149, 187, 161, 142, 100, 80, 0x0a, 0xea, 0x06, 0xe6}, 12, 0x51ccc178},
+    // 199.92.111.2:14230 -> 65.69.140.83:4739
+    {{199, 92, 111, 2, 65, 69, 140, 83}, 8, 0xd718262a},
+    {{199, 92, 111, 2, 65, 69, 140, 83, 0x37, 0x96, 0x12, 0x83}, 12, 0xc626b0ea},
+    // [3ffe:2501:200:1fff::7]:2794 -> [3ffe:2501:200:3::1]:1766
+    {{0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x1f, 0xff, 0, 0, 0, 0, 0, 0, 0, 7,
+      0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x00, 0x03, 0, 0, 0, 0, 0, 0, 0, 1},
+     32,
+     0x2cc18cd5},
+    {{0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x1f, 0xff, 0, 0, 0, 0, 0, 0, 0, 7, 0x3f, 0xfe,
+      0x25, 0x01, 0x02, 0x00, 0x00, 0x03, 0, 0, 0, 0, 0, 0, 0, 1, 0x0a, 0xea, 0x06, 0xe6},
+     36,
+     0x40207d3d},
+};
+
+static bool CheckKnownAnswers(const ToeplitzHash& Hasher)
+{
+    bool Passed = true;
+
+    for (const ToeplitzVector& Vector : KnownAnswers) {
+        UINT32 Reference = ToeplitzHash::HashReference(
+            RssPredictor::DefaultKey, sizeof(RssPredictor::DefaultKey), Vector.Input, Vector.Length);
+        UINT32 Table = Hasher.Hash(Vector.Input, Vector.Length);
+        if (Reference != Vector.Expected || Table != Vector.Expected) {
+            fprintf(
+                stderr,
+                "known answer mismatch: length %u expected %08x reference %08x table %08x\n",
+                Vector.Length,
+                Vector.Expected,
+                Reference,
+                Table);
+            Passed = false;
+        }
+    }
+    return Passed;
+}
+
+struct HashRate {
+    double MillionsPerSecond;
+    UINT32 Checksum;
+};
+
+template <typename HashFn>
+static HashRate MeasureHashes(const TscClock& Clock, UINT32 Count, HashFn&& Hash)
+{
+    UINT64 Start = Clock.NowOrdered();
+    UINT32 Checksum = Hash();
+    UINT64 Ns = Clock.TicksToNs(Clock.NowOrdered() - Start);
+    return {Ns != 0 ? Count * 1000.0 / Ns : 0.0, Checksum};
+}
+
+//
+// Hashes/s of the bit-serial reference, the table-driven hash and the batch
+// API for IPv4 and IPv6 4-tuples, then frames/s through RssPredictor.
+//
+int ToeplitzBenchmark(int argc, char** argv)
+{
+    UINT32 Count = argc >= 1 ? atoi(argv[0]) : 4000000;
+    if (Count < 8) {
+        fprintf(stderr, "count must be at least 8\n");
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    ToeplitzHash Hasher(RssPredictor::DefaultKey, sizeof(RssPredictor::DefaultKey));
+    if (!CheckKnownAnswers(Hasher)) {
+        return EXIT_FAILURE;
+    }
+    printf("known answers: ok, batch path: %s\n\n", ToeplitzHash::HasAvx2() ? "AVX2" : "scalar");
+
+    std::mt19937 Random(3);
+    std::vector<UINT32> Hashes(Count);
+    printf("%-6s %-10s %14s\n", "input", "method", "Mhashes/s");
+
+    for (UINT32 Length : {12u, 36u}) {
+        std::vector<UINT8> Inputs((size_t)Count * Length);
+        for (UINT8& Byte : Inputs) {
+            Byte = (UINT8)Random();
+        }
+
+        UINT32 ReferenceCount = Count / 64;
+        HashRate Reference = MeasureHashes(Clock, ReferenceCount, [&] {
+            UINT32 Sum = 0;
+            for (UINT32 i = 0; i < ReferenceCount; i++) {
+                Sum += ToeplitzHash::HashReference(
+                    RssPredictor::DefaultKey, sizeof(RssPredictor::DefaultKey), &Inputs[(size_t)i * Length], Length);
+            }
+            return Sum;
+        });
+        HashRate Table = MeasureHashes(Clock, Count, [&] {
+            UINT32 Sum = 0;
+            for (UINT32 i = 0; i < Count; i++) {
+                Hashes[i] = Hasher.Hash(&Inputs[(size_t)i * Length], Length);
+                Sum += Hashes[i];
+            }
+            return Sum;
+        });
+        HashRate Batch = MeasureHashes(Clock, Count, [&] {
+            UINT32 Sum = 0;
+            std::vector<UINT32> BatchHashes(Count);
+            Hasher.HashBatch(Inputs.data(), Length, Length, Count, BatchHashes.data());
+            for (UINT32 i = 0; i < Count; i++) {
+                Sum += BatchHashes[i];
+            }
+            return Sum;
+        });
+
+        const char* Name = Length == 12 ? "ipv4" : "ipv6";
+        printf("%-6s %-10s %14.1f\n", Name, "reference", Reference.MillionsPerSecond);
+        printf("%-6s %-10s %14.1f\n", Name, "table", Table.MillionsPerSecond);
+        printf("%-6s %-10s %14.1f\n", Name, "batch", Batch.MillionsPerSecond);
+        if (Batch.Checksum != Table.Checksum) {
+            fprintf(stderr, "batch and table hashes differ\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    //
+    // Whole frames: field selection plus hash plus table lookup.
+    //
+    constexpr UINT32 FrameLength = 64;
+    constexpr UINT32 FrameCount = 65536;
+    std::vector<PROCESSOR_NUMBER> Table(128);
+    for (UINT32 Bucket = 0; Bucket < Table.size(); Bucket++) {
+        Table[Bucket].Number = (BYTE)(Bucket % 8);
+    }
+    RssPredictor Predictor(
+        XDP_RSS_VALID_HASH_TYPES,
+        RssPredictor::DefaultKey,
+        sizeof(RssPredictor::DefaultKey),
+        Table.data(),
+        (UINT32)Table.size());
+
+    auto Frames = std::make_unique<UCHAR[]>((size_t)FrameCount * FrameLength);
+    std::vector<const UCHAR*> FramePointers(FrameCount);
+    std::vector<UINT32> FrameLengths(FrameCount, FrameLength);
+    std::vector<UINT32> Queues(FrameCount);
+    for (UINT32 i = 0; i < FrameCount; i++) {
+        UCHAR* Frame = &Frames[(size_t)i * FrameLength];
+        BuildUdpFrame(Frame, FrameLength, Random(), (UINT16)Random(), 0xef000000 | (Random() & 0xffff), 5000);
+        FramePointers[i] = Frame;
+    }
+
+    UINT32 Rounds = std::max(1u, Count / FrameCount);
+    HashRate Single = MeasureHashes(Clock, Rounds * FrameCount, [&] {
+        UINT32 Sum = 0;
+        for (UINT32 Round = 0; Round < Rounds; Round++) {
+            for (UINT32 i = 0; i < FrameCount; i++) {
+                Sum += Predictor.PredictQueue(FramePointers[i], FrameLength);
+            }
+        }
+        return Sum;
+    });
+    HashRate Batch = MeasureHashes(Clock, Rounds * FrameCount, [&] {
+        UINT32 Sum = 0;
+        for (UINT32 Round = 0; Round < Rounds; Round++) {
+            Predictor.PredictBatch(FramePointers.data(), FrameLengths.data(), FrameCount, Queues.data());
+            Sum += Queues[Round % FrameCount];
+        }
+        return Sum;
+    });
+
+    printf("\n%-17s %14s\n", "frame prediction", "Mframes/s");
+    printf("%-17s %14.1f\n", "per frame", Single.MillionsPerSecond);
+    printf("%-17s %14.1f\n", "batch", Batch.MillionsPerSecond);
+
+    return EXIT_SUCCESS;
+}
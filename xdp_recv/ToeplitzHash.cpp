@@ -0,0 +1,131 @@
+#include "ToeplitzHash.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+#include <algorithm>
+
+//
+// The 32 key bits starting at key bit Bit, zero-padded past the end.
+//
+static UINT32 KeyWindow(_In_reads_(KeySize) const UINT8* Key, UINT32 KeySize, UINT32 Bit)
+{
+    UINT64 Window = 0;
+    UINT32 First = Bit / 8;
+    for (UINT32 i = 0; i < 5; i++) {
+        Window = (Window << 8) | (First + i < KeySize ? Key[First + i] : 0);
+    }
+    return (UINT32)(Window >> (8 - Bit % 8));
+}
+
+ToeplitzHash::ToeplitzHash(_In_reads_(KeySize) const UINT8* Key, UINT32 KeySize)
+    : Tables(std::make_unique<UINT32[]>(MaxInputLength * 256))
+    , MaxInput(KeySize >= 4 ? std::min(KeySize - 4, MaxInputLength) : 0)
+    , UseAvx2(HasAvx2())
+{
+    for (UINT32 Position = 0; Position < MaxInput; Position++) {
+        UINT32 BitValue[8];
+        for (UINT32 Bit = 0; Bit < 8; Bit++) {
+            BitValue[Bit] = KeyWindow(Key, KeySize, Position * 8 + Bit);
+        }
+
+        UINT32* Table = &Tables[Position * 256];
+        for (UINT32 Byte = 0; Byte < 256; Byte++) {
+            UINT32 Value = 0;
+            for (UINT32 Bit = 0; Bit < 8; Bit++) {
+                if (Byte & (0x80 >> Bit)) {
+                    Value ^= BitValue[Bit];
+                }
+            }
+            Table[Byte] = Value;
+        }
+    }
+}
+
+bool ToeplitzHash::HasAvx2()
+{
+    int Regs[4];
+
+    __cpuid(Regs, 0);
+    if (Regs[0] < 7) {
+        return false;
+    }
+
+    //
+    // The OS must save YMM state (OSXSAVE, then XCR0 bits 1 and 2).
+    //
+    __cpuid(Regs, 1);
+    if ((Regs[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+
+    __cpuidex(Regs, 7, 0);
+    return (Regs[1] & (1 << 5)) != 0;
+}
+
+UINT32 ToeplitzHash::HashReference(
+    _In_reads_(KeySize) const UINT8* Key,
+    UINT32 KeySize,
+    _In_reads_(Length) const UINT8* Input,
+    UINT32 Length)
+{
+    UINT32 Result = 0;
+    for (UINT32 Bit = 0; Bit < Length * 8; Bit++) {
+        if (Input[Bit / 8] & (0x80 >> (Bit % 8))) {
+            Result ^= KeyWindow(Key, KeySize, Bit);
+        }
+    }
+    return Result;
+}
+
+void ToeplitzHash::HashBatch(
+    _In_ const UINT8* Inputs,
+    UINT32 Stride,
+    UINT32 Length,
+    UINT32 Count,
+    _Out_writes_(Count) UINT32* Hashes) const
+{
+    UINT32 Done = 0;
+
+    if (UseAvx2 && Count >= 8 && Stride * 7 < MAXINT32) {
+        Done = Count & ~7u;
+        HashBatchAvx2(Inputs, Stride, Length, Done, Hashes);
+    }
+
+    for (UINT32 i = Done; i < Count; i++) {
+        Hashes[i] = Hash(Inputs + (size_t)i * Stride, Length);
+    }
+}
+
+void ToeplitzHash::HashBatchAvx2(
+    const UINT8* Inputs,
+    UINT32 Stride,
+    UINT32 Length,
+    UINT32 Count,
+    UINT32* Hashes) const
+{
+    const __m256i Lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(Stride));
+    const __m256i ByteMask = _mm256_set1_epi32(0xff);
+    const int* Table = (const int*)Tables.get();
+
+    for (UINT32 i = 0; i < Count; i += 8) {
+        const int* Base = (const int*)(Inputs + (size_t)i * Stride);
+        __m256i Result = _mm256_setzero_si256();
+
+        //
+        // Gather four input bytes from each of the eight inputs, then look
+        // each byte up in its position's table.
+        //
+        for (UINT32 Position = 0; Position < Length; Position += 4) {
+            __m256i Words = _mm256_i32gather_epi32(Base, _mm256_add_epi32(Lanes, _mm256_set1_epi32(Position)), 1);
+
+            for (UINT32 Byte = 0; Byte < 4; Byte++) {
+                __m256i Index = _mm256_and_si256(_mm256_srli_epi32(Words, Byte * 8), ByteMask);
+                Index = _mm256_add_epi32(Index, _mm256_set1_epi32((Position + Byte) * 256));
+                Result = _mm256_xor_si256(Result, _mm256_i32gather_epi32(Table, Index, 4));
+            }
+        }
+
+        _mm256_storeu_si256((__m256i*)(Hashes + i), Result);
+    }
+}
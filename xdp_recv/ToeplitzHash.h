@@ -0,0 +1,68 @@
+#pragma once
+
+#include <windows.h>
+
+#include <memory>
+
+//
+// Toeplitz hash as computed by RSS NICs, for a fixed secret key.
+//
+// Each set input bit i (most significant bit of the first byte is bit 0)
+// XORs the 32 key bits starting at key bit i into the result. The
+// constructor folds that into one 256-entry table per input byte position,
+// so Hash() costs one lookup per input byte. HashBatch() hashes eight inputs
+// at a time with AVX2 gathers when the CPU has them.
+//
+class ToeplitzHash {
+  public:
+    //
+    // Longest RSS input: IPv6 source and destination address plus ports.
+    //
+    static constexpr UINT32 MaxInputLength = 36;
+    static constexpr UINT32 MaxKeySize = MaxInputLength + 4;
+
+    //
+    // Inputs are limited to KeySize - 4 bytes.
+    //
+    ToeplitzHash(_In_reads_(KeySize) const UINT8* Key, UINT32 KeySize);
+
+    UINT32 Hash(_In_reads_(Length) const UINT8* Input, UINT32 Length) const
+    {
+        UINT32 Result = 0;
+        for (UINT32 i = 0; i < Length; i++) {
+            Result ^= Tables[i * 256 + Input[i]];
+        }
+        return Result;
+    }
+
+    //
+    // Hashes Count inputs of Length bytes each, the first at Inputs and each
+    // next one Stride bytes further. Length must be a multiple of 4, which
+    // every RSS input is.
+    //
+    void HashBatch(
+        _In_ const UINT8* Inputs,
+        UINT32 Stride,
+        UINT32 Length,
+        UINT32 Count,
+        _Out_writes_(Count) UINT32* Hashes) const;
+
+    UINT32 InputLimit() const { return MaxInput; }
+    static bool HasAvx2();
+
+    //
+    // Bit-at-a-time definition, for validating the fast paths.
+    //
+    static UINT32 HashReference(
+        _In_reads_(KeySize) const UINT8* Key,
+        UINT32 KeySize,
+        _In_reads_(Length) const UINT8* Input,
+        UINT32 Length);
+
+  private:
+    void HashBatchAvx2(const UINT8* Inputs, UINT32 Stride, UINT32 Length, UINT32 Count, UINT32* Hashes) const;
+
+    std::unique_ptr<UINT32[]> Tables;
+    UINT32 MaxInput;
+    bool UseAvx2;
+};
@@ -0,0 +1,137 @@
+#include "TscClock.h"
+
+//
+// 100 ns intervals between 1601-01-01 and 1970-01-01.
+//
+static constexpr UINT64 FileTimeUnixEpoch = 116444736000000000ULL;
+
+//
+// Length of the startup calibration window.
+//
+static constexpr DWORD CalibrationMs = 100;
+
+bool TscClock::IsInvariantTscSupported()
+{
+    int Regs[4];
+
+    __cpuid(Regs, 0x80000000);
+    if ((unsigned int)Regs[0] < 0x80000007) {
+        return false;
+    }
+
+    //
+    // CPUID.80000007H:EDX[8] advertises a TSC that runs at a constant rate in
+    // all ACPI P-, C- and T-states.
+    //
+    __cpuid(Regs, 0x80000007);
+    return (Regs[3] & (1 << 8)) != 0;
+}
+
+UINT64 TscClock::ReadWallClockNs()
+{
+    FILETIME FileTime;
+    GetSystemTimePreciseAsFileTime(&FileTime);
+    UINT64 Intervals = ((UINT64)FileTime.dwHighDateTime << 32) | FileTime.dwLowDateTime;
+    return (Intervals - FileTimeUnixEpoch) * 100;
+}
+
+TscClock::TscClock()
+{
+    LARGE_INTEGER Frequency;
+    QueryPerformanceFrequency(&Frequency);
+    NsPerQpcTick = 1e9 / (double)Frequency.QuadPart;
+    UseTsc = IsInvariantTscSupported();
+
+    First = TakeSample();
+    if (!UseTsc) {
+        Publish({First.Tick, First.MonotonicNs, First.WallClockNs, NsPerQpcTick});
+        return;
+    }
+
+    Sleep(CalibrationMs);
+    Sample Last = TakeSample();
+    double NsPerTick = (double)(Last.MonotonicNs - First.MonotonicNs) / (double)(Last.Tick - First.Tick);
+    Publish({Last.Tick, Last.MonotonicNs, Last.WallClockNs, NsPerTick});
+}
+
+TscClock::~TscClock()
+{
+    StopDriftCorrection();
+}
+
+//
+// Reads the TSC on both sides of the OS clock reads and keeps the tightest of
+// a few attempts, so an interrupt between the reads does not skew the sample.
+//
+TscClock::Sample TscClock::TakeSample() const
+{
+    Sample Best {};
+    UINT64 BestWidth = MAXUINT64;
+
+    for (int i = 0; i < 8; i++) {
+        UINT64 Before = UseTsc ? ReadTscOrdered() : 0;
+        UINT64 Qpc = ReadQpc();
+        UINT64 WallClockNs = ReadWallClockNs();
+        UINT64 After = UseTsc ? ReadTscOrdered() : 0;
+
+        if (!UseTsc) {
+            return {Qpc, (UINT64)((double)Qpc * NsPerQpcTick), WallClockNs};
+        }
+
+        if (After - Before < BestWidth) {
+            BestWidth = After - Before;
+            Best = {Before + (After - Before) / 2, (UINT64)((double)Qpc * NsPerQpcTick), WallClockNs};
+        }
+    }
+
+    return Best;
+}
+
+void TscClock::Publish(const TscCalibration& Calibration)
+{
+    UINT32 Begin = Sequence.load(std::memory_order_relaxed);
+    Sequence.store(Begin + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Current = Calibration;
+    Sequence.store(Begin + 2, std::memory_order_release);
+}
+
+void TscClock::StartDriftCorrection(UINT32 PeriodMs)
+{
+    if (!UseTsc || DriftThread.joinable()) {
+        return;
+    }
+
+    DriftStop = false;
+    DriftThread = std::thread(&TscClock::DriftCorrectionThread, this, PeriodMs);
+}
+
+void TscClock::StopDriftCorrection()
+{
+    if (!DriftThread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> Guard(DriftLock);
+        DriftStop = true;
+    }
+    DriftWake.notify_all();
+    DriftThread.join();
+}
+
+void TscClock::DriftCorrectionThread(UINT32 PeriodMs)
+{
+    std::unique_lock<std::mutex> Guard(DriftLock);
+
+    while (!DriftWake.wait_for(Guard, std::chrono::milliseconds(PeriodMs), [this] { return DriftStop; })) {
+        //
+        // The rate is measured over the whole baseline since construction, so
+        // its error shrinks as the process runs; the anchor moves to the
+        // latest sample so accumulated offset error is dropped.
+        //
+        Sample Latest = TakeSample();
+        double NsPerTick = (double)(Latest.MonotonicNs - First.MonotonicNs) / (double)(Latest.Tick - First.Tick);
+        Publish({Latest.Tick, Latest.MonotonicNs, Latest.WallClockNs, NsPerTick});
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <windows.h>
+#include <intrin.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//
+// Conversion parameters from raw ticks to nanoseconds. Each calibration is
+// anchored at one (tick, monotonic ns, wall-clock ns) sample; monotonic ns are
+// in the QueryPerformanceCounter time base and wall-clock ns count from the
+// Unix epoch.
+//
+struct TscCalibration {
+    UINT64 BaseTick;
+    UINT64 BaseMonotonicNs;
+    UINT64 BaseWallClockNs;
+    double NsPerTick;
+
+    UINT64 TicksToNs(UINT64 Ticks) const { return (UINT64)((double)Ticks * NsPerTick); }
+
+    UINT64 ToMonotonicNs(UINT64 Tick) const
+    {
+        return BaseMonotonicNs + (UINT64)((double)(INT64)(Tick - BaseTick) * NsPerTick);
+    }
+
+    UINT64 ToWallClockNs(UINT64 Tick) const
+    {
+        return BaseWallClockNs + (UINT64)((double)(INT64)(Tick - BaseTick) * NsPerTick);
+    }
+};
+
+//
+// Clock source for the RX hot path. Reads are a bare RDTSC/RDTSCP; all the
+// QueryPerformanceCounter and system time calls happen during calibration.
+//
+// The constructor checks for an invariant TSC and calibrates its rate against
+// QueryPerformanceCounter. StartDriftCorrection() then re-samples both clocks
+// periodically on a background thread, refines the rate over the growing
+// baseline and re-anchors the offsets. Readers pick up new parameters through
+// a sequence lock and never block.
+//
+// Without an invariant TSC the clock falls back to QueryPerformanceCounter
+// ticks; the API stays the same, only reads get more expensive.
+//
+class TscClock {
+  public:
+    TscClock();
+    ~TscClock();
+
+    TscClock(const TscClock&) = delete;
+    TscClock& operator=(const TscClock&) = delete;
+
+    void StartDriftCorrection(UINT32 PeriodMs = 1000);
+    void StopDriftCorrection();
+
+    bool UsesTsc() const { return UseTsc; }
+    static bool IsInvariantTscSupported();
+
+    static UINT64 ReadTsc() { return __rdtsc(); }
+
+    //
+    // RDTSCP waits until all previous instructions have executed, so the
+    // read cannot be hoisted above the code being measured.
+    //
+    static UINT64 ReadTscOrdered()
+    {
+        unsigned int Aux;
+        return __rdtscp(&Aux);
+    }
+
+    UINT64 Now() const { return UseTsc ? ReadTsc() : ReadQpc(); }
+    UINT64 NowOrdered() const { return UseTsc ? ReadTscOrdered() : ReadQpc(); }
+
+    TscCalibration Calibration() const
+    {
+        TscCalibration Result;
+        UINT32 Begin;
+        do {
+            Begin = Sequence.load(std::memory_order_acquire);
+            Result = Current;
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((Begin & 1) != 0 || Begin != Sequence.load(std::memory_order_relaxed));
+        return Result;
+    }
+
+    UINT64 TicksToNs(UINT64 Ticks) const { return Calibration().TicksToNs(Ticks); }
+    UINT64 ToMonotonicNs(UINT64 Tick) const { return Calibration().ToMonotonicNs(Tick); }
+    UINT64 ToWallClockNs(UINT64 Tick) const { return Calibration().ToWallClockNs(Tick); }
+    UINT64 NsToTicks(UINT64 Nanoseconds) const { return (UINT64)((double)Nanoseconds / Calibration().NsPerTick); }
+
+    static UINT64 ReadQpc()
+    {
+        LARGE_INTEGER Counter;
+        QueryPerformanceCounter(&Counter);
+        return (UINT64)Counter.QuadPart;
+    }
+
+    static UINT64 ReadWallClockNs();
+
+  private:
+    struct Sample {
+        UINT64 Tick;
+        UINT64 MonotonicNs;
+        UINT64 WallClockNs;
+    };
+
+    Sample TakeSample() const;
+    void Publish(const TscCalibration& Calibration);
+    void DriftCorrectionThread(UINT32 PeriodMs);
+
+    bool UseTsc;
+    double NsPerQpcTick;
+    Sample First;
+
+    std::atomic<UINT32> Sequence {0};
+    TscCalibration Current;
+
+    std::thread DriftThread;
+    std::mutex DriftLock;
+    std::condition_variable DriftWake;
+    bool DriftStop = false;
+};
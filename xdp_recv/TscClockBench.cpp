@@ -0,0 +1,82 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Benchmarks.h"
+#include "TscClock.h"
+
+static constexpr UINT32 ReadIterations = 10000000;
+
+template <typename ReadFn>
+static void MeasureReadCost(const char* Name, ReadFn Read)
+{
+    volatile UINT64 Sink = 0;
+
+    UINT64 Start = TscClock::ReadQpc();
+    for (UINT32 i = 0; i < ReadIterations; i++) {
+        Sink = Sink + Read();
+    }
+    UINT64 End = TscClock::ReadQpc();
+
+    LARGE_INTEGER Frequency;
+    QueryPerformanceFrequency(&Frequency);
+    double Ns = (double)(End - Start) * 1e9 / (double)Frequency.QuadPart;
+    printf("%-32s %8.2f ns/read\n", Name, Ns / ReadIterations);
+}
+
+//
+// Reports the cost of each clock read and then, for the requested duration
+// (an hour by default), how far TSC-derived time drifts from the OS clocks
+// with the startup calibration only and with periodic drift correction.
+//
+int TscClockBenchmark(int argc, char** argv)
+{
+    UINT32 DriftSeconds = argc >= 1 ? atoi(argv[0]) : 3600;
+    const UINT32 ReportSeconds = 10;
+
+    TscClock Clock;
+    printf("Invariant TSC: %s\n", Clock.UsesTsc() ? "yes" : "no, using QueryPerformanceCounter");
+
+    MeasureReadCost("rdtsc", [] { return TscClock::ReadTsc(); });
+    MeasureReadCost("rdtscp", [] { return TscClock::ReadTscOrdered(); });
+    MeasureReadCost("TscClock::Now", [&Clock] { return Clock.Now(); });
+    MeasureReadCost("TscClock::Now + ToWallClockNs", [&Clock] { return Clock.ToWallClockNs(Clock.Now()); });
+    MeasureReadCost("QueryPerformanceCounter", [] { return TscClock::ReadQpc(); });
+    MeasureReadCost("GetSystemTimePreciseAsFileTime", [] { return TscClock::ReadWallClockNs(); });
+
+    if (DriftSeconds == 0) {
+        return EXIT_SUCCESS;
+    }
+
+    LARGE_INTEGER Frequency;
+    QueryPerformanceFrequency(&Frequency);
+    double NsPerQpcTick = 1e9 / (double)Frequency.QuadPart;
+
+    TscCalibration Startup = Clock.Calibration();
+    Clock.StartDriftCorrection();
+
+    printf(
+        "\n%8s %22s %22s %22s\n",
+        "elapsed",
+        "startup-only (ns)",
+        "corrected (ns)",
+        "corrected wall (ns)");
+
+    for (UINT32 Elapsed = ReportSeconds; Elapsed <= DriftSeconds; Elapsed += ReportSeconds) {
+        Sleep(ReportSeconds * 1000);
+
+        UINT64 Tick = Clock.NowOrdered();
+        UINT64 QpcNs = (UINT64)((double)TscClock::ReadQpc() * NsPerQpcTick);
+        UINT64 WallNs = TscClock::ReadWallClockNs();
+
+        printf(
+            "%7us %22lld %22lld %22lld\n",
+            Elapsed,
+            (long long)(Startup.ToMonotonicNs(Tick) - QpcNs),
+            (long long)(Clock.ToMonotonicNs(Tick) - QpcNs),
+            (long long)(Clock.ToWallClockNs(Tick) - WallNs));
+        fflush(stdout);
+    }
+
+    return EXIT_SUCCESS;
+}
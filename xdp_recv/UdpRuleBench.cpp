@@ -0,0 +1,218 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "PacketHeaders.h"
+#include "SoftwareXdp.h"
+#include "TscClock.h"
+#include "UdpRuleCompiler.h"
+
+static constexpr UINT32 BenchFrameLength = 64;
+static constexpr UINT32 GroupBase = 0xef010000;     // 239.1.0.0
+static constexpr UINT32 WholeGroupBase = 0xef020000; // 239.2.0.0
+static constexpr UINT32 WholeGroupCount = 64;
+static constexpr UINT32 SenderBase = 0x0a000001;
+static constexpr UINT16 GroupPortBase = 10000;
+static constexpr UINT16 AnyAddressPortBase = 30000;
+static constexpr UINT32 PortLayouts = 4;
+
+//
+// A market-data style subscription set: Groups multicast groups, each on
+// PortsPerGroup ports drawn from one of a few port layouts, a range of ports
+// on any address, a block of whole groups, and some source-pinned flows.
+//
+static std::vector<UdpSubscription> BuildSubscriptions(UINT32 Groups, UINT32 PortsPerGroup, UINT32 AnyAddressPorts)
+{
+    std::vector<UdpSubscription> Subscriptions;
+
+    for (UINT32 Group = 0; Group < Groups; Group++) {
+        UINT16 Base = (UINT16)(GroupPortBase + (Group % PortLayouts) * PortsPerGroup);
+        for (UINT32 Port = 0; Port < PortsPerGroup; Port++) {
+            Subscriptions.push_back({GroupBase + Group, (UINT16)(Base + Port), 0, 0});
+        }
+    }
+
+    for (UINT32 Port = 0; Port < AnyAddressPorts; Port++) {
+        Subscriptions.push_back({UdpSubscription::AnyAddress, (UINT16)(AnyAddressPortBase + Port), 0, 0});
+    }
+
+    for (UINT32 Group = 0; Group < WholeGroupCount; Group++) {
+        Subscriptions.push_back({WholeGroupBase + Group, UdpSubscription::AnyPort, 0, 0});
+    }
+
+    //
+    // Source-pinned flows. With a multiple of PortLayouts groups, the odd ones
+    // land on groups of the first port layout and are already covered by the
+    // group's own subscription.
+    //
+    for (UINT32 i = 0; i < 32; i++) {
+        UINT32 Group = (i % 2 == 0) ? Groups + i : (i * PortLayouts) % Groups;
+        Subscriptions.push_back({GroupBase + Group, GroupPortBase, SenderBase + i, 5000});
+    }
+
+    return Subscriptions;
+}
+
+//
+// Whether the subscriptions ask for a frame, straight from their definition.
+//
+static bool IsSubscribed(
+    const std::vector<UdpSubscription>& Subscriptions,
+    UINT32 Source,
+    UINT16 SourcePort,
+    UINT32 Destination,
+    UINT16 Port)
+{
+    for (const UdpSubscription& Subscription : Subscriptions) {
+        if ((Subscription.DestinationAddress == UdpSubscription::AnyAddress ||
+             Subscription.DestinationAddress == Destination) &&
+            (Subscription.DestinationPort == UdpSubscription::AnyPort || Subscription.DestinationPort == Port) &&
+            (Subscription.SourceAddress == UdpSubscription::AnyAddress ||
+             (Subscription.SourceAddress == Source && Subscription.SourcePort == SourcePort))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void PrintRuleSet(const char* Name, const CompiledRuleSet& RuleSet)
+{
+    printf(
+        "%-10s %10u %10u %14.1f\n",
+        Name,
+        RuleSet.RuleCount(),
+        RuleSet.PortSetCount(),
+        (double)RuleSet.PortSetBytes() / 1024);
+}
+
+//
+// Classifies every frame once and returns the number of redirects and the
+// mean cost per frame.
+//
+static UINT64 ClassifyAll(
+    const TscClock& Clock,
+    const SoftwareXdpProgram& Program,
+    const std::vector<UCHAR>& Frames,
+    UINT32 FrameCount,
+    _Out_writes_(FrameCount) XDP_RULE_ACTION* Actions,
+    _Out_ double* NsPerFrame)
+{
+    UINT64 Redirected = 0;
+    UINT64 Start = Clock.NowOrdered();
+
+    for (UINT32 i = 0; i < FrameCount; i++) {
+        HANDLE Target;
+        Actions[i] = Program.Classify(&Frames[(size_t)i * BenchFrameLength], BenchFrameLength, &Target);
+        Redirected += Actions[i] == XDP_PROGRAM_ACTION_REDIRECT;
+    }
+
+    *NsPerFrame = (double)Clock.TicksToNs(Clock.NowOrdered() - Start) / FrameCount;
+    return Redirected;
+}
+
+//
+// Rule count and per-frame classification cost of the forwarder's old
+// one-rule-per-port set against the compiled rule set, on traffic where about
+// half of the frames match a subscription. The compiled set must redirect
+// exactly the subscribed frames; the old one redirects a superset, and the
+// frames it should not have are counted as unwanted.
+//
+int UdpRuleBenchmark(int argc, char** argv)
+{
+    UINT32 Groups = argc >= 1 ? atoi(argv[0]) : 256;
+    UINT32 PortsPerGroup = argc >= 2 ? atoi(argv[1]) : 16;
+    UINT32 AnyAddressPorts = argc >= 3 ? atoi(argv[2]) : 512;
+    UINT32 FrameCount = argc >= 4 ? atoi(argv[3]) : 20000;
+
+    if (Groups == 0 || PortsPerGroup == 0 || FrameCount == 0 ||
+        GroupPortBase + PortLayouts * PortsPerGroup > AnyAddressPortBase ||
+        AnyAddressPortBase + AnyAddressPorts > MAXUINT16) {
+        fprintf(stderr, "invalid subscription shape\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<UdpSubscription> Subscriptions = BuildSubscriptions(Groups, PortsPerGroup, AnyAddressPorts);
+    HANDLE Target = (HANDLE)1;
+
+    CompiledRuleSet Naive;
+    CompiledRuleSet Compiled;
+    if (FAILED(UdpRuleCompiler::CompileNaive(Subscriptions.data(), (UINT32)Subscriptions.size(), Target, &Naive)) ||
+        FAILED(UdpRuleCompiler::Compile(Subscriptions.data(), (UINT32)Subscriptions.size(), Target, &Compiled))) {
+        fprintf(stderr, "rule compilation failed\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%zu subscriptions\n\n", Subscriptions.size());
+    printf("%-10s %10s %10s %14s\n", "rule set", "rules", "port sets", "port set KiB");
+    PrintRuleSet("naive", Naive);
+    PrintRuleSet("compiled", Compiled);
+    printf("rule count reduction: %.1fx\n\n", (double)Naive.RuleCount() / Compiled.RuleCount());
+
+    //
+    // Half the frames go to a random subscription (with a random sender, so
+    // source-pinned flows mostly miss), half to random groups and ports.
+    //
+    std::mt19937 Random(1);
+    std::vector<UCHAR> Frames((size_t)FrameCount * BenchFrameLength);
+    std::vector<bool> Wanted(FrameCount);
+    for (UINT32 i = 0; i < FrameCount; i++) {
+        UINT32 Destination;
+        UINT16 Port;
+
+        if (Random() % 2 == 0) {
+            const UdpSubscription& Subscription = Subscriptions[Random() % Subscriptions.size()];
+            Destination = Subscription.DestinationAddress != UdpSubscription::AnyAddress
+                              ? Subscription.DestinationAddress
+                              : GroupBase + Random() % (Groups * 2);
+            Port = Subscription.DestinationPort != UdpSubscription::AnyPort ? Subscription.DestinationPort
+                                                                             : (UINT16)(Random() % 65536);
+        } else {
+            Destination = GroupBase + Random() % (Groups * 2);
+            Port = (UINT16)(GroupPortBase + Random() % 40000);
+        }
+
+        UINT32 Sender = SenderBase + Random() % 64;
+        BuildUdpFrame(&Frames[(size_t)i * BenchFrameLength], BenchFrameLength, Sender, 5000, Destination, Port);
+        Wanted[i] = IsSubscribed(Subscriptions, Sender, 5000, Destination, Port);
+    }
+
+    TscClock Clock;
+    SoftwareXdpProgram NaiveProgram(Naive.Rules(), Naive.RuleCount());
+    SoftwareXdpProgram CompiledProgram(Compiled.Rules(), Compiled.RuleCount());
+    auto NaiveActions = std::make_unique<XDP_RULE_ACTION[]>(FrameCount);
+    auto CompiledActions = std::make_unique<XDP_RULE_ACTION[]>(FrameCount);
+    double NaiveNs;
+    double CompiledNs;
+
+    UINT64 NaiveHits = ClassifyAll(Clock, NaiveProgram, Frames, FrameCount, NaiveActions.get(), &NaiveNs);
+    UINT64 CompiledHits = ClassifyAll(Clock, CompiledProgram, Frames, FrameCount, CompiledActions.get(), &CompiledNs);
+
+    UINT32 Mismatches = 0;
+    UINT32 NaiveMisses = 0;
+    UINT32 NaiveUnwanted = 0;
+    UINT32 CompiledUnwanted = 0;
+    for (UINT32 i = 0; i < FrameCount; i++) {
+        bool NaiveRedirect = NaiveActions[i] == XDP_PROGRAM_ACTION_REDIRECT;
+        bool CompiledRedirect = CompiledActions[i] == XDP_PROGRAM_ACTION_REDIRECT;
+        Mismatches += CompiledRedirect != Wanted[i];
+        CompiledUnwanted += !Wanted[i] && CompiledRedirect;
+        NaiveMisses += Wanted[i] && !NaiveRedirect;
+        NaiveUnwanted += !Wanted[i] && NaiveRedirect;
+    }
+
+    printf("%-10s %12s %12s %12s\n", "rule set", "redirected", "unwanted", "ns/frame");
+    printf("%-10s %12llu %12u %12.1f\n", "naive", (unsigned long long)NaiveHits, NaiveUnwanted, NaiveNs);
+    printf("%-10s %12llu %12u %12.1f\n", "compiled", (unsigned long long)CompiledHits, CompiledUnwanted, CompiledNs);
+    printf(
+        "classification speedup: %.1fx, compiled mismatches: %u, naive misses: %u\n",
+        NaiveNs / CompiledNs,
+        Mismatches,
+        NaiveMisses);
+
+    return Mismatches == 0 && NaiveMisses == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
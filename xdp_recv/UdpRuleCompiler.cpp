@@ -0,0 +1,252 @@
+#include "UdpRuleCompiler.h"
+#include "PacketHeaders.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <utility>
+
+static void SetPortBit(_Inout_ UINT8* PortSet, UINT16 Port)
+{
+    UINT16 NetworkPort = HostToNet16(Port);
+    PortSet[NetworkPort >> 3] |= (UINT8)(1 << (NetworkPort & 7));
+}
+
+static bool TestPortBit(_In_ const UINT8* PortSet, UINT16 Port)
+{
+    UINT16 NetworkPort = HostToNet16(Port);
+    return (PortSet[NetworkPort >> 3] & (1 << (NetworkPort & 7))) != 0;
+}
+
+static bool IsSourcePinned(const UdpSubscription& Subscription)
+{
+    return Subscription.SourceAddress != UdpSubscription::AnyAddress ||
+           Subscription.SourcePort != UdpSubscription::AnyPort;
+}
+
+static HRESULT ValidateSubscription(const UdpSubscription& Subscription)
+{
+    if (!IsSourcePinned(Subscription)) {
+        return S_OK;
+    }
+
+    if (Subscription.SourceAddress == UdpSubscription::AnyAddress ||
+        Subscription.SourcePort == UdpSubscription::AnyPort ||
+        Subscription.DestinationAddress == UdpSubscription::AnyAddress ||
+        Subscription.DestinationPort == UdpSubscription::AnyPort) {
+        //
+        // XDP_MATCH_IPV4_UDP_TUPLE has no wildcards.
+        //
+        return E_INVALIDARG;
+    }
+    return S_OK;
+}
+
+UINT8* UdpRuleCompiler::AddPortSet(CompiledRuleSet* RuleSet)
+{
+    RuleSet->PortSets.push_back(std::make_unique<UINT8[]>(XDP_PORT_SET_BUFFER_SIZE));
+    return RuleSet->PortSets.back().get();
+}
+
+XDP_RULE* UdpRuleCompiler::AddRule(CompiledRuleSet* RuleSet, XDP_MATCH_TYPE Match, HANDLE Target)
+{
+    XDP_RULE& Rule = RuleSet->RuleList.emplace_back();
+    Rule.Match = Match;
+    Rule.Action = XDP_PROGRAM_ACTION_REDIRECT;
+    Rule.Redirect.TargetType = XDP_REDIRECT_TARGET_TYPE_XSK;
+    Rule.Redirect.Target = Target;
+    return &Rule;
+}
+
+HRESULT UdpRuleCompiler::Compile(
+    _In_reads_(Count) const UdpSubscription* Subscriptions,
+    UINT32 Count,
+    HANDLE Target,
+    _Out_ CompiledRuleSet* RuleSet)
+{
+    *RuleSet = CompiledRuleSet();
+
+    auto AnyAddressPorts = std::make_unique<UINT8[]>(XDP_PORT_SET_BUFFER_SIZE);
+    UINT32 AnyAddressPortCount = 0;
+    UINT16 SingleAnyAddressPort = 0;
+    std::vector<UINT32> WholeAddresses;
+    std::vector<std::pair<UINT32, UINT16>> AddressPorts;
+    std::vector<UdpSubscription> Tuples;
+
+    for (UINT32 i = 0; i < Count; i++) {
+        const UdpSubscription& Subscription = Subscriptions[i];
+
+        if (HRESULT Result = ValidateSubscription(Subscription); FAILED(Result)) {
+            return Result;
+        }
+
+        if (IsSourcePinned(Subscription)) {
+            Tuples.push_back(Subscription);
+        } else if (Subscription.DestinationAddress == UdpSubscription::AnyAddress) {
+            if (Subscription.DestinationPort == UdpSubscription::AnyPort) {
+                //
+                // All UDP traffic: nothing else matters.
+                //
+                *RuleSet = CompiledRuleSet();
+                AddRule(RuleSet, XDP_MATCH_UDP, Target);
+                return S_OK;
+            }
+            if (!TestPortBit(AnyAddressPorts.get(), Subscription.DestinationPort)) {
+                SetPortBit(AnyAddressPorts.get(), Subscription.DestinationPort);
+                SingleAnyAddressPort = Subscription.DestinationPort;
+                AnyAddressPortCount++;
+            }
+        } else if (Subscription.DestinationPort == UdpSubscription::AnyPort) {
+            WholeAddresses.push_back(Subscription.DestinationAddress);
+        } else {
+            AddressPorts.emplace_back(Subscription.DestinationAddress, Subscription.DestinationPort);
+        }
+    }
+
+    std::sort(WholeAddresses.begin(), WholeAddresses.end());
+    WholeAddresses.erase(std::unique(WholeAddresses.begin(), WholeAddresses.end()), WholeAddresses.end());
+
+    const UINT8* AnyPorts = AnyAddressPorts.get();
+    auto Covered = [&](UINT32 Address, UINT16 Port) {
+        return TestPortBit(AnyPorts, Port) ||
+               std::binary_search(WholeAddresses.begin(), WholeAddresses.end(), Address);
+    };
+
+    std::sort(AddressPorts.begin(), AddressPorts.end());
+    AddressPorts.erase(std::unique(AddressPorts.begin(), AddressPorts.end()), AddressPorts.end());
+    std::erase_if(AddressPorts, [&](const std::pair<UINT32, UINT16>& Entry) {
+        return Covered(Entry.first, Entry.second);
+    });
+
+    //
+    // Ports on any address.
+    //
+    if (AnyAddressPortCount == 1) {
+        XDP_RULE* Rule = AddRule(RuleSet, XDP_MATCH_UDP_DST, Target);
+        Rule->Pattern.Port = HostToNet16(SingleAnyAddressPort);
+    } else if (AnyAddressPortCount > 1) {
+        XDP_RULE* Rule = AddRule(RuleSet, XDP_MATCH_UDP_PORT_SET, Target);
+        Rule->Pattern.PortSet.PortSet = AnyAddressPorts.get();
+        RuleSet->PortSets.push_back(std::move(AnyAddressPorts));
+    }
+
+    //
+    // Whole addresses, as the largest aligned prefixes they fill.
+    //
+    for (size_t i = 0; i < WholeAddresses.size();) {
+        UINT32 Start = WholeAddresses[i];
+        UINT64 Length = 1;
+
+        for (UINT32 Bits = 1; Bits <= 32; Bits++) {
+            UINT64 Size = 1ull << Bits;
+            if ((Start & (Size - 1)) != 0 || i + Size > WholeAddresses.size() ||
+                WholeAddresses[i + Size - 1] != Start + Size - 1) {
+                break;
+            }
+            Length = Size;
+        }
+
+        XDP_RULE* Rule = AddRule(RuleSet, XDP_MATCH_IPV4_DST_MASK, Target);
+        Rule->Pattern.IpMask.Address.Ipv4.s_addr = HostToNet32(Start);
+        Rule->Pattern.IpMask.Mask.Ipv4.s_addr = HostToNet32((UINT32)~(Length - 1));
+        i += Length;
+    }
+
+    //
+    // Per-address port sets. AddressPorts is sorted by address, so each
+    // address is one run.
+    //
+    std::map<std::vector<UINT16>, const UINT8*> SharedPortSets;
+    for (size_t i = 0; i < AddressPorts.size();) {
+        UINT32 Address = AddressPorts[i].first;
+        std::vector<UINT16> Ports;
+        for (; i < AddressPorts.size() && AddressPorts[i].first == Address; i++) {
+            Ports.push_back(AddressPorts[i].second);
+        }
+
+        const UINT8*& PortSet = SharedPortSets[Ports];
+        if (PortSet == nullptr) {
+            UINT8* NewPortSet = AddPortSet(RuleSet);
+            for (UINT16 Port : Ports) {
+                SetPortBit(NewPortSet, Port);
+            }
+            PortSet = NewPortSet;
+        }
+
+        XDP_RULE* Rule = AddRule(RuleSet, XDP_MATCH_IPV4_UDP_PORT_SET, Target);
+        Rule->Pattern.IpPortSet.Address.Ipv4.s_addr = HostToNet32(Address);
+        Rule->Pattern.IpPortSet.PortSet.PortSet = PortSet;
+    }
+
+    //
+    // Source-pinned subscriptions not already covered.
+    //
+    auto TupleKey = [](const UdpSubscription& Tuple) {
+        return std::make_tuple(Tuple.DestinationAddress, Tuple.DestinationPort, Tuple.SourceAddress, Tuple.SourcePort);
+    };
+    std::sort(Tuples.begin(), Tuples.end(), [&](const UdpSubscription& A, const UdpSubscription& B) {
+        return TupleKey(A) < TupleKey(B);
+    });
+    Tuples.erase(
+        std::unique(
+            Tuples.begin(),
+            Tuples.end(),
+            [&](const UdpSubscription& A, const UdpSubscription& B) { return TupleKey(A) == TupleKey(B); }),
+        Tuples.end());
+
+    for (const UdpSubscription& Tuple : Tuples) {
+        std::pair<UINT32, UINT16> Destination(Tuple.DestinationAddress, Tuple.DestinationPort);
+        if (Covered(Tuple.DestinationAddress, Tuple.DestinationPort) ||
+            std::binary_search(AddressPorts.begin(), AddressPorts.end(), Destination)) {
+            continue;
+        }
+
+        XDP_RULE* Rule = AddRule(RuleSet, XDP_MATCH_IPV4_UDP_TUPLE, Target);
+        Rule->Pattern.Tuple.SourceAddress.Ipv4.s_addr = HostToNet32(Tuple.SourceAddress);
+        Rule->Pattern.Tuple.DestinationAddress.Ipv4.s_addr = HostToNet32(Tuple.DestinationAddress);
+        Rule->Pattern.Tuple.SourcePort = HostToNet16(Tuple.SourcePort);
+        Rule->Pattern.Tuple.DestinationPort = HostToNet16(Tuple.DestinationPort);
+    }
+
+    return S_OK;
+}
+
+HRESULT UdpRuleCompiler::CompileNaive(
+    _In_reads_(Count) const UdpSubscription* Subscriptions,
+    UINT32 Count,
+    HANDLE Target,
+    _Out_ CompiledRuleSet* RuleSet)
+{
+    *RuleSet = CompiledRuleSet();
+    auto Ports = std::make_unique<UINT8[]>(XDP_PORT_SET_BUFFER_SIZE);
+
+    for (UINT32 i = 0; i < Count; i++) {
+        const UdpSubscription& Subscription = Subscriptions[i];
+
+        if (HRESULT Result = ValidateSubscription(Subscription); FAILED(Result)) {
+            return Result;
+        }
+
+        if (IsSourcePinned(Subscription)) {
+            XDP_RULE* Rule = AddRule(RuleSet, XDP_MATCH_IPV4_UDP_TUPLE, Target);
+            Rule->Pattern.Tuple.SourceAddress.Ipv4.s_addr = HostToNet32(Subscription.SourceAddress);
+            Rule->Pattern.Tuple.DestinationAddress.Ipv4.s_addr = HostToNet32(Subscription.DestinationAddress);
+            Rule->Pattern.Tuple.SourcePort = HostToNet16(Subscription.SourcePort);
+            Rule->Pattern.Tuple.DestinationPort = HostToNet16(Subscription.DestinationPort);
+        } else if (Subscription.DestinationPort != UdpSubscription::AnyPort) {
+            if (!TestPortBit(Ports.get(), Subscription.DestinationPort)) {
+                SetPortBit(Ports.get(), Subscription.DestinationPort);
+                XDP_RULE* Rule = AddRule(RuleSet, XDP_MATCH_UDP_DST, Target);
+                Rule->Pattern.Port = HostToNet16(Subscription.DestinationPort);
+            }
+        } else if (Subscription.DestinationAddress == UdpSubscription::AnyAddress) {
+            AddRule(RuleSet, XDP_MATCH_UDP, Target);
+        } else {
+            XDP_RULE* Rule = AddRule(RuleSet, XDP_MATCH_IPV4_DST_MASK, Target);
+            Rule->Pattern.IpMask.Address.Ipv4.s_addr = HostToNet32(Subscription.DestinationAddress);
+            Rule->Pattern.IpMask.Mask.Ipv4.s_addr = MAXUINT32;
+        }
+    }
+
+    return S_OK;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <windows.h>
+#include <xdpapi.h>
+
+#include <memory>
+#include <vector>
+
+//
+// A UDP subscription. Addresses and ports are in host byte order.
+//
+// DestinationAddress AnyAddress subscribes to DestinationPort on every local
+// address; DestinationPort AnyPort subscribes to every port of
+// DestinationAddress. A source address and port, if given, pin the
+// subscription to a single sender and both destination fields must be set.
+//
+struct UdpSubscription {
+    static constexpr UINT32 AnyAddress = 0;
+    static constexpr UINT16 AnyPort = 0;
+
+    UINT32 DestinationAddress;
+    UINT16 DestinationPort;
+    UINT32 SourceAddress;
+    UINT16 SourcePort;
+};
+
+//
+// The XDP_RULE array for a set of subscriptions, together with the port set
+// bitmaps the rules point into. Bitmaps are separate heap blocks, so moving a
+// CompiledRuleSet leaves every rule's PortSet pointer valid; the set must be
+// kept alive for as long as a program created from it exists.
+//
+class CompiledRuleSet {
+  public:
+    CompiledRuleSet() = default;
+    CompiledRuleSet(CompiledRuleSet&&) = default;
+    CompiledRuleSet& operator=(CompiledRuleSet&&) = default;
+
+    const XDP_RULE* Rules() const { return RuleList.data(); }
+    UINT32 RuleCount() const { return (UINT32)RuleList.size(); }
+
+    UINT32 PortSetCount() const { return (UINT32)PortSets.size(); }
+    UINT64 PortSetBytes() const { return (UINT64)PortSets.size() * XDP_PORT_SET_BUFFER_SIZE; }
+
+  private:
+    friend class UdpRuleCompiler;
+
+    std::vector<XDP_RULE> RuleList;
+    std::vector<std::unique_ptr<UINT8[]>> PortSets;
+};
+
+//
+// Compiles UDP subscriptions into the smallest XDP program we know how to
+// build, with every rule redirecting to the same target:
+//
+//  - Ports subscribed on any address become one XDP_MATCH_UDP_PORT_SET rule,
+//    or XDP_MATCH_UDP_DST if there is only one.
+//  - Addresses subscribed on every port are merged into aligned prefixes and
+//    become XDP_MATCH_IPV4_DST_MASK rules. These also match non-UDP traffic
+//    to the address, which is what a whole-group subscription wants anyway.
+//  - The ports of each remaining address become an XDP_MATCH_IPV4_UDP_PORT_SET
+//    rule. Addresses with identical port sets share one bitmap.
+//  - Source-pinned subscriptions become XDP_MATCH_IPV4_UDP_TUPLE rules.
+//
+// Subscriptions covered by a broader one are dropped. Port set bitmaps are
+// indexed by the port as it appears on the wire, like XDP_RULE patterns.
+//
+class UdpRuleCompiler {
+  public:
+    static HRESULT Compile(
+        _In_reads_(Count) const UdpSubscription* Subscriptions,
+        UINT32 Count,
+        HANDLE Target,
+        _Out_ CompiledRuleSet* RuleSet);
+
+    //
+    // For comparison, the rules the forwarder built before this compiler:
+    // one XDP_MATCH_UDP_DST rule per subscribed port, with the address left
+    // to the application, so it redirects more than was asked for. Whole
+    // addresses and source-pinned flows get one rule each, as above.
+    //
+    static HRESULT CompileNaive(
+        _In_reads_(Count) const UdpSubscription* Subscriptions,
+        UINT32 Count,
+        HANDLE Target,
+        _Out_ CompiledRuleSet* RuleSet);
+
+  private:
+    static UINT8* AddPortSet(CompiledRuleSet* RuleSet);
+    static XDP_RULE* AddRule(CompiledRuleSet* RuleSet, XDP_MATCH_TYPE Match, HANDLE Target);
+};
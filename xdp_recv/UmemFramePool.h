@@ -0,0 +1,169 @@
+#pragma once
+
+#include <windows.h>
+#include <string.h>
+
+#include <memory>
+#include <mutex>
+
+//
+// Free frames of a UMEM shared by several sockets, each serviced by its own
+// thread. Threads move frames in and out in batches through their
+// UmemFramePool, so the lock is taken once per batch rather than per frame.
+//
+class SharedFrameDepot {
+  public:
+    explicit SharedFrameDepot(UINT32 Capacity) : Frames(std::make_unique<UINT64[]>(Capacity)), Capacity(Capacity) {}
+
+    void AddRegion(UINT64 BaseAddress, UINT32 ChunkCount, UINT32 ChunkSize)
+    {
+        std::lock_guard Guard(Lock);
+        for (UINT32 i = 0; i < ChunkCount && Count < Capacity; i++) {
+            Frames[Count++] = BaseAddress + (UINT64)i * ChunkSize;
+        }
+    }
+
+    //
+    // Moves up to Max frames to Out and returns how many.
+    //
+    UINT32 Take(_Out_writes_to_(Max, return) UINT64* Out, UINT32 Max)
+    {
+        std::lock_guard Guard(Lock);
+        UINT32 Taken = Max < Count ? Max : Count;
+        Count -= Taken;
+        memcpy(Out, &Frames[Count], Taken * sizeof(UINT64));
+        return Taken;
+    }
+
+    //
+    // Takes all Number frames or, with no room for them, none, so a frame
+    // is never lost on the way; the caller keeps what is refused.
+    //
+    bool Put(_In_reads_(Number) const UINT64* In, UINT32 Number)
+    {
+        std::lock_guard Guard(Lock);
+        if (Number > Capacity - Count) {
+            Refused += Number;
+            return false;
+        }
+        memcpy(&Frames[Count], In, Number * sizeof(UINT64));
+        Count += Number;
+        return true;
+    }
+
+    UINT32 Available() const
+    {
+        std::lock_guard Guard(Lock);
+        return Count;
+    }
+
+    //
+    // Frames Put() turned away. Non-zero means the depot is smaller than
+    // the frames in circulation.
+    //
+    UINT64 RefusedFrames() const
+    {
+        std::lock_guard Guard(Lock);
+        return Refused;
+    }
+
+  private:
+    mutable std::mutex Lock;
+    std::unique_ptr<UINT64[]> Frames;
+    UINT32 Capacity;
+    UINT32 Count = 0;
+    UINT64 Refused = 0;
+};
+
+//
+// Free list of UMEM frame addresses (offsets from the start of the UMEM).
+// Frames that are neither posted to the fill ring nor held by the application
+// live here. The pool is owned by a single thread and all storage is
+// allocated up front.
+//
+// An address is the start of a chunk, which is what the fill ring takes:
+// the BaseAddress of a returned descriptor, never its AddressAndOffset.
+//
+// Backed by a SharedFrameDepot, the pool is that thread's cache of the
+// shared UMEM: an empty pool takes Batch frames from the depot, a full one
+// hands Batch frames back, so frames freed on one thread reach the others.
+//
+class UmemFramePool {
+  public:
+    explicit UmemFramePool(UINT32 Capacity) : Frames(std::make_unique<UINT64[]>(Capacity)), Capacity(Capacity) {}
+
+    UmemFramePool(UINT32 Capacity, _In_ SharedFrameDepot* Depot, UINT32 Batch)
+        : Frames(std::make_unique<UINT64[]>(Capacity))
+        , Capacity(Capacity)
+        , Depot(Depot)
+        , Batch(Batch == 0 ? 1 : Batch < Capacity ? Batch : Capacity)
+    {
+    }
+
+    //
+    // Adds every chunk of a UMEM region to the pool.
+    //
+    void AddRegion(UINT64 BaseAddress, UINT32 ChunkCount, UINT32 ChunkSize)
+    {
+        for (UINT32 i = 0; i < ChunkCount; i++) {
+            Free(BaseAddress + (UINT64)i * ChunkSize);
+        }
+    }
+
+    bool Allocate(_Out_ UINT64* Address)
+    {
+        if (Count == 0) {
+            if (Depot == nullptr || (Count = Depot->Take(Frames.get(), Batch)) == 0) {
+                return false;
+            }
+            DepotTransfers++;
+        }
+        *Address = Frames[--Count];
+        return true;
+    }
+
+    //
+    // Fails, and counts the frame as lost, only when the pool and its depot
+    // are both full: more frames are in circulation than they were sized
+    // for, which is a bug in the caller.
+    //
+    bool Free(UINT64 Address)
+    {
+        if (Count == Capacity && Depot != nullptr && Depot->Put(&Frames[Count - Batch], Batch)) {
+            Count -= Batch;
+            DepotTransfers++;
+        }
+        if (Count == Capacity) {
+            LostFrames++;
+            return false;
+        }
+        Frames[Count++] = Address;
+        return true;
+    }
+
+    //
+    // Returns every cached frame to the depot, e.g. before the owning thread
+    // exits.
+    //
+    void Flush()
+    {
+        if (Depot != nullptr && Count != 0 && Depot->Put(Frames.get(), Count)) {
+            Count = 0;
+            DepotTransfers++;
+        }
+    }
+
+    UINT32 Available() const { return Count; }
+    UINT32 Size() const { return Capacity; }
+    UINT64 Transfers() const { return DepotTransfers; }
+    UINT64 Lost() const { return LostFrames; }
+
+  private:
+    std::unique_ptr<UINT64[]> Frames;
+    UINT32 Capacity;
+    UINT32 Count = 0;
+    SharedFrameDepot* Depot = nullptr;
+    UINT32 Batch = 0;
+    UINT64 DepotTransfers = 0;
+    UINT64 LostFrames = 0;
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <windows.h>
+#include <afxdp_helper.h>
+
+#include <memory>
+
+#include "PacketHeaders.h"
+
+//
+// The rings of an AF_XDP socket kept in process memory, for backends that
+// receive through the socket API instead of XDP. They are laid out the way
+// XSK_SOCKOPT_RING_INFO describes kernel rings, so the application side
+// initializes its XSK_RINGs from RingInfo() and cannot tell the difference.
+//
+// The backend plays the kernel: it takes buffers off the fill ring,
+// receives a datagram into each behind room for the Ethernet, IPv4 and UDP
+// headers, writes those headers from the datagram's addresses and posts
+// the buffer on the RX ring. Handlers see the same frames as with XDP.
+//
+class UserRingSocket {
+  public:
+    static constexpr UINT32 HeaderLength = sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader);
+
+    void RegisterUmem(const XSK_UMEM_REG& Umem)
+    {
+        this->Umem = (UCHAR*)Umem.Address;
+        UmemSize = Umem.TotalSize;
+        ChunkSize = Umem.ChunkSize;
+    }
+
+    bool HasUmem() const { return Umem != nullptr; }
+    UINT32 ChunkCount() const { return (UINT32)(UmemSize / ChunkSize); }
+    UINT32 Chunk(UINT64 Address) const { return (UINT32)(Address / ChunkSize); }
+
+    //
+    // Creates the RX and fill rings; there is no TX side.
+    //
+    HRESULT CreateRings(UINT32 RxSize, UINT32 FillSize)
+    {
+        if (!IsPowerOfTwo(RxSize) || !IsPowerOfTwo(FillSize) || Memory != nullptr) {
+            return E_INVALIDARG;
+        }
+
+        UINT64 RxBytes = RingHeaderSize + (UINT64)RxSize * sizeof(XSK_BUFFER_DESCRIPTOR);
+        UINT64 FillBytes = RingHeaderSize + (UINT64)FillSize * sizeof(UINT64);
+        Memory = std::make_unique<UCHAR[]>(RxBytes + FillBytes + RingCacheLine);
+        memset(Memory.get(), 0, RxBytes + FillBytes + RingCacheLine);
+
+        UCHAR* Base = (UCHAR*)(((ULONG_PTR)Memory.get() + RingCacheLine - 1) & ~(ULONG_PTR)(RingCacheLine - 1));
+        Rings = {};
+        Rings.Rx = RingAt(Base, RxSize, sizeof(XSK_BUFFER_DESCRIPTOR));
+        Rings.Fill = RingAt(Base + RxBytes, FillSize, sizeof(UINT64));
+        XskRingInitialize(&KernelRx, &Rings.Rx);
+        XskRingInitialize(&KernelFill, &Rings.Fill);
+        return S_OK;
+    }
+
+    const XSK_RING_INFO_SET& RingInfo() const { return Rings; }
+    bool HasRings() const { return Memory != nullptr; }
+
+    //
+    // Takes up to Max buffers off the fill ring. Returns the UMEM offset of
+    // each chunk.
+    //
+    UINT32 TakeFillBuffers(_Out_writes_to_(Max, return) UINT64* Addresses, UINT32 Max)
+    {
+        UINT32 Index;
+        UINT32 Count = XskRingConsumerReserve(&KernelFill, Max, &Index);
+        for (UINT32 i = 0; i < Count; i++) {
+            XSK_BUFFER_ADDRESS Address;
+            Address.AddressAndOffset = *(UINT64*)XskRingGetElement(&KernelFill, Index + i);
+            Addresses[i] = (Address.BaseAddress + Address.Offset) / ChunkSize * ChunkSize;
+        }
+        XskRingConsumerRelease(&KernelFill, Count);
+        return Count;
+    }
+
+    UINT32 FillAvailable() const
+    {
+        return ReadUInt32Acquire(KernelFill.SharedProducer) - *KernelFill.SharedConsumer;
+    }
+
+    UINT32 RxRoom() const
+    {
+        return KernelRx.Size - (*KernelRx.SharedProducer - ReadUInt32Acquire(KernelRx.SharedConsumer));
+    }
+
+    bool RxAvailable() const
+    {
+        return ReadUInt32Acquire(KernelRx.SharedProducer) != ReadUInt32Acquire(KernelRx.SharedConsumer);
+    }
+
+    //
+    // Where a datagram goes in the chunk at Address, and how much fits.
+    //
+    UCHAR* Payload(UINT64 Address) const { return Umem + Address + HeaderLength; }
+    UINT32 PayloadRoom() const { return ChunkSize - HeaderLength; }
+
+    //
+    // Writes the headers in front of a datagram received into the chunk at
+    // Address and queues the frame for the RX ring; SubmitRx() publishes the
+    // queued frames. Callers keep to RxRoom() frames between submits.
+    // Addresses and ports are in host byte order.
+    //
+    void Deliver(
+        UINT64 Address,
+        UINT32 PayloadLength,
+        UINT32 SourceAddress,
+        UINT16 SourcePort,
+        UINT32 DestinationAddress,
+        UINT16 DestinationPort)
+    {
+        WriteUdpHeaders(Umem + Address, PayloadLength, SourceAddress, SourcePort, DestinationAddress, DestinationPort);
+
+        XSK_BUFFER_DESCRIPTOR* Descriptor =
+            (XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&KernelRx, *KernelRx.SharedProducer + PendingRx);
+        Descriptor->Address.AddressAndOffset = Address;
+        Descriptor->Length = HeaderLength + PayloadLength;
+        Descriptor->Reserved = 0;
+        PendingRx++;
+    }
+
+    void SubmitRx()
+    {
+        if (PendingRx != 0) {
+            XskRingProducerSubmit(&KernelRx, PendingRx);
+            PendingRx = 0;
+        }
+    }
+
+  private:
+    //
+    // Producer index, consumer index and flags each get their own cache
+    // line, followed by the descriptors.
+    //
+    static constexpr UINT32 RingCacheLine = 64;
+    static constexpr UINT32 RingHeaderSize = 3 * RingCacheLine;
+
+    static bool IsPowerOfTwo(UINT32 Value) { return Value != 0 && (Value & (Value - 1)) == 0; }
+
+    static XSK_RING_INFO RingAt(_In_ UCHAR* Base, UINT32 Size, UINT32 ElementStride)
+    {
+        XSK_RING_INFO Info {};
+        Info.Ring = Base;
+        Info.ProducerIndexOffset = 0;
+        Info.ConsumerIndexOffset = RingCacheLine;
+        Info.FlagsOffset = 2 * RingCacheLine;
+        Info.DescriptorsOffset = RingHeaderSize;
+        Info.Size = Size;
+        Info.ElementStride = ElementStride;
+        return Info;
+    }
+
+    UCHAR* Umem = nullptr;
+    UINT64 UmemSize = 0;
+    UINT32 ChunkSize = 0;
+    std::unique_ptr<UCHAR[]> Memory;
+    XSK_RING_INFO_SET Rings {};
+
+    //
+    // The rings as the receive side of the backend sees them: fill is
+    // consumed, RX is produced.
+    //
+    XSK_RING KernelFill {};
+    XSK_RING KernelRx {};
+    UINT32 PendingRx = 0;
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <windows.h>
+#include <string.h>
+
+#include <array>
+
+//
+// Runtime support for the message decoders --decoder-gen generates from a
+// schema (see DecoderGenerator.h). A generated decoder is a set of flyweight
+// views, each a pointer into frame memory with one accessor per field at a
+// constexpr offset, and a schema type naming the packet header, the framing
+// and the messages. Nothing is copied out of the UMEM; a field is loaded and
+// converted from the wire byte order when its accessor is called.
+//
+// Messages follow the packet header, each behind a length prefix and with a
+// one-byte type first (the ITCH/MoldUDP64 layout). WireDecode() walks them
+// and dispatches on the type through a 256-entry table of functions built at
+// compile time per handler type, one per message the schema knows. A handler
+// implements On(const Message&) for the messages it wants; the rest are
+// counted and skipped without a branch on the type anywhere.
+//
+
+enum class WireByteOrder {
+    Little,
+    Big,
+};
+
+inline UINT16 WireSwap16(UINT16 Value)
+{
+#if defined(_MSC_VER)
+    return _byteswap_ushort(Value);
+#else
+    return __builtin_bswap16(Value);
+#endif
+}
+
+inline UINT32 WireSwap32(UINT32 Value)
+{
+#if defined(_MSC_VER)
+    return _byteswap_ulong(Value);
+#else
+    return __builtin_bswap32(Value);
+#endif
+}
+
+inline UINT64 WireSwap64(UINT64 Value)
+{
+#if defined(_MSC_VER)
+    return _byteswap_uint64(Value);
+#else
+    return __builtin_bswap64(Value);
+#endif
+}
+
+//
+// Loads a Bytes-wide unsigned integer stored in Order. The receive path only
+// runs on little-endian hosts, like the rest of the tree.
+//
+template <UINT32 Bytes, WireByteOrder Order>
+inline UINT64 WireLoad(_In_reads_bytes_(Bytes) const UCHAR* Data)
+{
+    static_assert(Bytes >= 1 && Bytes <= 8);
+
+    if constexpr (Bytes == 1) {
+        return Data[0];
+    } else if constexpr (Bytes == 2) {
+        UINT16 Value;
+        memcpy(&Value, Data, sizeof(Value));
+        return Order == WireByteOrder::Big ? WireSwap16(Value) : Value;
+    } else if constexpr (Bytes == 4) {
+        UINT32 Value;
+        memcpy(&Value, Data, sizeof(Value));
+        return Order == WireByteOrder::Big ? WireSwap32(Value) : Value;
+    } else if constexpr (Bytes == 8) {
+        UINT64 Value;
+        memcpy(&Value, Data, sizeof(Value));
+        return Order == WireByteOrder::Big ? WireSwap64(Value) : Value;
+    } else {
+        //
+        // Odd widths (ITCH's 6-byte timestamps) are assembled a byte at a
+        // time so the load never reaches past the field.
+        //
+        UINT64 Value = 0;
+        for (UINT32 i = 0; i < Bytes; i++) {
+            UINT32 Byte = Order == WireByteOrder::Big ? i : Bytes - 1 - i;
+            Value = (Value << 8) | Data[Byte];
+        }
+        return Value;
+    }
+}
+
+//
+// Stores the low Bytes bytes of Value big-endian; the writing side of
+// WireLoad, for the feeds and the retransmission rig that build packets.
+//
+inline void WireStoreBig(_Out_writes_bytes_(Bytes) UCHAR* Data, UINT64 Value, UINT32 Bytes)
+{
+    for (UINT32 i = 0; i < Bytes; i++) {
+        Data[i] = (UCHAR)(Value >> (8 * (Bytes - 1 - i)));
+    }
+}
+
+template <typename... Messages>
+struct WireMessageList {};
+
+struct WireDecodeStats {
+    UINT64 Datagrams;
+    UINT64 Messages;
+
+    //
+    // Messages of a type the schema does not know, or shorter than their
+    // type's fixed layout; both are skipped.
+    //
+    UINT64 UnknownMessages;
+    UINT64 ShortMessages;
+
+    //
+    // Datagrams shorter than the packet header or ending inside a message.
+    //
+    UINT64 MalformedDatagrams;
+};
+
+template <typename Handler>
+using WireDispatchFn = void (*)(Handler& Target, _In_ const UCHAR* Data, UINT32 Length, _Inout_ WireDecodeStats* Stats);
+
+template <typename Handler, typename Message>
+void WireDispatchMessage(Handler& Target, _In_ const UCHAR* Data, UINT32 Length, _Inout_ WireDecodeStats* Stats)
+{
+    if (Length < Message::Size) {
+        Stats->ShortMessages++;
+        return;
+    }
+    if constexpr (requires { Target.On(Message(Data)); }) {
+        Target.On(Message(Data));
+    }
+}
+
+template <typename Handler>
+void WireDispatchUnknown(Handler& Target, _In_ const UCHAR* Data, UINT32 Length, _Inout_ WireDecodeStats* Stats)
+{
+    Stats->UnknownMessages++;
+    if constexpr (requires { Target.OnUnknown(Data, Length); }) {
+        Target.OnUnknown(Data, Length);
+    }
+}
+
+template <typename Handler, typename... Messages>
+constexpr std::array<WireDispatchFn<Handler>, 256> WireBuildDispatchTable(WireMessageList<Messages...>)
+{
+    std::array<WireDispatchFn<Handler>, 256> Table {};
+    Table.fill(&WireDispatchUnknown<Handler>);
+    ((Table[Messages::Type] = &WireDispatchMessage<Handler, Messages>), ...);
+    return Table;
+}
+
+template <typename Schema, typename Handler>
+inline constexpr std::array<WireDispatchFn<Handler>, 256> WireDispatchTable =
+    WireBuildDispatchTable<Handler>(typename Schema::Messages {});
+
+//
+// Decodes the messages of one datagram payload in place, calling
+// Target.OnPacket(const Schema::Packet&) first if the handler has it.
+// Returns the number of messages dispatched.
+//
+template <typename Schema, typename Handler>
+UINT32 WireDecode(
+    _In_reads_bytes_(Length) const UCHAR* Payload,
+    UINT32 Length,
+    Handler& Target,
+    _Inout_ WireDecodeStats* Stats)
+{
+    using Packet = typename Schema::Packet;
+    constexpr UINT32 PrefixBytes = Schema::LengthPrefixBytes;
+    constexpr const auto& Table = WireDispatchTable<Schema, Handler>;
+
+    Stats->Datagrams++;
+    if (Length < Packet::Size) {
+        Stats->MalformedDatagrams++;
+        return 0;
+    }
+    if constexpr (requires { Target.OnPacket(Packet(Payload)); }) {
+        Target.OnPacket(Packet(Payload));
+    }
+
+    const UCHAR* Next = Payload + Packet::Size;
+    const UCHAR* End = Payload + Length;
+    UINT32 Count = 0;
+    while ((UINT32)(End - Next) >= PrefixBytes) {
+        UINT32 MessageLength = (UINT32)WireLoad<PrefixBytes, Schema::Order>(Next);
+        Next += PrefixBytes;
+        if (MessageLength == 0 || MessageLength > (UINT32)(End - Next)) {
+            Stats->MalformedDatagrams++;
+            break;
+        }
+        Table[Next[0]](Target, Next, MessageLength, Stats);
+        Next += MessageLength;
+        Count++;
+    }
+    Stats->Messages += Count;
+    return Count;
+}
@@ -0,0 +1,283 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "FanOutDispatcher.h"
+#include "PacketHeaders.h"
+#include "RssPredictor.h"
+#include "TscClock.h"
+#include "UmemFramePool.h"
+#include "WorkStealingPool.h"
+
+static constexpr UINT32 BenchChunkSize = 2048;
+static constexpr UINT32 BenchChunks = 8192;
+static constexpr UINT32 BenchFrameLength = 64;
+static constexpr UINT32 BenchBurst = 32;
+static constexpr UINT32 PayloadOffset = sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader);
+
+enum class Scheduler {
+    StaticHash,
+    Stealing,
+    StealingOrdered,
+};
+
+struct SkewedWorkload {
+    std::vector<std::vector<UCHAR>> FlowFrames;
+    std::vector<UINT64> FlowCostTicks;
+    std::vector<UINT32> Sequence;
+};
+
+struct BenchPayload {
+    UINT32 Flow;
+    UINT32 Sequence;
+};
+
+struct alignas(64) WorkerLoad {
+    std::atomic<UINT64> BusyTicks {0};
+};
+
+struct StealRunResult {
+    double Mpps;
+    double BusyMaxOverMean;
+    UINT64 OrderViolations;
+    UINT64 Steals;
+};
+
+//
+// Flow popularity is Zipf(1) and every HeavyEvery-th flow costs HeavyNs per
+// frame instead of CheapNs, like book-building instruments among
+// decode-only ones. A static mapping gives whole heavy flows to one worker.
+//
+static SkewedWorkload MakeWorkload(
+    const TscClock& Clock,
+    UINT32 Flows,
+    UINT32 Frames,
+    UINT32 CheapNs,
+    UINT32 HeavyNs,
+    UINT32 HeavyEvery)
+{
+    SkewedWorkload Workload;
+    std::mt19937 Random(11);
+    std::vector<double> Weights(Flows);
+
+    Workload.FlowFrames.assign(Flows, std::vector<UCHAR>(BenchFrameLength));
+    Workload.FlowCostTicks.resize(Flows);
+    for (UINT32 Flow = 0; Flow < Flows; Flow++) {
+        BuildUdpFrame(
+            Workload.FlowFrames[Flow].data(),
+            BenchFrameLength,
+            0x0a000000 | Flow,
+            (UINT16)(20000 + Flow),
+            0xef000001,
+            5000);
+        Workload.FlowCostTicks[Flow] = Clock.NsToTicks(Flow % HeavyEvery == HeavyEvery / 2 ? HeavyNs : CheapNs);
+        Weights[Flow] = 1.0 / (Flow + 1);
+    }
+
+    std::discrete_distribution<UINT32> Popularity(Weights.begin(), Weights.end());
+    Workload.Sequence.resize(Frames);
+    for (UINT32& Flow : Workload.Sequence) {
+        Flow = Popularity(Random);
+    }
+    return Workload;
+}
+
+static StealRunResult RunScheduler(
+    const TscClock& Clock,
+    const RssPredictor& Predictor,
+    const SkewedWorkload& Workload,
+    Scheduler Kind,
+    UINT32 Workers)
+{
+    UINT32 Flows = (UINT32)Workload.FlowFrames.size();
+    auto Umem = std::make_unique<UCHAR[]>((size_t)BenchChunks * BenchChunkSize);
+    UmemFramePool Pool(BenchChunks);
+    Pool.AddRegion(0, BenchChunks, BenchChunkSize);
+
+    std::vector<UINT32> NextSequence(Flows, 1);
+    auto LastSequence = std::make_unique<std::atomic<UINT32>[]>(Flows);
+    auto Load = std::make_unique<WorkerLoad[]>(Workers);
+    std::atomic<UINT64> OrderViolations {0};
+
+    auto Handle = [&](UINT32 Worker, const FanOutFrame* Frames, UINT32 Count) {
+        UINT64 Busy = 0;
+        for (UINT32 i = 0; i < Count; i++) {
+            BenchPayload Payload;
+            memcpy(&Payload, Frames[i].Data + PayloadOffset, sizeof(Payload));
+            if (LastSequence[Payload.Flow].exchange(Payload.Sequence, std::memory_order_relaxed) >
+                Payload.Sequence) {
+                OrderViolations.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            UINT64 Start = Clock.Now();
+            UINT64 End = Start + Workload.FlowCostTicks[Payload.Flow];
+            while (Clock.Now() < End) {
+            }
+            Busy += End - Start;
+        }
+        Load[Worker].BusyTicks.fetch_add(Busy, std::memory_order_relaxed);
+    };
+
+    FanOutConfig StaticConfig;
+    StaticConfig.Workers = Workers;
+    FanOutDispatcher Static(StaticConfig, &Predictor);
+
+    WorkStealingConfig StealConfig;
+    StealConfig.Workers = Workers;
+    StealConfig.MaxBatch = BenchBurst;
+    WorkStealingPool Stealing(StealConfig);
+
+    auto Reclaim = [&] {
+        if (Kind == Scheduler::StaticHash) {
+            Static.Flush();
+            Static.Reclaim(&Pool);
+        } else {
+            Stealing.Reclaim(&Pool);
+        }
+    };
+
+    if (Kind == Scheduler::StaticHash) {
+        Static.Start(Handle);
+    } else {
+        Stealing.Start(Handle);
+    }
+
+    FanOutFrame Burst[BenchBurst];
+    UINT32 BurstKeys[BenchBurst];
+    UINT32 BurstCount = 0;
+    UINT64 Start = Clock.NowOrdered();
+
+    for (UINT32 i = 0; i < Workload.Sequence.size(); i++) {
+        UINT64 Address;
+        while (!Pool.Allocate(&Address)) {
+            Reclaim();
+            std::this_thread::yield();
+        }
+
+        UINT32 Flow = Workload.Sequence[i];
+        UCHAR* Frame = &Umem[Address];
+        BenchPayload Payload {Flow, NextSequence[Flow]++};
+        memcpy(Frame, Workload.FlowFrames[Flow].data(), BenchFrameLength);
+        memcpy(Frame + PayloadOffset, &Payload, sizeof(Payload));
+
+        if (Kind == Scheduler::StaticHash) {
+            while (!Static.Dispatch(Frame, Address, BenchFrameLength)) {
+                Reclaim();
+                std::this_thread::yield();
+            }
+            if (i % BenchBurst == BenchBurst - 1) {
+                Reclaim();
+            }
+            continue;
+        }
+
+        Burst[BurstCount] = {Frame, Address, BenchFrameLength, Flow};
+        BurstKeys[BurstCount] = Flow;
+        if (++BurstCount == BenchBurst || i + 1 == Workload.Sequence.size()) {
+            const UINT32* Keys = Kind == Scheduler::StealingOrdered ? BurstKeys : nullptr;
+            while (!Stealing.Submit(Burst, BurstCount, Keys)) {
+                Reclaim();
+                std::this_thread::yield();
+            }
+            BurstCount = 0;
+            Reclaim();
+        }
+    }
+
+    StealRunResult Result {};
+    if (Kind == Scheduler::StaticHash) {
+        Static.Stop(&Pool);
+    } else {
+        Stealing.Stop(&Pool);
+        for (UINT32 Worker = 0; Worker < Workers; Worker++) {
+            Result.Steals += Stealing.Statistics(Worker).Steals;
+        }
+    }
+    UINT64 Ns = Clock.TicksToNs(Clock.NowOrdered() - Start);
+
+    UINT64 BusyTotal = 0;
+    UINT64 BusyMax = 0;
+    for (UINT32 Worker = 0; Worker < Workers; Worker++) {
+        UINT64 Busy = Load[Worker].BusyTicks.load();
+        BusyTotal += Busy;
+        BusyMax = std::max(BusyMax, Busy);
+    }
+
+    Result.Mpps = Ns != 0 ? Workload.Sequence.size() * 1000.0 / Ns : 0.0;
+    Result.BusyMaxOverMean = BusyTotal != 0 ? (double)BusyMax * Workers / BusyTotal : 0.0;
+    Result.OrderViolations = OrderViolations.load();
+    return Result;
+}
+
+//
+// Static flow hashing against work stealing, with and without per-flow
+// ordering, on a workload where a few popular flows cost far more per frame
+// than the rest.
+//
+int WorkStealingBenchmark(int argc, char** argv)
+{
+    UINT32 Workers = argc >= 1 ? atoi(argv[0]) : 4;
+    UINT32 Frames = argc >= 2 ? atoi(argv[1]) : 400000;
+    UINT32 Flows = argc >= 3 ? atoi(argv[2]) : 256;
+    UINT32 CheapNs = argc >= 4 ? atoi(argv[3]) : 100;
+    UINT32 HeavyNs = argc >= 5 ? atoi(argv[4]) : 2000;
+    UINT32 HeavyEvery = argc >= 6 ? atoi(argv[5]) : 10;
+
+    if (Workers == 0 || Frames == 0 || Flows == 0 || HeavyEvery == 0) {
+        fprintf(stderr, "workers, frames, flows and heavy-every must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    std::vector<PROCESSOR_NUMBER> Table(128);
+    RssPredictor Predictor(
+        XDP_RSS_VALID_HASH_TYPES,
+        RssPredictor::DefaultKey,
+        sizeof(RssPredictor::DefaultKey),
+        Table.data(),
+        (UINT32)Table.size());
+    SkewedWorkload Workload = MakeWorkload(Clock, Flows, Frames, CheapNs, HeavyNs, HeavyEvery);
+
+    printf(
+        "%u workers, %u frames over %u Zipf flows, %u ns per frame, %u ns for every %uth flow, "
+        "%u hardware threads\n\n",
+        Workers,
+        Frames,
+        Flows,
+        CheapNs,
+        HeavyNs,
+        HeavyEvery,
+        std::thread::hardware_concurrency());
+    printf("%-16s %10s %14s %12s %10s\n", "scheduler", "Mpps", "busy max/mean", "out-of-order", "steals");
+
+    static const struct {
+        const char* Name;
+        Scheduler Kind;
+    } Schedulers[] = {
+        {"static hash", Scheduler::StaticHash},
+        {"stealing", Scheduler::Stealing},
+        {"stealing ordered", Scheduler::StealingOrdered},
+    };
+
+    for (const auto& Entry : Schedulers) {
+        StealRunResult Result = RunScheduler(Clock, Predictor, Workload, Entry.Kind, Workers);
+        printf(
+            "%-16s %10.3f %14.2f %12llu %10llu\n",
+            Entry.Name,
+            Result.Mpps,
+            Result.BusyMaxOverMean,
+            (unsigned long long)Result.OrderViolations,
+            (unsigned long long)Result.Steals);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,316 @@
+#include "WorkStealingPool.h"
+
+static UINT32 NextRandom(_Inout_ UINT32* State)
+{
+    UINT32 X = *State;
+    X ^= X << 13;
+    X ^= X >> 17;
+    X ^= X << 5;
+    *State = X;
+    return X;
+}
+
+WorkStealingPool::WorkStealingPool(const WorkStealingConfig& Config) : Config(Config)
+{
+    if (this->Config.Workers == 0) {
+        this->Config.Workers = 1;
+    }
+    if (this->Config.MaxBatch == 0) {
+        this->Config.MaxBatch = 1;
+    }
+    if (this->Config.BatchSlots == 0) {
+        this->Config.BatchSlots = 1;
+    }
+    if (this->Config.LaneBudget == 0) {
+        this->Config.LaneBudget = 1;
+    }
+
+    //
+    // Every slot and every lane can be queued at once, and all of them on a
+    // single worker, so inboxes and deques sized for that never overflow.
+    //
+    UINT32 QueueSize = this->Config.BatchSlots + this->Config.OrderLanes;
+
+    SlotFrames = std::make_unique<FanOutFrame[]>((size_t)this->Config.BatchSlots * this->Config.MaxBatch);
+    Slots = std::make_unique<TaskSlot[]>(this->Config.BatchSlots);
+    for (UINT32 Slot = this->Config.BatchSlots; Slot-- > 0;) {
+        Slots[Slot] = {0, &SlotFrames[(size_t)Slot * this->Config.MaxBatch]};
+        FreeSlots.push_back(Slot);
+    }
+
+    FrameGroup.resize(this->Config.MaxBatch);
+    GroupLane.resize(this->Config.MaxBatch);
+    GroupSlot.resize(this->Config.MaxBatch);
+
+    for (UINT32 i = 0; i < this->Config.OrderLanes; i++) {
+        Lanes.push_back(std::make_unique<Lane>(this->Config.LaneDepth));
+    }
+    for (UINT32 Worker = 0; Worker < this->Config.Workers; Worker++) {
+        State.push_back(std::make_unique<WorkerState>(QueueSize, this->Config.BatchSlots));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    Stop(nullptr);
+}
+
+void WorkStealingPool::Start(Handler Handle)
+{
+    this->Handle = std::move(Handle);
+    Stopping.store(false, std::memory_order_relaxed);
+    Running = true;
+    for (UINT32 Worker = 0; Worker < State.size(); Worker++) {
+        State[Worker]->Thread = std::thread(&WorkStealingPool::WorkerThread, this, Worker);
+    }
+}
+
+void WorkStealingPool::Stop(_Inout_opt_ UmemFramePool* Pool)
+{
+    if (!Running) {
+        return;
+    }
+
+    //
+    // Every task is done once all of its slots are back.
+    //
+    Publish();
+    while (FreeSlots.size() != Config.BatchSlots) {
+        if (Reclaim(Pool) == 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    Stopping.store(true, std::memory_order_release);
+    for (auto& Worker : State) {
+        Worker->Thread.join();
+    }
+    Running = false;
+}
+
+bool WorkStealingPool::Submit(
+    _In_reads_(Count) const FanOutFrame* Frames,
+    UINT32 Count,
+    _In_reads_opt_(Count) const UINT32* OrderKeys)
+{
+    if (Count == 0) {
+        return true;
+    }
+    if (Count > Config.MaxBatch) {
+        return false;
+    }
+    if (Config.OrderLanes == 0) {
+        OrderKeys = nullptr;
+    }
+
+    //
+    // One task for the unordered frames and one per lane, each keeping the
+    // frames in submit order.
+    //
+    UINT32 Groups = 0;
+    for (UINT32 i = 0; i < Count; i++) {
+        UINT32 LaneIndex = Unordered;
+        if (OrderKeys != nullptr && OrderKeys[i] != Unordered) {
+            LaneIndex = OrderKeys[i] % Config.OrderLanes;
+        }
+
+        UINT32 Group = 0;
+        while (Group < Groups && GroupLane[Group] != LaneIndex) {
+            Group++;
+        }
+        if (Group == Groups) {
+            if (LaneIndex != Unordered && Lanes[LaneIndex]->Tasks.Room() == 0) {
+                return false;
+            }
+            GroupLane[Groups++] = LaneIndex;
+        }
+        FrameGroup[i] = Group;
+    }
+
+    if (FreeSlots.size() < Groups) {
+        return false;
+    }
+
+    for (UINT32 Group = 0; Group < Groups; Group++) {
+        GroupSlot[Group] = FreeSlots.back();
+        FreeSlots.pop_back();
+        Slots[GroupSlot[Group]].Count = 0;
+    }
+    for (UINT32 i = 0; i < Count; i++) {
+        TaskSlot& Slot = Slots[GroupSlot[FrameGroup[i]]];
+        Slot.Frames[Slot.Count++] = Frames[i];
+    }
+
+    for (UINT32 Group = 0; Group < Groups; Group++) {
+        if (GroupLane[Group] == Unordered) {
+            Enqueue(GroupSlot[Group]);
+            continue;
+        }
+
+        //
+        // The lane is scheduled only on its idle-to-busy edge; the worker
+        // that clears Scheduled checks the lane again afterwards, so a task
+        // pushed here is never left behind.
+        //
+        Lane& Ordered = *Lanes[GroupLane[Group]];
+        Ordered.Tasks.Push(GroupSlot[Group]);
+        Ordered.Tasks.Publish();
+        if (!Ordered.Scheduled.exchange(true, std::memory_order_seq_cst)) {
+            Enqueue(LaneTask | GroupLane[Group]);
+        }
+    }
+
+    Publish();
+    return true;
+}
+
+void WorkStealingPool::Enqueue(UINT32 Task)
+{
+    //
+    // The less loaded of two random workers. The count of a busy worker's
+    // deque is stale, but it only steers the choice.
+    //
+    UINT32 Workers = (UINT32)State.size();
+    WorkerState* Worker = State[NextRandom(&EnqueueRandom) % Workers].get();
+    if (Workers > 1) {
+        WorkerState* Other = State[NextRandom(&EnqueueRandom) % Workers].get();
+        if (Other->Inbox.Occupancy() + Other->Deque.Occupancy() <
+            Worker->Inbox.Occupancy() + Worker->Deque.Occupancy()) {
+            Worker = Other;
+        }
+    }
+
+    Worker->Inbox.Push(Task);
+    Worker->InboxPending = true;
+}
+
+void WorkStealingPool::Publish()
+{
+    for (auto& Worker : State) {
+        if (Worker->InboxPending) {
+            Worker->Inbox.Publish();
+            Worker->InboxPending = false;
+        }
+    }
+}
+
+UINT32 WorkStealingPool::Reclaim(_Inout_opt_ UmemFramePool* Pool)
+{
+    UINT32 Done[64];
+    UINT32 Total = 0;
+
+    for (auto& Worker : State) {
+        UINT32 Count;
+        while ((Count = Worker->Done.Pop(Done, (UINT32)std::size(Done))) != 0) {
+            for (UINT32 i = 0; i < Count; i++) {
+                const TaskSlot& Slot = Slots[Done[i]];
+                for (UINT32 Frame = 0; Frame < Slot.Count && Pool != nullptr; Frame++) {
+                    Pool->Free(Slot.Frames[Frame].Address);
+                }
+                FreeSlots.push_back(Done[i]);
+            }
+            Total += Count;
+        }
+    }
+    return Total;
+}
+
+WorkStealingStats WorkStealingPool::Statistics(UINT32 Worker) const
+{
+    const WorkerState& Stats = *State[Worker];
+    return {
+        Stats.Tasks.load(std::memory_order_relaxed),
+        Stats.Frames.load(std::memory_order_relaxed),
+        Stats.Steals.load(std::memory_order_relaxed),
+        Stats.LaneRuns.load(std::memory_order_relaxed),
+    };
+}
+
+bool WorkStealingPool::FindTask(UINT32 Worker, _Inout_ UINT32* Random, _Out_ UINT32* Task)
+{
+    WorkerState& Self = *State[Worker];
+
+    //
+    // Move new work to the deque first, where others can steal it.
+    //
+    UINT32 Incoming[32];
+    UINT32 Count;
+    while ((Count = Self.Inbox.Pop(Incoming, (UINT32)std::size(Incoming))) != 0) {
+        for (UINT32 i = 0; i < Count; i++) {
+            Self.Deque.Push(Incoming[i]);
+        }
+    }
+
+    if (Self.Deque.Pop(Task)) {
+        return true;
+    }
+
+    UINT32 Workers = (UINT32)State.size();
+    UINT32 First = NextRandom(Random) % Workers;
+    for (UINT32 i = 0; i < Workers; i++) {
+        UINT32 Victim = (First + i) % Workers;
+        if (Victim != Worker && State[Victim]->Deque.Steal(Task)) {
+            Self.Steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::RunSlot(UINT32 Worker, UINT32 Slot)
+{
+    WorkerState& Self = *State[Worker];
+
+    Handle(Worker, Slots[Slot].Frames, Slots[Slot].Count);
+    Self.Tasks.fetch_add(1, std::memory_order_relaxed);
+    Self.Frames.fetch_add(Slots[Slot].Count, std::memory_order_relaxed);
+
+    Self.Done.Push(Slot);
+    Self.Done.Publish();
+}
+
+void WorkStealingPool::RunLane(UINT32 Worker, UINT32 LaneIndex)
+{
+    WorkerState& Self = *State[Worker];
+    Lane& Ordered = *Lanes[LaneIndex];
+    UINT32 Slot;
+
+    for (UINT32 Ran = 0; Ran < Config.LaneBudget && Ordered.Tasks.Pop(&Slot, 1) == 1; Ran++) {
+        RunSlot(Worker, Slot);
+    }
+    Self.LaneRuns.fetch_add(1, std::memory_order_relaxed);
+
+    //
+    // Still busy: put the lane back where it can be stolen. Otherwise mark
+    // it idle, unless the RX thread queued more before it saw the flag.
+    //
+    if (Ordered.Tasks.Occupancy() == 0) {
+        Ordered.Scheduled.exchange(false, std::memory_order_seq_cst);
+        if (Ordered.Tasks.Occupancy() == 0 || Ordered.Scheduled.exchange(true, std::memory_order_seq_cst)) {
+            return;
+        }
+    }
+    Self.Deque.Push(LaneTask | LaneIndex);
+}
+
+void WorkStealingPool::WorkerThread(UINT32 Worker)
+{
+    UINT32 Random = Worker * 2654435761u + 1;
+
+    while (TRUE) {
+        UINT32 Task;
+        if (FindTask(Worker, &Random, &Task)) {
+            if ((Task & LaneTask) != 0) {
+                RunLane(Worker, Task & ~LaneTask);
+            } else {
+                RunSlot(Worker, Task);
+            }
+            continue;
+        }
+
+        if (Stopping.load(std::memory_order_acquire)) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+}
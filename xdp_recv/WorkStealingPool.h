@@ -0,0 +1,173 @@
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ChaseLevDeque.h"
+#include "FanOutDispatcher.h"
+#include "SpscRing.h"
+#include "UmemFramePool.h"
+
+struct WorkStealingConfig {
+    UINT32 Workers = 4;
+
+    //
+    // Frames per task, and the most frames one Submit() takes.
+    //
+    UINT32 MaxBatch = 32;
+
+    //
+    // Tasks that can be in flight at once.
+    //
+    UINT32 BatchSlots = 4096;
+
+    //
+    // Ordering lanes. Frames submitted with an ordering key are serialized
+    // per lane (key modulo OrderLanes); 0 disables ordering.
+    //
+    UINT32 OrderLanes = 1024;
+
+    //
+    // Tasks queued per lane, and how many a worker runs from one lane before
+    // it puts the lane back up for stealing.
+    //
+    UINT32 LaneDepth = 64;
+    UINT32 LaneBudget = 4;
+};
+
+struct WorkStealingStats {
+    UINT64 Tasks;
+    UINT64 Frames;
+    UINT64 Steals;
+    UINT64 LaneRuns;
+};
+
+//
+// Work-stealing worker pool for frame batches whose handling cost varies too
+// much for a static flow-to-worker mapping.
+//
+// The RX thread submits batches of frame handles. Each task lands in the
+// inbox (SPSC ring) of the less loaded of two workers, which moves it to its
+// own Chase-Lev deque; idle workers steal the oldest task from other
+// workers' deques. Frames and task slots go back to the RX thread over
+// per-worker done rings and are released by Reclaim(), so the RX thread stays
+// the only owner of the frame pool, as with FanOutDispatcher.
+//
+// Unordered frames may run anywhere and in any order. Frames submitted with
+// an ordering key are queued in submit order on the key's lane, and it is
+// the lane, not its individual tasks, that is scheduled: at most one
+// reference to a lane is ever in a deque or running, so a thief can only take
+// a lane as a whole and frames with the same key never run concurrently or
+// out of order.
+//
+class WorkStealingPool {
+  public:
+    using Handler = FanOutDispatcher::Handler;
+
+    static constexpr UINT32 Unordered = MAXUINT32;
+
+    explicit WorkStealingPool(const WorkStealingConfig& Config);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void Start(Handler Handle);
+
+    //
+    // Waits until every submitted task has run, then joins the workers.
+    // Frames go back to Pool, or are discarded if it is null.
+    //
+    void Stop(_Inout_opt_ UmemFramePool* Pool);
+
+    //
+    // RX thread. Submits up to MaxBatch frames; OrderKeys, if given, holds
+    // one key per frame, Unordered for frames that need no ordering. Either
+    // all frames are accepted or, if task slots or lane queues are
+    // exhausted, none are and the caller still owns them.
+    //
+    bool Submit(
+        _In_reads_(Count) const FanOutFrame* Frames,
+        UINT32 Count,
+        _In_reads_opt_(Count) const UINT32* OrderKeys = nullptr);
+
+    //
+    // RX thread. Returns the frames of finished tasks to Pool.
+    //
+    UINT32 Reclaim(_Inout_opt_ UmemFramePool* Pool);
+
+    UINT32 Workers() const { return (UINT32)State.size(); }
+    WorkStealingStats Statistics(UINT32 Worker) const;
+
+  private:
+    //
+    // A deque entry is a task slot index, or a lane index with LaneTask set.
+    //
+    static constexpr UINT32 LaneTask = 0x80000000;
+
+    struct TaskSlot {
+        UINT32 Count;
+        FanOutFrame* Frames;
+    };
+
+    struct alignas(64) Lane {
+        explicit Lane(UINT32 Depth) : Tasks(Depth) {}
+
+        SpscRing<UINT32> Tasks;
+        std::atomic<bool> Scheduled {false};
+    };
+
+    struct alignas(64) WorkerState {
+        WorkerState(UINT32 QueueSize, UINT32 Slots) : Inbox(QueueSize), Deque(QueueSize), Done(Slots) {}
+
+        SpscRing<UINT32> Inbox;
+        ChaseLevDeque<UINT32> Deque;
+        SpscRing<UINT32> Done;
+        std::thread Thread;
+
+        //
+        // Written by the RX thread.
+        //
+        bool InboxPending = false;
+
+        //
+        // Written by the worker.
+        //
+        alignas(64) std::atomic<UINT64> Tasks {0};
+        std::atomic<UINT64> Frames {0};
+        std::atomic<UINT64> Steals {0};
+        std::atomic<UINT64> LaneRuns {0};
+    };
+
+    void Enqueue(UINT32 Task);
+    void Publish();
+    bool FindTask(UINT32 Worker, _Inout_ UINT32* Random, _Out_ UINT32* Task);
+    void RunSlot(UINT32 Worker, UINT32 Slot);
+    void RunLane(UINT32 Worker, UINT32 LaneIndex);
+    void WorkerThread(UINT32 Worker);
+
+    WorkStealingConfig Config;
+    std::unique_ptr<FanOutFrame[]> SlotFrames;
+    std::unique_ptr<TaskSlot[]> Slots;
+    std::vector<UINT32> FreeSlots;
+
+    //
+    // Submit() scratch: the group of each frame, and the lane and slot of
+    // each group.
+    //
+    std::vector<UINT32> FrameGroup;
+    std::vector<UINT32> GroupLane;
+    std::vector<UINT32> GroupSlot;
+
+    std::vector<std::unique_ptr<Lane>> Lanes;
+    std::vector<std::unique_ptr<WorkerState>> State;
+    UINT32 EnqueueRandom = 1;
+    Handler Handle;
+    std::atomic<bool> Stopping {false};
+    bool Running = false;
+};
@@ -0,0 +1,151 @@
+#include <windows.h>
+#include <xdpapi.h>
+
+#include <vector>
+
+#include "UdpRuleCompiler.h"
+#include "XskBackend.h"
+
+namespace {
+
+const XDP_HOOK_ID RxInspectHook = {
+    .Layer = XDP_HOOK_L2,
+    .Direction = XDP_HOOK_RX,
+    .SubLayer = XDP_HOOK_INSPECT,
+};
+
+//
+// A program handle together with the rules it was created from, which XDP
+// reads for as long as the program exists.
+//
+struct XdpRedirect {
+    HANDLE Program;
+    CompiledRuleSet Rules;
+};
+
+class XdpBackend : public XskBackend {
+  public:
+    explicit XdpBackend(_In_ const XDP_API_TABLE* XdpApi) : XdpApi(XdpApi) {}
+
+    const char* Name() const override { return "XDP for Windows"; }
+
+    HRESULT CreateSocket(_Out_ HANDLE* Socket) override { return XdpApi->XskCreate(Socket); }
+
+    void CloseSocket(HANDLE Socket) override { CloseHandle(Socket); }
+
+    _Ret_maybenull_ VOID* AllocateUmem(SIZE_T Size) override
+    {
+        return VirtualAlloc(nullptr, Size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    }
+
+    void FreeUmem(_In_ VOID* Memory, SIZE_T) override { VirtualFree(Memory, 0, MEM_RELEASE); }
+
+    HRESULT RegisterUmem(HANDLE Socket, const XSK_UMEM_REG& Umem) override
+    {
+        return XdpApi->XskSetSockopt(Socket, XSK_SOCKOPT_UMEM_REG, &Umem, sizeof(Umem));
+    }
+
+    HRESULT Bind(
+        HANDLE Socket,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        XSK_BIND_FLAGS Flags,
+        const XskRingSizes& Sizes) override
+    {
+        if (auto Result = XdpApi->XskBind(Socket, IfIndex, QueueId, Flags); FAILED(Result)) {
+            return Result;
+        }
+
+        const struct {
+            UINT32 Option;
+            UINT32 Size;
+        } Rings[] = {
+            {XSK_SOCKOPT_RX_RING_SIZE, Sizes.Rx},
+            {XSK_SOCKOPT_RX_FILL_RING_SIZE, Sizes.Fill},
+            {XSK_SOCKOPT_TX_RING_SIZE, Sizes.Tx},
+            {XSK_SOCKOPT_TX_COMPLETION_RING_SIZE, Sizes.Completion},
+        };
+        for (const auto& Ring : Rings) {
+            if (Ring.Size == 0) {
+                continue;
+            }
+            if (auto Result = XdpApi->XskSetSockopt(Socket, Ring.Option, &Ring.Size, sizeof(Ring.Size));
+                FAILED(Result)) {
+                return Result;
+            }
+        }
+
+        return XdpApi->XskActivate(Socket, XSK_ACTIVATE_FLAG_NONE);
+    }
+
+    HRESULT GetRingInfo(HANDLE Socket, _Out_ XSK_RING_INFO_SET* Rings) override
+    {
+        UINT32 OptionLength = sizeof(*Rings);
+        return XdpApi->XskGetSockopt(Socket, XSK_SOCKOPT_RING_INFO, Rings, &OptionLength);
+    }
+
+    HRESULT RedirectUdp(
+        HANDLE Socket,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        _In_reads_(PortCount) const UINT16* Ports,
+        UINT32 PortCount,
+        _Out_ HANDLE* Program) override
+    {
+        *Program = nullptr;
+
+        std::vector<UdpSubscription> Subscriptions(PortCount);
+        for (UINT32 i = 0; i < PortCount; i++) {
+            Subscriptions[i].DestinationPort = Ports[i];
+        }
+
+        auto Redirect = std::make_unique<XdpRedirect>();
+        HRESULT Result = UdpRuleCompiler::Compile(Subscriptions.data(), PortCount, Socket, &Redirect->Rules);
+        if (FAILED(Result)) {
+            return Result;
+        }
+
+        Result = XdpApi->XdpCreateProgram(
+            IfIndex,
+            &RxInspectHook,
+            QueueId,
+            XDP_CREATE_PROGRAM_FLAG_NONE,
+            Redirect->Rules.Rules(),
+            Redirect->Rules.RuleCount(),
+            &Redirect->Program);
+        if (FAILED(Result)) {
+            return Result;
+        }
+
+        *Program = Redirect.release();
+        return S_OK;
+    }
+
+    void CloseProgram(HANDLE Program) override
+    {
+        XdpRedirect* Redirect = (XdpRedirect*)Program;
+        CloseHandle(Redirect->Program);
+        delete Redirect;
+    }
+
+    HRESULT Notify(
+        HANDLE Socket,
+        XSK_NOTIFY_FLAGS Flags,
+        UINT32 TimeoutMs,
+        _Out_ XSK_NOTIFY_RESULT_FLAGS* Result) override
+    {
+        return XdpApi->XskNotifySocket(Socket, Flags, TimeoutMs, Result);
+    }
+
+    bool NeedsPoke(const XSK_RING* Ring) const override { return XskRingProducerNeedPoke(Ring); }
+
+  private:
+    const XDP_API_TABLE* XdpApi;
+};
+
+} // namespace
+
+std::unique_ptr<XskBackend> CreateXdpBackend(_In_ const XDP_API_TABLE* XdpApi)
+{
+    return std::make_unique<XdpBackend>(XdpApi);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <windows.h>
+#include <afxdp_helper.h>
+
+#include <memory>
+
+typedef struct _XDP_API_TABLE XDP_API_TABLE;
+
+//
+// Descriptor count of each ring a socket asks for. A zero leaves the ring
+// out; every size must otherwise be a power of two.
+//
+struct XskRingSizes {
+    UINT32 Rx;
+    UINT32 Fill;
+    UINT32 Tx;
+    UINT32 Completion;
+};
+
+//
+// The AF_XDP control path of one operating system: what the receive path
+// needs to get from a UMEM to a set of rings with traffic redirected onto
+// them. Once bound, rings use the XSK_RING_INFO layout on every backend, so
+// afxdp_helper.h and everything built on it (frame pools, fill refillers,
+// burst pipelines) run unchanged; only the control calls go through here.
+//
+// A socket is set up in this order: CreateSocket, RegisterUmem, Bind,
+// GetRingInfo, then RedirectUdp to steer traffic to it.
+//
+class XskBackend {
+  public:
+    virtual ~XskBackend() = default;
+
+    virtual const char* Name() const = 0;
+
+    virtual HRESULT CreateSocket(_Out_ HANDLE* Socket) = 0;
+    virtual void CloseSocket(HANDLE Socket) = 0;
+
+    //
+    // Page-aligned memory for a UMEM of Size bytes, and its release.
+    //
+    virtual _Ret_maybenull_ VOID* AllocateUmem(SIZE_T Size) = 0;
+    virtual void FreeUmem(_In_ VOID* Memory, SIZE_T Size) = 0;
+
+    virtual HRESULT RegisterUmem(HANDLE Socket, const XSK_UMEM_REG& Umem) = 0;
+
+    //
+    // Binds Socket to QueueId of IfIndex with rings of the given sizes. The
+    // rings exist and traffic can flow once this returns.
+    //
+    virtual HRESULT Bind(
+        HANDLE Socket,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        XSK_BIND_FLAGS Flags,
+        const XskRingSizes& Sizes) = 0;
+
+    virtual HRESULT GetRingInfo(HANDLE Socket, _Out_ XSK_RING_INFO_SET* Rings) = 0;
+
+    //
+    // Redirects UDP frames to any of Ports (host byte order) arriving on
+    // QueueId of IfIndex to Socket; everything else goes on to the stack.
+    // The redirect lasts until the returned program is closed.
+    //
+    virtual HRESULT RedirectUdp(
+        HANDLE Socket,
+        UINT32 IfIndex,
+        UINT32 QueueId,
+        _In_reads_(PortCount) const UINT16* Ports,
+        UINT32 PortCount,
+        _Out_ HANDLE* Program) = 0;
+    virtual void CloseProgram(HANDLE Program) = 0;
+
+    //
+    // Pokes and waits with XskNotifySocket semantics.
+    //
+    virtual HRESULT Notify(
+        HANDLE Socket,
+        XSK_NOTIFY_FLAGS Flags,
+        UINT32 TimeoutMs,
+        _Out_ XSK_NOTIFY_RESULT_FLAGS* Result) = 0;
+
+    //
+    // Whether the kernel asks to be poked before it looks at Ring again. The
+    // flag bit differs between systems.
+    //
+    virtual bool NeedsPoke(const XSK_RING* Ring) const = 0;
+};
+
+//
+// XDP for Windows through its API table: sockets from XskCreate, redirects
+// from XdpCreateProgram at the L2 inspect hook.
+//
+std::unique_ptr<XskBackend> CreateXdpBackend(_In_ const XDP_API_TABLE* XdpApi);
+
+#if defined(__linux__)
+//
+// Linux AF_XDP: socket(AF_XDP), rings mapped from the socket, and an XDP
+// program redirecting into an XSKMAP.
+//
+std::unique_ptr<XskBackend> CreateAfXdpBackend();
+#endif
+
+//
+// The fallback for hosts without XDP, or where its use is denied: ordinary
+// UDP sockets, one per redirected port, received in batches into the UMEM
+// behind synthesized Ethernet, IPv4 and UDP headers and posted on rings
+// kept in process memory. Registered I/O on Windows, recvmmsg() with
+// SO_BUSY_POLL on Linux. Receive only; the caller's pokes and waits do the
+// receiving, so NeedsPoke() is always true.
+//
+std::unique_ptr<XskBackend> CreateSocketBackend();
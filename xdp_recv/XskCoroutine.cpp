@@ -0,0 +1,87 @@
+#include <windows.h>
+
+#include <memory>
+#include <new>
+
+#include "XskCoroutine.h"
+
+namespace {
+
+struct FrameArena {
+    union Block {
+        Block* Next;
+        alignas(std::max_align_t) UCHAR Bytes[CoroutineFrameArena::BlockSize];
+    };
+
+    std::unique_ptr<Block[]> Blocks;
+    Block* FreeList = nullptr;
+    UINT64 HeapFallbacks = 0;
+
+    bool Owns(const VOID* Frame) const
+    {
+        return Blocks && Frame >= Blocks.get() && Frame < Blocks.get() + CoroutineFrameArena::BlockCount;
+    }
+};
+
+thread_local FrameArena Arena;
+
+} // namespace
+
+VOID* CoroutineFrameArena::Allocate(SIZE_T Size)
+{
+    if (!Arena.Blocks) {
+        Arena.Blocks = std::make_unique<FrameArena::Block[]>(BlockCount);
+        for (UINT32 i = 0; i < BlockCount; i++) {
+            Arena.Blocks[i].Next = i + 1 < BlockCount ? &Arena.Blocks[i + 1] : nullptr;
+        }
+        Arena.FreeList = &Arena.Blocks[0];
+    }
+
+    if (Size <= BlockSize && Arena.FreeList != nullptr) {
+        FrameArena::Block* Frame = Arena.FreeList;
+        Arena.FreeList = Frame->Next;
+        return Frame;
+    }
+
+    Arena.HeapFallbacks++;
+    return ::operator new(Size);
+}
+
+void CoroutineFrameArena::Free(_In_ VOID* Frame, SIZE_T Size)
+{
+    if (Arena.Owns(Frame)) {
+        FrameArena::Block* Block = (FrameArena::Block*)Frame;
+        Block->Next = Arena.FreeList;
+        Arena.FreeList = Block;
+    } else {
+        ::operator delete(Frame, Size);
+    }
+}
+
+UINT64 CoroutineFrameArena::HeapFallbacks()
+{
+    return Arena.HeapFallbacks;
+}
+
+HRESULT XskCoroutineScheduler::Attach(_In_ XskAwaitableSocket* Socket)
+{
+    //
+    // A notification resumes the coroutine waiting on the socket, which runs
+    // until it waits again. If it yielded with frames left on the ring it is
+    // resumed on the next pass; otherwise the socket is rearmed. A socket
+    // whose coroutine has returned is dropped.
+    //
+    return Reactor.Add(Socket->Handle(), XSK_NOTIFY_FLAG_WAIT_RX, [Socket](XSK_NOTIFY_RESULT_FLAGS) {
+        std::coroutine_handle<> Waiter = Socket->Waiter;
+        if (!Waiter) {
+            return XskDrainResult::Detach;
+        }
+        Socket->Waiter = nullptr;
+        Waiter.resume();
+
+        if (!Socket->Waiter) {
+            return XskDrainResult::Detach;
+        }
+        return Socket->Yielded ? XskDrainResult::More : XskDrainResult::Idle;
+    });
+}
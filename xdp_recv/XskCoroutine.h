@@ -0,0 +1,218 @@
+#pragma once
+
+#include <windows.h>
+#include <xdpapi.h>
+#include <afxdp_helper.h>
+
+#include <coroutine>
+#include <exception>
+
+#include "XskReactor.h"
+
+//
+// Fixed-size blocks for coroutine frames, one arena per thread, so starting
+// a receive coroutine does not go to the heap either. A frame larger than a
+// block, or one started after the arena ran out, comes from operator new and
+// is counted. Frames must be destroyed on the thread that started them.
+//
+class CoroutineFrameArena {
+  public:
+    static constexpr SIZE_T BlockSize = 1024;
+    static constexpr UINT32 BlockCount = 256;
+
+    static VOID* Allocate(SIZE_T Size);
+    static void Free(_In_ VOID* Frame, SIZE_T Size);
+
+    //
+    // Frames of the calling thread that did not fit in the arena.
+    //
+    static UINT64 HeapFallbacks();
+};
+
+class XskCoroutineScheduler;
+
+//
+// Return type of a receive coroutine. The coroutine starts running at the
+// call and runs until its first suspension; its first parameter must be
+// the scheduler that resumes it, which counts it as live until it returns.
+//
+//     XskTask Receive(XskCoroutineScheduler& Scheduler, XskAwaitableSocket& Socket)
+//     {
+//         for (;;) {
+//             XskRxBurst Burst = co_await Socket.ReceiveBurst(32);
+//             ...
+//             Socket.Release(Burst);
+//         }
+//     }
+//
+class XskTask {
+  public:
+    struct promise_type {
+        template <typename... Args>
+        promise_type(XskCoroutineScheduler& Scheduler, Args&&...);
+        ~promise_type();
+
+        XskTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static VOID* operator new(SIZE_T Size) { return CoroutineFrameArena::Allocate(Size); }
+        static void operator delete(VOID* Frame, SIZE_T Size) { CoroutineFrameArena::Free(Frame, Size); }
+
+        XskCoroutineScheduler* Scheduler;
+    };
+};
+
+//
+// Received frames of one burst: Count descriptors of the RX ring, starting
+// at Index. Count is zero only if the socket was woken without frames.
+//
+struct XskRxBurst {
+    XSK_RING* Ring;
+    UINT32 Index;
+    UINT32 Count;
+
+    const XSK_BUFFER_DESCRIPTOR& operator[](UINT32 i) const
+    {
+        return *(const XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(Ring, Index + i);
+    }
+};
+
+//
+// An AF_XDP socket's RX ring as something a coroutine can wait on.
+//
+// co_await ReceiveBurst() returns at once, without suspending, while the
+// ring has frames: in steady state it is the same ring read as a hand
+// written loop. Only an empty ring suspends the coroutine, into an
+// XskNotifyAsync wait on the scheduler's completion port. After MaxStreak
+// bursts in a row the coroutine yields to the scheduler anyway, so one busy
+// socket cannot keep the others from running.
+//
+class XskAwaitableSocket {
+  public:
+    static constexpr UINT32 DefaultMaxStreak = 16;
+
+    XskAwaitableSocket(HANDLE Socket, _In_ XSK_RING* RxRing, UINT32 MaxStreak = DefaultMaxStreak)
+        : Socket(Socket), RxRing(RxRing), MaxStreak(MaxStreak)
+    {
+    }
+
+    XskAwaitableSocket(const XskAwaitableSocket&) = delete;
+    XskAwaitableSocket& operator=(const XskAwaitableSocket&) = delete;
+
+    class BurstAwaiter {
+      public:
+        BurstAwaiter(_In_ XskAwaitableSocket* Owner, UINT32 MaxFrames) : Owner(Owner), MaxFrames(MaxFrames) {}
+
+        bool await_ready()
+        {
+            Burst.Ring = Owner->RxRing;
+            Burst.Count = XskRingConsumerReserve(Owner->RxRing, MaxFrames, &Burst.Index);
+            if (Burst.Count != 0 && Owner->Streak < Owner->MaxStreak) {
+                Owner->Streak++;
+                return true;
+            }
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> Handle)
+        {
+            Owner->Waiter = Handle;
+            Owner->Yielded = Burst.Count != 0;
+            Owner->Streak = 0;
+        }
+
+        XskRxBurst await_resume()
+        {
+            if (Owner->Streak == 0) {
+                Burst.Count = XskRingConsumerReserve(Owner->RxRing, MaxFrames, &Burst.Index);
+                Owner->Streak = 1;
+            }
+            return Burst;
+        }
+
+      private:
+        XskAwaitableSocket* Owner;
+        UINT32 MaxFrames;
+        XskRxBurst Burst;
+    };
+
+    BurstAwaiter ReceiveBurst(UINT32 MaxFrames) { return BurstAwaiter(this, MaxFrames); }
+
+    //
+    // Hands the burst's descriptors back to the RX ring.
+    //
+    void Release(const XskRxBurst& Burst) { XskRingConsumerRelease(RxRing, Burst.Count); }
+
+    HANDLE Handle() const { return Socket; }
+    XSK_RING* Rx() const { return RxRing; }
+
+  private:
+    friend class XskCoroutineScheduler;
+
+    HANDLE Socket;
+    XSK_RING* RxRing;
+    UINT32 MaxStreak;
+    UINT32 Streak = 0;
+
+    //
+    // The coroutine suspended on the socket, and whether it left frames on
+    // the ring when it did.
+    //
+    std::coroutine_handle<> Waiter;
+    bool Yielded = false;
+};
+
+//
+// Resumes receive coroutines as their RX rings fill, on an XskReactor. Run
+// returns once every XskTask started on the scheduler has returned, or
+// after Stop.
+//
+class XskCoroutineScheduler {
+  public:
+    explicit XskCoroutineScheduler(_In_ const XDP_API_TABLE* XdpApi, const XskReactorConfig& Config = {})
+        : Reactor(XdpApi, Config)
+    {
+    }
+
+    HRESULT Open() { return Reactor.Open(); }
+
+    //
+    // Serves Socket, which must outlive the scheduler. Start the socket's
+    // coroutine first: a socket with no coroutine waiting on it is dropped.
+    //
+    HRESULT Attach(_In_ XskAwaitableSocket* Socket);
+
+    HRESULT Run() { return LiveTasks != 0 ? Reactor.Run() : S_OK; }
+    void Stop() { Reactor.Stop(); }
+
+    UINT32 TaskCount() const { return LiveTasks; }
+    const XskReactorStats& Statistics() const { return Reactor.Statistics(); }
+
+  private:
+    friend struct XskTask::promise_type;
+
+    void TaskStarted() { LiveTasks++; }
+    void TaskFinished()
+    {
+        if (--LiveTasks == 0) {
+            Reactor.Stop();
+        }
+    }
+
+    XskReactor Reactor;
+    UINT32 LiveTasks = 0;
+};
+
+template <typename... Args>
+XskTask::promise_type::promise_type(XskCoroutineScheduler& Scheduler, Args&&...) : Scheduler(&Scheduler)
+{
+    Scheduler.TaskStarted();
+}
+
+inline XskTask::promise_type::~promise_type()
+{
+    Scheduler->TaskFinished();
+}
@@ -0,0 +1,214 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+
+#include "Benchmarks.h"
+#include "FillRingRefiller.h"
+#include "PacketHeaders.h"
+#include "SoftwareXdp.h"
+#include "SoftwareXsk.h"
+#include "TscClock.h"
+#include "UmemFramePool.h"
+#include "XskCoroutine.h"
+
+static constexpr UINT32 BenchRingSize = 1024;
+static constexpr UINT32 BenchChunkSize = 2048;
+static constexpr UINT32 BenchChunks = 2 * BenchRingSize;
+static constexpr UINT32 BenchFrameLength = 64;
+
+//
+// One socket and the NIC feeding it, driven from the receiving thread: each
+// step delivers a burst, so the ring always has one waiting.
+//
+struct CoroutineBenchSocket {
+    CoroutineBenchSocket()
+        : Umem(std::make_unique<UCHAR[]>((UINT64)BenchChunks * BenchChunkSize))
+        , Xsk(Umem.get(), (UINT64)BenchChunks * BenchChunkSize, BenchChunkSize, BenchRingSize)
+        , Pool(BenchChunks)
+        , Refiller(InitializeRings(), &Pool, BenchRingSize / 2)
+    {
+        Pool.AddRegion(0, BenchChunks, BenchChunkSize);
+        Refiller.Refill();
+        BuildUdpFrame(Frame, sizeof(Frame), 0x0a000001, 10000, 0xef000001, 5000);
+    }
+
+    XSK_RING* InitializeRings()
+    {
+        XskRingInitialize(&Rx, &Xsk.RingInfo().Rx);
+        XskRingInitialize(&Fill, &Xsk.RingInfo().Fill);
+        return &Fill;
+    }
+
+    void Deliver(UINT32 Count)
+    {
+        for (UINT32 i = 0; i < Count; i++) {
+            Xsk.Deliver(Frame, sizeof(Frame));
+        }
+    }
+
+    //
+    // The handler: read each frame's first word, give its chunk back.
+    //
+    UINT64 Handle(UINT32 Index, UINT32 Count)
+    {
+        UINT64 Sum = 0;
+        for (UINT32 i = 0; i < Count; i++) {
+            const XSK_BUFFER_DESCRIPTOR* Descriptor = (const XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&Rx, Index + i);
+            UINT64 Word;
+            memcpy(&Word, Umem.get() + Descriptor->Address.BaseAddress + Descriptor->Address.Offset, sizeof(Word));
+            Sum += Word + Descriptor->Length;
+            Pool.Free(Descriptor->Address.BaseAddress);
+        }
+        return Sum;
+    }
+
+    std::unique_ptr<UCHAR[]> Umem;
+    SoftwareXsk Xsk;
+    XSK_RING Rx;
+    XSK_RING Fill;
+    UmemFramePool Pool;
+    FillRingRefiller Refiller;
+    UCHAR Frame[BenchFrameLength];
+};
+
+static UINT64 HandWrittenLoop(_Inout_ CoroutineBenchSocket* Socket, UINT64 Frames, UINT32 Burst)
+{
+    UINT64 Sum = 0;
+    for (UINT64 Received = 0; Received < Frames;) {
+        Socket->Deliver(Burst);
+
+        UINT32 Index;
+        UINT32 Count = XskRingConsumerReserve(&Socket->Rx, Burst, &Index);
+        if (Count == 0) {
+            continue;
+        }
+        Sum += Socket->Handle(Index, Count);
+        XskRingConsumerRelease(&Socket->Rx, Count);
+        Socket->Refiller.Refill();
+        Received += Count;
+    }
+    return Sum;
+}
+
+//
+// Scheduler is only read by the promise, which counts the coroutine as live
+// on it (see XskTask).
+//
+static XskTask ReceiveCoroutine(
+    XskCoroutineScheduler& Scheduler,
+    CoroutineBenchSocket& Socket,
+    XskAwaitableSocket& Awaitable,
+    UINT64 Frames,
+    UINT32 Burst,
+    UINT64& Sum)
+{
+    UNREFERENCED_PARAMETER(Scheduler);
+
+    for (UINT64 Received = 0; Received < Frames;) {
+        Socket.Deliver(Burst);
+
+        XskRxBurst Rx = co_await Awaitable.ReceiveBurst(Burst);
+        Sum += Socket.Handle(Rx.Index, Rx.Count);
+        Awaitable.Release(Rx);
+        Socket.Refiller.Refill();
+        Received += Rx.Count;
+    }
+}
+
+//
+// Runs Frames through the coroutine with at most MaxStreak bursts between
+// trips through the scheduler. Returns ns per frame.
+//
+static double RunCoroutine(
+    const TscClock& Clock,
+    UINT64 Frames,
+    UINT32 Burst,
+    UINT32 MaxStreak,
+    _Out_ UINT64* Sum,
+    _Out_ UINT64* Resumes)
+{
+    CoroutineBenchSocket Socket;
+    XskAwaitableSocket Awaitable((HANDLE)&Socket.Xsk, &Socket.Rx, MaxStreak);
+
+    XskReactorConfig Config;
+    Config.Associate = &SoftwareXsk::AssociateCompletionPort;
+    XskCoroutineScheduler Scheduler(SoftwareXdpHook::ApiTable(), Config);
+    if (FAILED(Scheduler.Open())) {
+        return 0.0;
+    }
+
+    *Sum = 0;
+    UINT64 Start = Clock.NowOrdered();
+    ReceiveCoroutine(Scheduler, Socket, Awaitable, Frames, Burst, *Sum);
+    if (Scheduler.TaskCount() != 0) {
+        Scheduler.Attach(&Awaitable);
+        Scheduler.Run();
+    }
+    UINT64 Ns = Clock.TicksToNs(Clock.NowOrdered() - Start);
+
+    Socket.Xsk.CancelNotify();
+    *Resumes = Scheduler.Statistics().Drains;
+    return (double)Ns / Frames;
+}
+
+//
+// Receive cost per frame of a coroutine awaiting bursts against the same
+// loop written by hand, in steady state and when yielding to the scheduler
+// every few bursts.
+//
+int XskCoroutineBenchmark(int argc, char** argv)
+{
+    UINT64 Frames = argc >= 1 ? strtoull(argv[0], nullptr, 10) : 20000000;
+    UINT32 Burst = argc >= 2 ? atoi(argv[1]) : 32;
+
+    if (Frames == 0 || Burst == 0 || Burst > BenchRingSize / 2) {
+        fprintf(stderr, "frames must be positive and burst 1 to %u\n", BenchRingSize / 2);
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    printf(
+        "%llu frames of %u bytes in bursts of %u, best of 3\n\n", (unsigned long long)Frames, BenchFrameLength, Burst);
+    printf("%-28s %10s %10s %10s\n", "receiver", "ns/frame", "vs hand", "resumes");
+
+    double Baseline = 0;
+    UINT64 Expected = 0;
+    for (UINT32 Run = 0; Run < 3; Run++) {
+        CoroutineBenchSocket Socket;
+        UINT64 Start = Clock.NowOrdered();
+        UINT64 Sum = HandWrittenLoop(&Socket, Frames, Burst);
+        double Ns = (double)Clock.TicksToNs(Clock.NowOrdered() - Start) / Frames;
+        Baseline = Run == 0 || Ns < Baseline ? Ns : Baseline;
+        Expected = Sum;
+    }
+    printf("%-28s %10.2f %9.2fx %10u\n", "hand-written loop", Baseline, 1.0, 0);
+
+    static const struct {
+        const char* Name;
+        UINT32 MaxStreak;
+    } Variants[] = {
+        {"co_await, never yields", MAXUINT32},
+        {"co_await, yields every 16", 16},
+        {"co_await, yields every burst", 1},
+    };
+    for (const auto& Variant : Variants) {
+        double Best = 0;
+        UINT64 Resumes = 0;
+        for (UINT32 Run = 0; Run < 3; Run++) {
+            UINT64 Sum;
+            double Ns = RunCoroutine(Clock, Frames, Burst, Variant.MaxStreak, &Sum, &Resumes);
+            if (Sum != Expected) {
+                fprintf(stderr, "%s received different frames\n", Variant.Name);
+                return EXIT_FAILURE;
+            }
+            Best = Run == 0 || Ns < Best ? Ns : Best;
+        }
+        printf("%-28s %10.2f %9.2fx %10llu\n", Variant.Name, Best, Best / Baseline, (unsigned long long)Resumes);
+    }
+
+    printf("\ncoroutine frames from the heap: %llu\n", (unsigned long long)CoroutineFrameArena::HeapFallbacks());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,210 @@
+#include <windows.h>
+#include <xdpapi.h>
+
+#include "XskReactor.h"
+
+//
+// Completion key of the packet Stop posts; sockets use their Source.
+//
+static constexpr ULONG_PTR StopKey = 0;
+
+XskReactor::XskReactor(_In_ const XDP_API_TABLE* XdpApi, const XskReactorConfig& Config)
+    : XdpApi(XdpApi), Config(Config)
+{
+    if (this->Config.MaxEvents == 0) {
+        this->Config.MaxEvents = 1;
+    }
+}
+
+XskReactor::~XskReactor()
+{
+    if (Port == nullptr) {
+        return;
+    }
+
+    //
+    // Outstanding waits write to their OVERLAPPED when they complete, so
+    // each is cancelled and its completion collected before the memory goes.
+    //
+    UINT32 Armed = 0;
+    for (const auto& Socket : Sources) {
+        if (Socket->Armed) {
+            CancelIoEx(Socket->Socket, &Socket->Overlapped);
+            Armed++;
+        }
+    }
+    while (Armed > 0) {
+        ULONG Removed;
+        if (!GetQueuedCompletionStatusEx(Port, Events.get(), Config.MaxEvents, &Removed, 1000, FALSE)) {
+            break;
+        }
+        for (ULONG i = 0; i < Removed; i++) {
+            if (Events[i].lpCompletionKey != StopKey) {
+                ((Source*)Events[i].lpCompletionKey)->Armed = false;
+                Armed--;
+            }
+        }
+    }
+
+    CloseHandle(Port);
+}
+
+HRESULT XskReactor::Open()
+{
+    Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+    if (Port == nullptr) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+    Events = std::make_unique<OVERLAPPED_ENTRY[]>(Config.MaxEvents);
+    return S_OK;
+}
+
+HRESULT XskReactor::Add(HANDLE Socket, XSK_NOTIFY_FLAGS Wait, DrainFn Drain)
+{
+    auto Entry = std::make_unique<Source>();
+    Entry->Socket = Socket;
+    Entry->Wait = Wait;
+    Entry->Drain = std::move(Drain);
+
+    HANDLE Associated = Config.Associate != nullptr ? Config.Associate(Socket, Port, (ULONG_PTR)Entry.get(), 0)
+                                                    : CreateIoCompletionPort(Socket, Port, (ULONG_PTR)Entry.get(), 0);
+    if (Associated == nullptr) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    Source* Added = Entry.get();
+    Sources.push_back(std::move(Entry));
+    return Arm(Added);
+}
+
+HRESULT XskReactor::Arm(_Inout_ Source* Socket)
+{
+    //
+    // A wait whose rings are already ready succeeds at once, but its
+    // completion is still queued to the port like a pending one, so both
+    // are handled there.
+    //
+    Socket->Overlapped = {};
+    HRESULT Result = XdpApi->XskNotifyAsync(Socket->Socket, Socket->Wait, &Socket->Overlapped);
+    if (FAILED(Result) && Result != HRESULT_FROM_WIN32(ERROR_IO_PENDING)) {
+        return Result;
+    }
+    Socket->Armed = true;
+    Stats.Arms++;
+    return S_OK;
+}
+
+HRESULT XskReactor::Dequeue(DWORD TimeoutMs, _Out_ ULONG* Removed)
+{
+    if (!GetQueuedCompletionStatusEx(Port, Events.get(), Config.MaxEvents, Removed, TimeoutMs, FALSE)) {
+        DWORD Error = GetLastError();
+        *Removed = 0;
+        if (Error != WAIT_TIMEOUT) {
+            return HRESULT_FROM_WIN32(Error);
+        }
+    }
+    return S_OK;
+}
+
+HRESULT XskReactor::RunOnce(UINT32 TimeoutMs)
+{
+    HRESULT ArmResult;
+    if (HRESULT Result = Pass(TimeoutMs, &ArmResult); FAILED(Result)) {
+        return Result;
+    }
+    return ArmResult;
+}
+
+//
+// One pass of RunOnce. Returns the port's error; the first error rearming a
+// socket goes to ArmResult.
+//
+HRESULT XskReactor::Pass(UINT32 TimeoutMs, _Out_ HRESULT* ArmResult)
+{
+    *ArmResult = S_OK;
+
+    //
+    // Look without waiting first, so that only a wait that found the port
+    // empty counts as a sleep.
+    //
+    ULONG Removed;
+    if (HRESULT Result = Dequeue(0, &Removed); FAILED(Result)) {
+        return Result;
+    }
+    if (Removed == 0 && Requeued.empty() && TimeoutMs != 0) {
+        Stats.Sleeps++;
+        if (HRESULT Result = Dequeue(TimeoutMs, &Removed); FAILED(Result)) {
+            return Result;
+        }
+    }
+
+    for (ULONG i = 0; i < Removed; i++) {
+        if (Events[i].lpCompletionKey == StopKey) {
+            Stopping = true;
+            continue;
+        }
+
+        Source* Socket = (Source*)Events[i].lpCompletionKey;
+        XSK_NOTIFY_RESULT_FLAGS Flags;
+        Socket->Armed = false;
+        Stats.Notifications++;
+        if (FAILED(XdpApi->XskGetNotifyAsyncResult(&Socket->Overlapped, &Flags))) {
+            Flags = XSK_NOTIFY_RESULT_FLAG_NONE;
+        }
+        Socket->Ready = Flags;
+        Draining.push_back(Socket);
+    }
+
+    //
+    // Sockets that still had frames after their last drain go behind the
+    // ones that became ready meanwhile.
+    //
+    Draining.insert(Draining.end(), Requeued.begin(), Requeued.end());
+    Requeued.clear();
+
+    //
+    // A socket whose wait cannot be rearmed is drained again on the next
+    // pass, which retries the wait; the rest of this pass still runs.
+    //
+    for (Source* Socket : Draining) {
+        Stats.Drains++;
+        switch (Socket->Drain(Socket->Ready)) {
+        case XskDrainResult::Idle:
+            if (HRESULT Result = Arm(Socket); FAILED(Result)) {
+                Stats.ArmFailures++;
+                Requeued.push_back(Socket);
+                if (SUCCEEDED(*ArmResult)) {
+                    *ArmResult = Result;
+                }
+            }
+            break;
+
+        case XskDrainResult::More:
+            Stats.Requeues++;
+            Requeued.push_back(Socket);
+            break;
+
+        case XskDrainResult::Detach:
+            Stats.Detached++;
+            break;
+        }
+    }
+    Draining.clear();
+    return S_OK;
+}
+
+HRESULT XskReactor::Run()
+{
+    while (!Stopping) {
+        HRESULT ArmResult;
+        if (HRESULT Result = Pass(INFINITE, &ArmResult); FAILED(Result)) {
+            return Result;
+        }
+    }
+    return S_OK;
+}
+
+void XskReactor::Stop()
+{
+    PostQueuedCompletionStatus(Port, 0, StopKey, nullptr);
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <windows.h>
+#include <xdpapi.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+using XskAssociateFn = HANDLE(HANDLE Socket, HANDLE Port, ULONG_PTR Key, DWORD Threads);
+
+struct XskReactorConfig {
+    //
+    // Completions taken off the port per wait.
+    //
+    UINT32 MaxEvents = 64;
+
+    //
+    // Associates a socket with the port. Null means CreateIoCompletionPort;
+    // software sockets supply their own.
+    //
+    XskAssociateFn* Associate = nullptr;
+};
+
+enum class XskDrainResult {
+    //
+    // The rings are empty; wait for the next notification.
+    //
+    Idle,
+
+    //
+    // Frames are left over; drain again on the next pass, after the other
+    // ready sockets, without waiting.
+    //
+    More,
+
+    //
+    // Stop serving the socket.
+    //
+    Detach,
+};
+
+struct XskReactorStats {
+    //
+    // Waits on the port that found nothing ready and blocked.
+    //
+    UINT64 Sleeps;
+    UINT64 Notifications;
+    UINT64 Drains;
+
+    //
+    // Drains that stopped at their batch limit with frames left, so the
+    // socket was drained again on the next pass instead of rearmed.
+    //
+    UINT64 Requeues;
+    UINT64 Arms;
+
+    //
+    // Waits that could not be rearmed; the socket is drained again on the
+    // next pass, which retries the wait.
+    //
+    UINT64 ArmFailures;
+    UINT64 Detached;
+};
+
+//
+// Event loop over many AF_XDP sockets on one IO completion port. Every idle
+// socket has an XskNotifyAsync wait outstanding for the rings it cares
+// about; the thread sleeps in GetQueuedCompletionStatusEx until one of them
+// completes, drains the sockets that are ready a batch each, round robin,
+// and rearms the ones it emptied. A handful of busy sockets cannot starve
+// the rest, and a thread serves dozens of low-rate sockets without polling
+// any of them.
+//
+// Not thread safe: Add, RunOnce and Run belong to the reactor's thread;
+// Stop may be called from any thread.
+//
+class XskReactor {
+  public:
+    //
+    // Drains up to a batch from a socket's rings. Ready holds the rings XDP
+    // reported ready on the last notification.
+    //
+    using DrainFn = std::function<XskDrainResult(XSK_NOTIFY_RESULT_FLAGS Ready)>;
+
+    explicit XskReactor(_In_ const XDP_API_TABLE* XdpApi, const XskReactorConfig& Config = {});
+    ~XskReactor();
+
+    XskReactor(const XskReactor&) = delete;
+    XskReactor& operator=(const XskReactor&) = delete;
+
+    HRESULT Open();
+
+    //
+    // Associates Socket with the port and arms a wait for the rings in Wait,
+    // XSK_NOTIFY_FLAG_WAIT_RX, XSK_NOTIFY_FLAG_WAIT_TX or both. The socket
+    // must stay open until the reactor is destroyed.
+    //
+    HRESULT Add(HANDLE Socket, XSK_NOTIFY_FLAGS Wait, DrainFn Drain);
+
+    //
+    // Takes the completed notifications off the port, waiting up to
+    // TimeoutMs if no socket is ready, and gives every ready socket one
+    // drain. Returns the first error rearming a socket, after the whole pass.
+    //
+    HRESULT RunOnce(UINT32 TimeoutMs);
+
+    //
+    // Runs until Stop is called or waiting on the port fails. Sockets that
+    // cannot be rearmed are counted in ArmFailures and retried.
+    //
+    HRESULT Run();
+    void Stop();
+
+    UINT32 SocketCount() const { return (UINT32)Sources.size(); }
+    const XskReactorStats& Statistics() const { return Stats; }
+
+  private:
+    struct Source {
+        OVERLAPPED Overlapped;
+        HANDLE Socket;
+        XSK_NOTIFY_FLAGS Wait;
+        DrainFn Drain;
+        XSK_NOTIFY_RESULT_FLAGS Ready;
+        bool Armed;
+    };
+
+    HRESULT Arm(_Inout_ Source* Socket);
+    HRESULT Pass(UINT32 TimeoutMs, _Out_ HRESULT* ArmResult);
+    HRESULT Dequeue(DWORD TimeoutMs, _Out_ ULONG* Removed);
+
+    const XDP_API_TABLE* XdpApi;
+    XskReactorConfig Config;
+    HANDLE Port = nullptr;
+    std::unique_ptr<OVERLAPPED_ENTRY[]> Events;
+    std::vector<std::unique_ptr<Source>> Sources;
+
+    //
+    // Sockets to drain on this pass, and those left over for the next.
+    //
+    std::vector<Source*> Draining;
+    std::vector<Source*> Requeued;
+
+    bool Stopping = false;
+    XskReactorStats Stats {};
+};
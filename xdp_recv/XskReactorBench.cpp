@@ -0,0 +1,268 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "LatencyHistogram.h"
+#include "PacketHeaders.h"
+#include "SharedUmem.h"
+#include "SoftwareXdp.h"
+#include "SoftwareXsk.h"
+#include "TscClock.h"
+#include "XskReactor.h"
+
+static constexpr UINT32 BenchRingSize = 256;
+static constexpr UINT32 BenchChunkSize = 2048;
+static constexpr UINT32 BenchFrameLength = 128;
+static constexpr UINT32 BenchDrainBatch = 32;
+static constexpr UINT32 PayloadOffset = sizeof(EthernetHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader);
+
+struct ReactorRunResult {
+    LatencyHistogram<> WakeupNs;
+    double CpuCores;
+    UINT64 Received;
+    UINT64 Dropped;
+    UINT64 Notifications;
+};
+
+static UINT64 ThreadCpuNs()
+{
+    FILETIME Creation, Exit, Kernel, User;
+    if (!GetThreadTimes(GetCurrentThread(), &Creation, &Exit, &Kernel, &User)) {
+        return 0;
+    }
+    UINT64 Total = ((UINT64)Kernel.dwHighDateTime << 32 | Kernel.dwLowDateTime) +
+                   ((UINT64)User.dwHighDateTime << 32 | User.dwLowDateTime);
+    return Total * 100;
+}
+
+//
+// Takes up to a batch of frames off a socket's RX ring, records how long
+// after the NIC stamped them they were seen, and returns the chunks to the
+// fill ring. Returns the number of frames taken.
+//
+static UINT32 DrainRx(
+    const TscClock& Clock,
+    _In_ const UCHAR* Umem,
+    _Inout_ SharedUmemSocket* Socket,
+    _Inout_ LatencyHistogram<>* WakeupNs)
+{
+    UINT32 Index;
+    UINT32 Count = XskRingConsumerReserve(Socket->Rx(), BenchDrainBatch, &Index);
+    if (Count == 0) {
+        return 0;
+    }
+
+    UINT64 Now = Clock.Now();
+    for (UINT32 i = 0; i < Count; i++) {
+        const XSK_BUFFER_DESCRIPTOR* Descriptor =
+            (const XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(Socket->Rx(), Index + i);
+        const UCHAR* Data = Umem + Descriptor->Address.BaseAddress + Descriptor->Address.Offset;
+        UINT64 Stamp;
+        memcpy(&Stamp, Data + PayloadOffset, sizeof(Stamp));
+        WakeupNs->Record(Now > Stamp ? Clock.TicksToNs(Now - Stamp) : 0);
+        Socket->Pool()->Free(Descriptor->Address.BaseAddress);
+    }
+    XskRingConsumerRelease(Socket->Rx(), Count);
+    Socket->Refill();
+    return Count;
+}
+
+//
+// Low-rate traffic spread over every socket: exponential gaps at the total
+// rate, each frame to a random socket, stamped with the TSC when delivered.
+// Runs on its own thread until Until.
+//
+static void GenerateTraffic(
+    const TscClock& Clock,
+    std::vector<std::unique_ptr<SoftwareXsk>>& Xsk,
+    double TotalPps,
+    UINT64 Until)
+{
+    std::mt19937_64 Random(42);
+    std::exponential_distribution<double> GapNs(TotalPps / 1e9);
+    std::uniform_int_distribution<UINT32> Socket(0, (UINT32)Xsk.size() - 1);
+
+    UCHAR Frame[BenchFrameLength];
+    BuildUdpFrame(Frame, sizeof(Frame), 0x0a000001, 10000, 0xef000001, 5000);
+
+    UINT64 Next = Clock.Now();
+    while (Next < Until) {
+        Next += Clock.NsToTicks((UINT64)GapNs(Random));
+        while (Clock.Now() < Next) {
+            std::this_thread::yield();
+        }
+        UINT64 Stamp = Clock.Now();
+        memcpy(Frame + PayloadOffset, &Stamp, sizeof(Stamp));
+        Xsk[Socket(Random)]->Deliver(Frame, sizeof(Frame));
+    }
+}
+
+//
+// Sockets on one shared UMEM, each with its own rings; the NIC thread feeds
+// them at TotalPps for Seconds. Fill rings are topped up after every drain,
+// so a receiver that is descheduled for a while does not also run dry. With Reactor, one thread serves every socket
+// through XskReactor; otherwise every socket has a thread spinning on its
+// RX ring.
+//
+static bool RunReceivers(
+    const TscClock& Clock,
+    UINT32 Sockets,
+    double TotalPps,
+    UINT32 Seconds,
+    bool Reactor,
+    _Out_ ReactorRunResult* Result)
+{
+    SharedUmemConfig Config;
+    Config.ChunkCount = Sockets * BenchRingSize * 2;
+    Config.ChunkSize = BenchChunkSize;
+    Config.CacheSize = 64;
+    Config.CacheBatch = 16;
+    SharedUmem Umem(Config);
+    if (!Umem.IsValid()) {
+        return false;
+    }
+
+    std::vector<std::unique_ptr<SoftwareXsk>> Xsk;
+    std::vector<std::unique_ptr<SharedUmemSocket>> Socket;
+    for (UINT32 i = 0; i < Sockets; i++) {
+        Xsk.push_back(std::make_unique<SoftwareXsk>(Umem.Address(), Umem.TotalSize(), BenchChunkSize, BenchRingSize));
+        Socket.push_back(
+            std::make_unique<SharedUmemSocket>(&Umem, Xsk[i]->RingInfo(), BenchRingSize - BenchDrainBatch));
+        Socket[i]->Refill();
+    }
+
+    std::vector<LatencyHistogram<>> WakeupNs(Reactor ? 1 : Sockets);
+    std::vector<UINT64> CpuNs(WakeupNs.size());
+    std::atomic<bool> Done {false};
+    std::vector<std::thread> Threads;
+
+    XskReactorConfig ReactorConfig;
+    ReactorConfig.Associate = &SoftwareXsk::AssociateCompletionPort;
+    XskReactor Loop(SoftwareXdpHook::ApiTable(), ReactorConfig);
+
+    if (Reactor) {
+        if (FAILED(Loop.Open())) {
+            return false;
+        }
+        for (UINT32 i = 0; i < Sockets; i++) {
+            SharedUmemSocket* Target = Socket[i].get();
+            auto Drain = [&, Target](XSK_NOTIFY_RESULT_FLAGS) {
+                UINT32 Drained = DrainRx(Clock, Umem.Address(), Target, &WakeupNs[0]);
+                return Drained == BenchDrainBatch ? XskDrainResult::More : XskDrainResult::Idle;
+            };
+            if (FAILED(Loop.Add((HANDLE)Xsk[i].get(), XSK_NOTIFY_FLAG_WAIT_RX, Drain))) {
+                return false;
+            }
+        }
+        Threads.emplace_back([&] {
+            UINT64 Start = ThreadCpuNs();
+            Loop.Run();
+            CpuNs[0] = ThreadCpuNs() - Start;
+        });
+    } else {
+        for (UINT32 i = 0; i < Sockets; i++) {
+            Threads.emplace_back([&, i] {
+                UINT64 Start = ThreadCpuNs();
+                while (!Done.load(std::memory_order_relaxed)) {
+                    DrainRx(Clock, Umem.Address(), Socket[i].get(), &WakeupNs[i]);
+                }
+                CpuNs[i] = ThreadCpuNs() - Start;
+            });
+        }
+    }
+
+    UINT64 Start = Clock.NowOrdered();
+    GenerateTraffic(Clock, Xsk, TotalPps, Start + Clock.NsToTicks((UINT64)Seconds * 1000000000));
+
+    //
+    // Let the receivers catch up with the last frames before stopping them.
+    //
+    Sleep(10);
+    Done = true;
+    if (Reactor) {
+        Loop.Stop();
+    }
+    for (std::thread& Thread : Threads) {
+        Thread.join();
+    }
+    UINT64 WallNs = Clock.TicksToNs(Clock.NowOrdered() - Start);
+
+    for (UINT32 i = 0; i < Sockets; i++) {
+        Xsk[i]->CancelNotify();
+        Result->Dropped += Xsk[i]->Statistics().RxDropped;
+    }
+
+    UINT64 TotalCpuNs = 0;
+    for (UINT32 i = 0; i < WakeupNs.size(); i++) {
+        Result->WakeupNs.Merge(WakeupNs[i]);
+        TotalCpuNs += CpuNs[i];
+    }
+    Result->Received = Result->WakeupNs.Count();
+    Result->CpuCores = WallNs != 0 ? (double)TotalCpuNs / WallNs : 0.0;
+    Result->Notifications = Loop.Statistics().Notifications;
+    return true;
+}
+
+//
+// Wakeup latency and CPU of one IOCP reactor thread serving many low-rate
+// sockets against a spinning thread per socket.
+//
+int XskReactorBenchmark(int argc, char** argv)
+{
+    UINT32 Sockets = argc >= 1 ? atoi(argv[0]) : 32;
+    UINT32 PpsPerSocket = argc >= 2 ? atoi(argv[1]) : 1000;
+    UINT32 Seconds = argc >= 3 ? atoi(argv[2]) : 3;
+
+    if (Sockets == 0 || PpsPerSocket == 0 || Seconds == 0) {
+        fprintf(stderr, "sockets, pps and seconds must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    TscClock Clock;
+    printf(
+        "%u sockets at %u frames/s each for %u s, %u hardware threads\n\n",
+        Sockets,
+        PpsPerSocket,
+        Seconds,
+        std::thread::hardware_concurrency());
+    printf(
+        "%-8s %8s %10s %10s %10s %10s %10s %12s %8s\n",
+        "mode",
+        "threads",
+        "CPU cores",
+        "p50 us",
+        "p99 us",
+        "p99.9 us",
+        "max us",
+        "wakeups/fr",
+        "drops");
+
+    for (bool Reactor : {false, true}) {
+        auto Result = std::make_unique<ReactorRunResult>();
+        if (!RunReceivers(Clock, Sockets, (double)Sockets * PpsPerSocket, Seconds, Reactor, Result.get())) {
+            fprintf(stderr, "cannot set up %u sockets\n", Sockets);
+            return EXIT_FAILURE;
+        }
+        printf(
+            "%-8s %8u %10.2f %10.1f %10.1f %10.1f %10.1f %12.2f %8llu\n",
+            Reactor ? "iocp" : "spin",
+            Reactor ? 1 : Sockets,
+            Result->CpuCores,
+            Result->WakeupNs.ValueAtPercentile(50) / 1000.0,
+            Result->WakeupNs.ValueAtPercentile(99) / 1000.0,
+            Result->WakeupNs.ValueAtPercentile(99.9) / 1000.0,
+            Result->WakeupNs.Max() / 1000.0,
+            Result->Received != 0 ? (double)Result->Notifications / Result->Received : 0.0,
+            (unsigned long long)Result->Dropped);
+    }
+
+    return EXIT_SUCCESS;
+}
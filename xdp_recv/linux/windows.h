@@ -0,0 +1,107 @@
+#pragma once
+
+//
+// The part of <windows.h> the portable receive path uses, for building it on
+// Linux against the AF_XDP backend. afxdp.h, afxdp_helper.h and the
+// header-only ring, pool, parsing and flow pieces compile unchanged with it.
+// From the repository root, on one line:
+//
+//   g++ -std=c++20 -O2 -march=native -pthread -Ixdp_recv/linux -Ixdp-devkit-x64-1.0.2/include
+//       xdp_recv/AfXdpBackend.cpp xdp_recv/RecvmmsgBackend.cpp xdp_recv/BackendReceiver.cpp
+//       xdp_recv/BackendBench.cpp xdp_recv/xdp_recv_linux.cpp -o xdp_recv
+//
+// Nothing else in the tree is meant to build with it.
+//
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef void VOID;
+typedef void* PVOID;
+typedef void* HANDLE;
+typedef char CHAR;
+typedef uint8_t UCHAR, BYTE, UINT8, BOOLEAN;
+typedef uint16_t USHORT, UINT16;
+typedef int16_t SHORT, INT16;
+typedef int32_t LONG, INT32, BOOL, HRESULT;
+typedef uint32_t ULONG, UINT32, DWORD, UINT;
+typedef int64_t LONG64, INT64, LONG_PTR;
+typedef uint64_t ULONG64, UINT64, ULONG_PTR, UINT_PTR, SIZE_T;
+typedef ULONG* PULONG;
+
+#define CONST const
+#define TRUE 1
+#define FALSE 0
+#define FORCEINLINE inline __attribute__((always_inline))
+#define XDPAPI
+#define DUMMYUNIONNAME
+#define DUMMYSTRUCTNAME
+
+#define MAXUINT8 ((UINT8)~((UINT8)0))
+#define MAXUINT16 ((UINT16)~((UINT16)0))
+#define MAXUINT32 ((UINT32)~((UINT32)0))
+#define MAXUINT64 ((UINT64)~((UINT64)0))
+#define MAXUSHORT 0xffff
+#define INFINITE 0xFFFFFFFF
+
+#define C_ASSERT(e) static_assert(e, #e)
+#define FIELD_OFFSET(Type, Field) offsetof(Type, Field)
+#define ARRAYSIZE(A) (sizeof(A) / sizeof((A)[0]))
+#define UNREFERENCED_PARAMETER(P) (void)(P)
+#define RtlZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+
+#define DEFINE_ENUM_FLAG_OPERATORS(E)                                                       \
+    extern "C++" {                                                                          \
+    inline constexpr E operator|(E A, E B) { return E((UINT32)A | (UINT32)B); }             \
+    inline constexpr E operator&(E A, E B) { return E((UINT32)A & (UINT32)B); }             \
+    inline constexpr E operator~(E A) { return E(~(UINT32)A); }                             \
+    inline E& operator|=(E& A, E B) { return A = A | B; }                                   \
+    inline E& operator&=(E& A, E B) { return A = A & B; }                                   \
+    }
+
+//
+// The shared ring indices are plain 32-bit words on both systems.
+//
+#define ReadULongAcquire(Source) __atomic_load_n((Source), __ATOMIC_ACQUIRE)
+#define ReadULongNoFence(Source) (*(volatile ULONG*)(Source))
+#define WriteULongRelease(Destination, Value) __atomic_store_n((Destination), (Value), __ATOMIC_RELEASE)
+#define WriteULongNoFence(Destination, Value) (*(volatile ULONG*)(Destination) = (Value))
+#define YieldProcessor() __builtin_ia32_pause()
+
+//
+// HRESULTs carry errno values the way Windows code carries Win32 errors.
+//
+#define S_OK ((HRESULT)0)
+#define SUCCEEDED(Result) (((HRESULT)(Result)) >= 0)
+#define FAILED(Result) (((HRESULT)(Result)) < 0)
+#define HRESULT_FROM_WIN32(Error) \
+    ((HRESULT)(Error) <= 0 ? (HRESULT)(Error) : (HRESULT)(((Error) & 0x0000FFFF) | (7 << 16) | 0x80000000))
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define E_UNEXPECTED ((HRESULT)0x8000FFFFL)
+
+//
+// SAL annotations carry no meaning for g++.
+//
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _In_opt_z_
+#define _In_reads_(Count)
+#define _In_reads_opt_(Count)
+#define _In_reads_bytes_(Size)
+#define _In_reads_bytes_opt_(Size)
+#define _Out_
+#define _Out_opt_
+#define _Out_writes_(Count)
+#define _Out_writes_opt_(Count)
+#define _Out_writes_bytes_(Size)
+#define _Out_writes_to_(Size, Count)
+#define _Inout_
+#define _Inout_opt_
+#define _Inout_updates_(Count)
+#define _Interlocked_operand_
+#define _Ret_maybenull_
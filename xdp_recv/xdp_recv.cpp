@@ -4,6 +4,7 @@
 //
 
 #include <iostream>
+#include <optional>
 
 #include <windows.h>
 #include <stdio.h>
@@ -11,18 +12,83 @@
 #include <xdpapi.h>
 #include <afxdp_helper.h>
 
-#pragma comment(lib, "xdpapi.lib")
-
-extern void JoinMulticastGroupOnAllInterfaces(const char* group_address = "224.0.0.200");
+#include "BackendReceiver.h"
+#include "Benchmarks.h"
+#include "DecoderGenerator.h"
+#include "EpochReclaim.h"
+#include "FanOutDispatcher.h"
+#include "FillRingRefiller.h"
+#include "Ipv4Reassembler.h"
+#include "MultiBufferRing.h"
+#include "MulticastMembership.h"
+#include "NumaPlacement.h"
+#include "OrderBook.h"
+#include "RssPredictor.h"
+#include "RssRebalanceService.h"
+#include "RuleSetManager.h"
+#include "RxBurstPipeline.h"
+#include "RxLatency.h"
+#include "SharedUmem.h"
+#include "TimerWheel.h"
+#include "TscClock.h"
+#include "UmemFramePool.h"
+#include "WorkStealingPool.h"
+#include "XskBackend.h"
 
+#pragma comment(lib, "xdpapi.lib")
 
 const CHAR* UsageText =
-    "xskfwd.exe <IfIndex>"
+    "xskfwd.exe <IfIndex> [FanOutWorkers] [PrefetchDistance] [NumaNodes] [RssPeriodMs]"
     "\n"
     "Forwards RX traffic using an XDP program and AF_XDP sockets. This sample\n"
     "application forwards traffic on the specified IfIndex originally destined to\n"
     "UDP port 1234 back to the sender. Only the 0th data path queue on the interface\n"
-    "is used.\n";
+    "is used. With FanOutWorkers, frames are spread over that many worker threads\n"
+    "by flow hash; given as steal:N, they go to N work-stealing workers instead,\n"
+    "still in order per flow. PrefetchDistance is how many frames ahead the\n"
+    "receive loop prefetches frame headers and flow state (default 4).\n"
+    "\n"
+    "The UMEM and all threads are placed on the NIC's NUMA node. NumaNodes\n"
+    "overrides that per RX queue, e.g. 0=1 puts queue 0 on node 1; \"\" keeps the\n"
+    "default.\n"
+    "\n"
+    "With RssPeriodMs, the interface's RSS indirection table is rebalanced every\n"
+    "that many milliseconds from the load per RSS bucket the receive loop sees.\n"
+    "\n"
+    "xskfwd.exe --bench <name> [args...]\n"
+    "\n"
+    "Runs one of the built-in benchmarks.\n"
+    "\n"
+    "xskfwd.exe --rss-predict <file.pcap> [queues] [table-size] [hash-types] [key-hex]\n"
+    "\n"
+    "Prints the receive queue distribution RSS would give the frames of a capture.\n"
+    "\n"
+    "xskfwd.exe --decoder-gen <file.schema> [output.h]\n"
+    "\n"
+    "Generates the zero-copy message decoder for a schema, see DecoderGenerator.h.\n"
+    "\n"
+    "xskfwd.exe --receive <IfIndex> [QueueId] [Seconds] [Ports]\n"
+    "\n"
+    "Counts UDP frames to Ports per flow with the portable receiver, the same code\n"
+    "xdp_recv_linux.cpp runs over Linux AF_XDP.\n"
+    "\n"
+    "Without XDP, or without access to it, both modes fall back to receiving on\n"
+    "registered I/O UDP sockets through the portable receiver.\n";
+
+//
+// User-space route of the frames received on a subscribed port.
+//
+const UINT16 DefaultRoute = 1;
+
+//
+// UDP port of the ITCH feed (MoldUDP64) the order books are built from.
+//
+const UINT16 ItchFeedPort = 26400;
+
+//
+// Multicast group joined on the bound interface, 224.0.0.200.
+//
+const UINT32 DefaultMulticastGroup = 0xE00000C8;
 
 const XDP_HOOK_ID XdpInspectRxL2 = {
     .Layer = XDP_HOOK_L2,
@@ -42,22 +108,105 @@ static UINT16 htons(UINT16 value)
     return result;
 }
 
-static void TranslateRxToTx(_Inout_ UCHAR* Frame, _In_ UINT32 Length)
+struct UdpFrameInfo {
+    UINT16 SrcPort;
+    UINT16 DstPort;
+};
+
+static bool ParseUdpFrame(const ChainedFrame& Frame, _Out_ UdpFrameInfo* Info)
 {
     // Ethernet 0,  14
     // Ipv4:    14, 20
     // UDP      34, 8
-    if (Length > 42) {
-        UINT16 srcPort;
-        UINT16 dstPort;
-        memcpy(&srcPort, &Frame[34], 2);
-        memcpy(&dstPort, &Frame[36], 2);
-        LOGERR("Length: %u: SrcPort: %04x, DstPort: %04x", Length, htons(srcPort), htons(dstPort));
+    if (Frame.Length() <= 42) {
+        return false;
+    }
+
+    UCHAR Scratch[4];
+    const UCHAR* Ports = Frame.Peek(34, sizeof(Scratch), Scratch);
+    memcpy(&Info->SrcPort, &Ports[0], 2);
+    memcpy(&Info->DstPort, &Ports[2], 2);
+    return true;
+}
+
+//
+// What the RX thread keeps per flow.
+//
+struct RxFlow {
+    UINT64 Frames;
+    UINT64 Bytes;
+};
+
+static void TranslateRxToTx(_Inout_ UCHAR* Frame, _In_ UINT32 Length, _In_opt_ const UdpFrameInfo* Info)
+{
+    if (Info != nullptr) {
+        LOGERR("Length: %u: SrcPort: %04x, DstPort: %04x", Length, htons(Info->SrcPort), htons(Info->DstPort));
     }
 
     memset(Frame, 0, Length);
 }
 
+static void TranslateChainedRxToTx(const ChainedFrame& Frame, _In_opt_ const UdpFrameInfo* Info)
+{
+    for (UINT32 i = 0; i < Frame.SegmentCount(); i++) {
+        const FrameSegment& Segment = Frame.Segment(i);
+        TranslateRxToTx(Segment.Data, Segment.Length, i == 0 ? Info : nullptr);
+    }
+}
+
+//
+// Handles a reassembled UDP datagram in place, without linearizing it.
+// Returns false if its destination port has no route. Completed datagrams
+// are counted by the reassembler and printed at exit.
+//
+static bool HandleDatagram(
+    _In_ const UCHAR* Umem,
+    const ReassembledDatagram& Datagram,
+    _In_ const PortRoutingTable* Routes)
+{
+    const ReassemblyFragment& First = Datagram.Fragments[0];
+    if (Datagram.Protocol != IpProtocolUdp) {
+        return true;
+    }
+
+    const UdpHeader* Udp = (const UdpHeader*)(Umem + First.Address + First.DataOffset);
+    if (Routes->Lookup(Udp->DestinationPort) == PortRoutingTable::NoRoute) {
+        return false;
+    }
+    return true;
+}
+
+//
+// Without XDP, or without the right to use it (see the Readme on granting
+// access), the portable receiver still counts the port's traffic, from RIO
+// sockets instead of an XSK, until the process is stopped.
+//
+static int ReceiveOnSockets(UINT32 IfIndex, UINT32 QueueId)
+{
+    BackendReceiverConfig Config;
+    Config.IfIndex = IfIndex;
+    Config.QueueId = QueueId;
+    Config.Seconds = MAXUINT32;
+
+    auto Backend = CreateSocketBackend();
+    fprintf(stderr, "XDP unavailable, receiving through %s\n", Backend->Name());
+
+    BackendReceiverStats Stats;
+    if (auto Result = RunBackendReceiver(*Backend, Config, stdout, &Stats); FAILED(Result)) {
+        LOGERR("RunBackendReceiver failed: %x", Result);
+        return EXIT_FAILURE;
+    }
+    PrintBackendReceiverStats(stdout, Stats);
+    return EXIT_SUCCESS;
+}
+
+//
+// What an expired RX-thread timer is for, carried as its context.
+//
+enum class RxTimer : UINT64 {
+    LatencyDump,
+};
+
 int main(int argc, char** argv)
 {
     if (argc < 2) {
@@ -65,7 +214,59 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
+    if (strcmp(argv[1], "--bench") == 0) {
+        return RunBenchmark(argc - 2, argv + 2);
+    }
+
+    if (strcmp(argv[1], "--rss-predict") == 0) {
+        return RssPredictCommand(argc - 2, argv + 2);
+    }
+
+    if (strcmp(argv[1], "--decoder-gen") == 0) {
+        return DecoderGenCommand(argc - 2, argv + 2);
+    }
+
+    if (strcmp(argv[1], "--receive") == 0) {
+        auto Fallback = CreateSocketBackend();
+        const XDP_API_TABLE* XdpApi;
+        if (auto Result = XdpOpenApi(XDP_API_VERSION_1, &XdpApi); FAILED(Result)) {
+            LOGERR("XdpOpenApi failed: %x", Result);
+            return BackendReceiveCommand(*Fallback, nullptr, argc - 2, argv + 2);
+        }
+        int ExitCode = BackendReceiveCommand(*CreateXdpBackend(XdpApi), Fallback.get(), argc - 2, argv + 2);
+        XdpApi->XdpCloseApi(XdpApi);
+        return ExitCode;
+    }
+
     UINT32 IfIndex = atoi(argv[1]);
+    const CHAR* FanOutArg = argc >= 3 ? argv[2] : "0";
+    bool WorkStealing = strncmp(FanOutArg, "steal:", 6) == 0;
+    UINT32 FanOutWorkers = atoi(WorkStealing ? FanOutArg + 6 : FanOutArg);
+    UINT32 PrefetchDistance = argc >= 4 ? atoi(argv[3]) : 4;
+    UINT32 RssPeriodMs = argc >= 6 ? atoi(argv[5]) : 0;
+    UINT32 QueueId = 0;
+
+    //
+    // Keep the receiver on the NIC's NUMA node. The RX thread is pinned
+    // there before the socket exists, so the rings XDP allocates on its
+    // behalf come from the node's memory too; the UMEM is allocated there
+    // explicitly.
+    //
+    USHORT OverrideNode;
+    if (auto Result = ParseNumaOverride(argc >= 5 ? argv[4] : nullptr, QueueId, &OverrideNode); FAILED(Result)) {
+        LOGERR("Invalid NumaNodes: %s", argv[4]);
+        return EXIT_FAILURE;
+    }
+
+    NumaPlacement Placement;
+    if (auto Result = ResolveNumaPlacement(IfIndex, OverrideNode, &Placement); FAILED(Result)) {
+        LOGERR("ResolveNumaPlacement failed: %x", Result);
+        return EXIT_FAILURE;
+    }
+    if (auto Result = PinCurrentThread(Placement.RxProcessor); FAILED(Result)) {
+        LOGERR("PinCurrentThread failed: %x", Result);
+        return EXIT_FAILURE;
+    }
 
     //
     // Retrieve the XDP API dispatch table.
@@ -73,16 +274,24 @@ int main(int argc, char** argv)
     const XDP_API_TABLE* XdpApi;
     if (auto Result = XdpOpenApi(XDP_API_VERSION_1, &XdpApi); FAILED(Result)) {
         LOGERR("XdpOpenApi failed: %x", Result);
-        return EXIT_FAILURE;
+        return ReceiveOnSockets(IfIndex, QueueId);
     }
 
+    //
+    // Sockets are set up through the backend, the part of the control path
+    // that differs between XDP for Windows and Linux AF_XDP. The program
+    // stays with RuleSetManager, which swaps rule sets on the XDP API.
+    //
+    std::unique_ptr<XskBackend> Backend = CreateXdpBackend(XdpApi);
+
     //
     // Create an AF_XDP socket. The newly created socket is not connected.
+    // Access to XDP is checked here, so a denial falls back to sockets.
     //
     HANDLE Socket;
-    if (auto Result = XdpApi->XskCreate(&Socket); FAILED(Result)) {
+    if (auto Result = Backend->CreateSocket(&Socket); FAILED(Result)) {
         LOGERR("XskCreate failed: %x", Result);
-        return EXIT_FAILURE;
+        return ReceiveOnSockets(IfIndex, QueueId);
     }
 
     //
@@ -90,60 +299,61 @@ int main(int argc, char** argv)
     // available mapped into AF_XDP's address space, and elements of descriptor
     // rings refer to relative offsets from the start of the UMEM.
     //
-    DWORD NumChunks = 16;
-    DWORD ChunkSize = 16384;
-    DWORD TotalSize = NumChunks * ChunkSize;
-    LPVOID Frame = VirtualAlloc(NULL, TotalSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-
-    if (Frame == nullptr) {
-        LOGERR("VirtualAlloc failed!");
-        return EXIT_FAILURE;
-    }
-
-    XSK_UMEM_REG UmemReg {
-        .TotalSize = TotalSize,
-        .ChunkSize = ChunkSize,
-        .Address = Frame,
-    };
-    if (auto Result = XdpApi->XskSetSockopt(Socket, XSK_SOCKOPT_UMEM_REG, &UmemReg, sizeof(UmemReg)); FAILED(Result)) {
-        LOGERR("XSK_UMEM_REG failed: %x", Result);
-        return EXIT_FAILURE;
-    }
-
+    // The UMEM holds a fill ring's worth of chunks plus a spare pool, so frames
+    // held by the application do not starve the fill ring. Fragments waiting
+    // for reassembly get chunks of their own on top.
     //
-    // Bind the AF_XDP socket to the specified interface and 0th data path
-    // queue, and indicate the intent to perform RX and TX actions.
+    // A chunk has to hold the largest frame unless the RX ring chains frames
+    // over several descriptors. XDP 1.0.2 has no way to ask for that on an
+    // AF_XDP socket, so FragmentOffset stays zero; with it, 4 KiB chunks do.
     //
-    if (auto Result = XdpApi->XskBind(Socket, IfIndex, 0, XSK_BIND_FLAG_RX); FAILED(Result)) {
-        LOGERR("XskBind failed: %x", Result);
+    UINT32 RingSize = 16;
+    UINT32 FillLowWatermark = RingSize / 2;
+    UINT32 ReassemblyDatagrams = 4;
+    UINT32 ReassemblyFragments = 12;
+    DWORD SpareChunks = RingSize + ReassemblyDatagrams * ReassemblyFragments;
+    DWORD NumChunks = RingSize + SpareChunks;
+    UINT32 FragmentOffset = 0;
+    DWORD ChunkSize = FragmentOffset != 0 ? 4096 : 16384;
+    SharedUmemConfig UmemConfig;
+    UmemConfig.ChunkCount = NumChunks;
+    UmemConfig.ChunkSize = ChunkSize;
+    UmemConfig.Node = Placement.Node;
+    SharedUmem Umem(UmemConfig);
+    if (!Umem.IsValid()) {
+        LOGERR("VirtualAllocExNuma failed!");
         return EXIT_FAILURE;
     }
+    LPVOID Frame = Umem.Address();
 
-    //
-    // Request a set of RX and RX fill descriptor rings.
-    // XDP will create the rings and map them into the process address space as part
-    // of the XskActivate step further below.
-    //
-
-    UINT32 RingSize = NumChunks;
-    if (auto Result = XdpApi->XskSetSockopt(Socket, XSK_SOCKOPT_RX_RING_SIZE, &RingSize, sizeof(RingSize));
-        FAILED(Result)) {
-        LOGERR("XSK_SOCKOPT_RX_RING_SIZE failed: %x", Result);
-        return EXIT_FAILURE;
+    PrintNumaPlacement(stdout, IfIndex, QueueId, Placement);
+    UINT32 PagesOnNode;
+    UINT32 PagesSampled;
+    if (SUCCEEDED(CountPagesOnNode(Frame, Umem.TotalSize(), Placement.Node, 1024, &PagesOnNode, &PagesSampled))) {
+        printf("NUMA: %u of %u sampled UMEM pages on node %u\n", PagesOnNode, PagesSampled, Placement.Node);
     }
 
-    if (auto Result = XdpApi->XskSetSockopt(Socket, XSK_SOCKOPT_RX_FILL_RING_SIZE, &RingSize, sizeof(RingSize));
-        FAILED(Result)) {
-        LOGERR("XSK_SOCKOPT_RX_FILL_RING_SIZE failed: %x", Result);
+    //
+    // The UMEM is registered per socket; sockets for further queues register
+    // the same one and take their frames from its depot.
+    //
+    if (auto Result = Backend->RegisterUmem(Socket, Umem.Registration()); FAILED(Result)) {
+        LOGERR("XSK_UMEM_REG failed: %x", Result);
         return EXIT_FAILURE;
     }
 
     //
-    // Activate the AF_XDP socket. Once activated, descriptor rings are
-    // available and RX can occur.
+    // Bind the AF_XDP socket to the specified interface and 0th data path
+    // queue, and indicate the intent to perform RX actions, with a set of RX
+    // and RX fill descriptor rings. XDP creates the rings and maps them into
+    // the process address space as the socket is activated at the end of
+    // the bind.
     //
-    if (auto Result = XdpApi->XskActivate(Socket, XSK_ACTIVATE_FLAG_NONE); FAILED(Result)) {
-        LOGERR("XskActivate failed: %x", Result);
+    XskRingSizes RingSizes {};
+    RingSizes.Rx = RingSize;
+    RingSizes.Fill = RingSize;
+    if (auto Result = Backend->Bind(Socket, IfIndex, QueueId, XSK_BIND_FLAG_RX, RingSizes); FAILED(Result)) {
+        LOGERR("Bind failed: %x", Result);
         return EXIT_FAILURE;
     }
 
@@ -151,8 +361,7 @@ int main(int argc, char** argv)
     // Retrieve the RX, RX fill, TX, and TX completion ring info from AF_XDP.
     //
     XSK_RING_INFO_SET RingInfo;
-    UINT32 OptionLength = sizeof(RingInfo);
-    if (auto Result = XdpApi->XskGetSockopt(Socket, XSK_SOCKOPT_RING_INFO, &RingInfo, &OptionLength); FAILED(Result)) {
+    if (auto Result = Backend->GetRingInfo(Socket, &RingInfo); FAILED(Result)) {
         LOGERR("XSK_SOCKOPT_RING_INFO failed: %x", Result);
         return EXIT_FAILURE;
     }
@@ -167,113 +376,440 @@ int main(int argc, char** argv)
     XskRingInitialize(&RxFillRing, &RingInfo.Fill);
 
     //
-    // Place an empty frame descriptor into the RX fill ring. When the AF_XDP
+    // Per-stage latency histograms, dumped once per second. NIC timestamps are
+    // used when the RX ring carries them, otherwise the TSC at dequeue. The
+    // clock is calibrated once here and kept in step by a background thread,
+    // so the loop below only ever executes RDTSC.
+    //
+    TscClock Clock;
+    Clock.StartDriftCorrection();
+
+    RxLatencyRecorder Latency(Clock);
+    Latency.ConfigureRxRing(&RingInfo.Rx);
+    printf(
+        "RX frame timestamps: %s\n",
+        Latency.HasFrameTimestamps() ? "available" : "unavailable, using TSC at dequeue");
+
+    //
+    // Place empty frame descriptors into the RX fill ring. When the AF_XDP
     // socket receives a frame from XDP, it will pop the first available
     // frame descriptor from the RX fill ring and copy the frame payload into
-    // that descriptor's buffer.
+    // that descriptor's buffer. The value of each RX fill ring element is an
+    // offset from the start of the UMEM to the start of the frame.
+    //
+    // All chunks start out in the UMEM's depot. The frame pool is this
+    // socket's cache of it, large enough to hold every chunk; the refiller
+    // tops the fill ring up from it whenever the ring drops below the low
+    // watermark.
     //
-    UINT32 StartRingIndex;
-    if (XskRingProducerReserve(&RxFillRing, NumChunks, &StartRingIndex) != NumChunks) {
-        LOGERR("XskRingProducerReserve failed to get all descriptors");
+    UmemFramePool FramePool(NumChunks, Umem.Depot(), RingSize);
+
+    FillRingRefiller Refiller(&RxFillRing, &FramePool, FillLowWatermark);
+    if (Refiller.Refill() != RingSize) {
+        LOGERR("Failed to post all fill descriptors");
         return EXIT_FAILURE;
     }
 
-    for (DWORD i = 0; i < NumChunks; i++) {
-        //
-        // The value of each RX fill and TX completion ring element is an offset
-        // from the start of the UMEM to the start of the frame. Since this sample
-        // is using a single buffer, the offset is always zero.
-        //
-        *(UINT32*)XskRingGetElement(&RxFillRing, StartRingIndex + i) = i * ChunkSize;
-        std::cout << "RingIndex + " << i << ": " << i * ChunkSize << std::endl;
-    }
-
-    XskRingProducerSubmit(&RxFillRing, NumChunks);
-
-    //
-    // Create an XDP program using the parsed rule at the L2 inspect hook point.
-    // The rule intercepts all UDP frames destined to local port Pattern.Port and
-    // redirects them to the AF_XDP socket.
-    //
-    XDP_RULE Rule[] {
-        {
-            .Match = XDP_MATCH_UDP, // XDP_MATCH_UDP_DST
-            .Pattern =
-                {
-                    .Port = htons(0x4321),
-                },
-            .Action = XDP_PROGRAM_ACTION_REDIRECT,
-            .Redirect =
-                {
-                    .TargetType = XDP_REDIRECT_TARGET_TYPE_XSK,
-                    .Target = Socket,
-                },
-        },
-    };
+    //
+    // Create an XDP program at the L2 inspect hook point that intercepts all
+    // UDP frames destined to the subscribed local ports and redirects them to
+    // the AF_XDP socket. Subscriptions can be changed at runtime with Apply():
+    // the replacement program is attached before the old one is closed, and
+    // the routing table the loop below reads is swapped without a lock.
+    //
+    EpochDomain RcuDomain(1);
+    UINT32 RxReader = RcuDomain.RegisterReader();
 
-    HANDLE Program;
-    if (auto Result = XdpApi->XdpCreateProgram(
-            IfIndex, &XdpInspectRxL2, 0, XDP_CREATE_PROGRAM_FLAG_ALL_QUEUES, &Rule[0], (DWORD)std::size(Rule), &Program);
-        FAILED(Result)) {
+    RuleSetManager Subscriptions(XdpApi, IfIndex, &XdpInspectRxL2, Socket, RcuDomain);
+    if (auto Result = Subscriptions.Apply({{0x4321, DefaultRoute}, {ItchFeedPort, DefaultRoute}}); FAILED(Result)) {
         LOGERR("XdpCreateProgram failed: %x", Result);
         return EXIT_FAILURE;
     }
 
-    JoinMulticastGroupOnAllInterfaces();
+    //
+    // Join the groups on the bound interface only; other NICs would pull in
+    // copies no program redirects. Like the port subscriptions, the groups
+    // can be changed at runtime with Apply(). A failed join is not fatal:
+    // unicast and already-flooded traffic still arrives.
+    //
+    MulticastMembership Multicast(IfIndex);
+    if (auto Result = Multicast.Apply({{DefaultMulticastGroup, MulticastSubscription::AnySource}}); FAILED(Result)) {
+        LOGERR("Joining multicast groups on interface %u failed: %x", IfIndex, Result);
+    } else {
+        printf("Joined %zu multicast groups on interface %u\n", Multicast.Memberships().size(), IfIndex);
+    }
+
+    //
+    // Optional software fan-out for interfaces with fewer RX queues than
+    // cores: the loop below only parses and routes, and hands each frame to
+    // a worker picked by the Toeplitz hash of its flow. Workers hand frames
+    // back through the dispatcher; only this thread touches the frame pool.
+    // Workers get the other processors of the RX thread's node, one each.
+    //
+    // With steal:N the frames go to a WorkStealingPool instead, for handlers
+    // whose cost varies too much per flow for a static mapping. The loop
+    // batches them and submits each batch with the flow hash of every frame
+    // as its ordering key, so a flow's frames still run one at a time and in
+    // order.
+    //
+    PROCESSOR_NUMBER HashOnlyTable {};
+    RssPredictor FlowHasher(
+        XDP_RSS_VALID_HASH_TYPES, RssPredictor::DefaultKey, sizeof(RssPredictor::DefaultKey), &HashOnlyTable, 1);
+    FanOutConfig FanOut;
+    FanOut.Workers = WorkStealing ? 0 : FanOutWorkers;
+    FanOut.WorkerAffinity = Placement.Processors;
+    if (ProcessorCount(Placement.Processors) > 1) {
+        FanOut.WorkerAffinity.Mask &= ~Placement.RxProcessor.Mask;
+    }
+    FanOutDispatcher Dispatcher(FanOut, &FlowHasher);
+    std::optional<WorkStealingPool> Stealing;
+    FanOutDispatcher::Handler FanOutHandler = [](UINT32, const FanOutFrame* Frames, UINT32 Count) {
+        for (UINT32 i = 0; i < Count; i++) {
+            TranslateRxToTx(Frames[i].Data, Frames[i].Length, nullptr);
+        }
+    };
+    UINT64 FanOutDrops = 0;
+    FanOutFrame StealBatch[32];
+    UINT32 StealKeys[32];
+    UINT32 StealCount = 0;
+    if (FanOutWorkers != 0 && WorkStealing) {
+        WorkStealingConfig StealConfig;
+        StealConfig.Workers = FanOutWorkers;
+        StealConfig.MaxBatch = (UINT32)std::size(StealBatch);
+        Stealing.emplace(StealConfig);
+        Stealing->Start(FanOutHandler);
+    } else if (FanOutWorkers != 0) {
+        Dispatcher.Start(FanOutHandler);
+    }
+
+    auto SubmitStealBatch = [&] {
+        if (StealCount != 0 && !Stealing->Submit(StealBatch, StealCount, StealKeys)) {
+            for (UINT32 i = 0; i < StealCount; i++) {
+                FramePool.Free(StealBatch[i].Address);
+            }
+            FanOutDrops += StealCount;
+        }
+        StealCount = 0;
+    };
+
+    //
+    // Optional RSS rebalancing. The loop below hashes every frame with the
+    // NIC's own hash types and key, counts it against its bucket of the
+    // indirection table, and the service moves buckets between the table's
+    // processors when one of them carries too much. Without XdpRssGet and
+    // XdpRssSet the forwarder runs on without it.
+    //
+    RssRebalanceService Rebalancer(XdpApi, IfIndex);
+    std::unique_ptr<RssPredictor> RssHasher;
+    std::unique_ptr<RssLoadCounters> RssCounters;
+    if (RssPeriodMs != 0) {
+        HRESULT Result = Rebalancer.Open();
+        if (SUCCEEDED(Result)) {
+            Result = Rebalancer.CreateHasher(&RssHasher);
+        }
+        if (FAILED(Result)) {
+            LOGERR("RSS rebalancing unavailable on interface %u: %x", IfIndex, Result);
+        } else {
+            RssCounters = std::make_unique<RssLoadCounters>(1, Rebalancer.BucketCount());
+            Rebalancer.Start(*RssCounters, RssPeriodMs);
+            printf(
+                "Rebalancing %u RSS buckets over %zu processors every %u ms\n",
+                Rebalancer.BucketCount(),
+                Rebalancer.Processors().size(),
+                RssPeriodMs);
+        }
+    }
+
+    //
+    // Feeds send datagrams of up to 16 KB that arrive as IPv4 fragments.
+    // Their frames stay in the UMEM until the datagram completes or times
+    // out; memory is bounded by the slot and fragment limits.
+    //
+    Ipv4ReassemblerConfig ReassemblyConfig;
+    ReassemblyConfig.MaxDatagrams = ReassemblyDatagrams;
+    ReassemblyConfig.MaxFragments = ReassemblyFragments;
+    ReassemblyConfig.TimeoutTicks = Clock.NsToTicks(30 * 1000000ull);
+    Ipv4Reassembler Reassembler(ReassemblyConfig, &FramePool);
+
+    //
+    // RX-thread timers live on one timer wheel, turned between bursts with a
+    // bounded number of expiries per turn, each kind with its own RxTimer.
+    // So far that is the periodic latency dump. Fragment reassembly keeps its
+    // own wheel of datagram timeouts, turned by Expire() after every burst.
+    //
+    TimerWheelConfig TimerConfig;
+    TimerConfig.ResolutionTicks = Clock.NsToTicks(10000);
+    TimerWheel Timers(TimerConfig, Clock.Now());
+    UINT64 LatencyDumpTicks = Clock.NsToTicks(1000 * 1000000ull);
+    Timers.Schedule(Clock.Now() + LatencyDumpTicks, (UINT64)RxTimer::LatencyDump);
+
+    //
+    // Per-flow state, looked up by 5-tuple on every frame. Flows idle for a
+    // minute are dropped by a sweep that checks 64 of them per iteration.
+    //
+    FlowTableConfig FlowConfig;
+    FlowConfig.MaxFlows = 65536;
+    FlowConfig.IdleTicks = Clock.NsToTicks(60 * 1000000000ull);
+    FlowTable<RxFlow> Flows(FlowConfig);
 
     //
     // Continuously scan the RX ring and TX completion ring for new descriptors.
-    // For simplicity, this loop performs actions one frame at a time. This can
-    // be optimized further by consuming, reserving, and submitting batches of
-    // frames across each XskRing* function.
+    // Frames are taken off the RX ring a burst at a time and run through a
+    // prefetch pipeline (see RxBurstPipeline.h) that brings in each frame's
+    // headers and flow state a few frames before the handler needs them.
+    //
+    // Frames are read as chained frames, which may span several descriptors;
+    // the parser peeks at the headers in place.
     //
+    UCHAR* pFrame = (UCHAR*)Frame;
+    MultiBufferRx FrameReader(&RxRing, FragmentOffset, pFrame, &FramePool);
+    RxBurstPipeline<RxFlow> Pipeline(&Flows, PrefetchDistance);
+    constexpr UINT32 RxBurst = 32;
+
+    //
+    // Feed datagrams update the order books a burst at a time, before the
+    // handler below forwards them like any other routed frame.
+    //
+    OrderBookConfig BookConfig;
+    BookConfig.MaxOrders = 1 << 20;
+    BookConfig.Port = ItchFeedPort;
+    OrderBookBuilder Books(BookConfig);
+
+    auto RxFrames = std::make_unique<ChainedFrame[]>(RxBurst);
+    const VOID* RxDescriptors[RxBurst];
+    UINT64 DequeueTicks[RxBurst];
+    UINT64 UnroutedFrames = 0;
+    UINT64 ReceivedFrames = 0;
     while (TRUE) {
-        if (XskRingConsumerReserve(&RxRing, 1, &StartRingIndex) == 1) {
-            XSK_BUFFER_DESCRIPTOR* RxBuffer;
+        UINT32 Burst = 0;
+        while (Burst < RxBurst && FrameReader.Receive(&RxFrames[Burst], &RxDescriptors[Burst])) {
+            DequeueTicks[Burst] = Latency.OnDequeue(RxDescriptors[Burst]);
+            Burst++;
+        }
+        if (Burst != 0) {
+            Books.ApplyBurst(RxFrames.get(), Burst);
+        }
 
+        Pipeline.Run(RxFrames.get(), Burst, Clock.Now(), [&](UINT32 Index, RxFlow* Flow) {
             //
             // A new RX frame appeared on the RX ring. Forward it to the TX
             // ring.
-
-            RxBuffer = (XSK_BUFFER_DESCRIPTOR*)XskRingGetElement(&RxRing, StartRingIndex);
+            //
+            const ChainedFrame& RxFrame = RxFrames[Index];
+            UINT64 DequeueTick = DequeueTicks[Index];
+            if (Flow != nullptr) {
+                Flow->Frames++;
+                Flow->Bytes += RxFrame.Length();
+            }
 
             //
             // Swap source and destination fields within the frame payload.
             //
-            UCHAR* pFrame = (UCHAR*)Frame;
-            std::cout << "AddressAndOffset: " << *(UINT32*)(RxBuffer) << std::endl;
-            TranslateRxToTx(&pFrame[RxBuffer->Address.AddressAndOffset], RxBuffer->Length);
+            UdpFrameInfo Info;
+            bool IsUdp = ParseUdpFrame(RxFrame, &Info);
+            UINT64 ParseTick = Clock.Now();
+            Latency.RecordTicks(RxStage::RingToParse, DequeueTick, ParseTick);
 
             //
-            // Advance the consumer index of the RX ring and the producer index
-            // of the TX ring, which allows XDP to write and read the descriptor
-            // elements respectively.
+            // Frames of a port that was just unsubscribed can still be in the
+            // ring; they have no route any more and are dropped here.
+            //
+            // Fragments are held by the reassembler; a completed datagram is
+            // routed by the UDP header in its first fragment and handled in
+            // place, on this thread. The reassembler and the workers take
+            // single-buffer frames; a chained frame is handled right here.
+            // Both read the frame at Head.Data and hold on to its chunk,
+            // which is what goes back to the pool.
             //
-            XskRingConsumerRelease(&RxRing, 1);
+            const FrameSegment& Head = RxFrame.Segment(0);
+            UINT64 HeadChunk = Head.Chunk();
+            bool Chained = RxFrame.SegmentCount() > 1;
+            bool Retained = false;
+            ReassembledDatagram Datagram;
+            ReassemblyResult Reassembly = ReassemblyResult::NotFragment;
+            if (!Chained) {
+                Reassembly = Reassembler.Submit(
+                    Head.Data, HeadChunk, Head.ChunkOffset(), Head.Length, DequeueTick, &Datagram);
+            }
+            RcuDomain.Enter(RxReader);
+            if (Reassembly != ReassemblyResult::NotFragment) {
+                Retained = true;
+                if (Reassembly == ReassemblyResult::Complete) {
+                    if (!HandleDatagram(pFrame, Datagram, Subscriptions.RoutingTable())) {
+                        UnroutedFrames++;
+                    }
+                    Reassembler.Release(Datagram);
+                }
+            } else if (IsUdp && Subscriptions.RoutingTable()->Lookup(Info.DstPort) == PortRoutingTable::NoRoute) {
+                UnroutedFrames++;
+            } else if (Stealing.has_value() && !Chained) {
+                UINT32 Hash = Dispatcher.FlowHash(Head.Data, Head.Length);
+                StealBatch[StealCount] = {Head.Data, HeadChunk, Head.Length, Hash};
+                StealKeys[StealCount] = Hash;
+                if (++StealCount == std::size(StealBatch)) {
+                    SubmitStealBatch();
+                }
+                Retained = true;
+            } else if (FanOutWorkers != 0 && !Chained) {
+                Retained = Dispatcher.Dispatch(Head.Data, HeadChunk, Head.Length);
+                FanOutDrops += !Retained;
+            } else {
+                TranslateChainedRxToTx(RxFrame, IsUdp ? &Info : nullptr);
+            }
+            RcuDomain.Exit(RxReader);
+            UINT64 HandlerDoneTick = Clock.Now();
+            Latency.RecordTicks(RxStage::ParseToHandlerDone, ParseTick, HandlerDoneTick);
+
+            UINT32 RssHash;
+            if (RssCounters != nullptr && RssHasher->HashFrame(Head.Data, Head.Length, &RssHash)) {
+                RssCounters->Record(0, RssHash & (RssCounters->BucketCount() - 1));
+            }
 
             //
-            // Reserve space in the RX fill ring. Since we're only using one
-            // frame in this sample, space is guaranteed to be available.
+            // The handler is done with the frame; return it to the pool. The
+            // refiller below decides when it goes back to the fill ring.
+            // Dispatched frames come back through Reclaim() once their
+            // worker is done with them, fragments once their datagram
+            // completes or expires.
             //
-            XskRingProducerReserve(&RxFillRing, 1, &StartRingIndex);
-            *(UINT32*)XskRingGetElement(&RxFillRing, StartRingIndex) = *(UINT32*)RxBuffer;
-            XskRingProducerSubmit(&RxFillRing, 1);
+            if (!Retained) {
+                RxFrame.Release(&FramePool);
+            }
+        });
+
+        //
+        // Advance the consumer index of the RX ring and the producer index
+        // of the TX ring, which allows XDP to write and read the descriptor
+        // elements respectively.
+        //
+        if (Burst != 0) {
+            FrameReader.Release();
+        }
 
-            static DWORD counter = 0;
-            if (counter++ > NumChunks)
+        ReceivedFrames += Burst;
+        if (ReceivedFrames > NumChunks)
+            break;
+
+        if (Stealing.has_value()) {
+            SubmitStealBatch();
+            Stealing->Reclaim(&FramePool);
+        } else if (FanOutWorkers != 0) {
+            Dispatcher.Flush();
+            Dispatcher.Reclaim(&FramePool);
+        }
+        Refiller.Refill();
+        UINT64 Now = Clock.Now();
+        Reassembler.Expire(Now);
+        Flows.ExpireIdle(Now, 64);
+
+        UINT64 ExpiredTimers[32];
+        UINT32 ExpiredCount = Timers.Advance(Now, ExpiredTimers, (UINT32)std::size(ExpiredTimers));
+        for (UINT32 i = 0; i < ExpiredCount; i++) {
+            switch ((RxTimer)ExpiredTimers[i]) {
+            case RxTimer::LatencyDump:
+                Latency.Dump(stdout);
+                Timers.Schedule(Now + LatencyDumpTicks, (UINT64)RxTimer::LatencyDump);
                 break;
+            }
         }
     }
 
+    if (Stealing.has_value()) {
+        SubmitStealBatch();
+        Stealing->Stop(&FramePool);
+    }
+    Dispatcher.Stop(&FramePool);
+    Rebalancer.Stop();
+    Latency.Dump(stdout);
+
+    XSK_STATISTICS Statistics {};
+    UINT32 OptionLength = sizeof(Statistics);
+    if (auto Result = XdpApi->XskGetSockopt(Socket, XSK_SOCKOPT_STATISTICS, &Statistics, &OptionLength);
+        FAILED(Result)) {
+        LOGERR("XSK_SOCKOPT_STATISTICS failed: %x", Result);
+    }
+
+    const FillRingStats& FillStats = Refiller.Statistics();
+    printf(
+        "RxDropped: %llu, unrouted: %llu, fill ring starvation: %llu, fill ring empty: %llu, refills: %llu, "
+        "frames lost: %llu\n",
+        (unsigned long long)Statistics.RxDropped,
+        (unsigned long long)UnroutedFrames,
+        (unsigned long long)FillStats.StarvationEvents,
+        (unsigned long long)FillStats.EmptyEvents,
+        (unsigned long long)FillStats.Refills,
+        (unsigned long long)FramePool.Lost());
+
+    const FlowTableStats& FlowStats = Flows.Statistics();
+    printf(
+        "flows: %u live, %llu seen, %llu idle, %llu evicted while full\n",
+        Flows.Flows(),
+        (unsigned long long)FlowStats.Inserts,
+        (unsigned long long)FlowStats.IdleEvictions,
+        (unsigned long long)FlowStats.FullEvictions);
+
+    const Ipv4ReassemblerStats& ReassemblyStats = Reassembler.Statistics();
+    printf(
+        "reassembly: %llu fragments, %llu datagrams, %llu timeouts, %llu evictions, %llu malformed, "
+        "%llu overlaps\n",
+        (unsigned long long)ReassemblyStats.Fragments,
+        (unsigned long long)ReassemblyStats.Datagrams,
+        (unsigned long long)ReassemblyStats.Timeouts,
+        (unsigned long long)ReassemblyStats.Evictions,
+        (unsigned long long)ReassemblyStats.Malformed,
+        (unsigned long long)ReassemblyStats.Overlaps);
+
+    const OrderBookStats& BookStats = Books.Statistics();
+    printf(
+        "order books: %llu messages, %llu updates, %u orders resting, %llu unknown, %llu top-of-book snapshots\n",
+        (unsigned long long)BookStats.Messages,
+        (unsigned long long)BookStats.Updates,
+        Books.Orders(),
+        (unsigned long long)BookStats.UnknownOrders,
+        (unsigned long long)BookStats.Published);
+
+    if (RssCounters != nullptr) {
+        const RssRebalancerStats& RssStats = Rebalancer.Statistics();
+        printf(
+            "RSS rebalancing: %llu periods, %llu table rewrites, %llu buckets moved, %llu unsplittable\n",
+            (unsigned long long)RssStats.Periods,
+            (unsigned long long)RssStats.Rewrites,
+            (unsigned long long)RssStats.BucketsMoved,
+            (unsigned long long)RssStats.Unsplittable);
+    }
+
+    if (FanOutWorkers != 0) {
+        printf("fan-out: %llu frames dropped with no room for them\n", (unsigned long long)FanOutDrops);
+    }
+
+    for (UINT32 Worker = 0; Stealing.has_value() && Worker < Stealing->Workers(); Worker++) {
+        WorkStealingStats WorkerStats = Stealing->Statistics(Worker);
+        printf(
+            "work-stealing worker %u: tasks: %llu, frames: %llu, steals: %llu\n",
+            Worker,
+            (unsigned long long)WorkerStats.Tasks,
+            (unsigned long long)WorkerStats.Frames,
+            (unsigned long long)WorkerStats.Steals);
+    }
+
+    for (UINT32 Worker = 0; Worker < FanOut.Workers; Worker++) {
+        FanOutWorkerStats WorkerStats = Dispatcher.Statistics(Worker);
+        printf(
+            "fan-out worker %u: handled: %llu, ring full: %llu\n",
+            Worker,
+            (unsigned long long)WorkerStats.Handled,
+            (unsigned long long)WorkerStats.RingFullDrops);
+    }
+
     //
     // Close the XDP program. Traffic will no longer be intercepted by XDP.
     //
-    CloseHandle(Program);
+    Subscriptions.Apply({});
 
     //
     // Close the AF_XDP socket. All socket resources will be cleaned up by XDP.
     //
-    CloseHandle(Socket);
+    Backend->CloseSocket(Socket);
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,61 @@
+//
+// The portable receiver on Linux AF_XDP. See linux/windows.h for the build.
+//
+// Try it on a veth pair, redirecting what one end receives:
+//
+//   ip link add vxa type veth peer name vxb
+//   ip link set vxa up && ip link set vxb up
+//   ./xdp_recv vxb 0 10 17185
+//
+// and send UDP to port 17185 (0x4321) into vxa from another shell.
+//
+
+#if defined(__linux__)
+
+#include <windows.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BackendReceiver.h"
+#include "Benchmarks.h"
+
+static const char UsageText[] =
+    "xdp_recv <Interface> [QueueId] [Seconds] [Ports]\n"
+    "\n"
+    "Receives UDP traffic to Ports (comma separated, default 17185) on QueueId of\n"
+    "Interface (a name or an index) through an AF_XDP socket for Seconds, counting\n"
+    "frames per flow. Without AF_XDP support or the privileges for it, receives\n"
+    "through recvmmsg() on UDP sockets instead.\n"
+    "\n"
+    "xdp_recv --bench backends <IfIndex> [seconds] [payload] [port]\n"
+    "\n"
+    "Compares AF_XDP and recvmmsg() receiving from a loopback sender.\n";
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, UsageText);
+        return EXIT_FAILURE;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0 && strcmp(argv[2], "backends") == 0) {
+        return BackendBenchmark(argc - 3, argv + 3);
+    }
+
+    //
+    // Interfaces are usually named here; the command takes the index.
+    //
+    char IfIndex[16];
+    if (UINT32 Index = if_nametoindex(argv[1]); Index != 0) {
+        snprintf(IfIndex, sizeof(IfIndex), "%u", Index);
+        argv[1] = IfIndex;
+    }
+
+    auto Backend = CreateAfXdpBackend();
+    auto Fallback = CreateSocketBackend();
+    return BackendReceiveCommand(*Backend, Fallback.get(), argc - 1, argv + 1);
+}
+
+#endif